@@ -26,8 +26,10 @@ AsyncTcpClient::AsyncTcpClient(EventLoop* loop)
 }
 
 void AsyncTcpClient::RunInCoroutine(
-    const AsyncTcpConnectionCoroutine::CoroutineFunc& func) {
-  auto co = alpha::make_unique<AsyncTcpConnectionCoroutine>(this, func);
+    const AsyncTcpConnectionCoroutine::CoroutineFunc& func,
+    Coroutine::StackMode stack_mode) {
+  auto co =
+      alpha::make_unique<AsyncTcpConnectionCoroutine>(this, func, stack_mode);
   coroutines_.emplace_back(std::move(co));
   (*coroutines_.rbegin())->Resume();
 }
@@ -22,7 +22,10 @@ class EventLoop;
 class AsyncTcpClient {
  public:
   AsyncTcpClient(EventLoop* loop);
-  void RunInCoroutine(const AsyncTcpConnectionCoroutine::CoroutineFunc& func);
+  // 调用栈比较深的func可以使用kDedicated, 避免每次切换都拷贝栈
+  void RunInCoroutine(
+      const AsyncTcpConnectionCoroutine::CoroutineFunc& func,
+      Coroutine::StackMode stack_mode = Coroutine::StackMode::kShared);
   std::shared_ptr<AsyncTcpConnection> ConnectTo(
       const NetAddress& addr, AsyncTcpConnectionCoroutine* co);
   EventLoop* loop() const { return loop_; }
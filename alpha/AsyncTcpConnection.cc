@@ -47,9 +47,8 @@ void AsyncTcpConnection::Write(alpha::Slice data) {
 }
 
 void AsyncTcpConnection::WaitWriteDone() {
-  size_t length;
-  auto p = conn_->WriteBuffer()->Read(&length);
-  if (!p) return;
+  auto length = conn_->BytesToWrite();
+  if (length == 0) return;
 
   DLOG_INFO << length << " bytes to send";
   SetWaitingWriteDone();
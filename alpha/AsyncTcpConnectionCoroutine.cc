@@ -17,8 +17,12 @@
 
 namespace alpha {
 AsyncTcpConnectionCoroutine::AsyncTcpConnectionCoroutine(
-    AsyncTcpClient* owner, const CoroutineFunc& func)
-    : timeout_(false), owner_(owner), func_(func), timeout_timer_id_(0) {}
+    AsyncTcpClient* owner, const CoroutineFunc& func, StackMode stack_mode)
+    : Coroutine(stack_mode),
+      timeout_(false),
+      owner_(owner),
+      func_(func),
+      timeout_timer_id_(0) {}
 
 AsyncTcpConnectionCoroutine::~AsyncTcpConnectionCoroutine() {
   MaybeCancelTimeoutTimer();
@@ -21,7 +21,9 @@ class AsyncTcpConnectionCoroutine final : public Coroutine {
  public:
   using CoroutineFunc =
       std::function<void(AsyncTcpClient*, AsyncTcpConnectionCoroutine*)>;
-  AsyncTcpConnectionCoroutine(AsyncTcpClient* owner, const CoroutineFunc& func);
+  AsyncTcpConnectionCoroutine(AsyncTcpClient* owner,
+                              const CoroutineFunc& func,
+                              StackMode stack_mode = StackMode::kShared);
   ~AsyncTcpConnectionCoroutine();
   virtual void Routine() override;
   virtual void Resume() override;
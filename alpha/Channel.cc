@@ -26,7 +26,14 @@ const int Channel::kWriteEvents = EPOLLOUT;
 const int Channel::kNoneEvents = 0;
 
 Channel::Channel(EventLoop* loop, int fd)
-    : loop_(loop), fd_(fd), events_(0), revents_(0), handling_events_(false) {}
+    : loop_(loop),
+      fd_(fd),
+      events_(0),
+      revents_(0),
+      registered_events_(0),
+      registered_(false),
+      edge_triggered_(false),
+      handling_events_(false) {}
 
 Channel::~Channel() {
   LOG_ERROR_IF(handling_events_) << "Destroy Channel when handling events"
@@ -37,7 +44,17 @@ Channel::~Channel() {
 
 void Channel::Remove() { loop_->RemoveChannel(this); }
 
-void Channel::Update() { loop_->UpdateChannel(this); }
+int Channel::epoll_events() const {
+  return edge_triggered_ ? events_ | EPOLLET : events_;
+}
+
+void Channel::Update() {
+  // 关注的事件没有变化就不需要epoll_ctl了
+  if (registered_ && epoll_events() == registered_events_) {
+    return;
+  }
+  loop_->UpdateChannel(this);
+}
 
 void Channel::HandleEvents() {
   handling_events_ = true;
@@ -32,6 +32,21 @@ class Channel {
   EventLoop* loop() const { return loop_; }
   int fd() const { return fd_; }
   int events() const { return events_; }
+  // 实际传给epoll_ctl的事件, 包括EPOLLET
+  int epoll_events() const;
+  bool edge_triggered() const { return edge_triggered_; }
+  // 边缘触发模式下回调需要自己读/写到EAGAIN为止
+  void set_edge_triggered(bool enable) {
+    edge_triggered_ = enable;
+    if (registered_) Update();
+  }
+  // 以下由Poller维护, 记录已经通过epoll_ctl注册的事件
+  bool registered() const { return registered_; }
+  int registered_events() const { return registered_events_; }
+  void set_registered(bool registered, int events) {
+    registered_ = registered;
+    registered_events_ = events;
+  }
 
   void Remove();
   void HandleEvents();
@@ -76,6 +91,9 @@ class Channel {
 
   int events_;
   int revents_;
+  int registered_events_;
+  bool registered_;
+  bool edge_triggered_;
   bool handling_events_;
   ReadCallback rcb_;
   WriteCallback wcb_;
@@ -11,60 +11,240 @@
  */
 
 #include <alpha/Coroutine.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstddef>
 #include <cstring>
 #include <alpha/Logger.h>
 
+#if defined(__x86_64__)
+// 只保存callee-saved寄存器, rsp, 返回地址和浮点控制字, 不需要系统调用
+// 寄存器不能压栈, 因为切出之前协程的栈已经拷走了, 只能存到from里
+extern "C" void alpha_coroutine_swap_context(void* from, const void* to);
+// 新协程的入口, r12为Coroutine*, r13为真正的入口函数
+extern "C" void alpha_coroutine_trampoline();
+
+__asm__(
+    ".text\n"
+    ".p2align 4\n"
+    ".globl alpha_coroutine_swap_context\n"
+    ".hidden alpha_coroutine_swap_context\n"
+    ".type alpha_coroutine_swap_context, @function\n"
+    "alpha_coroutine_swap_context:\n"
+    "  movq (%rsp), %rax\n"
+    "  leaq 8(%rsp), %rcx\n"
+    "  movq %rcx, 0(%rdi)\n"
+    "  movq %rax, 8(%rdi)\n"
+    "  movq %rbx, 16(%rdi)\n"
+    "  movq %rbp, 24(%rdi)\n"
+    "  movq %r12, 32(%rdi)\n"
+    "  movq %r13, 40(%rdi)\n"
+    "  movq %r14, 48(%rdi)\n"
+    "  movq %r15, 56(%rdi)\n"
+    "  stmxcsr 64(%rdi)\n"
+    "  fnstcw 68(%rdi)\n"
+    "  movq 0(%rsi), %rsp\n"
+    "  movq 16(%rsi), %rbx\n"
+    "  movq 24(%rsi), %rbp\n"
+    "  movq 32(%rsi), %r12\n"
+    "  movq 40(%rsi), %r13\n"
+    "  movq 48(%rsi), %r14\n"
+    "  movq 56(%rsi), %r15\n"
+    "  ldmxcsr 64(%rsi)\n"
+    "  fldcw 68(%rsi)\n"
+    "  jmpq *8(%rsi)\n"
+    ".size alpha_coroutine_swap_context, .-alpha_coroutine_swap_context\n"
+    ".p2align 4\n"
+    ".globl alpha_coroutine_trampoline\n"
+    ".hidden alpha_coroutine_trampoline\n"
+    ".type alpha_coroutine_trampoline, @function\n"
+    "alpha_coroutine_trampoline:\n"
+    "  movq %r12, %rdi\n"
+    "  callq *%r13\n"
+    "  ud2\n"
+    ".size alpha_coroutine_trampoline, .-alpha_coroutine_trampoline\n");
+#endif
+
 namespace alpha {
 thread_local Coroutine* current = nullptr;
 thread_local char shared_stack[Coroutine::kMaxStackSize];
 
 std::atomic_int Coroutine::next_coroutine_id_(1);
 
-Coroutine::Coroutine()
+const size_t CoroutineStackPool::kDefaultMaxFreeStacks;
+
+CoroutineStackPool::CoroutineStackPool(size_t stack_size,
+                                       size_t max_free_stacks)
+    : page_size_(::sysconf(_SC_PAGESIZE)),
+      stack_size_((stack_size + page_size_ - 1) / page_size_ * page_size_),
+      max_free_stacks_(max_free_stacks) {}
+
+CoroutineStackPool::~CoroutineStackPool() {
+  for (auto stack : free_stacks_) {
+    ::munmap(stack - page_size_, stack_size_ + page_size_);
+  }
+}
+
+char* CoroutineStackPool::Allocate() {
+  if (!free_stacks_.empty()) {
+    auto stack = free_stacks_.back();
+    free_stacks_.pop_back();
+    return stack;
+  }
+  // 只占虚拟地址, 真正用到的页才会分配物理内存
+  void* p = ::mmap(nullptr,
+                   stack_size_ + page_size_,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+                   -1,
+                   0);
+  PCHECK(p != MAP_FAILED) << "mmap coroutine stack failed";
+  PCHECK(::mprotect(p, page_size_, PROT_NONE) == 0) << "mprotect failed";
+  return static_cast<char*>(p) + page_size_;
+}
+
+void CoroutineStackPool::Deallocate(char* stack) {
+  if (free_stacks_.size() < max_free_stacks_) {
+    free_stacks_.push_back(stack);
+  } else {
+    ::munmap(stack - page_size_, stack_size_ + page_size_);
+  }
+}
+
+CoroutineStackPool* Coroutine::StackPool() {
+  static thread_local CoroutineStackPool pool(kMaxStackSize);
+  return &pool;
+}
+
+Coroutine::Coroutine(StackMode stack_mode)
+    : Coroutine(kDefaultBackend, stack_mode) {}
+
+Coroutine::Coroutine(Backend backend, StackMode stack_mode)
     : status_(Status::kReady),
+      backend_(backend),
+      stack_mode_(stack_mode),
+      dedicated_stack_(nullptr),
       real_stack_size_(0),
-      id_(next_coroutine_id_.fetch_add(1)) {}
+      id_(next_coroutine_id_.fetch_add(1)) {
+#if defined(__x86_64__)
+  static_assert(offsetof(MachineContext, rsp) == 0, "rsp offset changed");
+  static_assert(offsetof(MachineContext, rip) == 8, "rip offset changed");
+  static_assert(offsetof(MachineContext, rbx) == 16, "rbx offset changed");
+  static_assert(offsetof(MachineContext, r15) == 56, "r15 offset changed");
+  static_assert(offsetof(MachineContext, mxcsr) == 64, "mxcsr offset changed");
+  static_assert(offsetof(MachineContext, fpu_control_word) == 68,
+                "fpu_control_word offset changed");
+#else
+  backend_ = Backend::kUContext;
+#endif
+}
 
-Coroutine::~Coroutine() {}
+Coroutine::~Coroutine() { ReleaseStack(); }
 
 void Coroutine::Yield() {
-  SaveStack();
+  if (stack_mode_ == StackMode::kShared) {
+    SaveStack();
+  }
   status_ = Status::kSuspended;
   current = nullptr;
+  // 必须在Yield里直接切换, 恢复时只有Yield及以上的栈帧是完整的
+#if defined(__x86_64__)
+  if (backend_ == Backend::kAssembly) {
+    alpha_coroutine_swap_context(&machine_execution_point_,
+                                 &machine_yield_recovery_point_);
+    return;
+  }
+#endif
   swapcontext(&execution_point_, &yield_recovery_point_);
 }
 
 void Coroutine::Resume() {
   CHECK(current == nullptr) << "Recursive resume called";
-  int err = 0;
-  auto ptr = reinterpret_cast<uintptr_t>(this);
-  uint64_t p = ptr;
   switch (status_) {
     case Status::kReady:
-      err = getcontext(&execution_point_);
-      CHECK(err != -1) << "getcontext failed";
-      execution_point_.uc_link = &yield_recovery_point_;
-      execution_point_.uc_stack.ss_sp = shared_stack;
-      execution_point_.uc_stack.ss_size = sizeof(shared_stack);
-      makecontext(&execution_point_,
-                  (void (*)(void))Coroutine::InternalRoutine,
-                  2,
-                  (uint32_t)(p >> 32),
-                  (uint32_t)(p));
-      status_ = Status::kRunning;
-      current = this;
-      swapcontext(&yield_recovery_point_, &execution_point_);
+      Start();
       break;
     case Status::kSuspended:
-      RestoreStack();
+      if (stack_mode_ == StackMode::kShared) {
+        RestoreStack();
+      }
       status_ = Status::kRunning;
       current = this;
+#if defined(__x86_64__)
+      if (backend_ == Backend::kAssembly) {
+        alpha_coroutine_swap_context(&machine_yield_recovery_point_,
+                                     &machine_execution_point_);
+        break;
+      }
+#endif
       swapcontext(&yield_recovery_point_, &execution_point_);
       break;
     default:
       CHECK(false) << "Invalid status: " << status_;
       break;
   }
+  // 已经切回调用者的栈了, 可以安全地归还协程的栈
+  if (status_ == Status::kDead) {
+    ReleaseStack();
+  }
+}
+
+void Coroutine::Start() {
+  if (stack_mode_ == StackMode::kDedicated) {
+    dedicated_stack_ = StackPool()->Allocate();
+  }
+  auto ptr = reinterpret_cast<uintptr_t>(this);
+  status_ = Status::kRunning;
+  current = this;
+#if defined(__x86_64__)
+  if (backend_ == Backend::kAssembly) {
+    auto top = reinterpret_cast<uintptr_t>(stack_bottom() + stack_size());
+    memset(&machine_execution_point_, 0, sizeof(machine_execution_point_));
+    // 进入trampoline时rsp按16字节对齐, call之后满足ABI的要求
+    machine_execution_point_.rsp =
+        reinterpret_cast<void*>(top & ~static_cast<uintptr_t>(15));
+    machine_execution_point_.rip =
+        reinterpret_cast<void*>(alpha_coroutine_trampoline);
+    machine_execution_point_.r12 = ptr;
+    machine_execution_point_.r13 =
+        reinterpret_cast<uintptr_t>(&Coroutine::MachineContextEntry);
+    // 沿用当前线程的浮点控制字
+    __asm__ __volatile__(
+        "stmxcsr %0\n"
+        "fnstcw %1\n"
+        : "=m"(machine_execution_point_.mxcsr),
+          "=m"(machine_execution_point_.fpu_control_word));
+    alpha_coroutine_swap_context(&machine_yield_recovery_point_,
+                                 &machine_execution_point_);
+    return;
+  }
+#endif
+  uint64_t p = ptr;
+  int err = getcontext(&execution_point_);
+  CHECK(err != -1) << "getcontext failed";
+  execution_point_.uc_link = &yield_recovery_point_;
+  execution_point_.uc_stack.ss_sp = stack_bottom();
+  execution_point_.uc_stack.ss_size = stack_size();
+  makecontext(&execution_point_,
+              (void (*)(void))Coroutine::InternalRoutine,
+              2,
+              (uint32_t)(p >> 32),
+              (uint32_t)(p));
+  swapcontext(&yield_recovery_point_, &execution_point_);
+}
+
+char* Coroutine::stack_bottom() const {
+  return dedicated_stack_ ? dedicated_stack_ : shared_stack;
+}
+
+size_t Coroutine::stack_size() const {
+  return dedicated_stack_ ? StackPool()->stack_size() : sizeof(shared_stack);
+}
+
+void Coroutine::Reset() {
+  CHECK(status_ == Status::kDead || status_ == Status::kReady)
+      << "Reset alive coroutine, status: " << status_;
+  status_ = Status::kReady;
 }
 
 Coroutine::Status Coroutine::status() const { return status_; }
@@ -77,7 +257,8 @@ bool Coroutine::IsDead() const { return status_ == Status::kDead; }
 
 void Coroutine::Done() { status_ = Status::kDead; }
 
-void Coroutine::SaveStack() {
+// 不能内联到Yield里, 否则Yield的部分栈帧可能在dummy之下, 不会被保存
+__attribute__((noinline)) void Coroutine::SaveStack() {
   char dummy = 0;
   char* addr = &dummy;
   CHECK(IsRunning()) << "Coroutine is not running, status: " << status();
@@ -102,6 +283,13 @@ void Coroutine::RestoreStack() {
   memcpy(addr, stack_.data(), real_stack_size_);
 }
 
+void Coroutine::ReleaseStack() {
+  if (dedicated_stack_) {
+    StackPool()->Deallocate(dedicated_stack_);
+    dedicated_stack_ = nullptr;
+  }
+}
+
 void Coroutine::InternalRoutine(uint32_t hi, uint32_t lo) {
   uint64_t p = (static_cast<uint64_t>(hi) << 32) | static_cast<uint64_t>(lo);
   uintptr_t ptr = static_cast<uintptr_t>(p);
@@ -110,4 +298,15 @@ void Coroutine::InternalRoutine(uint32_t hi, uint32_t lo) {
   co->Done();
   current = nullptr;
 }
+
+#if defined(__x86_64__)
+void Coroutine::MachineContextEntry(Coroutine* co) {
+  co->Routine();
+  co->Done();
+  current = nullptr;
+  alpha_coroutine_swap_context(&co->machine_execution_point_,
+                               &co->machine_yield_recovery_point_);
+  CHECK(false) << "Dead coroutine resumed, id: " << co->id();
+}
+#endif
 }
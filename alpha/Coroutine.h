@@ -16,36 +16,108 @@
 #include <cstdint>
 #include <vector>
 #include <atomic>
+#include <alpha/Compiler.h>
 
 namespace alpha {
+// mmap分配的协程栈, 最低地址处有一个PROT_NONE的guard page
+// 栈溢出时直接段错误, 不会悄悄写坏其他内存, 释放的栈留在池里复用
+class CoroutineStackPool final {
+ public:
+  static const size_t kDefaultMaxFreeStacks = 64;
+
+  explicit CoroutineStackPool(size_t stack_size,
+                              size_t max_free_stacks = kDefaultMaxFreeStacks);
+  ~CoroutineStackPool();
+  DISABLE_COPY_ASSIGNMENT(CoroutineStackPool);
+
+  // 返回可用部分的最低地址, 大小为stack_size(), 不包括guard page
+  char* Allocate();
+  void Deallocate(char* stack);
+  size_t stack_size() const { return stack_size_; }
+  size_t free_stacks() const { return free_stacks_.size(); }
+
+ private:
+  const size_t page_size_;
+  const size_t stack_size_;
+  const size_t max_free_stacks_;
+  std::vector<char*> free_stacks_;
+};
+
 class Coroutine {
  public:
   enum class Status { kReady = 0, kSuspended = 1, kRunning = 2, kDead = 3 };
+  // kAssembly只保存callee-saved寄存器, 不需要系统调用, 只支持x86-64
+  // kUContext使用swapcontext, 每次切换都有一次rt_sigprocmask系统调用
+  enum class Backend { kUContext = 0, kAssembly = 1 };
+  // kShared在线程共享的栈上运行, 切换时拷贝用到的栈, 内存占用小
+  // kDedicated使用StackPool中独立的栈, 切换时不拷贝, 适合栈比较深的协程
+  enum class StackMode { kShared = 0, kDedicated = 1 };
   static const size_t kMaxStackSize = 1 << 20;
+#if defined(__x86_64__)
+  static const Backend kDefaultBackend = Backend::kAssembly;
+#else
+  static const Backend kDefaultBackend = Backend::kUContext;
+#endif
 
-  Coroutine();
+  // 不支持的平台上kAssembly会退化为kUContext
+  explicit Coroutine(Backend backend = kDefaultBackend,
+                     StackMode stack_mode = StackMode::kShared);
+  explicit Coroutine(StackMode stack_mode);
   virtual ~Coroutine();
   virtual void Routine() = 0;
 
   void Yield();
   virtual void Resume();
+  // 已经结束的协程回到kReady, 再次Resume时重新执行Routine, 用于复用协程对象
+  void Reset();
   Status status() const;
   bool IsRunning() const;
   bool IsDead() const;
   bool IsSuspended() const;
   int64_t id() const { return id_; }
+  Backend backend() const { return backend_; }
+  StackMode stack_mode() const { return stack_mode_; }
+
+  // 当前线程kDedicated模式使用的栈池, 栈大小为kMaxStackSize
+  static CoroutineStackPool* StackPool();
 
  private:
+  // 和Coroutine.cc中汇编使用的偏移一一对应, 不要随意修改
+  struct MachineContext {
+    void* rsp;
+    void* rip;
+    uint64_t rbx;
+    uint64_t rbp;
+    uint64_t r12;
+    uint64_t r13;
+    uint64_t r14;
+    uint64_t r15;
+    uint32_t mxcsr;
+    uint16_t fpu_control_word;
+  };
+
   static void InternalRoutine(uint32_t hi, uint32_t lo);
+  static void MachineContextEntry(Coroutine* co);
   void Done();
 
  private:
+  void Start();
+  // 协程运行时使用的栈
+  char* stack_bottom() const;
+  size_t stack_size() const;
   void SaveStack();
   void RestoreStack();
+  void ReleaseStack();
   static std::atomic_int next_coroutine_id_;
   Status status_;
+  Backend backend_;
+  StackMode stack_mode_;
+  // kDedicated模式下从StackPool分配的栈, 协程结束后归还
+  char* dedicated_stack_;
   ucontext_t yield_recovery_point_;
   ucontext_t execution_point_;
+  MachineContext machine_yield_recovery_point_;
+  MachineContext machine_execution_point_;
   size_t real_stack_size_;
   int64_t id_;
   std::vector<char> stack_;
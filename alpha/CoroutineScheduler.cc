@@ -0,0 +1,228 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  CoroutineScheduler.cc
+ *        Created:  10/18/26 19:05:41
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <alpha/CoroutineScheduler.h>
+#include <alpha/Channel.h>
+#include <alpha/EventLoop.h>
+
+namespace alpha {
+static thread_local CoroutineScheduler* current_scheduler = nullptr;
+
+// 等待状态都放在协程对象里, 不能放在协程的栈上
+// 共享栈模式下挂起之后栈上的内容会被其他协程覆盖
+class CoroutineScheduler::ScheduledCoroutine final : public Coroutine {
+ public:
+  ScheduledCoroutine(StackMode stack_mode, size_t index)
+      : Coroutine(stack_mode),
+        index(index),
+        parked(false),
+        fd_ready(false),
+        timer_id(0) {}
+  void Routine() override {
+    task();
+    task = nullptr;
+  }
+
+  Task task;
+  // 在CoroutineScheduler::routines_中的下标
+  size_t index;
+  bool parked;
+  bool fd_ready;
+  TimerManager::TimerId timer_id;
+  std::unique_ptr<Channel> wait_channel;
+};
+
+const size_t CoroutineScheduler::kDefaultMaxFreeCoroutines;
+
+CoroutineScheduler::CoroutineScheduler(EventLoop* loop,
+                                       Coroutine::StackMode stack_mode,
+                                       size_t max_free_coroutines)
+    : loop_(loop),
+      stack_mode_(stack_mode),
+      max_free_coroutines_(max_free_coroutines),
+      running_(nullptr),
+      run_ready_queued_(false),
+      alive_coroutines_(0),
+      alive_(std::make_shared<bool>(true)) {}
+
+CoroutineScheduler::~CoroutineScheduler() {
+  CHECK(running_ == nullptr) << "Destroy scheduler in its coroutine";
+  LOG_WARNING_IF(alive_coroutines_) << alive_coroutines_
+                                    << " coroutines are still alive";
+  for (auto& routine : routines_) {
+    Cleanup(routine.get());
+  }
+}
+
+CoroutineScheduler* CoroutineScheduler::Current() { return current_scheduler; }
+
+void CoroutineScheduler::Spawn(Task task) {
+  ScheduledCoroutine* routine = nullptr;
+  if (free_coroutines_.empty()) {
+    auto index = routines_.size();
+    routines_.emplace_back(new ScheduledCoroutine(stack_mode_, index));
+    routine = routines_.back().get();
+  } else {
+    routine = free_coroutines_.back();
+    free_coroutines_.pop_back();
+    routine->Reset();
+  }
+  routine->task = std::move(task);
+  ++alive_coroutines_;
+  MakeReady(routine);
+}
+
+void CoroutineScheduler::YieldNow() {
+  auto routine = CheckRunning();
+  MakeReady(routine);
+  routine->Yield();
+}
+
+void CoroutineScheduler::SleepFor(uint32_t milliseconds) {
+  auto routine = CheckRunning();
+  routine->timer_id = loop_->RunAfter(milliseconds, [this, routine] {
+    routine->timer_id = 0;
+    Unpark(routine);
+  });
+  Park();
+}
+
+bool CoroutineScheduler::WaitReadable(int fd, int timeout_ms) {
+  return WaitFor(fd, true, timeout_ms);
+}
+
+bool CoroutineScheduler::WaitWritable(int fd, int timeout_ms) {
+  return WaitFor(fd, false, timeout_ms);
+}
+
+void CoroutineScheduler::Park() {
+  auto routine = CheckRunning();
+  routine->parked = true;
+  routine->Yield();
+}
+
+void CoroutineScheduler::Unpark(ScheduledCoroutine* routine) {
+  if (routine->parked) {
+    routine->parked = false;
+    MakeReady(routine);
+  }
+}
+
+CoroutineScheduler::ScheduledCoroutine* CoroutineScheduler::CheckRunning()
+    const {
+  CHECK(running_ && current_scheduler == this)
+      << "Not in coroutine of this scheduler";
+  return running_;
+}
+
+bool CoroutineScheduler::WaitFor(int fd, bool readable, int timeout_ms) {
+  auto routine = CheckRunning();
+  routine->fd_ready = false;
+  routine->wait_channel.reset(new Channel(loop_, fd));
+  auto channel = routine->wait_channel.get();
+  auto ready = [this, routine] {
+    routine->fd_ready = true;
+    Unpark(routine);
+  };
+  // 出错时也唤醒, 让调用者自己去读写拿到错误
+  channel->set_error_callback(ready);
+  if (readable) {
+    channel->set_read_callback(ready);
+    channel->EnableReading();
+  } else {
+    channel->set_write_callback(ready);
+    channel->EnableWriting();
+  }
+  if (timeout_ms >= 0) {
+    auto timeout = static_cast<uint32_t>(timeout_ms);
+    routine->timer_id = loop_->RunAfter(timeout, [this, routine] {
+      routine->timer_id = 0;
+      Unpark(routine);
+    });
+  }
+  Park();
+
+  channel->Remove();
+  routine->wait_channel.reset();
+  if (routine->timer_id) {
+    loop_->RemoveTimer(routine->timer_id);
+    routine->timer_id = 0;
+  }
+  return routine->fd_ready;
+}
+
+void CoroutineScheduler::MakeReady(ScheduledCoroutine* routine) {
+  ready_.push_back(routine);
+  if (!run_ready_queued_) {
+    run_ready_queued_ = true;
+    std::weak_ptr<bool> alive = alive_;
+    loop_->QueueInLoop([this, alive] {
+      if (alive.lock()) RunReady();
+    });
+  }
+}
+
+void CoroutineScheduler::RunReady() {
+  run_ready_queued_ = false;
+  // 只运行这一批, 运行中再就绪的协程等下一轮, 避免饿死网络事件
+  auto n = ready_.size();
+  for (size_t i = 0; i < n; ++i) {
+    auto routine = ready_.front();
+    ready_.pop_front();
+    running_ = routine;
+    current_scheduler = this;
+    routine->Resume();
+    current_scheduler = nullptr;
+    running_ = nullptr;
+    if (!routine->IsDead()) continue;
+
+    --alive_coroutines_;
+    if (free_coroutines_.size() < max_free_coroutines_) {
+      free_coroutines_.push_back(routine);
+    } else {
+      // 和最后一个交换之后删除
+      auto index = routine->index;
+      routines_.back()->index = index;
+      std::swap(routines_[index], routines_.back());
+      routines_.pop_back();
+    }
+  }
+}
+
+void CoroutineScheduler::Cleanup(ScheduledCoroutine* routine) {
+  if (routine->wait_channel) {
+    routine->wait_channel->Remove();
+  }
+  if (routine->timer_id) {
+    loop_->RemoveTimer(routine->timer_id);
+  }
+}
+
+void WaitGroup::Done() {
+  CHECK(count_ > 0) << "WaitGroup::Done called too many times";
+  if (--count_ == 0) {
+    for (auto& waiter : waiters_) {
+      waiter.first->Unpark(waiter.second);
+    }
+    waiters_.clear();
+  }
+}
+
+void WaitGroup::Wait() {
+  auto scheduler = CoroutineScheduler::Current();
+  CHECK(scheduler) << "WaitGroup::Wait can only be called in coroutine";
+  while (count_ > 0) {
+    waiters_.emplace_back(scheduler, scheduler->running());
+    scheduler->Park();
+  }
+}
+}
@@ -0,0 +1,177 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  CoroutineScheduler.h
+ *        Created:  10/18/26 19:05:33
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  基于EventLoop的协程调度器, 以及协程间的同步原语
+ *
+ * =============================================================================
+ */
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <alpha/Compiler.h>
+#include <alpha/Coroutine.h>
+#include <alpha/Logger.h>
+
+namespace alpha {
+class EventLoop;
+
+// 每个EventLoop一个, 只能在loop线程中使用
+// 就绪的协程在QueueInLoop中依次运行, 睡眠和等待fd都由loop唤醒
+// 结束的协程对象回到池中复用
+class CoroutineScheduler final {
+ public:
+  using Task = std::function<void()>;
+  // 调度器中的协程, 同步原语用它来挂起和唤醒协程
+  class ScheduledCoroutine;
+  static const size_t kDefaultMaxFreeCoroutines = 1024;
+
+  // 协程之间经常互相引用栈上的对象(比如WaitGroup), 所以默认使用独立栈
+  // 共享栈模式下挂起的协程的栈会被其他协程覆盖, 只适合互不引用的协程
+  explicit CoroutineScheduler(
+      EventLoop* loop,
+      Coroutine::StackMode stack_mode = Coroutine::StackMode::kDedicated,
+      size_t max_free_coroutines = kDefaultMaxFreeCoroutines);
+  ~CoroutineScheduler();
+  DISABLE_COPY_ASSIGNMENT(CoroutineScheduler);
+
+  // 创建协程并放入就绪队列, 在本轮loop处理完网络事件之后开始运行
+  void Spawn(Task task);
+
+  // 正在运行的协程所属的调度器, 不在调度器的协程中时返回nullptr
+  static CoroutineScheduler* Current();
+
+  // 以下只能在本调度器的协程中调用
+  // 让出CPU, 排到就绪队列末尾
+  void YieldNow();
+  void SleepFor(uint32_t milliseconds);
+  // fd可读/可写时返回true, 超时返回false, timeout_ms为-1时一直等
+  bool WaitReadable(int fd, int timeout_ms = -1);
+  bool WaitWritable(int fd, int timeout_ms = -1);
+
+  // Park挂起当前协程, 直到其他人调用Unpark
+  // Unpark一个没有挂起的协程什么也不做, 所以调用者需要自己重新检查条件
+  ScheduledCoroutine* running() const { return running_; }
+  void Park();
+  void Unpark(ScheduledCoroutine* routine);
+
+  EventLoop* loop() const { return loop_; }
+  size_t alive_coroutines() const { return alive_coroutines_; }
+  size_t free_coroutines() const { return free_coroutines_.size(); }
+
+ private:
+  ScheduledCoroutine* CheckRunning() const;
+  bool WaitFor(int fd, bool readable, int timeout_ms);
+  void MakeReady(ScheduledCoroutine* routine);
+  void RunReady();
+  void Cleanup(ScheduledCoroutine* routine);
+
+  EventLoop* loop_;
+  const Coroutine::StackMode stack_mode_;
+  const size_t max_free_coroutines_;
+  ScheduledCoroutine* running_;
+  bool run_ready_queued_;
+  size_t alive_coroutines_;
+  std::deque<ScheduledCoroutine*> ready_;
+  std::vector<ScheduledCoroutine*> free_coroutines_;
+  // 所有活着的协程, 析构时用来清理
+  std::vector<std::unique_ptr<ScheduledCoroutine>> routines_;
+  // 调度器析构之后, 已经QueueInLoop的RunReady直接返回
+  std::shared_ptr<bool> alive_;
+};
+
+// 计数归零时唤醒所有Wait的协程
+class WaitGroup final {
+ public:
+  WaitGroup() : count_(0) {}
+  ~WaitGroup() { DCHECK(waiters_.empty()); }
+  DISABLE_COPY_ASSIGNMENT(WaitGroup);
+
+  void Add(int n = 1) { count_ += n; }
+  void Done();
+  void Wait();
+  int count() const { return count_; }
+
+ private:
+  using Waiter = std::pair<CoroutineScheduler*,
+                           CoroutineScheduler::ScheduledCoroutine*>;
+  int count_;
+  std::vector<Waiter> waiters_;
+};
+
+// 有界的协程间队列, 满了Send挂起, 空了Recv挂起
+// 只能在同一个loop线程的协程中使用
+template <typename T>
+class CoChannel final {
+ public:
+  explicit CoChannel(size_t capacity) : capacity_(capacity), closed_(false) {
+    CHECK(capacity_ > 0) << "CoChannel capacity must be positive";
+  }
+  ~CoChannel() { DCHECK(senders_.empty() && receivers_.empty()); }
+  DISABLE_COPY_ASSIGNMENT(CoChannel);
+
+  // 已经关闭时返回false
+  bool Send(T value) {
+    while (buffer_.size() >= capacity_ && !closed_) {
+      Wait(&senders_);
+    }
+    if (closed_) return false;
+    buffer_.push_back(std::move(value));
+    WakeOne(&receivers_);
+    return true;
+  }
+
+  // 关闭并且数据已经取完时返回false
+  bool Recv(T* value) {
+    while (buffer_.empty() && !closed_) {
+      Wait(&receivers_);
+    }
+    if (buffer_.empty()) return false;
+    *value = std::move(buffer_.front());
+    buffer_.pop_front();
+    WakeOne(&senders_);
+    return true;
+  }
+
+  // 唤醒所有等待的协程, 之后Send都会失败, Recv取完剩下的数据后失败
+  void Close() {
+    closed_ = true;
+    while (!senders_.empty()) WakeOne(&senders_);
+    while (!receivers_.empty()) WakeOne(&receivers_);
+  }
+
+  bool closed() const { return closed_; }
+  size_t size() const { return buffer_.size(); }
+  size_t capacity() const { return capacity_; }
+
+ private:
+  using Waiter = std::pair<CoroutineScheduler*,
+                           CoroutineScheduler::ScheduledCoroutine*>;
+  void Wait(std::deque<Waiter>* waiters) {
+    auto scheduler = CoroutineScheduler::Current();
+    CHECK(scheduler) << "CoChannel can only be used in coroutine";
+    waiters->emplace_back(scheduler, scheduler->running());
+    scheduler->Park();
+  }
+
+  void WakeOne(std::deque<Waiter>* waiters) {
+    if (waiters->empty()) return;
+    auto waiter = waiters->front();
+    waiters->pop_front();
+    waiter.first->Unpark(waiter.second);
+  }
+
+  const size_t capacity_;
+  bool closed_;
+  std::deque<T> buffer_;
+  std::deque<Waiter> senders_;
+  std::deque<Waiter> receivers_;
+};
+}
@@ -12,12 +12,15 @@
 
 #include <alpha/EventLoop.h>
 
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include <cassert>
 #include <type_traits>
 #include <algorithm>
 #include <alpha/Logger.h>
 #include <alpha/Channel.h>
 #include <alpha/Poller.h>
+#include <alpha/TcpConnectionBuffer.h>
 
 namespace alpha {
 static_assert(
@@ -29,24 +32,48 @@ static void signal_handler(int signo) { signal_num = signo; }
 
 static const int kDefaultBusyTimeoutMS = 20;
 static const int kDefaultIdleTimeoutMS = 100;
-EventLoop::EventLoop()
+EventLoop::EventLoop(TimerManager::Backend timer_backend)
     : quit_(false),
       iteration_(0),
       busy_timeout_ms_(kDefaultBusyTimeoutMS),
       idle_timeout_ms_(kDefaultIdleTimeoutMS),
-      next_timeout_ms_(busy_timeout_ms_) {
+      next_timeout_ms_(busy_timeout_ms_),
+      thread_id_(std::thread::id()),
+      queued_functors_(nullptr) {
   poller_.reset(new Poller);
-  timer_manager_.reset(new TimerManager);
+  buffer_pool_.reset(new TcpConnectionBufferPool);
+  timer_manager_.reset(new TimerManager(timer_backend));
+  wakeup_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  PCHECK(wakeup_fd_ >= 0) << "eventfd failed";
+  wakeup_channel_.reset(new Channel(this, wakeup_fd_));
+  wakeup_channel_->set_read_callback(std::bind(&EventLoop::HandleWakeup, this));
+  wakeup_channel_->EnableReading();
 }
 
-EventLoop::~EventLoop() = default;
+EventLoop::~EventLoop() {
+  wakeup_channel_->Remove();
+  ::close(wakeup_fd_);
+  // 没来得及执行的也要释放掉
+  auto head = queued_functors_.exchange(nullptr, std::memory_order_acquire);
+  while (head) {
+    auto next = head->next;
+    delete head;
+    head = next;
+  }
+}
 
 void EventLoop::Run() {
   //先注册信号处理函数
   ChannelList channels;
 
   static const int kMaxLoopBeforeIdle = 100;
+  // Run之前没有loop线程, 构造loop的线程调用QueueInLoop也要唤醒
+  thread_id_ = std::this_thread::get_id();
   next_timeout_ms_ = busy_timeout_ms_;
+  if (queued_functors_.load(std::memory_order_relaxed)) {
+    // Run之前就有QueueInLoop的函数了
+    next_timeout_ms_ = 0;
+  }
   unsigned idle = 0;
 
   int status = kIdle;
@@ -67,8 +94,6 @@ void EventLoop::Run() {
     ++iteration_;
     DLOG_INFO_IF(!channels.empty()) << "channels.size() = " << channels.size()
                                     << ", now = " << now;
-    std::vector<Functor> queued_functors;
-    std::swap(queued_functors, queued_functors_);
 
     //再处理网络消息
     std::for_each(channels.begin(), channels.end(), [](Channel* channel) {
@@ -77,21 +102,23 @@ void EventLoop::Run() {
     idle = channels.empty() ? idle + 1 : 0;
     channels.clear();
 
+    // 必须在HandleWakeup读空eventfd之后再取, 否则中间提交的函数发出的唤醒会丢失
+    QueuedFunctor* queued_functors = nullptr;
+    if (queued_functors_.load(std::memory_order_relaxed)) {
+      queued_functors =
+          queued_functors_.exchange(nullptr, std::memory_order_acquire);
+    }
+
     //然后是周期函数
     if (cron_functor_) {
       status = cron_functor_(iteration_);
     }
 
     //再处理延时调用函数
-    std::for_each(queued_functors.begin(),
-                  queued_functors.end(),
-                  [](const Functor& f) { f(); });
+    RunQueuedFunctors(queued_functors);
 
-    auto timer_functors = timer_manager_->Step(now);
     //最后处理定时器
-    std::for_each(timer_functors.begin(),
-                  timer_functors.end(),
-                  [](const Functor& f) { f(); });
+    timer_manager_->Fire(now);
 
     int timeoutms = busy_timeout_ms_;
     if (idle >= kMaxLoopBeforeIdle && status == kIdle) {
@@ -107,7 +134,16 @@ int EventLoop::RunForever() {
   return 0;
 }
 
-void EventLoop::Quit() { quit_ = true; }
+void EventLoop::Quit() {
+  quit_ = true;
+  if (!IsInLoopThread()) {
+    Wakeup();
+  }
+}
+
+bool EventLoop::IsInLoopThread() const {
+  return thread_id_ == std::this_thread::get_id();
+}
 
 void EventLoop::UpdateChannel(Channel* channel) {
   poller_->UpdateChannel(channel);
@@ -156,8 +192,59 @@ bool EventLoop::TrapSignal(int signal, const Functor& cb) {
   return true;
 }
 
-void EventLoop::QueueInLoop(const EventLoop::Functor& functor) {
-  queued_functors_.push_back(functor);
+void EventLoop::RunInLoop(EventLoop::Functor functor) {
+  if (IsInLoopThread()) {
+    functor();
+  } else {
+    QueueInLoop(std::move(functor));
+  }
+}
+
+void EventLoop::QueueInLoop(EventLoop::Functor functor) {
+  auto node = new QueuedFunctor{std::move(functor), nullptr};
+  auto head = queued_functors_.load(std::memory_order_relaxed);
+  do {
+    node->next = head;
+  } while (!queued_functors_.compare_exchange_weak(
+      head, node, std::memory_order_release, std::memory_order_relaxed));
+
+  // 只有从空变为非空时才需要通知loop
+  if (head == nullptr) {
+    if (IsInLoopThread()) {
+      set_next_max_timeout(0);
+    } else {
+      Wakeup();
+    }
+  }
+}
+
+void EventLoop::Wakeup() {
+  uint64_t one = 1;
+  ssize_t n = ::write(wakeup_fd_, &one, sizeof(one));
+  PLOG_WARNING_IF(n != sizeof(one)) << "write to eventfd failed";
+}
+
+void EventLoop::HandleWakeup() {
+  uint64_t value;
+  ssize_t n = ::read(wakeup_fd_, &value, sizeof(value));
+  PLOG_WARNING_IF(n != sizeof(value) && errno != EAGAIN)
+      << "read from eventfd failed";
+}
+
+void EventLoop::RunQueuedFunctors(QueuedFunctor* head) {
+  // 栈是后进先出的, 先反转成提交的顺序
+  QueuedFunctor* reversed = nullptr;
+  while (head) {
+    auto next = head->next;
+    head->next = reversed;
+    reversed = head;
+    head = next;
+  }
+  while (reversed) {
+    std::unique_ptr<QueuedFunctor> node(reversed);
+    reversed = reversed->next;
+    node->functor();
+  }
 }
 
 void EventLoop::set_next_max_timeout(int timeoutms) {
@@ -16,7 +16,9 @@
 #include <signal.h>
 #include <map>
 #include <vector>
+#include <atomic>
 #include <memory>
+#include <thread>
 #include <functional>
 #include <alpha/Compiler.h>
 #include <alpha/TimeUtil.h>
@@ -25,6 +27,7 @@
 namespace alpha {
 class Poller;
 class Channel;
+class TcpConnectionBufferPool;
 
 class EventLoop {
  public:
@@ -33,16 +36,25 @@ class EventLoop {
   using Functor = std::function<void(void)>;
 
  public:
-  EventLoop();
+  explicit EventLoop(
+      TimerManager::Backend timer_backend = TimerManager::Backend::kTree);
   ~EventLoop();
   DISABLE_COPY_ASSIGNMENT(EventLoop);
 
   void Run();
   int RunForever();
+  // Quit, RunInLoop和QueueInLoop可以在其他线程调用
   void Quit();
-  void QueueInLoop(const Functor& functor);
+  // 在loop线程中直接执行, 否则和QueueInLoop一样
+  void RunInLoop(Functor functor);
+  // 本次循环处理完网络事件之后执行, 从其他线程调用时会立即唤醒loop
+  void QueueInLoop(Functor functor);
+  // Run之前总是返回false
+  bool IsInLoopThread() const;
   void UpdateChannel(Channel* channel);
   void RemoveChannel(Channel* channel);
+  // 本loop上所有连接共用的缓冲区chunk池, 只能在loop线程使用
+  TcpConnectionBufferPool* buffer_pool() const { return buffer_pool_.get(); }
 
   template <typename F, typename... Args>
   typename std::enable_if<sizeof...(Args) != 0, TimerManager::TimerId>::type
@@ -66,15 +78,29 @@ class EventLoop {
   void set_cron_functor(const CronFunctor& functor) { cron_functor_ = functor; }
 
  private:
+  // 多生产者单消费者的无锁栈, loop线程一次取走全部
+  struct QueuedFunctor {
+    Functor functor;
+    QueuedFunctor* next;
+  };
+  void Wakeup();
+  void HandleWakeup();
+  void RunQueuedFunctors(QueuedFunctor* head);
+
   std::unique_ptr<Poller> poller_;
-  bool quit_;
+  // 定时器, 回调和排队的函数里可能还持有连接, 要在它们之后析构
+  std::unique_ptr<TcpConnectionBufferPool> buffer_pool_;
+  std::atomic<bool> quit_;
   uint64_t iteration_;
   int busy_timeout_ms_;
   int idle_timeout_ms_;
   int next_timeout_ms_;
   CronFunctor cron_functor_;
   std::unique_ptr<TimerManager> timer_manager_;
-  std::vector<Functor> queued_functors_;
+  std::atomic<std::thread::id> thread_id_;
+  int wakeup_fd_;
+  std::unique_ptr<Channel> wakeup_channel_;
+  std::atomic<QueuedFunctor*> queued_functors_;
   std::map<int, Functor> signal_handlers_;
 };
 }
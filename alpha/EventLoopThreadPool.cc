@@ -0,0 +1,107 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  EventLoopThreadPool.cc
+ *        Created:  10/18/26 11:14:40
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <alpha/EventLoopThreadPool.h>
+
+#include <signal.h>
+#include <pthread.h>
+#include <cassert>
+#include <alpha/Logger.h>
+#include <alpha/EventLoop.h>
+
+namespace alpha {
+EventLoopThreadPool::EventLoopThreadPool(EventLoop* base_loop,
+                                         int num_threads,
+                                         TimerManager::Backend timer_backend)
+    : base_loop_(base_loop), started_(false), next_(0) {
+  assert(base_loop_);
+  CHECK(num_threads >= 0) << "Invalid num_threads: " << num_threads;
+  for (int i = 0; i < num_threads; ++i) {
+    loops_.emplace_back(new EventLoop(timer_backend));
+  }
+}
+
+EventLoopThreadPool::~EventLoopThreadPool() { Stop(); }
+
+void EventLoopThreadPool::Start() {
+  CHECK(!started_) << "EventLoopThreadPool already started";
+  started_ = true;
+  for (size_t i = 0; i < loops_.size(); ++i) {
+    threads_.emplace_back(&EventLoopThreadPool::ThreadMain, this, i);
+  }
+  LOG_INFO << "EventLoopThreadPool started, threads: " << loops_.size();
+}
+
+void EventLoopThreadPool::Stop() {
+  for (auto& loop : loops_) {
+    loop->Quit();
+  }
+  for (auto& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+EventLoop* EventLoopThreadPool::GetNextLoop() {
+  if (loops_.empty()) {
+    return base_loop_;
+  }
+  EventLoop* loop = loops_[next_].get();
+  next_ = (next_ + 1) % loops_.size();
+  return loop;
+}
+
+EventLoop* EventLoopThreadPool::GetLoop(size_t index) const {
+  if (loops_.empty()) {
+    return base_loop_;
+  }
+  return loops_[index % loops_.size()].get();
+}
+
+std::vector<EventLoop*> EventLoopThreadPool::GetAllLoops() const {
+  if (loops_.empty()) {
+    return std::vector<EventLoop*>(1, base_loop_);
+  }
+  std::vector<EventLoop*> loops;
+  for (auto& loop : loops_) {
+    loops.push_back(loop.get());
+  }
+  return loops;
+}
+
+void EventLoopThreadPool::ThreadMain(size_t index) {
+  EventLoop* loop = loops_[index].get();
+  // 信号统一由base_loop所在线程处理
+  sigset_t mask;
+  sigfillset(&mask);
+  int err = ::pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+  LOG_WARNING_IF(err != 0) << "pthread_sigmask failed, err: " << err;
+  if (!cpus_.empty()) {
+    BindCpu(index);
+  }
+  if (thread_init_callback_) {
+    thread_init_callback_(loop);
+  }
+  loop->Run();
+}
+
+void EventLoopThreadPool::BindCpu(size_t index) {
+  const int cpu = cpus_[index % cpus_.size()];
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int err = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+  LOG_WARNING_IF(err != 0) << "pthread_setaffinity_np failed, cpu: " << cpu
+                           << ", err: " << err;
+}
+}
@@ -0,0 +1,67 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  EventLoopThreadPool.h
+ *        Created:  10/18/26 11:02:17
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  Run several EventLoops, one per thread
+ *
+ * =============================================================================
+ */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <functional>
+#include <alpha/Compiler.h>
+#include <alpha/TimerManager.h>
+
+namespace alpha {
+class EventLoop;
+
+class EventLoopThreadPool {
+ public:
+  using ThreadInitCallback = std::function<void(EventLoop*)>;
+
+  // 没有工作线程时所有的接口都返回base_loop
+  EventLoopThreadPool(
+      EventLoop* base_loop,
+      int num_threads,
+      TimerManager::Backend timer_backend = TimerManager::Backend::kTree);
+  ~EventLoopThreadPool();
+  DISABLE_COPY_ASSIGNMENT(EventLoopThreadPool);
+
+  // 在Start之前调用, cb在每个工作线程的loop开始运行之前被调用
+  void SetThreadInitCallback(const ThreadInitCallback& cb) {
+    thread_init_callback_ = cb;
+  }
+  // 在Start之前调用, 第i个工作线程绑定到cpus[i % cpus.size()]上
+  void SetCpuAffinity(const std::vector<int>& cpus) { cpus_ = cpus; }
+
+  void Start();
+  // 让所有工作线程的loop退出并等待线程结束, 可以重复调用
+  void Stop();
+
+  EventLoop* base_loop() const { return base_loop_; }
+  EventLoop* GetNextLoop();
+  EventLoop* GetLoop(size_t index) const;
+  std::vector<EventLoop*> GetAllLoops() const;
+  size_t size() const { return loops_.size(); }
+  bool started() const { return started_; }
+
+ private:
+  void ThreadMain(size_t index);
+  void BindCpu(size_t index);
+
+  EventLoop* base_loop_;
+  bool started_;
+  size_t next_;
+  ThreadInitCallback thread_init_callback_;
+  std::vector<int> cpus_;
+  std::vector<std::unique_ptr<EventLoop>> loops_;
+  std::vector<std::thread> threads_;
+};
+}
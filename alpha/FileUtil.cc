@@ -11,8 +11,29 @@
  */
 
 #include <alpha/FileUtil.h>
+#include <stdio.h>
 #include <unistd.h>
+#include <alpha/File.h>
 
 namespace alpha {
 bool DeleteFile(alpha::Slice path) { return unlink(path.data()) == 0; }
+
+bool WriteFileAtomically(alpha::Slice path, const void* data, int size) {
+  auto tmp_path = path.ToString() + ".tmp";
+  File file(tmp_path, O_WRONLY | O_CREAT | O_TRUNC);
+  if (!file) {
+    return false;
+  }
+  if (file.WriteAt(0, data, size) != size || !file.Flush() || !file.Close() ||
+      ::rename(tmp_path.data(), path.data()) != 0) {
+    DeleteFile(tmp_path);
+    return false;
+  }
+  return true;
+}
+
+bool ReadFileExactly(alpha::Slice path, void* data, int size) {
+  File file(path);
+  return file && file.GetLength() == size && file.ReadAt(0, data, size) == size;
+}
 }
@@ -16,4 +16,8 @@
 
 namespace alpha {
 bool DeleteFile(alpha::Slice path);
+// 先写到临时文件再rename, 中途崩溃时path要么不变, 要么是完整的新内容
+bool WriteFileAtomically(alpha::Slice path, const void* data, int size);
+// 文件大小必须正好是size
+bool ReadFileExactly(alpha::Slice path, void* data, int size);
 }
@@ -15,7 +15,7 @@
 
 namespace alpha {
 std::string HexDump(alpha::Slice data) {
-  char buf[10];
+  char buf[16];
   std::ostringstream oss;
   const int kMaxBytesPerLine = 16;
   const int size = data.size();
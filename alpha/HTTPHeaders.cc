@@ -11,11 +11,12 @@
  */
 
 #include <alpha/HTTPHeaders.h>
+#include <strings.h>
 
 namespace alpha {
 HTTPHeaders::HTTPHeaders() {
   header_names_.reserve(kInitializeHeaderSize);
-  header_names_.reserve(kInitializeHeaderSize);
+  header_values_.reserve(kInitializeHeaderSize);
 }
 
 void HTTPHeaders::Add(alpha::Slice name, alpha::Slice value) {
@@ -30,30 +31,39 @@ void HTTPHeaders::Set(alpha::Slice name, alpha::Slice value) {
 
 bool HTTPHeaders::Remove(alpha::Slice target) {
   bool removed = false;
-  std::for_each(header_names_.begin(),
-                header_names_.end(),
-                [&removed, &target](std::string& name) {
-                  if (name == target.ToString()) {
-                    name.clear();
-                    removed = true;
-                  }
-                });
+  for (auto& name : header_names_) {
+    if (NameEquals(name, target)) {
+      name.clear();
+      removed = true;
+    }
+  }
   return removed;
 }
 
-bool HTTPHeaders::Exists(alpha::Slice name) const {
-  return std::find(header_names_.begin(),
-                   header_names_.end(),
-                   name.ToString()) != header_names_.end();
-}
+bool HTTPHeaders::Exists(alpha::Slice name) const { return Find(name) >= 0; }
 
 std::string HTTPHeaders::Get(alpha::Slice name) const {
-  auto it =
-      std::find(header_names_.begin(), header_names_.end(), name.ToString());
-  if (it == header_names_.end()) {
-    return "";
-  } else {
-    return header_values_[std::distance(header_names_.begin(), it)];
+  auto i = Find(name);
+  return i < 0 ? "" : header_values_[i];
+}
+
+bool HTTPHeaders::NameEquals(alpha::Slice lhs, alpha::Slice rhs) {
+  // 头部的名字不区分大小写
+  return lhs.size() == rhs.size() &&
+         ::strncasecmp(lhs.data(), rhs.data(), lhs.size()) == 0;
+}
+
+int HTTPHeaders::Find(alpha::Slice name) const {
+  for (auto i = 0u; i < header_names_.size(); ++i) {
+    if (NameEquals(header_names_[i], name)) {
+      return i;
+    }
   }
+  return -1;
+}
+
+void HTTPHeaders::Clear() {
+  header_names_.clear();
+  header_values_.clear();
 }
 }
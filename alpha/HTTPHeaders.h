@@ -25,11 +25,15 @@ class HTTPHeaders {
   bool Remove(alpha::Slice name);
   bool Exists(alpha::Slice name) const;
   std::string Get(alpha::Slice name) const;
+  // 清空所有头部, vector的容量保留下来复用
+  void Clear();
 
   template <typename LAMBDA>
   void Foreach(LAMBDA lambda) const;
 
  private:
+  static bool NameEquals(alpha::Slice lhs, alpha::Slice rhs);
+  int Find(alpha::Slice name) const;
   static const int kInitializeHeaderSize = 16;
   std::vector<std::string> header_names_;
   std::vector<std::string> header_values_;
@@ -38,6 +38,25 @@ HTTPMessage::~HTTPMessage() {
   }
 }
 
+void HTTPMessage::Reset() {
+  headers_.Clear();
+  if (fields_.which == 1) {
+    auto& req = request();
+    req.client_ip.clear();
+    req.client_port = 0;
+    req.method.clear();
+    req.path.clear();
+    req.query_string.clear();
+  } else if (fields_.which == 2) {
+    response().status = 0;
+    response().status_string.clear();
+  }
+  parsed_params_ = false;
+  query_params_.clear();
+  body_.clear();
+  payloads_.clear();
+}
+
 HTTPHeaders& HTTPMessage::Headers() { return headers_; }
 
 const HTTPHeaders& HTTPMessage::Headers() const { return headers_; }
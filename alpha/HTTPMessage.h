@@ -24,6 +24,8 @@ class HTTPMessage {
   static std::string FormatDate(alpha::TimeStamp time);
   HTTPMessage();
   ~HTTPMessage();
+  // 清空内容以便解析同一个连接上的下一个请求, 已经分配的内存留着复用
+  void Reset();
   HTTPHeaders& Headers();
   const HTTPHeaders& Headers() const;
 
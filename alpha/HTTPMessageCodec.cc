@@ -11,12 +11,54 @@
  */
 
 #include <alpha/HTTPMessageCodec.h>
+#include <strings.h>
+#include <cstring>
 #include <alpha/Logger.h>
+#include <alpha/TcpConnectionBuffer.h>
 
 namespace alpha {
 static const Slice CRLF("\r\n");
 static const Slice DoubleCRLF("\r\n\r\n");
+const size_t HTTPMessageCodec::kMaxHeaderSize;
+
 HTTPMessageCodec::Status HTTPMessageCodec::Process(Slice& data) {
+  const auto data_size = data.size();
+  auto status = DoProcess(data);
+  bytes_processed_ += data_size - data.size();
+  return status;
+}
+
+void HTTPMessageCodec::Reset() {
+  status_ = Status::kParseStartLine;
+  content_length_ = std::numeric_limits<uint32_t>::max();
+  http11_ = false;
+  keep_alive_ = false;
+  data_to_peer_.clear();
+  http_message_.Reset();
+}
+
+void HTTPMessageCodec::Resume() {
+  suspended_ = false;
+  if (resume_callback_) {
+    resume_callback_();
+  }
+}
+
+HTTPMessageCodec::Status HTTPMessageCodec::ProcessInPlace(
+    Slice& data, HTTPRequest* request, size_t max_size) {
+  if (status_ < 0 || status_ == Status::kDone) {
+    return status_;
+  }
+  size_t length = 0;
+  status_ = ParseInPlace(data, request, max_size, &length);
+  if (status_ == Status::kDone) {
+    data.Advance(length);
+    bytes_processed_ += length;
+  }
+  return status_;
+}
+
+HTTPMessageCodec::Status HTTPMessageCodec::DoProcess(Slice& data) {
   if (status_ < 0) {
     return status_;
   }
@@ -73,6 +115,7 @@ HTTPMessageCodec::Status HTTPMessageCodec::ParseStartLine(Slice& data) {
   if (!start_line.EndsWith(" HTTP/1.0") && !start_line.EndsWith(" HTTP/1.1")) {
     return Status::kInvalidHTTPVersion;
   }
+  http11_ = start_line.EndsWith(" HTTP/1.1");
   size_t method_size = 0;
   if (start_line.StartsWith("GET /")) {
     http_message_.SetMethod("GET");
@@ -128,7 +171,119 @@ HTTPMessageCodec::Status HTTPMessageCodec::ParseHeader(Slice& data) {
   return Status::kParseHeader;
 }
 
+HTTPMessageCodec::Status HTTPMessageCodec::ParseInPlace(Slice data,
+                                                       HTTPRequest* request,
+                                                       size_t max_size,
+                                                       size_t* length) {
+  // 请求不完整时每次都从头解析, 头部一般很短, 比保存中间状态简单
+  const char* begin = data.data();
+  const char* header_end = static_cast<const char*>(
+      ::memmem(begin, data.size(), DoubleCRLF.data(), DoubleCRLF.size()));
+  if (header_end == nullptr) {
+    return data.size() > kMaxHeaderSize ? Status::kHeaderTooLarge
+                                        : Status::kParseHeader;
+  }
+  const char* end = header_end + CRLF.size();
+
+  // 起始行: METHOD SP PATH[?QUERY] SP HTTP/1.x CRLF
+  request->Clear();
+  const char* line_end =
+      static_cast<const char*>(::memchr(begin, '\r', end - begin));
+  const char* sp =
+      static_cast<const char*>(::memchr(begin, ' ', line_end - begin));
+  if (sp == nullptr || sp == begin) {
+    return Status::kInvalidStartLine;
+  }
+  Slice method(begin, sp - begin);
+  if (!(method == "GET" || method == "PUT" || method == "POST" ||
+        method == "DELETE")) {
+    return Status::kInvalidMethod;
+  }
+  const Slice kVersionPrefix(" HTTP/1.");
+  const char* version = line_end - kVersionPrefix.size() - 1;
+  if (version <= sp ||
+      ::memcmp(version, kVersionPrefix.data(), kVersionPrefix.size()) != 0 ||
+      (line_end[-1] != '0' && line_end[-1] != '1')) {
+    return Status::kInvalidHTTPVersion;
+  }
+  const char* target = sp + 1;
+  if (target == version || *target != '/') {
+    return Status::kInvalidStartLine;
+  }
+  const char* question =
+      static_cast<const char*>(::memchr(target, '?', version - target));
+  request->method_ = method;
+  if (question == nullptr) {
+    request->path_ = Slice(target, version - target);
+  } else {
+    request->path_ = Slice(target, question - target);
+    request->query_string_ = Slice(question + 1, version - question - 1);
+  }
+  request->http11_ = line_end[-1] == '1';
+
+  // 头部: NAME ":" OWS VALUE OWS CRLF
+  for (const char* p = line_end + CRLF.size(); p < end;) {
+    const char* eol = static_cast<const char*>(::memchr(p, '\r', end - p));
+    if (eol == nullptr || eol[1] != '\n') {
+      return Status::kInvalidHeadLine;
+    }
+    const char* colon = static_cast<const char*>(::memchr(p, ':', eol - p));
+    if (colon == nullptr || colon == p) {
+      return Status::kInvalidHeadLine;
+    }
+    const char* value = colon + 1;
+    const char* value_end = eol;
+    while (value < value_end && (*value == ' ' || *value == '\t')) ++value;
+    while (value_end > value &&
+           (value_end[-1] == ' ' || value_end[-1] == '\t')) {
+      --value_end;
+    }
+    if (!request->AddHeader(Slice(p, colon - p),
+                            Slice(value, value_end - value))) {
+      return Status::kHeaderTooLarge;
+    }
+    p = eol + CRLF.size();
+  }
+
+  size_t content_length = 0;
+  Slice content_length_str = request->Header("Content-Length");
+  if (!content_length_str.empty()) {
+    if (content_length_str.size() > 9) {
+      return Status::kInvalidContentLength;
+    }
+    for (size_t i = 0; i < content_length_str.size(); ++i) {
+      const char c = content_length_str.data()[i];
+      if (c < '0' || c > '9') {
+        return Status::kInvalidContentLength;
+      }
+      content_length = content_length * 10 + (c - '0');
+    }
+  }
+  const size_t header_length = end + CRLF.size() - begin;
+  // 整个请求都要放在读缓冲区里
+  if (header_length + content_length > max_size) {
+    return Status::kTooMuchContent;
+  }
+  if (data.size() < header_length + content_length) {
+    return Status::kParseData;
+  }
+  request->body_ = Slice(begin + header_length, content_length);
+  http11_ = request->http11_;
+  keep_alive_ = KeepAlive(request->Header("Connection"));
+  *length = header_length + content_length;
+  return Status::kDone;
+}
+
+bool HTTPMessageCodec::KeepAlive(Slice connection) const {
+  auto equals = [&connection](Slice s) {
+    return connection.size() == s.size() &&
+           ::strncasecmp(connection.data(), s.data(), s.size()) == 0;
+  };
+  return http11_ ? !equals("close") : equals("keep-alive");
+}
+
 HTTPMessageCodec::Status HTTPMessageCodec::OperationAfterParseHeader() {
+  keep_alive_ = KeepAlive(http_message_.Headers().Get("Connection"));
   return http_message_.Headers().Exists("Content-Length") ? Status::kParseData
                                                           : Status::kDone;
 }
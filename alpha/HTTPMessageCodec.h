@@ -14,10 +14,12 @@
 
 #include <map>
 #include <limits>
+#include <functional>
 #include <string>
 #include <alpha/Slice.h>
 #include <alpha/TcpConnection.h>
 #include <alpha/HTTPMessage.h>
+#include <alpha/HTTPRequest.h>
 
 namespace alpha {
 class HTTPMessageCodec {
@@ -36,6 +38,7 @@ class HTTPMessageCodec {
     kDuplicatedHead = -104,
     kInvalidContentLength = -105,
     kTooMuchContent = -106,
+    kHeaderTooLarge = -107,
     kParseStartLine = 100,
     kParseHeader = 101,
     kParseEmptyLine = 102,
@@ -43,14 +46,44 @@ class HTTPMessageCodec {
   };
 
   using HTTPHeader = std::map<std::string, std::string>;
+  // ProcessInPlace时起始行加头部的上限
+  static const size_t kMaxHeaderSize = 8192;
 
   Status Process(Slice& data);
   HTTPMessage& Done();
+  // 不拷贝数据的解析方式, 整个请求都在data中时才会解析完成, 否则不消耗数据
+  // 完成之后request中的Slice都指向data, 在data被消耗或修改之前有效
+  // max_size是读缓冲区的上限, 整个请求超过它时返回kTooMuchContent
+  Status ProcessInPlace(
+      Slice& data,
+      HTTPRequest* request,
+      size_t max_size = TcpConnectionBuffer::kMaxBufferSize);
+  // 回到初始状态解析同一个连接上的下一个请求, 不重新分配内存
+  void Reset();
   Status status() const { return status_; }
+  // 解析完成之后有效, HTTP/1.1默认保持连接, HTTP/1.0需要显式指定keep-alive
+  bool keep_alive() const { return keep_alive_; }
+  bool http11() const { return http11_; }
+  // 流式回包还没发完时暂停处理同一个连接上后面的请求, Reset不会清除
+  // Resume之后调用resume callback继续处理已经收到的数据
+  void Suspend() { suspended_ = true; }
+  void Resume();
+  bool suspended() const { return suspended_; }
+  void SetResumeCallback(const std::function<void()>& cb) {
+    resume_callback_ = cb;
+  }
+  // 累计处理过的字节数, Reset不清零
+  uint64_t bytes_processed() const { return bytes_processed_; }
   std::string data_to_peer() const { return data_to_peer_; }
   void clear_data_to_peer() { data_to_peer_.clear(); }
 
  private:
+  Status DoProcess(Slice& data);
+  Status ParseInPlace(Slice data,
+                      HTTPRequest* request,
+                      size_t max_size,
+                      size_t* length);
+  bool KeepAlive(Slice connection) const;
   Status ParseStartLine(Slice& data);
   Status ParseHeader(Slice& data);
   Status OperationAfterParseHeader();
@@ -59,7 +92,12 @@ class HTTPMessageCodec {
   void ParseHTTPMessagePayload(HTTPMessage* message,
                                const std::string& boundary) const;
   uint32_t content_length_{std::numeric_limits<uint32_t>::max()};
+  bool http11_{false};
+  bool keep_alive_{false};
+  bool suspended_{false};
+  uint64_t bytes_processed_{0};
   std::string data_to_peer_;
+  std::function<void()> resume_callback_;
   HTTPMessage http_message_;
 };
 }  // namespace alpha
@@ -0,0 +1,97 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  HTTPRequest.cc
+ *        Created:  10/18/26 22:46:32
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <alpha/HTTPRequest.h>
+#include <strings.h>
+#include <cstring>
+
+namespace alpha {
+const int HTTPRequest::kMaxHeaders;
+const int HTTPRequest::kIndexSize;
+
+HTTPRequest::HTTPRequest() { Clear(); }
+
+Slice HTTPRequest::Header(Slice name) const {
+  int i = FindHeader(name);
+  return i < 0 ? Slice() : headers_[i].value;
+}
+
+bool HTTPRequest::HasHeader(Slice name) const { return FindHeader(name) >= 0; }
+
+Slice HTTPRequest::Param(Slice key) const {
+  Slice result;
+  bool found = false;
+  ForeachParam([&](Slice k, Slice v) {
+    if (!found && k == key) {
+      result = v;
+      found = true;
+    }
+  });
+  return result;
+}
+
+uint32_t HTTPRequest::HashName(Slice name) {
+  // FNV-1a, 先转成小写
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < name.size(); ++i) {
+    hash ^= static_cast<uint8_t>(name.data()[i]) | 0x20;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+bool HTTPRequest::NameEquals(Slice lhs, Slice rhs) {
+  return lhs.size() == rhs.size() &&
+         ::strncasecmp(lhs.data(), rhs.data(), lhs.size()) == 0;
+}
+
+void HTTPRequest::Clear() {
+  method_.Clear();
+  path_.Clear();
+  query_string_.Clear();
+  body_.Clear();
+  http11_ = false;
+  header_count_ = 0;
+  memset(index_, 0, sizeof(index_));
+}
+
+bool HTTPRequest::AddHeader(Slice name, Slice value) {
+  if (header_count_ == kMaxHeaders) {
+    return false;
+  }
+  headers_[header_count_] = HeaderField{name, value};
+  // 槽数是头部上限的两倍, 一定能找到空槽
+  uint32_t slot = HashName(name) % kIndexSize;
+  while (index_[slot] != 0) {
+    if (NameEquals(headers_[index_[slot] - 1].name, name)) {
+      // 同名的头部只索引第一个
+      ++header_count_;
+      return true;
+    }
+    slot = (slot + 1) % kIndexSize;
+  }
+  index_[slot] = static_cast<uint8_t>(++header_count_);
+  return true;
+}
+
+int HTTPRequest::FindHeader(Slice name) const {
+  uint32_t slot = HashName(name) % kIndexSize;
+  while (index_[slot] != 0) {
+    int i = index_[slot] - 1;
+    if (NameEquals(headers_[i].name, name)) {
+      return i;
+    }
+    slot = (slot + 1) % kIndexSize;
+  }
+  return -1;
+}
+}
@@ -0,0 +1,98 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  HTTPRequest.h
+ *        Created:  10/18/26 22:41:09
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  不拷贝数据的HTTP请求
+ *
+ * =============================================================================
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <alpha/Compiler.h>
+#include <alpha/Slice.h>
+
+namespace alpha {
+class HTTPMessageCodec;
+
+// 由HTTPMessageCodec::ProcessInPlace填充, 所有的Slice都指向连接的读缓冲区,
+// 只在回调期间有效, 需要保存的内容要自己拷贝
+class HTTPRequest final {
+ public:
+  static const int kMaxHeaders = 32;
+
+  HTTPRequest();
+  DISABLE_COPY_ASSIGNMENT(HTTPRequest);
+
+  Slice method() const { return method_; }
+  Slice path() const { return path_; }
+  Slice query_string() const { return query_string_; }
+  Slice body() const { return body_; }
+  bool http11() const { return http11_; }
+
+  // 头部名字不区分大小写, 同名的头部返回第一个, 不存在时返回空的Slice
+  Slice Header(Slice name) const;
+  bool HasHeader(Slice name) const;
+  int header_count() const { return header_count_; }
+  template <typename LAMBDA>
+  void ForeachHeader(LAMBDA lambda) const;
+
+  // 在query string中查找参数, 不做URL解码
+  Slice Param(Slice key) const;
+  template <typename LAMBDA>
+  void ForeachParam(LAMBDA lambda) const;
+
+ private:
+  friend class HTTPMessageCodec;
+  struct HeaderField {
+    Slice name;
+    Slice value;
+  };
+  // 开放寻址, 槽里存header下标加一, 0表示空槽
+  static const int kIndexSize = 64;
+
+  static uint32_t HashName(Slice name);
+  static bool NameEquals(Slice lhs, Slice rhs);
+  void Clear();
+  // 超过kMaxHeaders时返回false
+  bool AddHeader(Slice name, Slice value);
+  int FindHeader(Slice name) const;
+
+  Slice method_;
+  Slice path_;
+  Slice query_string_;
+  Slice body_;
+  bool http11_;
+  int header_count_;
+  HeaderField headers_[kMaxHeaders];
+  uint8_t index_[kIndexSize];
+};
+
+template <typename LAMBDA>
+void HTTPRequest::ForeachHeader(LAMBDA lambda) const {
+  for (int i = 0; i < header_count_; ++i) {
+    lambda(headers_[i].name, headers_[i].value);
+  }
+}
+
+template <typename LAMBDA>
+void HTTPRequest::ForeachParam(LAMBDA lambda) const {
+  const char* p = query_string_.data();
+  const char* end = p + query_string_.size();
+  while (p < end) {
+    const char* sep = p;
+    while (sep < end && *sep != '&') ++sep;
+    const char* eq = p;
+    while (eq < sep && *eq != '=') ++eq;
+    if (eq != p) {
+      lambda(Slice(p, eq - p),
+             eq == sep ? Slice() : Slice(eq + 1, sep - eq - 1));
+    }
+    p = sep + 1;
+  }
+}
+}
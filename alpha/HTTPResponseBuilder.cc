@@ -11,9 +11,117 @@
  */
 
 #include <alpha/HTTPResponseBuilder.h>
+#include <sys/stat.h>
 #include <cassert>
+#include <alpha/Logger.h>
+#include <alpha/HTTPMessageCodec.h>
 
 namespace alpha {
+namespace {
+const char* CRLF = "\r\n";
+
+HTTPMessageCodec* GetCodec(const TcpConnectionPtr& conn) {
+  auto codec = conn->GetContextPtr<std::shared_ptr<HTTPMessageCodec>>();
+  return codec ? codec->get() : nullptr;
+}
+
+void CloseConnection(TcpConnectionPtr conn) {
+  conn->SetOnWriteDone(nullptr);
+  if (!conn->closed()) {
+    conn->Close();
+  }
+}
+
+// 回包的数据都交给连接之后调用
+// 不保持连接时要等数据都写出去再关闭, 否则发送队列中的数据会被丢掉
+void FinishResponse(const TcpConnectionPtr& conn, bool keep_alive) {
+  if (conn->closed()) {
+    return;
+  }
+  auto codec = GetCodec(conn);
+  if (keep_alive) {
+    if (codec && codec->suspended()) {
+      codec->Resume();
+    }
+  } else if (conn->BytesToWrite() == 0) {
+    conn->Close();
+  } else {
+    if (codec) {
+      codec->Suspend();
+    }
+    conn->SetOnWriteDone(&CloseConnection);
+  }
+}
+
+// 由写完成回调驱动, 发送队列降到水位以下才继续向producer要数据
+class ChunkedStream {
+ public:
+  ChunkedStream(const HTTPResponseBuilder::ChunkProducer& producer,
+                bool chunked,
+                bool keep_alive)
+      : producer_(producer), chunked_(chunked), keep_alive_(keep_alive) {}
+
+  // 返回true表示已经发完
+  bool Pump(const TcpConnectionPtr& conn) {
+    while (conn->BytesToWrite() < HTTPResponseBuilder::kStreamHighWaterMark) {
+      chunk_.clear();
+      if (!producer_(&chunk_)) {
+        if (chunked_) {
+          conn->Write("0\r\n\r\n");
+        }
+        return true;
+      }
+      // 空的chunk表示结束, 不能发出去
+      if (chunk_.empty()) {
+        continue;
+      }
+      if (!WriteChunk(conn)) {
+        // 已经发出去一部分了, 只能关闭连接
+        conn->Close();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void OnWriteDone(TcpConnectionPtr conn) {
+    if (!conn->closed() && Pump(conn)) {
+      conn->SetOnWriteDone(nullptr);
+      FinishResponse(conn, keep_alive_);
+    }
+  }
+
+ private:
+  bool WriteChunk(const TcpConnectionPtr& conn) {
+    char size_line[32];
+    int n = 0;
+    if (chunked_) {
+      n = snprintf(size_line, sizeof(size_line), "%zx\r\n", chunk_.size());
+    }
+    if (conn->BytesCanWrite() < n + chunk_.size() + (chunked_ ? 2 : 0)) {
+      LOG_WARNING << "Chunk too large, size = " << chunk_.size()
+                  << ", bytes can write = " << conn->BytesCanWrite();
+      return false;
+    }
+    if (chunked_) {
+      conn->Write(size_line, n);
+    }
+    conn->Write(std::move(chunk_));
+    if (chunked_) {
+      conn->Write(CRLF);
+    }
+    return true;
+  }
+
+  HTTPResponseBuilder::ChunkProducer producer_;
+  const bool chunked_;
+  const bool keep_alive_;
+  std::string chunk_;
+};
+}
+
+const size_t HTTPResponseBuilder::kStreamHighWaterMark = 64 << 10;
+
 HTTPResponseBuilder::HTTPResponseBuilder(TcpConnectionPtr& conn) : conn_(conn) {
   assert(conn_ && !conn_->closed());
 }
@@ -40,30 +148,95 @@ HTTPResponseBuilder& HTTPResponseBuilder::AddHeader(Slice name, Slice value) {
 }
 
 void HTTPResponseBuilder::SendWithEOM() {
+  const bool keep_alive = KeepAlive();
+  // 先拼好头部, 和body一起最多两次写就能发出去
+  auto head = BuildHead(keep_alive);
+  head.append("Content-Length: ");
+  head.append(std::to_string(body_.size()));
+  head.append(CRLF);
+  // 保持连接时客户端靠空行和Content-Length区分下一个回包
+  head.append(CRLF);
+  conn_->Write(std::move(head));
+  if (!body_.empty()) {
+    conn_->Write(std::move(body_));
+  }
+  FinishResponse(conn_, keep_alive);
+}
+
+void HTTPResponseBuilder::SendChunked(const ChunkProducer& producer) {
+  using namespace std::placeholders;
+  auto codec = GetCodec(conn_);
+  // HTTP/1.0不认识chunked编码, 只能靠关闭连接表示结束
+  const bool chunked = !codec || codec->http11();
+  const bool keep_alive = chunked && KeepAlive();
+  auto head = BuildHead(keep_alive);
+  if (chunked) {
+    head.append("Transfer-Encoding: chunked");
+    head.append(CRLF);
+  }
+  head.append(CRLF);
+  conn_->Write(std::move(head));
+
+  auto stream = std::make_shared<ChunkedStream>(producer, chunked, keep_alive);
+  if (stream->Pump(conn_)) {
+    FinishResponse(conn_, keep_alive);
+    return;
+  }
+  if (codec) {
+    codec->Suspend();
+  }
+  conn_->SetOnWriteDone(std::bind(&ChunkedStream::OnWriteDone, stream, _1));
+}
+
+bool HTTPResponseBuilder::SendFile(int fd, off_t offset, size_t len) {
+  struct stat st;
+  if (::fstat(fd, &st) == -1 || offset < 0 ||
+      static_cast<uint64_t>(offset) + len > static_cast<uint64_t>(st.st_size)) {
+    LOG_WARNING << "Invalid file range, fd = " << fd << ", offset = " << offset
+                << ", len = " << len;
+    return false;
+  }
+  const bool keep_alive = KeepAlive();
+  auto head = BuildHead(keep_alive);
+  head.append("Content-Length: ");
+  head.append(std::to_string(len));
+  head.append(CRLF);
+  head.append(CRLF);
+  conn_->Write(std::move(head));
+  if (!conn_->SendFile(fd, offset, len)) {
+    // 头部已经发出去了, 只能关闭连接
+    conn_->Close();
+    return true;
+  }
+  FinishResponse(conn_, keep_alive);
+  return true;
+}
+
+bool HTTPResponseBuilder::KeepAlive() const {
+  // 由SimpleHTTPServer接收的请求按请求决定是否保持连接, 否则发完就关闭
+  auto codec = GetCodec(conn_);
+  return codec && codec->keep_alive();
+}
+
+std::string HTTPResponseBuilder::BuildHead(bool keep_alive) {
   char buf[64];
-  const char* CRLF = "\r\n";
   auto nbytes = snprintf(buf,
                          sizeof(buf),
-                         "HTTP/1.0 %d %s%s",
+                         "HTTP/1.1 %d %s%s",
                          message_.Status(),
                          message_.StatusString().c_str(),
                          CRLF);
   assert(nbytes < static_cast<ssize_t>(sizeof(buf)));
-  conn_->Write(alpha::Slice(buf, nbytes));
+  std::string head(buf, nbytes);
   message_.Headers().Foreach(
-      [&CRLF, this](const std::string& name, const std::string& val) {
-        conn_->Write(name);
-        conn_->Write(": ");
-        conn_->Write(val);
-        conn_->Write(CRLF);
+      [&head](const std::string& name, const std::string& val) {
+        head.append(name);
+        head.append(": ");
+        head.append(val);
+        head.append(CRLF);
       });
-  conn_->Write("Content-Length: ");
-  conn_->Write(std::to_string(body_.size()));
-  conn_->Write(CRLF);
-  if (!body_.empty()) {
-    conn_->Write(CRLF);
-    conn_->Write(body_);
-  }
-  conn_->Close();
+  head.append(keep_alive ? "Connection: keep-alive" : "Connection: close");
+  head.append(CRLF);
+  return head;
 }
 }
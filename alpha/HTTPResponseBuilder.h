@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <sys/types.h>
+#include <functional>
 #include <alpha/Slice.h>
 #include <alpha/TcpConnection.h>
 #include <alpha/HTTPMessage.h>
@@ -19,6 +21,9 @@
 namespace alpha {
 class HTTPResponseBuilder {
  public:
+  // 往chunk里填下一块数据, 返回false表示没有更多数据了
+  using ChunkProducer = std::function<bool(std::string* chunk)>;
+
   HTTPResponseBuilder(TcpConnectionPtr& conn);
 
   HTTPResponseBuilder& status(int16_t code, Slice msg);
@@ -26,9 +31,23 @@ class HTTPResponseBuilder {
   HTTPResponseBuilder& body(std::string&& body);
 
   HTTPResponseBuilder& AddHeader(Slice name, Slice value);
+  // 请求要求保持连接时发完不关闭, 否则发完就关闭连接
   void SendWithEOM();
+  // 用chunked编码流式发送, 待发数据少于kStreamHighWaterMark时才向producer要数据
+  // 没发完之前同一个连接上后面的请求暂不处理, producer可能在之后的写完成回调中调用
+  // HTTP/1.0的请求不分块, 发完之后关闭连接
+  void SendChunked(const ChunkProducer& producer);
+  // 用sendfile(2)发送文件中[offset, offset + len)的内容, 数据直接从page cache发出
+  // 范围超出文件大小时返回false, 此时什么都没有发送, 可以改发别的回包
+  // 返回之后fd可以立即关闭
+  bool SendFile(int fd, off_t offset, size_t len);
+
+  static const size_t kStreamHighWaterMark;
 
  private:
+  bool KeepAlive() const;
+  std::string BuildHead(bool keep_alive);
+
   TcpConnectionPtr conn_;
   HTTPMessage message_;
   std::string body_;
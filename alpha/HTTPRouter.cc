@@ -0,0 +1,122 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  HTTPRouter.cc
+ *        Created:  10/18/26 23:15:27
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <alpha/HTTPRouter.h>
+#include <algorithm>
+#include <cstring>
+#include <alpha/HTTPRequest.h>
+#include <alpha/HTTPResponseBuilder.h>
+
+namespace alpha {
+namespace {
+// 依次取出路径中非空的分段, 没有更多分段时返回false
+bool NextSegment(const char** p, const char* end, Slice* segment) {
+  while (*p < end && **p == '/') ++*p;
+  if (*p == end) {
+    return false;
+  }
+  const char* slash = static_cast<const char*>(::memchr(*p, '/', end - *p));
+  if (slash == nullptr) slash = end;
+  *segment = Slice(*p, slash - *p);
+  *p = slash;
+  return true;
+}
+}
+
+HTTPRouter::HTTPRouter() : root_(new Node) {}
+
+HTTPRouter::~HTTPRouter() = default;
+
+void HTTPRouter::Add(Slice method, Slice path, const Handler& handler) {
+  Insert(path)->exact.push_back(Route{method.ToString(), handler});
+}
+
+void HTTPRouter::AddPrefix(Slice method,
+                           Slice prefix,
+                           const Handler& handler) {
+  Insert(prefix)->prefix.push_back(Route{method.ToString(), handler});
+}
+
+HTTPRouter::Node* HTTPRouter::Insert(Slice path) {
+  Node* node = root_.get();
+  const char* p = path.data();
+  Slice segment;
+  while (NextSegment(&p, path.end(), &segment)) {
+    auto it = std::find_if(
+        node->children.begin(),
+        node->children.end(),
+        [&segment](const std::pair<std::string, std::unique_ptr<Node>>& c) {
+          return segment == c.first;
+        });
+    if (it == node->children.end()) {
+      node->children.emplace_back(segment.ToString(),
+                                  std::unique_ptr<Node>(new Node));
+      it = node->children.end() - 1;
+    }
+    node = it->second.get();
+  }
+  return node;
+}
+
+const HTTPRouter::Route* HTTPRouter::Match(const std::vector<Route>& routes,
+                                           Slice method) {
+  for (const auto& route : routes) {
+    if (route.method.empty() || method == route.method) {
+      return &route;
+    }
+  }
+  return nullptr;
+}
+
+void HTTPRouter::Dispatch(TcpConnectionPtr conn,
+                          const HTTPRequest& request) const {
+  const Node* node = root_.get();
+  const Route* prefix_route = Match(node->prefix, request.method());
+  bool path_exists = !node->prefix.empty();
+  const char* p = request.path().data();
+  const char* end = p + request.path().size();
+  Slice segment;
+  while (node && NextSegment(&p, end, &segment)) {
+    const Node* next = nullptr;
+    for (const auto& child : node->children) {
+      if (segment == child.first) {
+        next = child.second.get();
+        break;
+      }
+    }
+    node = next;
+    if (node && !node->prefix.empty()) {
+      path_exists = true;
+      auto route = Match(node->prefix, request.method());
+      if (route) prefix_route = route;
+    }
+  }
+
+  const Route* route = nullptr;
+  if (node && !node->exact.empty()) {
+    path_exists = true;
+    route = Match(node->exact, request.method());
+  }
+  if (route == nullptr) {
+    route = prefix_route;
+  }
+  if (route) {
+    route->handler(std::move(conn), request);
+  } else if (path_exists) {
+    HTTPResponseBuilder(conn).status(405, "Method Not Allowed").SendWithEOM();
+  } else if (not_found_handler_) {
+    not_found_handler_(std::move(conn), request);
+  } else {
+    HTTPResponseBuilder(conn).status(404, "Not Found").SendWithEOM();
+  }
+}
+}
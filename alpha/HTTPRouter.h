@@ -0,0 +1,64 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  HTTPRouter.h
+ *        Created:  10/18/26 23:08:51
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  按路径分发HTTP请求
+ *
+ * =============================================================================
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <alpha/Compiler.h>
+#include <alpha/Slice.h>
+#include <alpha/TcpConnection.h>
+
+namespace alpha {
+class HTTPRequest;
+
+// 路径按'/'分段存成一棵trie, 查找时不分配内存
+// 完全匹配优先, 其次是最长的前缀匹配; 路径存在但方法不匹配时回405, 否则回404
+class HTTPRouter final {
+ public:
+  using Handler = std::function<void(TcpConnectionPtr, const HTTPRequest&)>;
+
+  HTTPRouter();
+  ~HTTPRouter();
+  DISABLE_COPY_ASSIGNMENT(HTTPRouter);
+
+  // method为空时匹配所有方法, 空的分段会被忽略, 即"/a/"和"/a"相同
+  void Add(Slice method, Slice path, const Handler& handler);
+  // 匹配prefix本身以及它下面的所有路径, 比如"/static"匹配"/static/a.js"
+  void AddPrefix(Slice method, Slice prefix, const Handler& handler);
+  // 替换默认的404回包
+  void SetNotFoundHandler(const Handler& handler) {
+    not_found_handler_ = handler;
+  }
+
+  void Dispatch(TcpConnectionPtr conn, const HTTPRequest& request) const;
+
+ private:
+  struct Route {
+    std::string method;
+    Handler handler;
+  };
+  struct Node {
+    std::vector<std::pair<std::string, std::unique_ptr<Node>>> children;
+    std::vector<Route> exact;
+    std::vector<Route> prefix;
+  };
+
+  Node* Insert(Slice path);
+  static const Route* Match(const std::vector<Route>& routes, Slice method);
+
+  std::unique_ptr<Node> root_;
+  Handler not_found_handler_;
+};
+}
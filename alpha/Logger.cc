@@ -17,11 +17,14 @@
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <functional>
 #include <alpha/Compiler.h>
+#include <alpha/LoggerAsyncWriter.h>
 #include <alpha/StackTrace.h>
 
 namespace detail {
@@ -54,8 +57,12 @@ std::string LogEnv::logdir_ = "/tmp";
 std::atomic_int LogDestination::logs_num_[alpha::kLogLevelNum];
 const char* LogDestination::prog_name_ = nullptr;
 LogDestination::LogFilesPtr LogDestination::files_;
+std::mutex LogDestination::files_mutex_;
+std::atomic<LoggerAsyncWriter*> LogDestination::async_writer_(nullptr);
 
 static const int kLogBufferSize = 30 * 1024;
+// 异步模式下每个线程的暂存区至少能放下两条最长的日志
+static const size_t kMinAsyncBufferSize = 4 * kLogBufferSize;
 
 static const char* const_basename(const char* name) {
   auto p = ::strrchr(name, '/');
@@ -73,6 +80,7 @@ void Logger::set_minloglevel(int level) {
   if (level < 0 || level >= kLogLevelNum) {
     alpha::Slice warning("[WARN]Invalid minloglevel, default to kLogLevelInfo");
     LogEnv::minloglevel_ = kLogLevelInfo;
+    return;
   }
   LogEnv::minloglevel_ = static_cast<LogLevel>(level);
 }
@@ -85,6 +93,48 @@ const char* Logger::GetLogLevelName(int level) {
   return LogLevelNames_[level];
 }
 
+// 其他线程可能还在写日志, 所以只停止后台线程, 不释放writer, 也不切回同步写文件
+// (files_会在之后的静态析构中释放). 停止之前写入的日志都会写到文件
+void Logger::StopAsyncAtExit() {
+  auto writer = LogDestination::async_writer_.load(std::memory_order_acquire);
+  if (writer) {
+    writer->Stop();
+  }
+}
+
+void Logger::EnableAsync(const AsyncLogOptions& options) {
+  if (!initialized_ || LogEnv::logtostderr()) {
+    return;
+  }
+  static bool registered = false;
+  if (!registered) {
+    std::atexit(&Logger::StopAsyncAtExit);
+    registered = true;
+  }
+  AsyncLogOptions adjusted = options;
+  adjusted.thread_buffer_size =
+      std::max(options.thread_buffer_size, kMinAsyncBufferSize);
+  delete LogDestination::async_writer_.exchange(nullptr);
+  LogDestination::async_writer_.store(new LoggerAsyncWriter(
+      adjusted, LogEnv::minloglevel(), &LogDestination::WriteToFile));
+}
+
+void Logger::DisableAsync() {
+  delete LogDestination::async_writer_.exchange(nullptr);
+}
+
+void Logger::Flush() {
+  auto writer = LogDestination::async_writer_.load(std::memory_order_acquire);
+  if (writer) {
+    writer->Flush();
+  }
+}
+
+uint64_t Logger::dropped_logs() {
+  auto writer = LogDestination::async_writer_.load(std::memory_order_acquire);
+  return writer ? writer->dropped() : 0;
+}
+
 void Logger::SendLog(LogLevel level, const char* buf, int len) {
   assert(len >= 0);
   static bool first_log_before_init = true;
@@ -152,12 +202,23 @@ void LogDestination::SendLog(LogLevel level, const char* buf, int len) {
   const int minloglevel = LogEnv::minloglevel();
   if (log_level >= minloglevel) {
     ++logs_num_[level];
+    auto writer = async_writer_.load(std::memory_order_acquire);
+    if (writer) {
+      writer->Append(level, static_cast<LogLevel>(minloglevel), buf, len);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(files_mutex_);
     for (int i = minloglevel; i <= log_level; ++i) {
       files_->at(i)->Write(buf, len);
     }
   }
 }
 
+void LogDestination::WriteToFile(LogLevel level, const char* buf, int len) {
+  std::lock_guard<std::mutex> lock(files_mutex_);
+  files_->at(level)->Write(buf, len);
+}
+
 void LogDestination::SendLogToStderr(LogLevel level, const char* buf, int len) {
   logs_num_[level]++;
   ::write(STDERR_FILENO, buf, len);
@@ -170,6 +231,93 @@ void LogDestination::AddFileSink(int level) {
       LogEnv::logdir(), prog_name_, Logger::GetLogLevelName(level))));
 }
 
+// 格式化一条日志用的缓冲区和流, 每个线程缓存一个, 避免每条日志都分配内存
+class LogMessageBuffer {
+ public:
+  char data[kLogBufferSize];
+  LoggerStream stream;
+  bool in_use = false;
+};
+
+static thread_local LogMessageBuffer* local_log_buffer = nullptr;
+static thread_local bool local_log_buffer_destroyed = false;
+
+namespace {
+struct LocalLogBufferDeleter {
+  ~LocalLogBufferDeleter() {
+    delete local_log_buffer;
+    local_log_buffer = nullptr;
+    local_log_buffer_destroyed = true;
+  }
+};
+thread_local LocalLogBufferDeleter local_log_buffer_deleter;
+}
+
+// 写入"[2015-01-01 00:00:00.000000 tid LEVEL file:line] ", 返回长度
+// 秒以上的部分每秒格式化一次, 其余的部分直接拼接
+static int FormatLogPrefix(char* buf,
+                           LogLevel level,
+                           const char* file,
+                           int line) {
+  static thread_local time_t last_second = -1;
+  static thread_local char time_prefix[32];
+  static thread_local int time_prefix_len = 0;
+  static thread_local char tid_string[24];
+  static thread_local int tid_len = 0;
+  static const int kMaxBaseNameLength = 256;
+
+  struct timeval tv;
+  int ret = gettimeofday(&tv, NULL);
+  assert(ret == 0);
+  (void)ret;
+  if (unlikely(tid_len == 0)) {
+    char* end = tid_string + sizeof(tid_string);
+    char* begin = detail::FormatDecimal(syscall(SYS_gettid), end);
+    tid_len = end - begin;
+    memmove(tid_string, begin, tid_len);
+  }
+  if (tv.tv_sec != last_second) {
+    struct tm tm;
+    last_second = tv.tv_sec;
+    if (NULL != localtime_r(&tv.tv_sec, &tm)) {
+      time_prefix_len = strftime(
+          time_prefix, sizeof(time_prefix), "[%Y-%m-%d %H:%M:%S.", &tm);
+    }
+  }
+
+  char* p = buf;
+  memcpy(p, time_prefix, time_prefix_len);
+  p += time_prefix_len;
+  auto usec = static_cast<uint32_t>(tv.tv_usec);
+  for (int i = 5; i >= 0; --i) {
+    p[i] = static_cast<char>('0' + usec % 10);
+    usec /= 10;
+  }
+  p += 6;
+  *p++ = ' ';
+  memcpy(p, tid_string, tid_len);
+  p += tid_len;
+  *p++ = ' ';
+  auto level_name = Logger::GetLogLevelName(level);
+  auto level_len = strlen(level_name);
+  memcpy(p, level_name, level_len);
+  p += level_len;
+  *p++ = ' ';
+  auto basename = const_basename(file);
+  auto basename_len = std::min<size_t>(strlen(basename), kMaxBaseNameLength);
+  memcpy(p, basename, basename_len);
+  p += basename_len;
+  *p++ = ':';
+  char digits[24];
+  char* digits_end = digits + sizeof(digits);
+  char* digits_begin = detail::FormatDecimal(line, digits_end);
+  memcpy(p, digits_begin, digits_end - digits_begin);
+  p += digits_end - digits_begin;
+  *p++ = ']';
+  *p++ = ' ';
+  return p - buf;
+}
+
 LogMessage::LogMessage(const char* file,
                        int line,
                        LogLevel level,
@@ -181,41 +329,27 @@ LogMessage::LogMessage(const char* file,
       level_(level),
       errno_message_(errno_message),
       expr_(expr),
-      log_buffer_(kLogBufferSize) {
-  static const int kTimeFormatBufferSize = 256;
-  static thread_local struct tm tm;
-  static thread_local time_t last_second = 0;
-  static thread_local char time_format[kTimeFormatBufferSize];
-  static thread_local pid_t tid = 0;
-
+      buffer_(nullptr),
+      owns_buffer_(false) {
   preserved_errno_ = errno;
-  struct timeval tv;
-  int ret = gettimeofday(&tv, NULL);
-  assert(ret == 0);
-  (void)ret;
-  if (unlikely(tid == 0)) {
-    tid = syscall(SYS_gettid);
+  if (unlikely(local_log_buffer == nullptr && !local_log_buffer_destroyed)) {
+    (void)&local_log_buffer_deleter;
+    local_log_buffer = new LogMessageBuffer;
   }
-  if (tv.tv_sec != last_second) {
-    last_second = tv.tv_sec;
-    if (NULL != localtime_r(&tv.tv_sec, &tm)) {
-      strftime(time_format,
-               sizeof(time_format),
-               "[%Y-%m-%d %H:%M:%S.%%06u %%d %%s %%s:%%d] ",
-               &tm);
-    }
+  if (likely(local_log_buffer && !local_log_buffer->in_use)) {
+    buffer_ = local_log_buffer;
+  } else {
+    // 格式化的过程中又写日志, 或者线程已经在退出了
+    buffer_ = new LogMessageBuffer;
+    owns_buffer_ = true;
   }
-  auto nbytes = snprintf(log_buffer_.data(),
-                         kLogBufferSize,
-                         time_format,
-                         tv.tv_usec,
-                         tid,
-                         Logger::GetLogLevelName(level),
-                         const_basename(file_),
-                         line_);
+  buffer_->in_use = true;
+
+  auto nbytes = FormatLogPrefix(buffer_->data, level, file_, line_);
   assert(nbytes > 0 && nbytes < kLogBufferSize);
-  stream_.rdbuf()->pubsetbuf(log_buffer_.data() + nbytes,
-                             kLogBufferSize - nbytes - 1);
+  buffer_->stream.Reset();
+  buffer_->stream.rdbuf()->pubsetbuf(buffer_->data + nbytes,
+                                     kLogBufferSize - nbytes - 1);
   if (unlikely(expr_ != nullptr)) {
     stream() << "Check failed: " << expr_ << " ";
   }
@@ -232,13 +366,20 @@ LogMessage::~LogMessage() {
     LogStackTrace(stream());
   }
   Flush();
+  if (owns_buffer_) {
+    delete buffer_;
+  } else {
+    buffer_->in_use = false;
+  }
   errno = preserved_errno_;
   if (unlikely(level_ == kLogLevelFatal)) {
+    // 异步模式下先等后台线程写完, 不能丢掉FATAL之前的日志
+    Logger::Flush();
     abort();
   }
 }
 
-alpha::LoggerStream& LogMessage::stream() { return stream_; }
+alpha::LoggerStream& LogMessage::stream() { return buffer_->stream; }
 
 int LogMessage::preserved_errno() const { return preserved_errno_; }
 
@@ -265,7 +406,7 @@ void LogMessage::LogStackTrace(LoggerStream& stream) {
         ++left_parenthesis;
         auto plus = strchr(left_parenthesis, '+');
         if (plus) {
-          function = detail::DemangleCxxName(left_parenthesis, plus);
+          function = ::detail::DemangleCxxName(left_parenthesis, plus);
         }
       }
       static const size_t kFormattedSize = 512;
@@ -284,13 +425,14 @@ void LogMessage::Flush() {
   if (flushed_) {
     return;
   }
-  int len = header_size_ + stream_.streambuf()->used();
+  int len = header_size_ + buffer_->stream.streambuf()->used();
   assert(len < kLogBufferSize);
-  if (log_buffer_[len - 1] != '\n') {
-    log_buffer_[len] = '\n';
+  auto data = buffer_->data;
+  if (data[len - 1] != '\n') {
+    data[len] = '\n';
     len += 1;
   }
-  Logger::SendLog(level_, log_buffer_.data(), len);
+  Logger::SendLog(level_, data, len);
   flushed_ = true;
 }
 }
@@ -13,6 +13,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <atomic>
 #include <functional>
@@ -28,6 +29,24 @@ enum LogLevel {
 };
 static const int kLogLevelNum = 4;
 
+// 异步日志的暂存区满了之后的处理方式
+enum class LogOverflowPolicy {
+  kBlock,         // 等待后台线程腾出空间, 不丢日志
+  kDrop,          // 直接丢弃, 只能通过Logger::dropped_logs查到
+  kDropAndCount,  // 丢弃, 并在日志文件中记录丢了多少条
+};
+
+struct AsyncLogOptions {
+  // 每个线程一个暂存区, 至少能放下一条最长的日志
+  size_t thread_buffer_size = 1 << 20;
+  // 后台线程最长多久写一次文件
+  uint32_t flush_interval_ms = 100;
+  LogOverflowPolicy overflow_policy = LogOverflowPolicy::kBlock;
+};
+
+class LoggerAsyncWriter;
+class LogMessageBuffer;
+
 class Logger {
  private:
   struct LogVoidify {
@@ -42,10 +61,22 @@ class Logger {
   static void set_logdir(alpha::Slice logdir);
   static void SendLog(LogLevel level, const char* buf, int len);
   static const char* GetLogLevelName(int level);
+  // 低于minloglevel的日志在构造LogMessage之前就被过滤掉
+  static bool enabled(LogLevel level);
+  // 写文件交给后台线程, Init之后调用, 和写日志的线程之间不能并发调用
+  // 只对写文件生效, logtostderr时什么也不做
+  static void EnableAsync(const AsyncLogOptions& options = AsyncLogOptions());
+  // 写完暂存的日志, 回到同步写文件, 和写日志的线程之间不能并发调用
+  // 进程退出时会自动写完暂存的日志
+  static void DisableAsync();
+  // 等待之前的日志都写到文件, FATAL日志abort之前会调用
+  static void Flush();
+  static uint64_t dropped_logs();
   static LogVoidify dummy_;
 
  private:
   Logger(LogLevel level, const LoggerOutput& output);
+  static void StopAsyncAtExit();
   static const char* LogLevelNames_[kLogLevelNum];
   static bool initialized_;
 };
@@ -64,6 +95,10 @@ class LogEnv {
   static std::string logdir_;
 };
 
+inline bool Logger::enabled(LogLevel level) {
+  return level >= LogEnv::minloglevel_;
+}
+
 class LogDestination {
  public:
   static void Init(const char* prog_name);
@@ -72,12 +107,18 @@ class LogDestination {
   static int GetLogNum(LogLevel level);
 
  private:
+  friend class Logger;
   using LogFiles = std::vector<std::unique_ptr<LoggerFile>>;
   using LogFilesPtr = std::unique_ptr<LogFiles>;
   static void AddFileSink(int level);
+  static void WriteToFile(LogLevel level, const char* buf, int len);
   static std::atomic_int logs_num_[kLogLevelNum];
   static const char* prog_name_;
   static LogFilesPtr files_;
+  // 同步模式下多个线程写同一个LoggerFile
+  static std::mutex files_mutex_;
+  // 写日志的线程不加锁读取, 进程退出时只停止后台线程不释放
+  static std::atomic<LoggerAsyncWriter*> async_writer_;
 };
 
 class LogMessage final {
@@ -103,17 +144,18 @@ class LogMessage final {
   LogLevel level_;
   bool errno_message_;
   const char* expr_;
-  std::vector<char> log_buffer_;
-  alpha::LoggerStream stream_;
+  // 平时用线程局部的缓冲区, 格式化的过程中又写日志时才另外分配
+  LogMessageBuffer* buffer_;
+  bool owns_buffer_;
 };
 }
 #define ALPHA_TOSTRING1(x) #x
 #define ALPHA_TOSTRING(x) ALPHA_TOSTRING1(x)
 #define VodifyStream(stream) alpha::Logger::dummy_& stream
 
-#define LOG_IF(level, cond) \
-  !(cond)                   \
-      ? (void)0             \
+#define LOG_IF(level, cond)                  \
+  !((cond) && alpha::Logger::enabled(level)) \
+      ? (void)0                              \
       : VodifyStream(alpha::LogMessage(__FILE__, __LINE__, level).stream())
 #define LOG_INFO_IF(cond) LOG_IF(alpha::kLogLevelInfo, cond)
 #define LOG_WARNING_IF(cond) LOG_IF(alpha::kLogLevelWarning, cond)
@@ -122,10 +164,11 @@ class LogMessage final {
 #define LOG_WARNING LOG_WARNING_IF(true)
 #define LOG_ERROR LOG_ERROR_IF(true)
 
-#define PLOG_IF(level, cond) \
-  !(cond) ? (void)0          \
-          : VodifyStream(    \
-                alpha::LogMessage(__FILE__, __LINE__, level, true).stream())
+#define PLOG_IF(level, cond)                 \
+  !((cond) && alpha::Logger::enabled(level)) \
+      ? (void)0                              \
+      : VodifyStream(                        \
+            alpha::LogMessage(__FILE__, __LINE__, level, true).stream())
 #define PLOG_INFO_IF(cond) PLOG_IF(alpha::kLogLevelInfo, cond)
 #define PLOG_WARNING_IF(cond) PLOG_IF(alpha::kLogLevelWarning, cond)
 #define PLOG_ERROR_IF(cond) PLOG_IF(alpha::kLogLevelError, cond)
@@ -0,0 +1,239 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  LoggerAsyncWriter.cc
+ *        Created:  10/18/26 20:02:25
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <alpha/LoggerAsyncWriter.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <alpha/RingBuffer.h>
+
+// 这里不能用LOG和CHECK, 会递归回到自己
+namespace alpha {
+class LoggerAsyncWriter::StagingBuffer {
+ public:
+  explicit StagingBuffer(size_t size)
+      : memory(new uint8_t[size]), unflushed_bytes(0), retired(false) {
+    bool ok = ring.CreateFrom(memory.get(), size);
+    assert(ok);
+    (void)ok;
+  }
+
+  std::unique_ptr<uint8_t[]> memory;
+  RingBuffer ring;
+  // 生产者写入之后还没有通知后台线程的字节数
+  size_t unflushed_bytes;
+  // 线程退出之后置位, 后台线程写完剩下的日志后释放
+  std::atomic<bool> retired;
+};
+
+namespace {
+struct LocalStagingBuffer {
+  ~LocalStagingBuffer() {
+    if (buffer) {
+      buffer->retired.store(true, std::memory_order_release);
+    }
+  }
+  uint64_t writer_id = 0;
+  std::shared_ptr<LoggerAsyncWriter::StagingBuffer> buffer;
+};
+
+std::atomic<uint64_t> next_writer_id(1);
+thread_local LocalStagingBuffer local_buffer;
+}
+
+LoggerAsyncWriter::LoggerAsyncWriter(const AsyncLogOptions& options,
+                                     LogLevel minloglevel,
+                                     const Sink& sink)
+    : options_(options),
+      sink_(sink),
+      id_(next_writer_id++),
+      stop_(false),
+      flush_requested_(0),
+      flush_completed_(0),
+      minloglevel_(minloglevel),
+      reported_dropped_(0),
+      batches_(kLogLevelNum),
+      wakeup_pending_(false),
+      stopped_(false),
+      dropped_(0) {
+  thread_ = std::thread(&LoggerAsyncWriter::BackgroundRoutine, this);
+}
+
+LoggerAsyncWriter::~LoggerAsyncWriter() { Stop(); }
+
+void LoggerAsyncWriter::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_) {
+      return;
+    }
+    stop_ = true;
+  }
+  cond_.notify_one();
+  thread_.join();
+  stopped_.store(true, std::memory_order_relaxed);
+}
+
+void LoggerAsyncWriter::Append(LogLevel level,
+                               LogLevel minloglevel,
+                               const char* buf,
+                               int len) {
+  auto buffer = LocalBuffer();
+  const int record_len = len + 2;
+  void* reserved;
+  while ((reserved = buffer->ring.Reserve(record_len)) == nullptr) {
+    if (options_.overflow_policy != LogOverflowPolicy::kBlock ||
+        stopped_.load(std::memory_order_relaxed)) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      Wakeup();
+      return;
+    }
+    wakeup_pending_.store(true, std::memory_order_release);
+    cond_.notify_one();
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  // 前两个字节是级别和写入时的minloglevel, 后面是格式化好的日志
+  auto record = static_cast<uint8_t*>(reserved);
+  record[0] = static_cast<uint8_t>(level);
+  record[1] = static_cast<uint8_t>(minloglevel);
+  memcpy(record + 2, buf, len);
+  buffer->ring.CommitReserved(record_len);
+
+  // 攒够四分之一的暂存区才叫醒后台线程, 平时不碰共享的状态
+  buffer->unflushed_bytes += record_len;
+  if (buffer->unflushed_bytes >= options_.thread_buffer_size / 4) {
+    buffer->unflushed_bytes = 0;
+    Wakeup();
+  }
+}
+
+void LoggerAsyncWriter::Flush() {
+  if (std::this_thread::get_id() == thread_.get_id()) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  const uint64_t ticket = ++flush_requested_;
+  cond_.notify_one();
+  flushed_cond_.wait(lock, [this, ticket] {
+    return flush_completed_ >= ticket || stop_;
+  });
+}
+
+uint64_t LoggerAsyncWriter::dropped() const {
+  return dropped_.load(std::memory_order_relaxed);
+}
+
+LoggerAsyncWriter::StagingBuffer* LoggerAsyncWriter::LocalBuffer() {
+  if (unlikely(local_buffer.writer_id != id_)) {
+    if (local_buffer.buffer) {
+      local_buffer.buffer->retired.store(true, std::memory_order_release);
+    }
+    local_buffer.buffer =
+        std::make_shared<StagingBuffer>(options_.thread_buffer_size);
+    local_buffer.writer_id = id_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.push_back(local_buffer.buffer);
+  }
+  return local_buffer.buffer.get();
+}
+
+void LoggerAsyncWriter::Wakeup() {
+  // 不加锁通知, 错过的话后台线程最多晚flush_interval_ms醒来
+  if (!wakeup_pending_.exchange(true, std::memory_order_acq_rel)) {
+    cond_.notify_one();
+  }
+}
+
+void LoggerAsyncWriter::BackgroundRoutine() {
+  const auto interval = std::chrono::milliseconds(options_.flush_interval_ms);
+  std::vector<std::shared_ptr<StagingBuffer>> buffers;
+  std::vector<bool> retired;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (1) {
+    cond_.wait_for(lock, interval, [this] {
+      return stop_ || flush_requested_ != flush_completed_ ||
+             wakeup_pending_.load(std::memory_order_acquire);
+    });
+    const bool stop = stop_;
+    const uint64_t ticket = flush_requested_;
+    wakeup_pending_.store(false, std::memory_order_release);
+    buffers = buffers_;
+    lock.unlock();
+
+    // 先看是否退出再取数据, 退出之前写入的日志一定能取到
+    retired.resize(buffers.size());
+    for (size_t i = 0; i < buffers.size(); ++i) {
+      retired[i] = buffers[i]->retired.load(std::memory_order_acquire);
+      Drain(buffers[i].get());
+    }
+    WriteBatches();
+
+    lock.lock();
+    for (size_t i = 0; i < buffers.size(); ++i) {
+      if (retired[i]) {
+        auto it = std::find(buffers_.begin(), buffers_.end(), buffers[i]);
+        assert(it != buffers_.end());
+        buffers_.erase(it);
+      }
+    }
+    buffers.clear();
+    flush_completed_ = ticket;
+    flushed_cond_.notify_all();
+    if (stop) break;
+  }
+}
+
+void LoggerAsyncWriter::Drain(StagingBuffer* buffer) {
+  int len;
+  void* data;
+  while ((data = buffer->ring.PeekContiguous(&len)) != nullptr) {
+    auto record = static_cast<const char*>(data);
+    const int level = record[0];
+    minloglevel_ = static_cast<LogLevel>(record[1]);
+    // 和同步模式一样, 一条日志写到所有不高于它的级别的文件中
+    for (int i = minloglevel_; i <= level; ++i) {
+      batches_[i].append(record + 2, len - 2);
+    }
+    buffer->ring.Commit();
+  }
+}
+
+void LoggerAsyncWriter::WriteBatches() {
+  if (options_.overflow_policy == LogOverflowPolicy::kDropAndCount) {
+    const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reported_dropped_) {
+      char message[128];
+      auto lost = static_cast<unsigned long>(dropped - reported_dropped_);
+      int n = snprintf(message,
+                       sizeof(message),
+                       "[WARN]%lu log messages dropped by async logger\n",
+                       lost);
+      reported_dropped_ = dropped;
+      for (int i = minloglevel_; i <= kLogLevelWarning; ++i) {
+        batches_[i].append(message, n);
+      }
+    }
+  }
+  for (int i = 0; i < kLogLevelNum; ++i) {
+    auto& batch = batches_[i];
+    if (!batch.empty()) {
+      sink_(static_cast<LogLevel>(i),
+            batch.data(),
+            static_cast<int>(batch.size()));
+      batch.clear();
+    }
+  }
+}
+}
@@ -0,0 +1,84 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  LoggerAsyncWriter.h
+ *        Created:  10/18/26 20:02:18
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  异步日志的后台写线程
+ *
+ * =============================================================================
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <alpha/Compiler.h>
+#include <alpha/Logger.h>
+
+namespace alpha {
+// 每个写日志的线程有自己的单生产者单消费者暂存区(RingBuffer), 写日志时不加锁
+// 后台线程定期把所有暂存区的日志按级别攒起来, 每个日志文件一次write
+// 同一个线程的日志保持顺序, 不同线程之间的日志不保证按时间排序
+class LoggerAsyncWriter final {
+ public:
+  // 后台线程攒好一批之后调用, level是要写入的日志文件
+  using Sink = std::function<void(LogLevel level, const char* buf, int len)>;
+
+  // minloglevel只用于写丢弃日志的提示, 收到日志之后按日志写入时的级别更新
+  LoggerAsyncWriter(const AsyncLogOptions& options,
+                    LogLevel minloglevel,
+                    const Sink& sink);
+  // 写完所有暂存的日志之后才返回
+  ~LoggerAsyncWriter();
+  DISABLE_COPY_ASSIGNMENT(LoggerAsyncWriter);
+
+  // 写完所有暂存的日志, 停止后台线程, 之后写入的日志不会再写到文件
+  void Stop();
+  // minloglevel是写入时的最低级别, 和同步模式一样写到[minloglevel, level]的文件
+  void Append(LogLevel level, LogLevel minloglevel, const char* buf, int len);
+  // 等待调用之前写入的日志全部写到文件, 在后台线程中调用直接返回
+  void Flush();
+  uint64_t dropped() const;
+
+  // 线程的暂存区, 线程退出之后由后台线程释放
+  class StagingBuffer;
+
+ private:
+  StagingBuffer* LocalBuffer();
+  void Wakeup();
+  void BackgroundRoutine();
+  void Drain(StagingBuffer* buffer);
+  void WriteBatches();
+
+  const AsyncLogOptions options_;
+  const Sink sink_;
+  // 用来区分thread_local中缓存的暂存区属于哪个writer
+  const uint64_t id_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::condition_variable flushed_cond_;
+  // 以下由mutex_保护
+  bool stop_;
+  uint64_t flush_requested_;
+  uint64_t flush_completed_;
+  std::vector<std::shared_ptr<StagingBuffer>> buffers_;
+  // 以下只在后台线程访问
+  LogLevel minloglevel_;
+  uint64_t reported_dropped_;
+  std::vector<std::string> batches_;
+
+  std::atomic<bool> wakeup_pending_;
+  // Stop之后暂存区满了也不再等待
+  std::atomic<bool> stopped_;
+  std::atomic<uint64_t> dropped_;
+  std::thread thread_;
+};
+}
@@ -27,7 +27,7 @@ LoggerFile::LoggerFile(const std::string& path,
 void LoggerFile::Write(const char* content, int len) {
   MaybeChangeLogFile();
   if (unlikely(!file_)) {
-    ::fprintf(stderr, content, len);
+    ::fwrite(content, 1, len, stderr);
   } else {
     int n = file_.Write(content, len);
     if (unlikely(n != len)) {
@@ -13,10 +13,84 @@
 #include <alpha/LoggerStream.h>
 
 namespace alpha {
+namespace detail {
+static const char kDigitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+char* FormatDecimal(uint64_t value, char* end) {
+  // 每次除100, 两位一起查表
+  while (value >= 100) {
+    auto index = (value % 100) * 2;
+    value /= 100;
+    *--end = kDigitPairs[index + 1];
+    *--end = kDigitPairs[index];
+  }
+  if (value < 10) {
+    *--end = static_cast<char>('0' + value);
+  } else {
+    auto index = value * 2;
+    *--end = kDigitPairs[index + 1];
+    *--end = kDigitPairs[index];
+  }
+  return end;
+}
+}
+
 LoggerStream::LoggerStream() { rdbuf(&streambuf_); }
 
 LoggerStreambuf* LoggerStream::streambuf() { return &streambuf_; }
 
+void LoggerStream::Reset() {
+  clear();
+  flags(std::ios_base::skipws | std::ios_base::dec);
+  width(0);
+  precision(6);
+  fill(' ');
+}
+
+bool LoggerStream::DefaultIntegerFormat() const {
+  static const auto kSpecial =
+      std::ios_base::hex | std::ios_base::oct | std::ios_base::showpos;
+  return (flags() & kSpecial) == 0 && width() == 0;
+}
+
+LoggerStream& LoggerStream::AppendSigned(long long value) {
+  if (!DefaultIntegerFormat()) {
+    static_cast<std::ostream&>(*this) << value;
+    return *this;
+  }
+  char buf[24];
+  char* end = buf + sizeof(buf);
+  // 取负数的绝对值时先转成无符号, 避免最小值溢出
+  auto magnitude = static_cast<unsigned long long>(value);
+  if (value < 0) magnitude = 0 - magnitude;
+  char* begin = detail::FormatDecimal(magnitude, end);
+  if (value < 0) *--begin = '-';
+  streambuf_.sputn(begin, end - begin);
+  return *this;
+}
+
+LoggerStream& LoggerStream::AppendUnsigned(unsigned long long value) {
+  if (!DefaultIntegerFormat()) {
+    static_cast<std::ostream&>(*this) << value;
+    return *this;
+  }
+  char buf[24];
+  char* end = buf + sizeof(buf);
+  char* begin = detail::FormatDecimal(value, end);
+  streambuf_.sputn(begin, end - begin);
+  return *this;
+}
+
 NullStream::NullStream() {
   LoggerStream::streambuf()->pubsetbuf(message_buffer_, 1);
 }
@@ -12,17 +12,56 @@
 
 #pragma once
 
+#include <cstdint>
 #include <ostream>
 #include <alpha/LoggerStreambuf.h>
 
 namespace alpha {
+namespace detail {
+// 把value的十进制从end往前写, 返回第一个字符的位置, end前面要留够20字节
+char* FormatDecimal(uint64_t value, char* end);
+}
+
 class LoggerStream : public std::ostream {
  public:
   LoggerStream();
   virtual ~LoggerStream() = default;
   LoggerStreambuf* streambuf();
+  // 恢复刚构造时的格式和状态, 复用之前调用
+  void Reset();
+
+  // 所有的<<都返回LoggerStream&, 连着写的整数才都能用上下面的快速路径
+  template <typename T>
+  LoggerStream& operator<<(const T& value) {
+    static_cast<std::ostream&>(*this) << value;
+    return *this;
+  }
+  LoggerStream& operator<<(std::ostream& (*manip)(std::ostream&)) {
+    manip(*this);
+    return *this;
+  }
+  LoggerStream& operator<<(std::ios_base& (*manip)(std::ios_base&)) {
+    manip(*this);
+    return *this;
+  }
+  // 十进制的整数不经过locale和num_put, 直接写进缓冲区
+  LoggerStream& operator<<(int value) { return AppendSigned(value); }
+  LoggerStream& operator<<(long value) { return AppendSigned(value); }
+  LoggerStream& operator<<(long long value) { return AppendSigned(value); }
+  LoggerStream& operator<<(unsigned value) { return AppendUnsigned(value); }
+  LoggerStream& operator<<(unsigned long value) {
+    return AppendUnsigned(value);
+  }
+  LoggerStream& operator<<(unsigned long long value) {
+    return AppendUnsigned(value);
+  }
 
  private:
+  LoggerStream& AppendSigned(long long value);
+  LoggerStream& AppendUnsigned(unsigned long long value);
+  // 设置了进制, 宽度或者showpos时交给std::ostream
+  bool DefaultIntegerFormat() const;
+
   LoggerStreambuf streambuf_;
 };
 
@@ -33,7 +33,7 @@ std::unique_ptr<MemoryListType> MemoryListType::Create(char* buffer,
   m->header_->free_area = (sizeof(Header) + sizeof(T) - 1) / sizeof(T);
   m->buffer_ = buffer;
   m->base_ = m->header_->free_area;
-  return std::move(m);
+  return m;
 }
 
 template <typename T>
@@ -63,7 +63,7 @@ std::unique_ptr<MemoryListType> MemoryListType::Restore(char* buffer,
   m->buffer_ = buffer;
   m->base_ = header_slots;
 
-  return std::move(m);
+  return m;
 }
 
 template <typename T>
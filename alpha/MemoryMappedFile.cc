@@ -12,6 +12,7 @@
 
 #include <alpha/MemoryMappedFile.h>
 
+#include <fcntl.h>
 #include <sys/mman.h>
 #include <alpha/Logger.h>
 
@@ -91,5 +92,59 @@ void* MemoryMappedFile::mapped_start() { return mapped_start_; }
 
 int64_t MemoryMappedFile::size() const { return file_.GetLength(); }
 
+bool MemoryMappedFile::Resize(int64_t new_size) {
+  CHECK(mapped_start_ && new_size > 0);
+  auto old_size = file_.GetLength();
+  if (new_size == old_size) {
+    return true;
+  }
+  // 缩小时要先缩小映射, 否则访问到文件末尾之后的页会收到SIGBUS
+  void* mem = MAP_FAILED;
+  if (new_size < old_size) {
+    mem = ::mremap(mapped_start_, old_size, new_size, MREMAP_MAYMOVE);
+    if (mem == MAP_FAILED) {
+      PLOG_WARNING << "mremap failed, old size: " << old_size
+                   << ", new size: " << new_size;
+      return false;
+    }
+    mapped_start_ = mem;
+  }
+  if (!file_.SetLength(new_size)) {
+    PLOG_WARNING << "Set file length failed, old size: " << old_size
+                 << ", new size: " << new_size;
+    if (new_size < old_size) {
+      mem = ::mremap(mapped_start_, new_size, old_size, MREMAP_MAYMOVE);
+      CHECK(mem != MAP_FAILED);
+      mapped_start_ = mem;
+    }
+    return false;
+  }
+  if (new_size > old_size) {
+    mem = ::mremap(mapped_start_, old_size, new_size, MREMAP_MAYMOVE);
+    if (mem == MAP_FAILED) {
+      PLOG_WARNING << "mremap failed, old size: " << old_size
+                   << ", new size: " << new_size;
+      file_.SetLength(old_size);
+      return false;
+    }
+    mapped_start_ = mem;
+  }
+  return true;
+}
+
+bool MemoryMappedFile::PunchHole(int64_t offset, int64_t size) {
+  CHECK(mapped_start_ && offset >= 0 && size >= 0);
+  int err = ::fallocate(file_.fd(),
+                        FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                        offset,
+                        size);
+  if (err) {
+    PLOG_WARNING << "fallocate failed, offset: " << offset
+                 << ", size: " << size;
+    return false;
+  }
+  return true;
+}
+
 std::string MemoryMappedFile::filepath() const { return filepath_; }
 }  // namespace alpha
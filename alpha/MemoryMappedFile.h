@@ -52,6 +52,15 @@ class MemoryMappedFile {
 
   int64_t size() const;
 
+  // 修改文件大小并重新映射(ftruncate + mremap), 映射的起始地址可能改变
+  // 失败时文件大小和映射都保持不变
+  bool Resize(int64_t new_size);
+
+  // 释放[offset, offset + size)占用的磁盘和内存, 之后读到的都是0, 文件大小不变
+  bool PunchHole(int64_t offset, int64_t size);
+
+  int fd() const { return file_.fd(); }
+
   operator bool() const;
 
   std::string filepath() const;
@@ -50,44 +50,34 @@ alpha::TimeStamp Poller::Poll(int timeout_in_ms, ChannelList* active_channels) {
 }
 
 void Poller::UpdateChannel(Channel* channel) {
-  ChannelMap::iterator iter = channels_.find(channel->fd());
-
-  if (iter == channels_.end()) {
-    // Insert new channel
-    epoll_event ev;
-    ev.data.fd = channel->fd();
-    ev.events = channel->events();
-    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, channel->fd(), &ev);
-
-    channels_[channel->fd()] = channel;
-  } else {
-    // Update channel
-    epoll_event ev;
-    ev.data.fd = channel->fd();
-    ev.events = channel->events();
-
-    ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, channel->fd(), &ev);
+  epoll_event ev;
+  ev.data.ptr = channel;
+  ev.events = channel->epoll_events();
+  int op = channel->registered() ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  int ret = ::epoll_ctl(epoll_fd_, op, channel->fd(), &ev);
+  if (unlikely(ret == -1)) {
+    // 失败时不记录, 下次Update还会重试
+    PLOG_WARNING << "epoll_ctl failed, op = " << op
+                 << ", fd = " << channel->fd();
+    return;
   }
+  channel->set_registered(true, channel->epoll_events());
 }
 
 void Poller::RemoveChannel(Channel* channel) {
-  ChannelMap::iterator iter = channels_.find(channel->fd());
-  assert(iter != channels_.end());
-
-  channels_.erase(iter);
+  if (!channel->registered()) {
+    return;
+  }
   epoll_event ev;
-  ev.data.fd = channel->fd();
+  ev.data.ptr = channel;
   ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, channel->fd(), &ev);
+  channel->set_registered(false, 0);
 }
 
 void Poller::FillActiveChannels(int nevents, ChannelList* active_channels) {
   assert(static_cast<size_t>(nevents) <= events_.size());
   for (int idx = 0; idx < nevents; ++idx) {
-    int fd = events_[idx].data.fd;
-    ChannelMap::iterator iter = channels_.find(fd);
-    assert(iter != channels_.end());
-
-    Channel* channel = iter->second;
+    Channel* channel = static_cast<Channel*>(events_[idx].data.ptr);
     channel->set_revents(events_[idx].events);
     active_channels->push_back(channel);
   }
@@ -12,7 +12,6 @@
 
 #pragma once
 
-#include <map>
 #include <vector>
 #include <chrono>
 
@@ -36,14 +35,12 @@ class Poller {
 
  private:
   typedef std::vector<epoll_event> EventList;
-  typedef std::map<int, Channel*> ChannelMap;
 
   void FillActiveChannels(int nevents, ChannelList* active_channels);
 
  private:
   const static int kMaxFdCount = 100;
   int epoll_fd_;
-  ChannelMap channels_;
   EventList events_;
 };
 }
@@ -12,11 +12,28 @@
 
 #include <alpha/ProcessBus.h>
 
+#include <poll.h>
 #include <cassert>
+#include <cerrno>
 #include <alpha/Logger.h>
 
 namespace alpha {
 
+static File OpenNotifyFifo(const std::string& path) {
+  if (::mkfifo(path.c_str(), 0666) != 0 && errno != EEXIST) {
+    PLOG_WARNING << "mkfifo failed, path: " << path;
+    return File();
+  }
+  // 读写方式打开, 不会因为对端还没打开而失败, 也不会读到EOF
+  File fifo(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  struct stat st;
+  if (!fifo || ::fstat(fifo.fd(), &st) != 0 || !S_ISFIFO(st.st_mode)) {
+    PLOG_WARNING << "Open fifo failed, path: " << path;
+    return File();
+  }
+  return fifo;
+}
+
 ProcessBus::ProcessBus(ProcessBus&& other) { swap(other); }
 
 ProcessBus& ProcessBus::operator=(ProcessBus&& other) {
@@ -53,9 +70,12 @@ bool ProcessBus::CreateFrom(alpha::Slice filepath,
   if (!write_queue.CreateFrom(write_queue_start, write_queue_size)) {
     return false;
   }
+  order_ = order;
   mmaped_file_ = std::move(mapped_file);
   read_queue_ = std::move(read_queue);
   write_queue_ = std::move(write_queue);
+  read_notify_.Close();
+  write_notify_.Close();
   return true;
 }
 
@@ -86,9 +106,12 @@ bool ProcessBus::RestoreFrom(alpha::Slice filepath, QueueOrder order) {
     return false;
   }
 
+  order_ = order;
   mmaped_file_ = std::move(mapped_file);
   read_queue_ = std::move(read_queue);
   write_queue_ = std::move(write_queue);
+  read_notify_.Close();
+  write_notify_.Close();
   return true;
 }
 
@@ -107,7 +130,11 @@ bool ProcessBus::RestoreOrCreate(alpha::Slice filepath,
 
 bool ProcessBus::Write(const void* buf, int len) {
   DCHECK(write_queue_);
-  return write_queue_.Push(buf, len);
+  if (!write_queue_.Push(buf, len)) {
+    return false;
+  }
+  NotifyReader();
+  return true;
 }
 
 void* ProcessBus::Read(int* plen) {
@@ -120,10 +147,84 @@ void* ProcessBus::Peek(int* plen) {
   return read_queue_.Peek(plen);
 }
 
+void* ProcessBus::PeekContiguous(int* plen) {
+  DCHECK(read_queue_);
+  return read_queue_.PeekContiguous(plen);
+}
+
+void ProcessBus::Commit() {
+  DCHECK(read_queue_);
+  read_queue_.Commit();
+}
+
+void* ProcessBus::Reserve(int len) {
+  DCHECK(write_queue_);
+  return write_queue_.Reserve(len);
+}
+
+bool ProcessBus::CommitReserved(int len) {
+  DCHECK(write_queue_);
+  if (!write_queue_.CommitReserved(len)) {
+    return false;
+  }
+  NotifyReader();
+  return true;
+}
+
+bool ProcessBus::EnableNotification() {
+  DCHECK(read_queue_ && write_queue_);
+  if (read_queue_.legacy_layout() || write_queue_.legacy_layout()) {
+    LOG_WARNING << "Notification is not supported by legacy layout, filepath: "
+                << filepath();
+    return false;
+  }
+  // 按队列在文件中的位置命名, 这样双方打开的是同一对管道
+  const int read_index = order_ == QueueOrder::kReadFirst ? 0 : 1;
+  auto prefix = filepath() + ".notify";
+  auto read_notify = OpenNotifyFifo(prefix + std::to_string(read_index));
+  auto write_notify = OpenNotifyFifo(prefix + std::to_string(1 - read_index));
+  if (!read_notify || !write_notify) {
+    return false;
+  }
+  read_notify_.swap(read_notify);
+  write_notify_.swap(write_notify);
+  return true;
+}
+
+bool ProcessBus::PrepareWait() {
+  DCHECK(notification_enabled());
+  char buf[64];
+  while (::read(read_notify_.fd(), buf, sizeof(buf)) > 0) {
+  }
+  return read_queue_.PrepareWait();
+}
+
+bool ProcessBus::WaitForReadable(int timeout_ms) {
+  if (!PrepareWait()) {
+    return true;
+  }
+  struct pollfd pfd = {read_notify_.fd(), POLLIN, 0};
+  int rc = ::poll(&pfd, 1, timeout_ms);
+  PLOG_WARNING_IF(rc < 0 && errno != EINTR) << "poll failed";
+  return rc > 0;
+}
+
+void ProcessBus::NotifyReader() {
+  if (write_notify_ && write_queue_.NeedWakeup()) {
+    // 管道满了说明读者还没来得及处理之前的通知, 忽略就好
+    char c = 0;
+    ssize_t n = ::write(write_notify_.fd(), &c, sizeof(c));
+    PLOG_WARNING_IF(n < 0 && errno != EAGAIN) << "write to fifo failed";
+  }
+}
+
 void ProcessBus::swap(ProcessBus& other) {
+  std::swap(order_, other.order_);
   std::swap(mmaped_file_, other.mmaped_file_);
   std::swap(read_queue_, other.read_queue_);
   std::swap(write_queue_, other.write_queue_);
+  read_notify_.swap(other.read_notify_);
+  write_notify_.swap(other.write_notify_);
 }
 
 ProcessBus::operator bool() const { return mmaped_file_; }
@@ -13,6 +13,7 @@
 #pragma once
 
 #include <memory>
+#include <alpha/File.h>
 #include <alpha/RingBuffer.h>
 #include <alpha/MemoryMappedFile.h>
 
@@ -48,6 +49,33 @@ class ProcessBus {
 
   void* Peek(int* plen);
 
+  // 零拷贝接口, 参见RingBuffer::PeekContiguous和RingBuffer::Reserve
+  void* PeekContiguous(int* plen);
+
+  void Commit();
+
+  void* Reserve(int len);
+
+  bool CommitReserved(int len);
+
+  // 可选的唤醒通知, 双方都打开之后读者可以睡眠等待而不用轮询
+  // 每个队列对应一个命名管道<filepath>.notify0/1, 写者只在读者登记了
+  // 等待的时候才写管道, 需要在CreateFrom/RestoreFrom之后调用
+  bool EnableNotification();
+
+  bool notification_enabled() const { return read_notify_.Valid(); }
+
+  // 读队列有新消息时可读, 可以注册到EventLoop
+  int notify_fd() const { return read_notify_.fd(); }
+
+  // 读者睡眠之前调用, 清空管道并登记等待
+  // 返回false表示已经有消息了, 需要继续读完再调用
+  bool PrepareWait();
+
+  // 阻塞等待读队列有消息, timeout_ms为-1时一直等, 超时返回false
+  // 可能被虚假唤醒, 调用者需要重新读
+  bool WaitForReadable(int timeout_ms);
+
   void swap(ProcessBus& other);
 
   operator bool() const;
@@ -57,8 +85,13 @@ class ProcessBus {
   std::string filepath() const;
 
  private:
+  void NotifyReader();
+
+  QueueOrder order_{QueueOrder::kReadFirst};
   alpha::MemoryMappedFile mmaped_file_;
   alpha::RingBuffer read_queue_;
   alpha::RingBuffer write_queue_;
+  alpha::File read_notify_;
+  alpha::File write_notify_;
 };
 }
@@ -18,15 +18,26 @@ namespace alpha {
 
 namespace detail {
 static __thread uint8_t local_buf[RingBuffer::kMaxBufferBodyLength];
+static __thread uint8_t reserve_buf[RingBuffer::kMaxBufferBodyLength];
 }
 
-const int RingBuffer::kMinByteSize =
-    sizeof(RingBuffer::OffsetData) + RingBuffer::kExtraSpace;
+// 预留对齐到cache line的空间
+const int RingBuffer::kMinByteSize = sizeof(RingBuffer::LayoutHeader) +
+                                     RingBuffer::kCacheLineSize - 1 +
+                                     RingBuffer::kExtraSpace;
 
 RingBuffer::RingBuffer()
-    : data_start_(nullptr), end_(nullptr), offset_(nullptr) {}
+    : data_start_(nullptr),
+      end_(nullptr),
+      header_(nullptr),
+      front_offset_(nullptr),
+      back_offset_(nullptr),
+      cached_front_(0),
+      cached_back_(0),
+      reserved_(nullptr),
+      reserved_len_(0) {}
 
-RingBuffer::RingBuffer(RingBuffer &&other) { swap(other); }
+RingBuffer::RingBuffer(RingBuffer &&other) : RingBuffer() { swap(other); }
 
 RingBuffer &RingBuffer::operator=(RingBuffer &&other) {
   swap(other);
@@ -34,20 +45,52 @@ RingBuffer &RingBuffer::operator=(RingBuffer &&other) {
 }
 
 bool RingBuffer::CreateFrom(void *start, int64_t len) {
-  if (start == nullptr || len < kMinByteSize) return false;
-  offset_ = reinterpret_cast<OffsetData *>(start);
-  data_start_ = reinterpret_cast<uint8_t *>(start) + sizeof(OffsetData);
-  end_ = reinterpret_cast<uint8_t *>(start) + len;
-  set_front(data_start_);
-  set_back(data_start_);
-  return true;
+  return Attach(start, len, true);
 }
 
 bool RingBuffer::RestoreFrom(void *start, int64_t len) {
+  return Attach(start, len, false);
+}
+
+bool RingBuffer::Attach(void *start, int64_t len, bool create) {
   if (start == nullptr || len < kMinByteSize) return false;
-  offset_ = reinterpret_cast<OffsetData *>(start);
-  data_start_ = reinterpret_cast<uint8_t *>(start) + sizeof(OffsetData);
-  end_ = reinterpret_cast<uint8_t *>(start) + len;
+  uint8_t *end = reinterpret_cast<uint8_t *>(start) + len;
+  auto aligned = (reinterpret_cast<uintptr_t>(start) + kCacheLineSize - 1) &
+                 ~(kCacheLineSize - 1);
+  auto header = reinterpret_cast<LayoutHeader *>(aligned);
+  if (create) {
+    header->magic = kLayoutMagic;
+    header->version = kLayoutVersion;
+    header->consumer_waiting.store(0, std::memory_order_relaxed);
+    header->front_offset.store(0, std::memory_order_relaxed);
+    header->back_offset.store(0, std::memory_order_release);
+  }
+
+  if (header->magic == kLayoutMagic && header->version == kLayoutVersion) {
+    header_ = header;
+    front_offset_ = &header->front_offset;
+    back_offset_ = &header->back_offset;
+    data_start_ = reinterpret_cast<uint8_t *>(header + 1);
+  } else {
+    // 没有版本信息的旧布局
+    auto offset = reinterpret_cast<OffsetData *>(start);
+    header_ = nullptr;
+    front_offset_ = &offset->front_offset;
+    back_offset_ = &offset->back_offset;
+    data_start_ = reinterpret_cast<uint8_t *>(offset + 1);
+  }
+  end_ = end;
+
+  const int64_t data_len = end_ - data_start_;
+  cached_front_ = front_offset_->load(std::memory_order_acquire);
+  cached_back_ = back_offset_->load(std::memory_order_acquire);
+  if (cached_front_ < 0 || cached_front_ > data_len || cached_back_ < 0 ||
+      cached_back_ > data_len) {
+    data_start_ = end_ = nullptr;
+    header_ = nullptr;
+    front_offset_ = back_offset_ = nullptr;
+    return false;
+  }
   return true;
 }
 
@@ -55,7 +98,7 @@ bool RingBuffer::Push(const void *buf, int len) {
   if (buf == nullptr || len == 0) return false;
 
   if (len > kMaxBufferBodyLength) return false;
-  if (len > SpaceLeft()) return false;
+  if (!ProducerHasSpace(len)) return false;
 
   this->Write(reinterpret_cast<const uint8_t *>(buf), len);
   return true;
@@ -63,7 +106,7 @@ bool RingBuffer::Push(const void *buf, int len) {
 
 void *RingBuffer::Pop(int *plen) {
   assert(plen);
-  if (empty()) {
+  if (ConsumerEmpty()) {
     *plen = 0;
     return nullptr;
   } else {
@@ -76,7 +119,7 @@ void *RingBuffer::Pop(int *plen) {
 
 void *RingBuffer::Peek(int *plen) {
   assert(plen);
-  if (empty()) {
+  if (ConsumerEmpty()) {
     *plen = 0;
     return nullptr;
   } else {
@@ -87,15 +130,79 @@ void *RingBuffer::Peek(int *plen) {
   }
 }
 
+void *RingBuffer::PeekContiguous(int *plen) {
+  assert(plen);
+  if (ConsumerEmpty()) {
+    *plen = 0;
+    return nullptr;
+  }
+  const int buffer_len = NextBufferLength();
+  assert(buffer_len > 0);
+  assert(buffer_len <= RingBuffer::kMaxBufferBodyLength);
+  *plen = buffer_len;
+  uint8_t *content = ContentPosition(get_front());
+  if (content + buffer_len <= end_) {
+    return content;
+  }
+  auto *buf = detail::local_buf;
+  ptrdiff_t tail_length = end_ - content;
+  memcpy(buf, content, tail_length);
+  memcpy(buf + tail_length, data_start_, buffer_len - tail_length);
+  return buf;
+}
+
+void RingBuffer::Commit() {
+  if (!ConsumerEmpty()) {
+    set_front(NextFront());
+  }
+}
+
+void *RingBuffer::Reserve(int len) {
+  reserved_ = nullptr;
+  if (len <= 0 || len > kMaxBufferBodyLength || !ProducerHasSpace(len)) {
+    return nullptr;
+  }
+  uint8_t *content = ContentPosition(get_back());
+  if (content + len <= end_) {
+    reserved_ = content;
+  } else {
+    reserved_ = detail::reserve_buf;
+  }
+  reserved_len_ = len;
+  return reserved_;
+}
+
+bool RingBuffer::CommitReserved(int len) {
+  auto reserved = reserved_;
+  reserved_ = nullptr;
+  if (reserved == nullptr || len <= 0 || len > reserved_len_) {
+    return false;
+  }
+  if (reserved == detail::reserve_buf) {
+    Write(reserved, len);
+  } else {
+    // 消息体已经在共享内存里了, 补上长度再移动back
+    WriteHeader(get_back(), len);
+    set_back(reserved + len);
+  }
+  return true;
+}
+
 void RingBuffer::swap(RingBuffer &other) {
   std::swap(data_start_, other.data_start_);
   std::swap(end_, other.end_);
-  std::swap(offset_, other.offset_);
+  std::swap(header_, other.header_);
+  std::swap(front_offset_, other.front_offset_);
+  std::swap(back_offset_, other.back_offset_);
+  std::swap(cached_front_, other.cached_front_);
+  std::swap(cached_back_, other.cached_back_);
+  std::swap(reserved_, other.reserved_);
+  std::swap(reserved_len_, other.reserved_len_);
 }
 
-int RingBuffer::SpaceLeft() const {
-  uint8_t *front = get_front();
-  uint8_t *back = get_back();
+int RingBuffer::SpaceLeft() const { return SpaceLeft(get_front(), get_back()); }
+
+int RingBuffer::SpaceLeft(uint8_t *front, uint8_t *back) const {
   int result;
   if (back >= front) {
     result = end_ - back + front - data_start_ - kExtraSpace - sizeof(int32_t);
@@ -109,22 +216,88 @@ bool RingBuffer::empty() const { return get_front() == get_back(); }
 
 RingBuffer::operator bool() const { return data_start_ != nullptr; }
 
+bool RingBuffer::ConsumerEmpty() {
+  auto front = front_offset_->load(std::memory_order_relaxed);
+  if (front != cached_back_) {
+    return false;
+  }
+  cached_back_ = back_offset_->load(std::memory_order_acquire);
+  return front == cached_back_;
+}
+
+bool RingBuffer::ProducerHasSpace(int len) {
+  auto back = get_back();
+  if (len <= SpaceLeft(data_start_ + cached_front_, back)) {
+    return true;
+  }
+  cached_front_ = front_offset_->load(std::memory_order_acquire);
+  return len <= SpaceLeft(data_start_ + cached_front_, back);
+}
+
+// 消费者写waiting再读back, 生产者写back再读waiting, 中间都有全序的fence
+// 所以要么消费者看到新消息不睡, 要么生产者看到waiting去唤醒
+bool RingBuffer::PrepareWait() {
+  if (header_ == nullptr) return true;
+  header_->consumer_waiting.store(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!ConsumerEmpty()) {
+    header_->consumer_waiting.store(0, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+bool RingBuffer::NeedWakeup() {
+  if (header_ == nullptr) return false;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return header_->consumer_waiting.load(std::memory_order_relaxed) &&
+         header_->consumer_waiting.exchange(0, std::memory_order_relaxed);
+}
+
+// 读对端的位置要acquire, 保证能看到对端在更新位置之前写入/读完的数据
 uint8_t *RingBuffer::get_front() const {
-  return offset_->front_offset + data_start_;
+  return front_offset_->load(std::memory_order_acquire) + data_start_;
 }
 
 uint8_t *RingBuffer::get_back() const {
-  return offset_->back_offset + data_start_;
+  return back_offset_->load(std::memory_order_acquire) + data_start_;
 }
 
+// 更新自己的位置要release, 保证对端看到新位置时数据已经写入/读完
 void RingBuffer::set_front(uint8_t *front) {
   assert(front >= data_start_);
-  offset_->front_offset = front - data_start_;
+  front_offset_->store(front - data_start_, std::memory_order_release);
 }
 
 void RingBuffer::set_back(uint8_t *back) {
   assert(back >= data_start_);
-  offset_->back_offset = back - data_start_;
+  back_offset_->store(back - data_start_, std::memory_order_release);
+}
+
+uint8_t *RingBuffer::ContentPosition(uint8_t *header) const {
+  // 长度本身也可能回绕, 和Write的写法保持一致
+  uint8_t *content = header + RingBuffer::kBufferHeaderLength;
+  return content >= end_ ? data_start_ + (content - end_) : content;
+}
+
+uint8_t *RingBuffer::NextFront() const {
+  const int buffer_len = NextBufferLength();
+  uint8_t *content = ContentPosition(get_front());
+  if (content + buffer_len <= end_) {
+    return content + buffer_len;
+  }
+  return data_start_ + buffer_len - (end_ - content);
+}
+
+void RingBuffer::WriteHeader(uint8_t *back, int len) {
+  if (back + sizeof(len) <= end_) {
+    memcpy(back, &len, sizeof(len));
+  } else {
+    uint8_t *len_addr = reinterpret_cast<uint8_t *>(&len);
+    int first = end_ - back;
+    memcpy(back, &len, first);
+    memcpy(data_start_, len_addr + first, sizeof(len) - first);
+  }
 }
 
 void RingBuffer::Write(const uint8_t *buf, int len) {
@@ -161,13 +334,9 @@ void RingBuffer::Write(const uint8_t *buf, int len) {
 
 uint8_t *RingBuffer::Read(int *plen, uint8_t **new_front) {
   assert(plen);
+  // 调用者已经检查过队列不为空
   auto *front = get_front();
 
-  if (empty()) {
-    *plen = 0;
-    return nullptr;
-  }
-
   const int buffer_len = NextBufferLength();
   assert(buffer_len > 0);
   assert(buffer_len <= RingBuffer::kMaxBufferBodyLength);
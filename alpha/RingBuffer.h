@@ -12,16 +12,36 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <cstddef>
+#include <cstdint>
 #include <alpha/Compiler.h>
 
 namespace alpha {
+// 单生产者单消费者, 生产者和消费者可以在不同的进程中
 class RingBuffer {
  private:
+  static const size_t kCacheLineSize = 64;
+  using Offset = std::atomic<int64_t>;
+
+  // 旧布局, 两个位置挨在一起, 只用于恢复旧的文件
   struct OffsetData {
-    ptrdiff_t front_offset;
-    ptrdiff_t back_offset;
+    Offset front_offset;
+    Offset back_offset;
+  };
+
+  // 新布局, 读写位置各占一个cache line, 避免两个进程false sharing
+  struct LayoutHeader {
+    uint64_t magic;
+    uint32_t version;
+    // 消费者准备睡眠时置1, 生产者看到后负责唤醒, 参见PrepareWait
+    std::atomic<uint32_t> consumer_waiting;
+    uint8_t pad0[kCacheLineSize - sizeof(uint64_t) - 2 * sizeof(uint32_t)];
+    Offset front_offset;
+    uint8_t pad1[kCacheLineSize - sizeof(Offset)];
+    Offset back_offset;
+    uint8_t pad2[kCacheLineSize - sizeof(Offset)];
   };
 
  public:
@@ -40,13 +60,37 @@ class RingBuffer {
   bool Push(const void* buf, int len);
   void* Pop(int* len);
   void* Peek(int* len);
+  // 消息没有回绕时直接返回共享内存中的地址, 否则拷贝到线程局部缓冲区
+  // 返回的地址在Commit之前有效, Commit之后消息才真正出队
+  void* PeekContiguous(int* len);
+  void Commit();
+  // 预留len字节直接在共享内存中构造消息, 会回绕时退化为线程局部缓冲区
+  // CommitReserved之后消息才对读者可见, 提交的长度可以小于预留的长度
+  void* Reserve(int len);
+  bool CommitReserved(int len);
   void swap(RingBuffer& other);
 
   int SpaceLeft() const;
   bool empty() const;
   operator bool() const;
+  // 从旧布局的文件中恢复时为true
+  bool legacy_layout() const { return data_start_ && header_ == nullptr; }
+
+  // 睡眠/唤醒协议, 旧布局不支持
+  // 消费者睡眠之前调用, 返回false表示队列不为空, 不能睡眠
+  bool PrepareWait();
+  // 生产者写入之后调用, 返回true表示消费者可能在睡眠, 需要唤醒
+  // 同一次睡眠只会返回一次true
+  bool NeedWakeup();
 
  private:
+  bool Attach(void* start, int64_t len, bool create);
+  int SpaceLeft(uint8_t* front, uint8_t* back) const;
+  // 消费者调用, 必要时才重新读取生产者的位置
+  bool ConsumerEmpty();
+  // 生产者调用, 必要时才重新读取消费者的位置
+  bool ProducerHasSpace(int len);
+
   uint8_t* get_front() const;
   uint8_t* get_back() const;
 
@@ -54,6 +98,9 @@ class RingBuffer {
   void set_back(uint8_t* back);
 
   int NextBufferLength() const;
+  uint8_t* ContentPosition(uint8_t* header) const;
+  uint8_t* NextFront() const;
+  void WriteHeader(uint8_t* back, int len);
   void Write(const uint8_t* buf, int len);
   uint8_t* Read(int* plen, uint8_t** new_front);
 
@@ -62,8 +109,22 @@ class RingBuffer {
   static const int64_t kMaxBufferLength =
       kBufferHeaderLength + kMaxBufferBodyLength;
   static const int64_t kExtraSpace = 1;
+  static const uint64_t kLayoutMagic = 0x3266754262676e52ull;  // "RngBuf2"
+  static const uint32_t kLayoutVersion = 2;
   uint8_t* data_start_;
   uint8_t* end_;
-  volatile OffsetData* offset_;
+  LayoutHeader* header_;
+  Offset* front_offset_;
+  Offset* back_offset_;
+  // 对端位置的本地缓存, 只会落后于真实值, 用来减少跨核的cache line访问
+  int64_t cached_front_;
+  int64_t cached_back_;
+  uint8_t* reserved_;
+  int reserved_len_;
 };
+
+static_assert(sizeof(std::atomic<int64_t>) == sizeof(int64_t),
+              "std::atomic<int64_t> must have the same layout as int64_t");
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "atomics must be lock free to live in shm");
 }
@@ -18,9 +18,41 @@
 #include <alpha/EventLoop.h>
 #include <alpha/TcpServer.h>
 #include <alpha/HTTPMessageCodec.h>
+#include <alpha/HTTPRequest.h>
+#include <alpha/HTTPRouter.h>
 
 namespace alpha {
-SimpleHTTPServer::SimpleHTTPServer(EventLoop* loop) : loop_(loop) {}
+namespace {
+// 每个连接一个定时器, 期间没有收到过数据, 也没有待发的回包就关闭连接
+// 按收到的字节数判断, 请求没收完(例如很慢的body)时也不算空闲
+// 收到数据时不需要重设定时器
+void CheckIdleConnection(std::weak_ptr<TcpConnection> weak_conn,
+                         uint32_t timeout,
+                         uint64_t bytes_read) {
+  auto conn = weak_conn.lock();
+  if (!conn || conn->closed()) {
+    return;
+  }
+  if (conn->BytesRead() == bytes_read && conn->BytesToWrite() == 0) {
+    DLOG_INFO << "Close idle connection, peer addr = " << conn->PeerAddr();
+    conn->Close();
+    return;
+  }
+  conn->loop()->RunAfter(timeout,
+                         std::bind(&CheckIdleConnection,
+                                   weak_conn,
+                                   timeout,
+                                   conn->BytesRead()));
+}
+}
+
+const uint32_t SimpleHTTPServer::kDefaultIdleTimeout;
+
+SimpleHTTPServer::SimpleHTTPServer(EventLoop* loop)
+    : loop_(loop),
+      idle_timeout_(kDefaultIdleTimeout),
+      pool_(nullptr),
+      dispatch_(TcpServer::Dispatch::kRoundRobin) {}
 
 SimpleHTTPServer::~SimpleHTTPServer() = default;
 
@@ -31,6 +63,9 @@ bool SimpleHTTPServer::Run(const NetAddress& addr) {
   server_->SetOnNewConnection(
       std::bind(&SimpleHTTPServer::OnConnected, this, _1));
   server_->SetOnClose(std::bind(&SimpleHTTPServer::OnClose, this, _1));
+  if (pool_) {
+    server_->SetThreadPool(pool_, dispatch_);
+  }
   return server_->Run();
 }
 
@@ -51,42 +86,97 @@ void SimpleHTTPServer::DefaultRequestCallback(TcpConnectionPtr conn,
   conn->Write("{\"result\": \"0\", \"msg\": \"ok\"}");
 }
 
+void SimpleHTTPServer::SetRouter(const HTTPRouter* router) {
+  using namespace std::placeholders;
+  SetRequestCallback(std::bind(&HTTPRouter::Dispatch, router, _1, _2));
+}
+
 void SimpleHTTPServer::OnMessage(TcpConnectionPtr conn,
                                  TcpConnectionBuffer* buffer) {
   auto codec = conn->GetContext<std::shared_ptr<HTTPMessageCodec>>();
+  if (request_callback_) {
+    ProcessInPlace(conn, codec.get(), buffer);
+    return;
+  }
   auto data = buffer->Read();
   // DLOG_INFO << '\n' << alpha::HexDump(data);
-  auto data_size = data.size();
-  auto status = codec->Process(data);
-  int consumed = data_size - data.size();
-  assert(consumed >= 0);
-  buffer->ConsumeBytes(consumed);
-  DLOG_INFO << "codec consume " << consumed << " bytes";
-  if (status > 0) {
+  const auto data_size = data.size();
+  // 一次可能读到多个流水线请求, 逐个解析并按顺序回包
+  while (!data.empty() && !conn->closed() && !codec->suspended()) {
+    auto status = codec->Process(data);
     // nasty way to handle multipart/form-data
     if (!codec->data_to_peer().empty()) {
       conn->Write(codec->data_to_peer());
       codec->clear_data_to_peer();
     }
-  } else if (status == HTTPMessageCodec::Status::kDone) {
-    // nasty way to handle multipart/form-data
-    if (!codec->data_to_peer().empty()) {
-      conn->Write(codec->data_to_peer());
-      codec->clear_data_to_peer();
+    if (status > 0) {
+      break;
+    } else if (status < 0) {
+      LOG_WARNING << "Codec error, status = " << status;
+      conn->Close();
+      break;
     }
     auto& http_message = codec->Done();
     http_message.SetClientAddress(conn->PeerAddr());
     callback_(conn, http_message);
-    if (!conn->closed()) conn->Close();
-  } else {
-    LOG_WARNING << "Codec error, status = " << status;
-    conn->Close();
+    if (!codec->keep_alive()) {
+      // 回包还没发完时由HTTPResponseBuilder在发完之后关闭
+      if (!conn->closed() && !codec->suspended()) conn->Close();
+      break;
+    }
+    codec->Reset();
   }
+  const auto consumed = data_size - data.size();
+  buffer->ConsumeBytes(consumed);
+  DLOG_INFO << "codec consume " << consumed << " bytes";
+}
+
+void SimpleHTTPServer::ProcessInPlace(const TcpConnectionPtr& conn,
+                                      HTTPMessageCodec* codec,
+                                      TcpConnectionBuffer* buffer) {
+  HTTPRequest request;
+  auto data = buffer->Read();
+  const auto data_size = data.size();
+  while (!data.empty() && !conn->closed() && !codec->suspended()) {
+    auto status = codec->ProcessInPlace(data, &request, buffer->max_size());
+    if (status > 0) {
+      break;
+    } else if (status < 0) {
+      LOG_WARNING << "Codec error, status = " << status;
+      conn->Close();
+      break;
+    }
+    request_callback_(conn, request);
+    if (!codec->keep_alive()) {
+      // 回包还没发完时由HTTPResponseBuilder在发完之后关闭
+      if (!conn->closed() && !codec->suspended()) conn->Close();
+      break;
+    }
+    codec->Reset();
+  }
+  // 回调返回之后request中的Slice才失效
+  buffer->ConsumeBytes(data_size - data.size());
 }
 
 void SimpleHTTPServer::OnConnected(TcpConnectionPtr conn) {
   auto codec = std::make_shared<HTTPMessageCodec>();
+  // 流式回包发完之后继续处理期间收到的流水线请求
+  std::weak_ptr<TcpConnection> weak_conn(conn);
+  codec->SetResumeCallback([this, weak_conn] {
+    auto conn = weak_conn.lock();
+    if (conn && !conn->closed()) {
+      OnMessage(conn, conn->ReadBuffer());
+    }
+  });
   conn->SetContext(codec);
+  if (idle_timeout_ > 0) {
+    conn->loop()->RunAfter(
+        idle_timeout_,
+        std::bind(&CheckIdleConnection,
+                  std::weak_ptr<TcpConnection>(conn),
+                  idle_timeout_,
+                  conn->BytesRead()));
+  }
 }
 
 void SimpleHTTPServer::OnClose(TcpConnectionPtr conn) { (void)conn; }
@@ -5,7 +5,7 @@
  *        Created:  05/03/15 19:11:14
  *         Author:  Peng Wang
  *          Email:  pw2191195@gmail.com
- *    Description:  Simple HTTP/1.0 server implementation
+ *    Description:  Simple HTTP/1.1 server implementation
  *
  * ==============================================================================
  */
@@ -15,25 +15,50 @@
 #include <map>
 #include <alpha/Slice.h>
 #include <alpha/NetAddress.h>
+#include <alpha/TcpServer.h>
 #include <alpha/TcpConnection.h>
 #include <alpha/HTTPMessageCodec.h>
 
 namespace alpha {
 class EventLoop;
-class TcpServer;
+class EventLoopThreadPool;
 class NetAddress;
 class HTTPMessage;
+class HTTPRequest;
+class HTTPRouter;
 class SimpleHTTPServer {
  public:
   using HTTPHeader = HTTPMessageCodec::HTTPHeader;
   using Callback =
       std::function<void(TcpConnectionPtr, const HTTPMessage& message)>;
-  using RequestCallback = std::function<void(
-      TcpConnectionPtr, Slice path, const HTTPHeader& header, Slice data)>;
+  // request中的数据都指向连接的读缓冲区, 不拷贝, 只在回调期间有效
+  using RequestCallback =
+      std::function<void(TcpConnectionPtr, const HTTPRequest& request)>;
   SimpleHTTPServer(EventLoop* loop);
   ~SimpleHTTPServer();
   bool Run(const NetAddress& addr);
+  // 同一个连接上的多个请求(包括流水线请求)按顺序回调
+  // callback需要同步地用HTTPResponseBuilder回包, 是否关闭连接由请求决定
+  // 流式回包(SendChunked)没发完之前, 同一个连接上后面的请求等它发完再回调
   void SetCallback(const Callback& cb) { callback_ = cb; }
+  // 设置之后使用不拷贝数据的解析方式, 不再调用Callback
+  // 整个请求(包括body)都要放得进连接的读缓冲区, 不支持multipart/form-data
+  void SetRequestCallback(const RequestCallback& cb) {
+    request_callback_ = cb;
+  }
+  // 用router分发请求, router要比server活得长
+  void SetRouter(const HTTPRouter* router);
+  // 在Run之前调用, 连接上超过这个时间没有收到数据就关闭, 0表示不关闭
+  void set_idle_timeout(uint32_t milliseconds) {
+    idle_timeout_ = milliseconds;
+  }
+  // 在Run之前调用, callback会在多个线程中被调用
+  void SetThreadPool(
+      EventLoopThreadPool* pool,
+      TcpServer::Dispatch dispatch = TcpServer::Dispatch::kRoundRobin) {
+    pool_ = pool;
+    dispatch_ = dispatch;
+  }
 
  private:
   void DefaultRequestCallback(TcpConnectionPtr,
@@ -42,12 +67,19 @@ class SimpleHTTPServer {
                               const HTTPHeader& header,
                               Slice data);
   void OnMessage(TcpConnectionPtr conn, TcpConnectionBuffer* buffer);
+  void ProcessInPlace(const TcpConnectionPtr& conn,
+                      HTTPMessageCodec* codec,
+                      TcpConnectionBuffer* buffer);
   void OnConnected(TcpConnectionPtr conn);
   void OnClose(TcpConnectionPtr conn);
 
-  static const int kReadHeaderTimeout = 3000;  // ms
+  static const uint32_t kDefaultIdleTimeout = 3000;  // ms
   EventLoop* loop_;
+  uint32_t idle_timeout_;
+  EventLoopThreadPool* pool_;
+  TcpServer::Dispatch dispatch_;
   std::unique_ptr<TcpServer> server_;
   Callback callback_;
+  RequestCallback request_callback_;
 };
 }
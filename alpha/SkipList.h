@@ -12,12 +12,19 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <random>
 #include <iterator>
 #include <iostream>
+#include <new>
+#include <string>
 #include <type_traits>
+#include <vector>
 #include <alpha/Compiler.h>
+#include <alpha/FileUtil.h>
 #include <alpha/MemoryList.h>
 #include <alpha/Random.h>
 #include <alpha/Logger.h>
@@ -27,14 +34,23 @@ template <typename Key,
           typename Value,
           int32_t kMaxLevel = 20,
           typename Comparator = std::less<Key>,
+          bool kIndexed = false,
           typename Enable = void>
 class SkipList;
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+// 节点的大小由层数决定, 只存放实际层数的前向指针
+// 同一层数的节点大小相同, 每种层数一个空闲链表(slab), 新节点从未分配区域切出
+// kIndexed为true时每个前向指针还记录跨过的节点数, 可以O(log n)按排名查找
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 class SkipList<Key,
                Value,
                kMaxLevel,
                Comparator,
+               kIndexed,
                typename std::enable_if<std::is_pod<Key>::value &&
                                        std::is_pod<Value>::value &&
                                        !std::is_pointer<Key>::value &&
@@ -51,28 +67,57 @@ class SkipList<Key,
   };
 
  private:
+  // 节点相对于内存起始位置的偏移
   using NodeId = size_type;
+  static const NodeId kInvalidNodeId = std::numeric_limits<NodeId>::max();
+
+  // 前面的字段和旧的布局相同, 靠magic区分两种布局
   struct Header {
     NodeId head;
     NodeId tail;
     size_type max_level;
     size_type elements;
     int64_t magic;
+    size_type buffer_size;
+    size_type value_size;
+    size_type max_elements;
+    NodeId free_area;
+    size_type free_nodes;
+    NodeId free_lists[kMaxLevel];
   };
 
-  static const size_type kHeaderSize = sizeof(Header);
-  static const int64_t kMagic = 0x631e48e40b310071;
+  // 两种节点布局不同, 不能互相恢复
+  static const int64_t kMagic =
+      kIndexed ? 0x631e48e40b310073 : 0x631e48e40b310072;
+  // 旧的布局: 所有节点都带kMaxLevel个前向指针, 由MemoryList<LegacyNode>分配
+  static const int64_t kLegacyMagic = 0x631e48e40b310071;
+  // 正在转换旧布局, 崩溃之后要从备份文件恢复旧的数据重新转换
+  static const int64_t kConvertingMagic = 0x631e48e40b310070;
+  static const size_type kLegacyHeaderSize = 24;
   using LevelArray = NodeId[kMaxLevel];
 
   struct Node {
+    value_type val;
     NodeId prev;
     size_type level;
-    LevelArray levels;
-    value_type val;
+    // 实际长度为level, 空闲时prev是空闲链表中的下一个节点
+    // kIndexed为true时后面紧跟着level个span, 见Spans
+    NodeId levels[1];
 
     NodeId next() const { return levels[0]; }
   };
 
+  struct LegacyNode {
+    NodeId prev;
+    size_type level;
+    LevelArray levels;
+    value_type val;
+  };
+
+  static const size_type kNodeAlign = alignof(Node);
+  static const size_type kHeaderSize =
+      (sizeof(Header) + kNodeAlign - 1) / kNodeAlign * kNodeAlign;
+
   template <typename DerivedType,
             typename ContainerType,
             typename Pointer,
@@ -149,7 +194,12 @@ class SkipList<Key,
 
   DISABLE_COPY_ASSIGNMENT(SkipList);
   static UniquePtr Create(char* start, size_type size);
-  static UniquePtr Restore(char* start, size_type size);
+  // 旧布局的数据会在原来的内存上转换成新的布局, 转换之前先把原来的数据写到
+  // legacy_backup, 转换中途崩溃时下次Restore从这个文件重新转换
+  // 没有指定legacy_backup时不转换旧布局
+  static UniquePtr Restore(char* start,
+                           size_type size,
+                           const std::string& legacy_backup = std::string());
   std::pair<iterator, bool> insert(const std::pair<key_type, mapped_type>& p);
   mapped_type& operator[](const key_type& k);
   void erase(iterator position);
@@ -164,39 +214,75 @@ class SkipList<Key,
   const_iterator end() const;
   bool empty() const;
   size_type size() const;
+  // 保证能放下的元素个数, 按节点的平均大小估算
   size_type max_size() const;
   void Dump() const;
 
+  // 以下只有kIndexed为true时可用, 排名从0开始
+  // 比k小的元素个数, k存在时就是k的排名
+  size_type rank(const key_type& k) const;
+  // 排名超出范围时返回end()
+  iterator at_rank(size_type r);
+  const_iterator at_rank(size_type r) const;
+  // 排名在[start, start + n)中的元素, 超出的部分被忽略
+  std::pair<iterator, iterator> range_by_rank(size_type start, size_type n);
+  std::pair<const_iterator, const_iterator> range_by_rank(size_type start,
+                                                          size_type n) const;
+
  private:
   SkipList() = default;
-  void InitHeader();
+  static size_type NodeSize(size_type level);
+  static UniquePtr Create(char* start, size_type size, int64_t magic);
+  static UniquePtr RestoreLegacy(char* start,
+                                 size_type size,
+                                 const std::string& legacy_backup);
+  void InitHeader(int64_t magic);
   bool RestoreHeader(char* start, size_type size);
+  Node* GetNode(NodeId node_id) const;
+  // 沿第i层的指针前进时跨过的节点数, 也就是两个节点的排名之差
+  static size_type* Spans(Node* node);
+  NodeId FindNodeByRank(size_type r) const;
+  NodeId AllocateNode(size_type level);
+  bool AllocateFromFreeArea(size_type level, NodeId* node_id);
+  void DeallocateNode(NodeId node_id);
   NodeId PrevNode(NodeId node_id) const;
   NodeId NextNode(NodeId node_id) const;
   value_type& NodeValue(NodeId node_id) const;
-  NodeId FindNode(const key_type& key, NodeId* path) const;
+  // ranks不为空时同时记录path中每个节点的排名(头节点为0)
+  NodeId FindNode(const key_type& key,
+                  NodeId* path,
+                  size_type* ranks = nullptr) const;
   void EraseNode(NodeId node_id, NodeId* path);
   bool NotGoBefore(const key_type& key, NodeId node_id, bool* equal) const;
   size_type RandomLevel();
 
   Header* header_;
+  char* start_;
 
  private:
-  using MemoryListType = MemoryList<Node>;
+  using LegacyMemoryList = MemoryList<LegacyNode>;
 
   std::uniform_int_distribution<int> dist_;
   key_compare comparator_;
-  std::unique_ptr<MemoryListType> nodes_;
 
-  static_assert(std::is_same<NodeId, typename MemoryListType::NodeId>::value,
+  static_assert(std::is_same<NodeId, typename LegacyMemoryList::NodeId>::value,
                 "type NodeId must be same as MemoryList<Node>::NodeId");
+  static_assert(kLegacyHeaderSize == offsetof(Header, buffer_size),
+                "legacy header must be a prefix of Header");
 };
 
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel = 20,
+          typename Comparator = std::less<Key>>
+using IndexedSkipList = SkipList<Key, Value, kMaxLevel, Comparator, true>;
+
 #define SkipListType                                               \
   SkipList<Key,                                                    \
            Value,                                                  \
            kMaxLevel,                                              \
            Comparator,                                             \
+           kIndexed,                                               \
            typename std::enable_if<std::is_pod<Key>::value &&      \
                                    std::is_pod<Value>::value &&    \
                                    !std::is_pointer<Key>::value && \
@@ -207,110 +293,509 @@ class SkipList<Key,
 #define ConstIteratorType typename SkipListType::const_iterator
 #define MappedType typename SkipListType::mapped_type
 #define NodeIdType typename SkipListType::NodeId
+#define NodeType typename SkipListType::Node
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+const int64_t SkipListType::kMagic;
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+const int64_t SkipListType::kLegacyMagic;
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+const int64_t SkipListType::kConvertingMagic;
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+const SizeType SkipListType::kLegacyHeaderSize;
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+const SizeType SkipListType::kNodeAlign;
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+const SizeType SkipListType::kHeaderSize;
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+const NodeIdType SkipListType::kInvalidNodeId;
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 typename SkipListType::UniquePtr SkipListType::Create(char* start,
                                                       SizeType size) {
-  if (size < kHeaderSize) {
+  return Create(start, size, kMagic);
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+typename SkipListType::UniquePtr SkipListType::Create(char* start,
+                                                      SizeType size,
+                                                      int64_t magic) {
+  // 至少要放得下头尾两个节点
+  if (size < kHeaderSize + 2 * NodeSize(kMaxLevel)) {
     return nullptr;
   }
 
-  std::unique_ptr<MemoryListType> nodes(
-      MemoryListType::Create(start + kHeaderSize, size - kHeaderSize));
-  if (nodes == nullptr) {
-    return nullptr;
+  // 按RandomLevel的分布算出节点的平均大小, 多留一点余量
+  // 分配时会给剩下的元素预留空间, 所以max_size个元素一定放得下
+  double expected_node_size = 0;
+  double p = 1;
+  for (auto level = 1; level <= kMaxLevel; ++level) {
+    auto q = level < kMaxLevel ? p * 0.75 : p;
+    expected_node_size += q * NodeSize(level);
+    p *= 0.25;
   }
+  auto space = size - kHeaderSize - 2 * NodeSize(kMaxLevel);
 
   std::unique_ptr<SkipList> l(new SkipList);
-  l->nodes_ = std::move(nodes);
+  l->start_ = start;
   l->header_ = reinterpret_cast<Header*>(start);
-  l->InitHeader();
-  return std::move(l);
+  l->header_->buffer_size = size;
+  l->header_->max_elements =
+      static_cast<size_type>(space / (expected_node_size * 1.05));
+  l->InitHeader(magic);
+  return l;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
-typename SkipListType::UniquePtr SkipListType::Restore(char* start,
-                                                       SizeType size) {
-  if (size < kHeaderSize) {
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+typename SkipListType::UniquePtr SkipListType::Restore(
+    char* start, SizeType size, const std::string& legacy_backup) {
+  if (size < kLegacyHeaderSize) {
     return nullptr;
   }
 
-  std::unique_ptr<MemoryListType> nodes(
-      MemoryListType::Restore(start + kHeaderSize, size - kHeaderSize));
-  if (nodes == nullptr) {
-    LOG_WARNING << "MemoryListType::Restore faield";
-    return nullptr;
+  auto header = reinterpret_cast<Header*>(start);
+  if (header->magic == kConvertingMagic) {
+    if (legacy_backup.empty() ||
+        !ReadFileExactly(legacy_backup, start, size)) {
+      LOG_WARNING << "Read legacy SkipList backup failed, backup: "
+                  << legacy_backup;
+      return nullptr;
+    }
+    LOG_INFO << "Convert legacy SkipList again from " << legacy_backup;
+  }
+  if (header->magic == kLegacyMagic) {
+    return RestoreLegacy(start, size, legacy_backup);
   }
+
   std::unique_ptr<SkipList> l(new SkipList);
-  l->nodes_ = std::move(nodes);
+  l->start_ = start;
   if (l->RestoreHeader(start, size) == false) {
     LOG_WARNING << "SkipList::RestoreHeader faield";
     return nullptr;
   }
-  return std::move(l);
+  return l;
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+typename SkipListType::UniquePtr SkipListType::RestoreLegacy(
+    char* start, SizeType size, const std::string& legacy_backup) {
+  auto header = reinterpret_cast<Header*>(start);
+  std::unique_ptr<LegacyMemoryList> nodes(LegacyMemoryList::Restore(
+      start + kLegacyHeaderSize, size - kLegacyHeaderSize));
+  if (nodes == nullptr || header->max_level != kMaxLevel ||
+      header->elements > nodes->max_size() - 2) {
+    LOG_WARNING << "Restore legacy SkipList faield";
+    return nullptr;
+  }
+
+  // 先把数据拷出来, 再在原来的内存上按新的布局重建
+  std::vector<value_type> values;
+  values.reserve(header->elements);
+  auto node_id = nodes->Get(header->head)->levels[0];
+  while (node_id != header->tail) {
+    if (node_id == LegacyMemoryList::kInvalidNodeId ||
+        values.size() == header->elements) {
+      LOG_WARNING << "Corrupted legacy SkipList";
+      return nullptr;
+    }
+    auto node = nodes->Get(node_id);
+    values.push_back(node->val);
+    node_id = node->levels[0];
+  }
+  if (values.size() != header->elements) {
+    LOG_WARNING << "Corrupted legacy SkipList, elements = " << header->elements
+                << ", nodes = " << values.size();
+    return nullptr;
+  }
+
+  if (legacy_backup.empty()) {
+    LOG_WARNING << "No backup file to convert legacy SkipList";
+    return nullptr;
+  }
+  // 原来的数据完整写到磁盘之后才能覆盖, 写magic之前崩溃还是旧布局
+  if (!WriteFileAtomically(legacy_backup, start, size)) {
+    PLOG_WARNING << "Write legacy SkipList backup failed, backup: "
+                 << legacy_backup;
+    return nullptr;
+  }
+  std::vector<char> backup(start, start + size);
+  header->magic = kConvertingMagic;
+  auto l = Create(start, size, kConvertingMagic);
+  if (l && values.size() <= l->max_size()) {
+    for (const auto& v : values) {
+      l->insert(std::make_pair(v.first, v.second));
+    }
+    // 数据全部插入之后再写magic
+    l->header_->magic = kMagic;
+    DeleteFile(legacy_backup);
+    LOG_INFO << "Convert legacy SkipList, elements = " << values.size()
+             << ", max_size = " << l->max_size();
+    return l;
+  }
+  LOG_WARNING << "Legacy SkipList too large to convert, elements = "
+              << values.size();
+  memcpy(start, backup.data(), size);
+  DeleteFile(legacy_backup);
+  return nullptr;
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+SizeType SkipListType::NodeSize(size_type level) {
+  auto links = kIndexed ? 2 * level : level;
+  auto size = offsetof(Node, levels) + links * sizeof(NodeId);
+  return (size + kNodeAlign - 1) / kNodeAlign * kNodeAlign;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
-void SkipListType::InitHeader() {
-  header_->magic = kMagic;
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+void SkipListType::InitHeader(int64_t magic) {
+  header_->magic = magic;
   header_->max_level = kMaxLevel;
   header_->elements = 0;
+  header_->value_size = sizeof(value_type);
+  header_->free_area = kHeaderSize;
+  header_->free_nodes = 0;
+  for (auto level = 0; level < kMaxLevel; ++level) {
+    header_->free_lists[level] = kInvalidNodeId;
+  }
 
-  auto head = nodes_->Allocate();
-  auto tail = nodes_->Allocate();
-  auto node = nodes_->Get(head);
-  node->prev = MemoryListType::kInvalidNodeId;
+  // 头尾节点总是kMaxLevel层, 已经在max_elements之外留出了空间
+  auto head = header_->free_area;
+  auto tail = head + NodeSize(kMaxLevel);
+  header_->free_area = tail + NodeSize(kMaxLevel);
+  auto node = GetNode(head);
+  node->prev = kInvalidNodeId;
   node->level = kMaxLevel;
   for (auto level = 0; level < kMaxLevel; ++level) {
     node->levels[level] = tail;
+    if (kIndexed) {
+      Spans(node)[level] = 1;
+    }
   }
 
-  node = nodes_->Get(tail);
+  node = GetNode(tail);
   node->prev = head;
   node->level = kMaxLevel;
   for (auto level = 0; level < kMaxLevel; ++level) {
-    node->levels[level] = MemoryListType::kInvalidNodeId;
+    node->levels[level] = kInvalidNodeId;
+    if (kIndexed) {
+      Spans(node)[level] = 0;
+    }
   }
 
   header_->head = head;
   header_->tail = tail;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 bool SkipListType::RestoreHeader(char* start, SizeType size) {
-  assert(size >= kHeaderSize);
-  (void)size;
+  if (size < kHeaderSize) {
+    return false;
+  }
   header_ = reinterpret_cast<Header*>(start);
+  auto node_area_end = header_->buffer_size - NodeSize(1);
   if (header_->magic != kMagic || header_->max_level != kMaxLevel ||
-      header_->elements > nodes_->max_size() - 2) {
+      header_->value_size != sizeof(value_type) ||
+      header_->buffer_size > size ||
+      header_->elements > header_->max_elements ||
+      header_->free_area < kHeaderSize ||
+      header_->free_area > header_->buffer_size ||
+      header_->head != kHeaderSize ||
+      header_->tail != kHeaderSize + NodeSize(kMaxLevel) ||
+      header_->free_area < header_->tail + NodeSize(kMaxLevel)) {
+    return false;
+  }
+  for (auto level = 0; level < kMaxLevel; ++level) {
+    auto free_list = header_->free_lists[level];
+    if (free_list != kInvalidNodeId &&
+        (free_list < kHeaderSize || free_list > node_area_end)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+NodeType* SkipListType::GetNode(NodeId node_id) const {
+  assert(node_id != kInvalidNodeId);
+  return reinterpret_cast<Node*>(start_ + node_id);
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+SizeType* SkipListType::Spans(Node* node) {
+  return node->levels + node->level;
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+NodeIdType SkipListType::FindNodeByRank(size_type r) const {
+  if (r >= header_->elements) {
+    return header_->tail;
+  }
+  // 头节点的排名是0, 第一个元素是1
+  const size_type target = r + 1;
+  size_type rank = 0;
+  auto node = GetNode(header_->head);
+  for (int level = kMaxLevel - 1; level >= 0; --level) {
+    while (node->levels[level] != header_->tail &&
+           rank + Spans(node)[level] <= target) {
+      rank += Spans(node)[level];
+      node = GetNode(node->levels[level]);
+    }
+    if (rank == target) {
+      break;
+    }
+  }
+  assert(rank == target);
+  return reinterpret_cast<char*>(node) - start_;
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+SizeType SkipListType::rank(const key_type& k) const {
+  static_assert(kIndexed, "rank requires an indexed SkipList");
+  LevelArray path;
+  LevelArray ranks;
+  FindNode(k, path, ranks);
+  return ranks[0];
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+IteratorType SkipListType::at_rank(size_type r) {
+  static_assert(kIndexed, "at_rank requires an indexed SkipList");
+  return iterator(this, FindNodeByRank(r));
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+ConstIteratorType SkipListType::at_rank(size_type r) const {
+  static_assert(kIndexed, "at_rank requires an indexed SkipList");
+  return const_iterator(this, FindNodeByRank(r));
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+std::pair<IteratorType, IteratorType> SkipListType::range_by_rank(
+    size_type start, size_type n) {
+  if (start >= header_->elements) {
+    return std::make_pair(end(), end());
+  }
+  auto last = start + std::min(n, header_->elements - start);
+  return std::make_pair(at_rank(start), at_rank(last));
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+std::pair<ConstIteratorType, ConstIteratorType> SkipListType::range_by_rank(
+    size_type start, size_type n) const {
+  if (start >= header_->elements) {
+    return std::make_pair(end(), end());
+  }
+  auto last = start + std::min(n, header_->elements - start);
+  return std::make_pair(at_rank(start), at_rank(last));
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+NodeIdType SkipListType::AllocateNode(size_type level) {
+  if (header_->elements == header_->max_elements) {
+    throw std::bad_alloc();
+  }
+  NodeId node_id;
+  // 先用同样层数的空闲节点, 空间不够时降低层数
+  for (auto l = level; l >= 1; --l) {
+    auto& free_list = header_->free_lists[l - 1];
+    if (free_list != kInvalidNodeId) {
+      node_id = free_list;
+      free_list = GetNode(node_id)->prev;
+      --header_->free_nodes;
+      return node_id;
+    }
+    if (AllocateFromFreeArea(l, &node_id)) {
+      return node_id;
+    }
+  }
+  // 未分配区域已经用完, 剩下的空闲节点一定够用
+  for (auto l = level + 1; l <= kMaxLevel; ++l) {
+    auto& free_list = header_->free_lists[l - 1];
+    if (free_list != kInvalidNodeId) {
+      node_id = free_list;
+      free_list = GetNode(node_id)->prev;
+      --header_->free_nodes;
+      return node_id;
+    }
+  }
+  CHECK(false) << "No space left, elements = " << header_->elements
+               << ", max_elements = " << header_->max_elements;
+  return kInvalidNodeId;
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+bool SkipListType::AllocateFromFreeArea(size_type level, NodeId* node_id) {
+  auto free_bytes = header_->buffer_size - header_->free_area;
+  auto node_size = NodeSize(level);
+  if (node_size > free_bytes) {
     return false;
   }
+  // 分配之后剩下的空间还要够其他元素每个至少放一个一层的节点
+  auto reserved = header_->max_elements - header_->elements - 1;
+  auto slots = (free_bytes - node_size) / NodeSize(1) + header_->free_nodes;
+  if (slots < reserved) {
+    return false;
+  }
+  *node_id = header_->free_area;
+  header_->free_area += node_size;
+  GetNode(*node_id)->level = level;
   return true;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+void SkipListType::DeallocateNode(NodeId node_id) {
+  auto node = GetNode(node_id);
+  auto& free_list = header_->free_lists[node->level - 1];
+  node->prev = free_list;
+  free_list = node_id;
+  ++header_->free_nodes;
+}
+
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 std::pair<IteratorType, bool> SkipListType::insert(
     const std::pair<key_type, mapped_type>& p) {
   LevelArray path;
-  auto node_id = FindNode(p.first, path);
+  LevelArray ranks;
+  auto node_id = FindNode(p.first, path, kIndexed ? ranks : nullptr);
   bool exists;
   if (node_id != header_->tail) {
     exists = true;
   } else {
     exists = false;
-    node_id = nodes_->Allocate();
-    auto node = nodes_->Get(node_id);
+    // 实际的层数可能比随机出来的低
+    node_id = AllocateNode(RandomLevel());
+    auto node = GetNode(node_id);
     node->val.first = p.first;
     node->val.second = p.second;
-    node->level = RandomLevel();
     node->prev = path[0];
     for (auto level = 0u; level < node->level; ++level) {
-      auto prev_node = nodes_->Get(path[level]);
+      auto prev_node = GetNode(path[level]);
       node->levels[level] = prev_node->levels[level];
       prev_node->levels[level] = node_id;
+      if (kIndexed) {
+        // 新节点把前一个节点的这一段分成两段
+        auto distance = ranks[0] - ranks[level];
+        Spans(node)[level] = Spans(prev_node)[level] - distance;
+        Spans(prev_node)[level] = distance + 1;
+      }
+    }
+    if (kIndexed) {
+      for (auto level = node->level; level < kMaxLevel; ++level) {
+        ++Spans(GetNode(path[level]))[level];
+      }
     }
 
-    auto next_node = nodes_->Get(node->next());
+    auto next_node = GetNode(node->next());
     next_node->prev = node_id;
 
     ++header_->elements;
@@ -318,18 +803,30 @@ std::pair<IteratorType, bool> SkipListType::insert(
   return std::make_pair(iterator(this, node_id), !exists);
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 MappedType& SkipListType::operator[](const key_type& k) {
   return insert(std::make_pair(k, mapped_type())).first->second;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 void SkipListType::erase(iterator position) {
   assert(position != end());
   erase(position->first);
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 SizeType SkipListType::erase(const key_type& k) {
   LevelArray path;
   auto node_id = FindNode(k, path);
@@ -341,7 +838,11 @@ SizeType SkipListType::erase(const key_type& k) {
   }
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 void SkipListType::erase(iterator first, iterator last) {
   auto it = first;
   while (it != last) {
@@ -352,72 +853,113 @@ void SkipListType::erase(iterator first, iterator last) {
   }
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 void SkipListType::clear() {
-  nodes_->Clear();
-  InitHeader();
+  InitHeader(kMagic);
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 IteratorType SkipListType::find(const key_type& k) {
   LevelArray path;
   return iterator(this, FindNode(k, path));
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 ConstIteratorType SkipListType::find(const key_type& k) const {
   LevelArray path;
-  return const_iterator(this,
-                        reinterpret_cast<SkipList*>(this)->FindNode(k, &path));
+  return const_iterator(this, FindNode(k, path));
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 IteratorType SkipListType::begin() {
-  return iterator(this, nodes_->Get(header_->head)->next());
+  return iterator(this, GetNode(header_->head)->next());
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 ConstIteratorType SkipListType::begin() const {
-  return const_iterator(this, nodes_->Get(header_->head)->next());
+  return const_iterator(this, GetNode(header_->head)->next());
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 IteratorType SkipListType::end() {
   return iterator(this, header_->tail);
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 ConstIteratorType SkipListType::end() const {
   return const_iterator(this, header_->tail);
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 bool SkipListType::empty() const {
   return header_->elements == 0;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 SizeType SkipListType::size() const {
   return header_->elements;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 SizeType SkipListType::max_size() const {
-  return nodes_->max_size() - 2;
+  return header_->max_elements;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 void SkipListType::Dump() const {
   std::cout << "************************************************************\n";
-  for (auto node_id = header_->head;
-       node_id != MemoryListType::kInvalidNodeId;) {
-    auto node = nodes_->Get(node_id);
+  for (auto node_id = header_->head; node_id != kInvalidNodeId;) {
+    auto node = GetNode(node_id);
     printf("id = %10d, prev = %10d, next = %10d, level = %10d, levels = [",
            node_id,
            node->prev,
            node->next(),
            node->level);
-    for (auto level = 0; level < node->level;) {
+    for (auto level = 0u; level < node->level;) {
       std::cout << node->levels[level];
       if (++level < node->level) {
         std::cout << ", ";
@@ -428,47 +970,66 @@ void SkipListType::Dump() const {
   }
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 NodeIdType SkipListType::PrevNode(NodeId node_id) const {
-  assert(node_id != MemoryListType::kInvalidNodeId);
+  assert(node_id != kInvalidNodeId);
   if (node_id == header_->head) {
     return header_->head;
   } else {
-    auto node = nodes_->Get(node_id);
+    auto node = GetNode(node_id);
     return node->prev;
   }
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 NodeIdType SkipListType::NextNode(NodeId node_id) const {
-  assert(node_id != MemoryListType::kInvalidNodeId);
+  assert(node_id != kInvalidNodeId);
   if (node_id == header_->tail) {
     return header_->tail;
   } else {
-    auto node = nodes_->Get(node_id);
+    auto node = GetNode(node_id);
     return node->next();
   }
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 typename SkipListType::value_type& SkipListType::NodeValue(
     NodeId node_id) const {
-  assert(node_id != MemoryListType::kInvalidNodeId);
+  assert(node_id != kInvalidNodeId);
   assert(node_id != header_->head);
   assert(node_id != header_->tail);
 
-  return nodes_->Get(node_id)->val;
+  return GetNode(node_id)->val;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
-NodeIdType SkipListType::FindNode(const key_type& key, NodeId* path) const {
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
+NodeIdType SkipListType::FindNode(const key_type& key,
+                                  NodeId* path,
+                                  size_type* ranks) const {
   assert(path);
   static_assert(kMaxLevel > 1, "KMaxLevel must be large than 1");
   int current_level = kMaxLevel - 1;
   auto current_node_id = header_->head;
-  auto current_node = nodes_->Get(current_node_id);
+  auto current_node = GetNode(current_node_id);
   auto prev_node_id = current_node_id;
   NodeId target = header_->tail;
+  size_type rank = 0;
   while (current_level >= 0) {
     bool equal;
     assert(current_node->level >= static_cast<size_type>(current_level));
@@ -481,37 +1042,59 @@ NodeIdType SkipListType::FindNode(const key_type& key, NodeId* path) const {
       } else {
         prev_node_id = current_node->levels[current_level];
       }
+      if (ranks) {
+        rank += Spans(current_node)[current_level];
+      }
       current_node_id = current_node->levels[current_level];
-      current_node = nodes_->Get(current_node_id);
+      current_node = GetNode(current_node_id);
     }
     path[current_level] = prev_node_id;
+    if (ranks) {
+      ranks[current_level] = rank;
+    }
     --current_level;
   }
   return target;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 void SkipListType::EraseNode(NodeId node_id, NodeId* path) {
   assert(path);
   assert(node_id != header_->head);
   assert(node_id != header_->tail);
-  assert(node_id != MemoryListType::kInvalidNodeId);
+  assert(node_id != kInvalidNodeId);
 
-  auto node = nodes_->Get(node_id);
-  auto next_node = nodes_->Get(node->next());
+  auto node = GetNode(node_id);
+  auto next_node = GetNode(node->next());
   next_node->prev = node->prev;
 
   for (auto level = 0u; level < node->level; ++level) {
-    auto level_node = nodes_->Get(path[level]);
+    auto level_node = GetNode(path[level]);
     assert(level_node->levels[level] == node_id);
     level_node->levels[level] = node->levels[level];
+    if (kIndexed) {
+      Spans(level_node)[level] += Spans(node)[level] - 1;
+    }
+  }
+  if (kIndexed) {
+    for (auto level = node->level; level < kMaxLevel; ++level) {
+      --Spans(GetNode(path[level]))[level];
+    }
   }
 
   --header_->elements;
-  nodes_->Deallocate(node_id);
+  DeallocateNode(node_id);
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 bool SkipListType::NotGoBefore(const key_type& key,
                                NodeId node_id,
                                bool* equal) const {
@@ -521,7 +1104,7 @@ bool SkipListType::NotGoBefore(const key_type& key,
   } else if (node_id == header_->head) {
     return true;
   } else {
-    auto node = nodes_->Get(node_id);
+    auto node = GetNode(node_id);
     assert(node);
     bool go_before = comparator_(key, node->val.first);
     bool go_after = comparator_(node->val.first, key);
@@ -530,7 +1113,11 @@ bool SkipListType::NotGoBefore(const key_type& key,
   }
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 SizeType SkipListType::RandomLevel() {
   size_t level = 1;
   while ((Random::Rand32() & 0xFFFF) < 0.25 * 0xFFFF) {
@@ -541,7 +1128,11 @@ SizeType SkipListType::RandomLevel() {
 
 #define IteratorBaseType \
   IteratorBase<DerivedType, ContainerType, Pointer, Reference>
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 template <typename DerivedType,
           typename ContainerType,
           typename Pointer,
@@ -549,7 +1140,11 @@ template <typename DerivedType,
 SkipListType::IteratorBaseType::IteratorBase(ContainerType* c, NodeId node_id)
     : c_(c), node_id_(node_id) {}
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 template <typename DerivedType,
           typename ContainerType,
           typename Pointer,
@@ -558,7 +1153,11 @@ DerivedType& SkipListType::IteratorBaseType::operator++() {
   node_id_ = c_->NextNode(node_id_);
   return static_cast<DerivedType&>(*this);
 }
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 template <typename DerivedType,
           typename ContainerType,
           typename Pointer,
@@ -569,7 +1168,11 @@ const DerivedType SkipListType::IteratorBaseType::operator++(int) {
   return res;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 template <typename DerivedType,
           typename ContainerType,
           typename Pointer,
@@ -579,7 +1182,11 @@ DerivedType& SkipListType::IteratorBaseType::operator--() {
   return static_cast<DerivedType&>(*this);
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 template <typename DerivedType,
           typename ContainerType,
           typename Pointer,
@@ -590,7 +1197,11 @@ const DerivedType SkipListType::IteratorBaseType::operator--(int) {
   return res;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 template <typename DerivedType,
           typename ContainerType,
           typename Pointer,
@@ -599,7 +1210,11 @@ Reference SkipListType::IteratorBaseType::operator*() const {
   return c_->NodeValue(node_id_);
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 template <typename DerivedType,
           typename ContainerType,
           typename Pointer,
@@ -608,7 +1223,11 @@ Pointer SkipListType::IteratorBaseType::operator->() const {
   return &**this;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 template <typename DerivedType,
           typename ContainerType,
           typename Pointer,
@@ -623,7 +1242,11 @@ bool SkipListType::IteratorBaseType::operator==(
   return c_ == rhs.c_ && node_id_ == rhs.node_id_;
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 template <typename DerivedType,
           typename ContainerType,
           typename Pointer,
@@ -638,32 +1261,52 @@ bool SkipListType::IteratorBaseType::operator!=(
   return !(*this == rhs);
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 SkipListType::ConstIterator::ConstIterator()
     : IteratorBase<ConstIterator,
                    const SkipList,
                    const value_type*,
-                   const value_type&>(nullptr, MemoryListType::kInvalidNodeId) {
+                   const value_type&>(nullptr, kInvalidNodeId) {
 }
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 SkipListType::ConstIterator::ConstIterator(const SkipList* l, NodeId node_id)
     : IteratorBase<ConstIterator,
                    const SkipList,
                    const value_type*,
                    const value_type&>(l, node_id) {}
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 SkipListType::Iterator::Iterator()
     : IteratorBase<Iterator, SkipList, value_type*, value_type&>(
-          nullptr, MemoryListType::kInvalidNodeId) {}
+          nullptr, kInvalidNodeId) {}
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 SkipListType::Iterator::Iterator(const ConstIterator& it)
     : IteratorBase<Iterator, SkipList, value_type*, value_type&>(it.c_,
                                                                  it.node_id_) {}
 
-template <typename Key, typename Value, int32_t kMaxLevel, typename Comparator>
+template <typename Key,
+          typename Value,
+          int32_t kMaxLevel,
+          typename Comparator,
+          bool kIndexed>
 SkipListType::Iterator::Iterator(SkipList* l, NodeId node_id)
     : IteratorBase<Iterator, SkipList, value_type*, value_type&>(l, node_id) {}
 
@@ -673,6 +1316,7 @@ SkipListType::Iterator::Iterator(SkipList* l, NodeId node_id)
 #undef ConstIteratorType
 #undef MappedType
 #undef NodeIdType
+#undef NodeType
 #undef IteratorBaseType
 }
 
@@ -42,6 +42,17 @@ void SetReuseAddress(int fd) {
   }
 }
 
+void SetReusePort(int fd) {
+  int enable_reuse_port = 1;
+  if (unlikely(::setsockopt(fd,
+                            SOL_SOCKET,
+                            SO_REUSEPORT,
+                            &enable_reuse_port,
+                            sizeof(enable_reuse_port)) == -1)) {
+    PLOG_WARNING << "setsockopt failed";
+  }
+}
+
 void SetReceiveTimeout(int fd, int microseconds) {
   static const int kMicroSecondsPerSecond = 1000000;
   struct timeval tv;
@@ -16,6 +16,7 @@ namespace alpha {
 namespace SocketOps {
 void SetNonBlocking(int fd);
 void SetReuseAddress(int fd);
+void SetReusePort(int fd);
 void SetReceiveTimeout(int fd, int microseconds);
 int GetAndClearError(int fd);
 void DisableReading(int fd);
@@ -11,7 +11,10 @@
  */
 #include <alpha/TcpAcceptor.h>
 
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include <cassert>
 
 #include <alpha/Compiler.h>
@@ -23,15 +26,22 @@
 #include <alpha/ScopedGeneric.h>
 
 namespace alpha {
-TcpAcceptor::TcpAcceptor(EventLoop* loop) : loop_(loop), listen_fd_(-1) {}
+TcpAcceptor::TcpAcceptor(EventLoop* loop)
+    : loop_(loop),
+      listen_fd_(-1),
+      idle_fd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+      edge_triggered_(false) {}
 
 TcpAcceptor::~TcpAcceptor() {
   if (listen_fd_ != -1) {
     ::close(listen_fd_);
   }
+  if (idle_fd_ != -1) {
+    ::close(idle_fd_);
+  }
 }
 
-bool TcpAcceptor::Bind(const alpha::NetAddress& addr) {
+bool TcpAcceptor::Bind(const alpha::NetAddress& addr, bool reuse_port) {
   assert(listen_fd_ == -1);
   listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
   if (unlikely(listen_fd_ == -1)) {
@@ -39,6 +49,9 @@ bool TcpAcceptor::Bind(const alpha::NetAddress& addr) {
     return false;
   }
   SocketOps::SetReuseAddress(listen_fd_);
+  if (reuse_port) {
+    SocketOps::SetReusePort(listen_fd_);
+  }
   struct sockaddr_in sock_addr = addr.ToSockAddr();
   int ret = ::bind(
       listen_fd_, reinterpret_cast<sockaddr*>(&sock_addr), sizeof(sockaddr));
@@ -61,27 +74,61 @@ bool TcpAcceptor::Listen() {
   } else {
     channel_.reset(new Channel(loop_, listen_fd_));
     channel_->set_read_callback(std::bind(&TcpAcceptor::OnNewConnection, this));
+    channel_->set_edge_triggered(edge_triggered_);
     channel_->EnableReading();
     return true;
   }
 }
 
 void TcpAcceptor::OnNewConnection() {
+  if (!edge_triggered_) {
+    AcceptOne();
+    return;
+  }
+  while (AcceptOne()) {
+  }
+}
+
+bool TcpAcceptor::AcceptOne() {
   struct sockaddr_in addr;
   socklen_t len = sizeof(addr);
-  alpha::ScopedFD fd(
-      ::accept(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len));
+  alpha::ScopedFD fd(::accept4(listen_fd_,
+                               reinterpret_cast<sockaddr*>(&addr),
+                               &len,
+                               SOCK_NONBLOCK | SOCK_CLOEXEC));
   if (unlikely(!fd.is_valid())) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return false;
+    }
     PLOG_WARNING << "accept failed";
-  } else {
-    int err = SocketOps::GetAndClearError(fd.get());
-    if (unlikely(err)) {
-      LOG_INFO << "Error immediately after accept, err: " << err;
-    } else {
-      SocketOps::SetNonBlocking(fd.get());
-      DLOG_INFO << "New Connection, fd = " << fd.get();
-      new_connection_callback_(fd.Release());
+    if (errno == EMFILE || errno == ENFILE) {
+      return DropOne();
     }
+    // 对端已经放弃的连接不影响后面的accept
+    return errno == ECONNABORTED || errno == EINTR;
+  }
+  int err = SocketOps::GetAndClearError(fd.get());
+  if (unlikely(err)) {
+    LOG_INFO << "Error immediately after accept, err: " << err;
+  } else {
+    DLOG_INFO << "New Connection, fd = " << fd.get();
+    new_connection_callback_(fd.Release());
+  }
+  return true;
+}
+
+bool TcpAcceptor::DropOne() {
+  if (idle_fd_ == -1) {
+    return false;
+  }
+  ::close(idle_fd_);
+  int fd = ::accept(listen_fd_, nullptr, nullptr);
+  if (fd != -1) {
+    LOG_WARNING << "Too many open files, close new connection";
+    ::close(fd);
   }
+  idle_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+  // 没有等待中的连接时accept也会返回EMFILE, 这时不能再继续
+  return fd != -1;
 }
 }
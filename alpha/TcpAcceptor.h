@@ -33,14 +33,23 @@ class TcpAcceptor {
     new_connection_callback_ = cb;
   }
 
-  bool Bind(const NetAddress& addr);
+  // reuse_port为true时多个TcpAcceptor可以绑定同一个地址, 由内核分发连接
+  bool Bind(const NetAddress& addr, bool reuse_port = false);
   bool Listen();
+  // 在Listen之前调用, 边缘触发时每次可读都会accept到EAGAIN为止
+  void set_edge_triggered(bool enable) { edge_triggered_ = enable; }
 
  private:
   void OnNewConnection();
+  bool AcceptOne();
+  bool DropOne();
 
   EventLoop* loop_;
   int listen_fd_;
+  // 预留的fd, fd用完时先关掉它来accept并关闭等待中的连接,
+  // 否则边缘触发时积压的连接再也不会被通知
+  int idle_fd_;
+  bool edge_triggered_;
   std::unique_ptr<Channel> channel_;
   NewConnectionCallback new_connection_callback_;
 };
@@ -12,7 +12,11 @@
 
 #include <alpha/TcpConnection.h>
 
+#include <sys/sendfile.h>
+#include <sys/stat.h>
 #include <sys/uio.h>
+#include <unistd.h>
+#include <climits>
 #include <alpha/Compiler.h>
 #include <alpha/Logger.h>
 #include <alpha/Channel.h>
@@ -22,13 +26,22 @@
 namespace alpha {
 TcpConnection::TcpConnection(EventLoop* loop,
                              int fd,
-                             TcpConnection::State state)
-    : loop_(loop), fd_(fd), state_(state) {
+                             TcpConnection::State state,
+                             bool edge_triggered)
+    : loop_(loop),
+      fd_(fd),
+      state_(state),
+      read_buffer_(loop->buffer_pool()),
+      write_buffer_(loop->buffer_pool()),
+      bytes_to_write_(0),
+      owned_bytes_to_write_(0),
+      bytes_read_(0),
+      write_done_queued_(false) {
   DCHECK(loop_);
   DCHECK(fd_);
   channel_.reset(new Channel(loop, fd));
   DCHECK(state_ == State::kConnected);
-  Init();
+  Init(edge_triggered);
 }
 
 TcpConnection::~TcpConnection() {
@@ -38,13 +51,14 @@ TcpConnection::~TcpConnection() {
 }
 
 bool TcpConnection::Write(const void* data, size_t size) {
-  if (unlikely(write_buffer_.Append(data, size) == false)) {
-    LOG_WARNING << "Write failed, size = " << size
-                << ", local_addr_ = " << *local_addr_
-                << ", peer_addr_ = " << *peer_addr_;
+  if (unlikely(!CheckWriteSize(size))) {
     return false;
   }
-  channel_->EnableWriting();
+  auto p = static_cast<const char*>(data);
+  auto nbytes = WriteDirectly(p, size);
+  if (nbytes != size) {
+    QueueWrite(p + nbytes, size - nbytes, nullptr);
+  }
   return true;
 }
 
@@ -52,6 +66,74 @@ bool TcpConnection::Write(const alpha::Slice& data) {
   return Write(data.data(), data.size());
 }
 
+bool TcpConnection::Write(const char* data) { return Write(Slice(data)); }
+
+bool TcpConnection::Write(std::string&& data) {
+  if (data.size() < kMinOwnedWriteSize) {
+    return Write(data.data(), data.size());
+  }
+  if (unlikely(!CheckWriteSize(data.size()))) {
+    return false;
+  }
+  auto nbytes = WriteDirectly(data.data(), data.size());
+  if (nbytes != data.size()) {
+    // 写完了就不需要再分配一个owner
+    auto owner = std::make_shared<std::string>(std::move(data));
+    QueueWrite(owner->data() + nbytes, owner->size() - nbytes, owner);
+  }
+  return true;
+}
+
+bool TcpConnection::Write(const alpha::Slice& data,
+                          std::shared_ptr<const void> owner) {
+  if (data.size() < kMinOwnedWriteSize || !owner) {
+    return Write(data.data(), data.size());
+  }
+  if (unlikely(!CheckWriteSize(data.size()))) {
+    return false;
+  }
+  auto nbytes = WriteDirectly(data.data(), data.size());
+  if (nbytes != data.size()) {
+    QueueWrite(data.data() + nbytes, data.size() - nbytes, std::move(owner));
+  }
+  return true;
+}
+
+bool TcpConnection::SendFile(int fd, off_t offset, size_t size) {
+  struct stat st;
+  if (::fstat(fd, &st) == -1) {
+    PLOG_WARNING << "fstat failed, fd = " << fd;
+    return false;
+  }
+  if (offset < 0 || static_cast<uint64_t>(offset) + size >
+                        static_cast<uint64_t>(st.st_size)) {
+    LOG_WARNING << "SendFile out of range, offset = " << offset
+                << ", size = " << size << ", file size = " << st.st_size;
+    return false;
+  }
+  if (size == 0) {
+    return true;
+  }
+  int file_fd = ::dup(fd);
+  if (file_fd == -1) {
+    PLOG_WARNING << "dup failed, fd = " << fd;
+    return false;
+  }
+  std::shared_ptr<const void> owner(new int(file_fd), [](const int* p) {
+    ::close(*p);
+    delete p;
+  });
+  auto nbytes = SendFileDirectly(file_fd, offset, size);
+  if (nbytes != size) {
+    offset += static_cast<off_t>(nbytes);
+    write_queue_.push_back(
+        WriteChunk{nullptr, size - nbytes, std::move(owner), file_fd, offset});
+    bytes_to_write_ += size - nbytes;
+    channel_->EnableWriting();
+  }
+  return true;
+}
+
 void TcpConnection::Close() {
   DCHECK(state_ != State::kDisconnected);
   if (state_ == State::kConnected) {
@@ -80,79 +162,283 @@ void TcpConnection::CloseByPeer() {
 }
 
 void TcpConnection::ReadFromPeer() {
-  static const size_t kLocalBufferSize =
-      1 << 16;  // 使用栈内存和readv尽快读取数据
-  char local_buffer[kLocalBufferSize];
-  const int iovcnt = 2;
-  iovec iov[iovcnt];
-
-  size_t contiguous_space_in_buffer = read_buffer_.GetContiguousSpace();
-  auto space_before_full = read_buffer_.SpaceBeforeFull();
-  DCHECK(space_before_full >= contiguous_space_in_buffer);
-  iov[0].iov_base = read_buffer_.WriteBegin();
-  iov[0].iov_len = contiguous_space_in_buffer;
-  iov[1].iov_base = local_buffer;
-  iov[1].iov_len = std::min(sizeof(local_buffer),
-                            space_before_full - contiguous_space_in_buffer);
-
-  ssize_t nbytes = ::readv(fd_, iov, iovcnt);
+  if (!channel_->edge_triggered()) {
+    ReadOnce();
+    return;
+  }
+  // 边缘触发时要读到EAGAIN, 但每次最多读kEdgeTriggeredReadBudget次,
+  // 剩下的留到下一次循环, 避免一个连接占住整个loop
+  for (int i = 0; i < kEdgeTriggeredReadBudget; ++i) {
+    if (ReadOnce() != ReadResult::kRead || state_ != State::kConnected) {
+      return;
+    }
+  }
+  TcpConnectionWeakPtr weak_conn(shared_from_this());
+  loop_->QueueInLoop([weak_conn] {
+    auto conn = weak_conn.lock();
+    if (conn && conn->state_ == State::kConnected) {
+      conn->ReadFromPeer();
+    }
+  });
+}
+
+TcpConnection::ReadResult TcpConnection::ReadOnce() {
+  // 直接读到buffer的chunk里, 每次只读到当前chunk剩下的空间(没有就新分配一个),
+  // 用连续的Read()的代码只有在一条消息真正跨chunk时才需要合并
+  size_t read_size = read_buffer_.GetContiguousSpace();
+  if (read_size == 0) {
+    read_size = TcpConnectionBuffer::kChunkSize;
+  }
+  iovec iov;
+  int iovcnt = read_buffer_.PrepareWrite(read_size, &iov, 1);
+  size_t space = iovcnt ? iov.iov_len : 0;
+
+  ssize_t nbytes = ::readv(fd_, &iov, iovcnt);
   DLOG_INFO << "readv return " << nbytes;
+  // 提交读到的数据, 同时归还多预留的chunk
+  read_buffer_.AddBytes(nbytes > 0 ? nbytes : 0);
 
   if (nbytes == 0) {
     LOG_INFO << "Peer closed connection, local_addr_ = " << *local_addr_
              << ", peer_addr_ = " << *peer_addr_;
     CloseByPeer();
+    return ReadResult::kClosed;
   } else if (nbytes == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return ReadResult::kDrained;
+    }
     PLOG_WARNING << "readv failed";
+    return ReadResult::kError;
   } else {
     size_t bytes = static_cast<size_t>(nbytes);
-    if (bytes <= contiguous_space_in_buffer) {
-      read_buffer_.AddBytes(bytes);
-    } else {
-      read_buffer_.AddBytes(contiguous_space_in_buffer);
-      size_t local_buffer_bytes = bytes - contiguous_space_in_buffer;
-      bool ok = read_buffer_.Append(local_buffer, local_buffer_bytes);
-      DCHECK(ok);
-      (void)ok;
-    }
+    bytes_read_ += bytes;
     DLOG_INFO << "Read " << bytes << " bytes from " << *peer_addr_;
     if (read_callback_) {
       read_callback_(shared_from_this(), &read_buffer_);
     }
+    // 没有读满说明内核里已经没有数据了, 省掉一次返回EAGAIN的readv
+    return bytes < space ? ReadResult::kDrained : ReadResult::kRead;
   }
 }
 
 void TcpConnection::WriteToPeer() {
-  size_t bytes;
-  auto buffer = write_buffer_.Read(&bytes);
+  if (FlushWriteQueue()) {
+    channel_->DisableWriting();
+    if (write_done_callback_) {
+      // 回调里可能会重新设置回调, 先复制一份
+      auto cb = write_done_callback_;
+      cb(shared_from_this());
+    }
+  }
+}
+
+bool TcpConnection::CheckWriteSize(size_t size) {
+  if (size > BytesCanWrite()) {
+    LOG_WARNING << "Write failed, size = " << size
+                << ", local_addr_ = " << *local_addr_
+                << ", peer_addr_ = " << *peer_addr_;
+    return false;
+  }
+  return true;
+}
+
+size_t TcpConnection::WriteDirectly(const char* data, size_t size) {
+  // 队列里还有数据时只能排在后面, 否则会乱序
+  if (!write_queue_.empty() || size == 0) {
+    return 0;
+  }
+  ssize_t nbytes = ::write(fd_, data, size);
+  if (nbytes == -1) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      // 留给WriteToPeer处理
+      PLOG_WARNING << "write failed, bytes = " << size;
+    }
+    return 0;
+  }
+  DLOG_INFO << "Write " << nbytes << " bytes directly";
+  if (static_cast<size_t>(nbytes) == size) {
+    QueueWriteDone();
+  }
+  return nbytes;
+}
+
+size_t TcpConnection::SendFileDirectly(int file_fd, off_t offset, size_t size) {
+  if (!write_queue_.empty()) {
+    return 0;
+  }
+  ssize_t nbytes = ::sendfile(fd_, file_fd, &offset, size);
+  if (nbytes == -1) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      PLOG_WARNING << "sendfile failed, bytes = " << size;
+    }
+    return 0;
+  }
+  DLOG_INFO << "Send " << nbytes << " bytes of file directly";
+  if (static_cast<size_t>(nbytes) == size) {
+    QueueWriteDone();
+  }
+  return nbytes;
+}
+
+void TcpConnection::QueueWrite(const char* data,
+                               size_t size,
+                               std::shared_ptr<const void> owner) {
+  DCHECK(size);
+  if (owner) {
+    owned_bytes_to_write_ += size;
+    write_queue_.push_back(WriteChunk{data, size, std::move(owner), -1, 0});
+  } else {
+    bool ok = write_buffer_.Append(data, size);
+    DCHECK(ok);
+    (void)ok;
+    // 相邻的拷贝数据在write_buffer_中是连续的, 合并成一段
+    if (!write_queue_.empty() && !write_queue_.back().owner) {
+      write_queue_.back().size += size;
+    } else {
+      write_queue_.push_back(WriteChunk{nullptr, size, nullptr, -1, 0});
+    }
+  }
+  bytes_to_write_ += size;
+  channel_->EnableWriting();
+}
+
+bool TcpConnection::FlushWriteQueue() {
+  static const int kMaxIovecs = IOV_MAX;
+  iovec iov[kMaxIovecs];
+  iovec buffered[kMaxIovecs];
+  while (!write_queue_.empty()) {
+    if (write_queue_.front().file_fd != -1) {
+      if (!FlushFileChunk()) {
+        return false;
+      }
+      continue;
+    }
+    // 拷贝进来的数据按顺序分布在write_buffer_的各个chunk里
+    int nbuffered = write_buffer_.Read(buffered, kMaxIovecs);
+    (void)nbuffered;
+    int buffered_index = 0;
+    size_t buffered_offset = 0;
+    int iovcnt = 0;
+    size_t bytes = 0;
+    // 遇到文件数据就先停下, 前面的数据写完之后再sendfile
+    for (auto it = write_queue_.begin();
+         it != write_queue_.end() && it->file_fd == -1 && iovcnt < kMaxIovecs;
+         ++it) {
+      if (it->owner) {
+        iov[iovcnt].iov_base = const_cast<char*>(it->data);
+        iov[iovcnt].iov_len = it->size;
+        ++iovcnt;
+        bytes += it->size;
+        continue;
+      }
+      auto left = it->size;
+      while (left != 0 && iovcnt < kMaxIovecs) {
+        DCHECK(buffered_index < nbuffered);
+        auto& b = buffered[buffered_index];
+        auto len = std::min(left, b.iov_len - buffered_offset);
+        iov[iovcnt].iov_base = static_cast<char*>(b.iov_base) + buffered_offset;
+        iov[iovcnt].iov_len = len;
+        ++iovcnt;
+        bytes += len;
+        left -= len;
+        buffered_offset += len;
+        if (buffered_offset == b.iov_len) {
+          ++buffered_index;
+          buffered_offset = 0;
+        }
+      }
+    }
 
-  while (bytes != 0) {
-    // TODO: 使用writev调整Buffer写入策略，同时快速递送消息
-    ssize_t nbytes = ::write(fd_, buffer, bytes);
+    ssize_t nbytes = ::writev(fd_, iov, iovcnt);
     if (nbytes == -1) {
       if (errno == EAGAIN || errno == EWOULDBLOCK) {
         //写满了
       } else if (state_ == State::kDisconnected) {
         // 连接已经关闭，而发送又失败了，就放弃吧
-        PLOG_WARNING << "write to closed connection failed, bytes = " << bytes;
+        PLOG_WARNING << "writev to closed connection failed, bytes = "
+                     << bytes;
       } else {
-        PLOG_WARNING << "write failed, bytes = " << bytes
+        PLOG_WARNING << "writev failed, bytes = " << bytes
                      << ", peer_addr_ = " << *peer_addr_;
       }
-      break;
+      return false;
     }
-    write_buffer_.ConsumeBytes(nbytes);
-    bytes -= nbytes;
-    buffer += nbytes;
+    ConsumeWriteQueue(nbytes);
     DLOG_INFO << "Write " << nbytes << " bytes to " << *peer_addr_;
+    if (static_cast<size_t>(nbytes) < bytes) {
+      // 没写完说明内核缓冲区已经满了, 省掉一次返回EAGAIN的writev
+      return false;
+    }
   }
+  return true;
+}
 
-  if (bytes == 0) {
-    channel_->DisableWriting();
-    if (write_done_callback_) {
-      write_done_callback_(shared_from_this());
+bool TcpConnection::FlushFileChunk() {
+  auto& chunk = write_queue_.front();
+  off_t offset = chunk.offset;
+  ssize_t nbytes = ::sendfile(fd_, chunk.file_fd, &offset, chunk.size);
+  if (nbytes == -1) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      PLOG_WARNING << "sendfile failed, bytes = " << chunk.size;
+    }
+    return false;
+  }
+  if (nbytes == 0) {
+    // 文件在发送期间被截短了, 对端收不全数据, 只能丢掉剩下的部分并关闭连接
+    LOG_WARNING << "sendfile reached end of file, bytes left = " << chunk.size;
+    ConsumeWriteQueue(chunk.size);
+    if (state_ == State::kConnected) {
+      Close();
     }
+    return true;
   }
+  const bool done = static_cast<size_t>(nbytes) == chunk.size;
+  ConsumeWriteQueue(nbytes);
+  DLOG_INFO << "Send " << nbytes << " bytes of file to " << *peer_addr_;
+  // 没写完说明内核缓冲区已经满了
+  return done;
+}
+
+void TcpConnection::ConsumeWriteQueue(size_t bytes) {
+  DCHECK(bytes <= bytes_to_write_);
+  bytes_to_write_ -= bytes;
+  while (bytes) {
+    auto& chunk = write_queue_.front();
+    auto n = std::min(bytes, chunk.size);
+    if (chunk.file_fd != -1) {
+      chunk.offset += n;
+    } else if (chunk.owner) {
+      chunk.data += n;
+      owned_bytes_to_write_ -= n;
+    } else {
+      write_buffer_.ConsumeBytes(n);
+    }
+    chunk.size -= n;
+    bytes -= n;
+    if (chunk.size == 0) {
+      write_queue_.pop_front();
+    }
+  }
+}
+
+void TcpConnection::QueueWriteDone() {
+  // 直接写完时没有可写事件, 在下一轮循环里通知, 避免在Write里重入回调
+  if (!write_done_callback_ || write_done_queued_) {
+    return;
+  }
+  write_done_queued_ = true;
+  TcpConnectionWeakPtr weak_conn(shared_from_this());
+  loop_->QueueInLoop([weak_conn] {
+    auto conn = weak_conn.lock();
+    if (conn) {
+      conn->write_done_queued_ = false;
+      // 还有数据没写完的话WriteToPeer会负责通知
+      if (conn->write_queue_.empty() && conn->write_done_callback_) {
+        auto cb = conn->write_done_callback_;
+        cb(conn);
+      }
+    }
+  });
 }
 
 void TcpConnection::HandleError() {
@@ -169,7 +455,9 @@ void TcpConnection::HandleError() {
 }
 
 size_t TcpConnection::BytesCanWrite() const {
-  return write_buffer_.SpaceBeforeFull();
+  // 所有权转交进来的数据同样占用发送缓冲区的额度
+  auto space = write_buffer_.SpaceBeforeFull();
+  return space > owned_bytes_to_write_ ? space - owned_bytes_to_write_ : 0;
 }
 
 void TcpConnection::SetPeerAddr(const alpha::NetAddress& addr) {
@@ -177,10 +465,15 @@ void TcpConnection::SetPeerAddr(const alpha::NetAddress& addr) {
   peer_addr_.reset(new NetAddress(addr));
 }
 
-void TcpConnection::Init() {
+bool TcpConnection::edge_triggered() const {
+  return channel_->edge_triggered();
+}
+
+void TcpConnection::Init(bool edge_triggered) {
   channel_->set_read_callback(std::bind(&TcpConnection::ReadFromPeer, this));
   channel_->set_write_callback(std::bind(&TcpConnection::WriteToPeer, this));
   channel_->set_error_callback(std::bind(&TcpConnection::HandleError, this));
+  channel_->set_edge_triggered(edge_triggered);
   channel_->EnableReading();
   // Try to get both sides address
   NetAddress addr;
@@ -13,6 +13,8 @@
 #pragma once
 
 #include <alpha/Slice.h>
+#include <sys/types.h>
+#include <deque>
 #include <memory>
 #include <functional>
 #include <boost/any.hpp>
@@ -41,12 +43,26 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   using ConnectErrorCallback = std::function<void(TcpConnectionPtr)>;
   using WriteDoneCallback = std::function<void(TcpConnectionPtr)>;
 
-  TcpConnection(EventLoop* loop, int fd, State state);
+  // edge_triggered为true时每次可读都会读到EAGAIN为止(有次数上限)
+  TcpConnection(EventLoop* loop,
+                int fd,
+                State state,
+                bool edge_triggered = false);
   ~TcpConnection();
   DISABLE_COPY_ASSIGNMENT(TcpConnection);
 
+  // 发送队列为空时会先直接write, 写不完的部分才进入队列等待可写事件
   bool Write(const void* data, size_t size);
   bool Write(const Slice& data);
+  bool Write(const char* data);
+  // 以下两个接口接管数据的所有权, 数据在写出之前不会被拷贝
+  // owner可以是std::unique_ptr(包括NetSvrdFrame::UniquePtr)或std::shared_ptr
+  bool Write(std::string&& data);
+  bool Write(const Slice& data, std::shared_ptr<const void> owner);
+  // 用sendfile(2)发送文件中[offset, offset + size)的内容, 数据不经过用户态
+  // 内部会dup一份fd, 返回之后调用者可以立即关闭自己的fd
+  // 文件数据不占用发送缓冲区的额度, 范围超出文件大小时返回false
+  bool SendFile(int fd, off_t offset, size_t size);
   void Close();
 
   void SetOnRead(const ReadCallback& cb) { read_callback_ = cb; }
@@ -75,6 +91,7 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   int fd() const { return fd_; }
   EventLoop* loop() const { return loop_; }
   State state() const { return state_; }
+  bool edge_triggered() const;
 
   bool LocalAddr(NetAddress* addr);
   bool PeerAddr(NetAddress* addr);
@@ -84,18 +101,48 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   NetAddress PeerAddr();
 
   TcpConnectionBuffer* ReadBuffer() { return &read_buffer_; }
+  // 只包含拷贝进来的数据, 所有权转交进来的数据不在这里面
   TcpConnectionBuffer* WriteBuffer() { return &write_buffer_; }
   size_t BytesCanWrite() const;
+  size_t BytesToWrite() const { return bytes_to_write_; }
+  // 累计从对端收到的字节数
+  uint64_t BytesRead() const { return bytes_read_; }
   void SetPeerAddr(const NetAddress& addr);
 
  private:
+  enum class ReadResult { kRead, kDrained, kClosed, kError };
+  static const int kEdgeTriggeredReadBudget = 16;
+  // 小于这个大小的数据直接拷贝, 比单独占一个iovec更划算
+  static const size_t kMinOwnedWriteSize = 512;
+
+  // 发送队列中的一段数据, owner为空表示数据在write_buffer_中
+  // file_fd不为-1时是文件中从offset开始的数据, owner负责关闭file_fd
+  struct WriteChunk {
+    const char* data;
+    size_t size;
+    std::shared_ptr<const void> owner;
+    int file_fd;
+    off_t offset;
+  };
+
   void ReadFromPeer();
+  ReadResult ReadOnce();
   void WriteToPeer();
+  bool CheckWriteSize(size_t size);
+  size_t WriteDirectly(const char* data, size_t size);
+  size_t SendFileDirectly(int file_fd, off_t offset, size_t size);
+  void QueueWrite(const char* data,
+                  size_t size,
+                  std::shared_ptr<const void> owner);
+  bool FlushWriteQueue();
+  bool FlushFileChunk();
+  void ConsumeWriteQueue(size_t bytes);
+  void QueueWriteDone();
   void ConnectedToPeer();
   void HandleError();
 
   void InitConnected();
-  void Init();
+  void Init(bool edge_triggered);
   void CloseByPeer();
 
  private:
@@ -107,6 +154,11 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   std::unique_ptr<NetAddress> peer_addr_;
   TcpConnectionBuffer read_buffer_;
   TcpConnectionBuffer write_buffer_;
+  std::deque<WriteChunk> write_queue_;
+  size_t bytes_to_write_;
+  size_t owned_bytes_to_write_;
+  uint64_t bytes_read_;
+  bool write_done_queued_;
   ReadCallback read_callback_;
   CloseCallback close_callback_;
   ConnectErrorCallback connect_error_callback_;
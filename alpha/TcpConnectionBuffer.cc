@@ -12,65 +12,160 @@
 
 #include <alpha/TcpConnectionBuffer.h>
 #include <cstring>
+#include <algorithm>
 #include <alpha/Compiler.h>
 #include <alpha/Logger.h>
 
 namespace alpha {
 
-const size_t TcpConnectionBuffer::kDefaultBufferSize = 1 << 16;
+const size_t TcpConnectionBufferPool::kDefaultMaxFreeChunks = 256;
+const size_t TcpConnectionBuffer::kChunkSize = 1 << 14;
+const size_t TcpConnectionBuffer::kDefaultBufferSize = 1 << 14;
 const size_t TcpConnectionBuffer::kMaxBufferSize = 1 << 20;
 
-TcpConnectionBuffer::TcpConnectionBuffer(size_t default_size)
-    : read_index_(0), write_index_(0), internal_buffer_(default_size) {
-  CHECK(default_size <= kMaxBufferSize);
+TcpConnectionBufferPool::TcpConnectionBufferPool(size_t max_free_chunks)
+    : max_free_chunks_(max_free_chunks) {}
+
+TcpConnectionBufferPool::~TcpConnectionBufferPool() {
+  for (auto chunk : free_chunks_) {
+    delete[] chunk;
+  }
 }
 
-TcpConnectionBuffer::~TcpConnectionBuffer() = default;
+char* TcpConnectionBufferPool::Allocate() {
+  if (free_chunks_.empty()) {
+    return new char[TcpConnectionBuffer::kChunkSize];
+  }
+  auto chunk = free_chunks_.back();
+  free_chunks_.pop_back();
+  return chunk;
+}
 
-size_t TcpConnectionBuffer::max_size() const { return kMaxBufferSize; }
+void TcpConnectionBufferPool::Deallocate(char* chunk) {
+  if (free_chunks_.size() < max_free_chunks_) {
+    free_chunks_.push_back(chunk);
+  } else {
+    delete[] chunk;
+  }
+}
+
+TcpConnectionBuffer::TcpConnectionBuffer(TcpConnectionBufferPool* pool,
+                                         size_t max_size)
+    : pool_(pool), max_size_(max_size), bytes_(0) {}
 
-size_t TcpConnectionBuffer::capacity() const { return internal_buffer_.size(); }
+TcpConnectionBuffer::~TcpConnectionBuffer() { FreeAllChunks(); }
+
+size_t TcpConnectionBuffer::capacity() const {
+  size_t capacity = 0;
+  for (const auto& chunk : chunks_) {
+    capacity += chunk.capacity;
+  }
+  return capacity;
+}
 
 size_t TcpConnectionBuffer::GetContiguousSpace() const {
-  CheckIndex();
-  return capacity() - write_index_;
+  auto i = WriteChunkIndex();
+  if (i == chunks_.size()) {
+    return 0;
+  }
+  return std::min(chunks_[i].capacity - chunks_[i].end, SpaceBeforeFull());
 }
 
 char* TcpConnectionBuffer::WriteBegin() {
-  CheckIndex();
-  return &internal_buffer_[write_index_];
+  auto i = WriteChunkIndex();
+  return i == chunks_.size() ? nullptr : chunks_[i].data + chunks_[i].end;
 }
 
 bool TcpConnectionBuffer::AddBytes(size_t n) {
-  if (write_index_ + n > internal_buffer_.size()) {
+  if (n > SpaceBeforeFull()) {
     return false;
-  };
-  write_index_ += n;
+  }
+  auto first = WriteChunkIndex();
+  size_t space = 0;
+  for (auto i = first; i < chunks_.size(); ++i) {
+    space += chunks_[i].capacity - chunks_[i].end;
+  }
+  if (n > space) {
+    return false;
+  }
+  bytes_ += n;
+  for (auto i = first; n != 0; ++i) {
+    auto& chunk = chunks_[i];
+    auto len = std::min(n, chunk.capacity - chunk.end);
+    chunk.end += len;
+    n -= len;
+  }
+  // PrepareWrite多预留的chunk还回去
+  ReleaseEmptyTail();
   CheckIndex();
   return true;
 }
 
+bool TcpConnectionBuffer::EnsureSpace(size_t n) {
+  if (unlikely(n > SpaceBeforeFull())) {
+    return false;
+  }
+  ReleaseEmptyTail();
+  auto i = WriteChunkIndex();
+  if (i != chunks_.size()) {
+    if (chunks_[i].capacity - chunks_[i].end >= n) {
+      return true;
+    }
+    // 剩下的空间不够连续写n字节, 直接废弃掉
+    chunks_[i].capacity = chunks_[i].end;
+  }
+  chunks_.push_back(NewChunk(n));
+  return true;
+}
+
+int TcpConnectionBuffer::PrepareWrite(size_t n, iovec* iov, int iovcnt) {
+  n = std::min(n, SpaceBeforeFull());
+  int count = 0;
+  size_t reserved = 0;
+  auto i = WriteChunkIndex();
+  while (reserved < n && count < iovcnt) {
+    if (i == chunks_.size()) {
+      chunks_.push_back(NewChunk(kChunkSize));
+    }
+    auto& chunk = chunks_[i++];
+    auto len = std::min(chunk.capacity - chunk.end, n - reserved);
+    iov[count].iov_base = chunk.data + chunk.end;
+    iov[count].iov_len = len;
+    ++count;
+    reserved += len;
+  }
+  return count;
+}
+
 bool TcpConnectionBuffer::Append(alpha::Slice s) {
   return Append(s.data(), s.size());
 }
 
 bool TcpConnectionBuffer::Append(const void* data, size_t size) {
-  if (unlikely(!EnsureSpace(size))) {
+  if (unlikely(size > SpaceBeforeFull())) {
     return false;
   }
-  DCHECK(GetContiguousSpace() >= size);
-  ::memcpy(WriteBegin(), data, size);
-  AddBytes(size);
+  auto p = static_cast<const char*>(data);
+  auto i = WriteChunkIndex();
+  bytes_ += size;
+  while (size != 0) {
+    if (i == chunks_.size()) {
+      chunks_.push_back(NewChunk(kChunkSize));
+    }
+    auto& chunk = chunks_[i++];
+    auto len = std::min(chunk.capacity - chunk.end, size);
+    ::memcpy(chunk.data + chunk.end, p, len);
+    chunk.end += len;
+    p += len;
+    size -= len;
+  }
+  ReleaseEmptyTail();
+  CheckIndex();
   return true;
 }
 
 size_t TcpConnectionBuffer::SpaceBeforeFull() const {
-  return kMaxBufferSize - internal_buffer_.size() + GetContiguousSpace();
-}
-
-size_t TcpConnectionBuffer::BytesToRead() const {
-  CheckIndex();
-  return write_index_ - read_index_;
+  return bytes_ < max_size_ ? max_size_ - bytes_ : 0;
 }
 
 char* TcpConnectionBuffer::Read(size_t* length) {
@@ -79,54 +174,143 @@ char* TcpConnectionBuffer::Read(size_t* length) {
 }
 
 const char* TcpConnectionBuffer::Read(size_t* length) const {
-  CheckIndex();
-  *length = BytesToRead();
-  return *length ? &internal_buffer_[read_index_] : nullptr;
+  Linearize();
+  *length = bytes_;
+  return bytes_ ? chunks_[0].data + chunks_[0].begin : nullptr;
 }
 
 alpha::Slice TcpConnectionBuffer::Read() const {
-  CheckIndex();
-  return alpha::Slice(&internal_buffer_[read_index_],
-                      write_index_ - read_index_);
+  size_t length;
+  auto p = Read(&length);
+  return alpha::Slice(p, length);
+}
+
+int TcpConnectionBuffer::Read(iovec* iov, int iovcnt) const {
+  int count = 0;
+  for (auto it = chunks_.begin(); it != chunks_.end() && count < iovcnt;
+       ++it) {
+    if (it->end != it->begin) {
+      iov[count].iov_base = it->data + it->begin;
+      iov[count].iov_len = it->end - it->begin;
+      ++count;
+    }
+  }
+  return count;
 }
 
 size_t TcpConnectionBuffer::ReadAndClear(void* buf, size_t len) {
-  size_t length;
-  auto p = Read(&length);
-  size_t n = std::min(len, length);
-  ::memcpy(buf, p, n);
+  auto p = static_cast<char*>(buf);
+  size_t n = std::min(len, bytes_);
+  size_t copied = 0;
+  for (auto it = chunks_.begin(); copied != n; ++it) {
+    auto sz = std::min(it->end - it->begin, n - copied);
+    ::memcpy(p + copied, it->data + it->begin, sz);
+    copied += sz;
+  }
   ConsumeBytes(n);
   return n;
 }
 
 void TcpConnectionBuffer::ConsumeBytes(size_t n) {
-  read_index_ += n;
+  CHECK(n <= bytes_);
+  bytes_ -= n;
+  if (bytes_ == 0) {
+    // 读空了就把内存还回去
+    FreeAllChunks();
+    return;
+  }
+  auto it = chunks_.begin();
+  while (n != 0) {
+    auto len = std::min(n, it->end - it->begin);
+    it->begin += len;
+    n -= len;
+    if (it->begin == it->end) {
+      FreeChunk(*it);
+      ++it;
+    }
+  }
+  chunks_.erase(chunks_.begin(), it);
   CheckIndex();
-  if (read_index_ == write_index_) {
-    read_index_ = write_index_ = 0;  //重置位置
+}
+
+TcpConnectionBuffer::Chunk TcpConnectionBuffer::NewChunk(size_t size) const {
+  Chunk chunk;
+  chunk.begin = chunk.end = 0;
+  if (size <= kChunkSize) {
+    chunk.capacity = kChunkSize;
+    chunk.pooled = pool_ != nullptr;
+    chunk.data = pool_ ? pool_->Allocate() : new char[kChunkSize];
+  } else {
+    chunk.capacity = size;
+    chunk.pooled = false;
+    chunk.data = new char[size];
   }
+  return chunk;
 }
 
-bool TcpConnectionBuffer::EnsureSpace(size_t n) {
-  if (unlikely(n > kMaxBufferSize)) {
-    return false;
+void TcpConnectionBuffer::FreeChunk(const Chunk& chunk) const {
+  if (chunk.pooled) {
+    pool_->Deallocate(chunk.data);
+  } else {
+    delete[] chunk.data;
   }
+}
 
-  size_t space_left = GetContiguousSpace();
-  if (space_left < n) {
-    size_t space_more = (n - space_left) * 2;
-    auto new_size =
-        std::min(kMaxBufferSize, internal_buffer_.size() + space_more);
-    if (unlikely(new_size - internal_buffer_.size() + space_left < n)) {
-      return false;
-    }
-    internal_buffer_.resize(new_size);
+void TcpConnectionBuffer::FreeAllChunks() const {
+  for (const auto& chunk : chunks_) {
+    FreeChunk(chunk);
   }
-  return true;
+  chunks_.clear();
+}
+
+size_t TcpConnectionBuffer::WriteChunkIndex() const {
+  // 写位置之前的chunk都是满的, 之后的chunk都是空的
+  auto i = chunks_.size();
+  while (i != 0 && chunks_[i - 1].end == 0) {
+    --i;
+  }
+  if (i != 0 && chunks_[i - 1].end < chunks_[i - 1].capacity) {
+    --i;
+  }
+  return i;
+}
+
+void TcpConnectionBuffer::ReleaseEmptyTail() {
+  while (!chunks_.empty() && chunks_.back().end == 0) {
+    FreeChunk(chunks_.back());
+    chunks_.pop_back();
+  }
+}
+
+void TcpConnectionBuffer::Linearize() const {
+  size_t data_chunks = 0;
+  for (const auto& chunk : chunks_) {
+    data_chunks += chunk.end != chunk.begin;
+  }
+  if (data_chunks <= 1) {
+    return;
+  }
+  // 多留一倍的空间, 后续的数据大概率能直接写进来, 避免反复合并
+  auto size = std::max(kChunkSize, std::min(bytes_ * 2, max_size_));
+  auto merged = NewChunk(std::max(size, bytes_));
+  for (const auto& chunk : chunks_) {
+    auto len = chunk.end - chunk.begin;
+    ::memcpy(merged.data + merged.end, chunk.data + chunk.begin, len);
+    merged.end += len;
+  }
+  FreeAllChunks();
+  chunks_.push_back(merged);
+  CheckIndex();
 }
 
 void TcpConnectionBuffer::CheckIndex() const {
-  CHECK(read_index_ <= write_index_);
-  CHECK(write_index_ <= internal_buffer_.size());
+  size_t bytes = 0;
+  for (const auto& chunk : chunks_) {
+    DCHECK(chunk.begin <= chunk.end);
+    DCHECK(chunk.end <= chunk.capacity);
+    bytes += chunk.end - chunk.begin;
+  }
+  DCHECK(bytes == bytes_);
+  (void)bytes;
 }
 }
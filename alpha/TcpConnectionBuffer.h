@@ -12,43 +12,92 @@
 
 #pragma once
 
+#include <sys/uio.h>
 #include <vector>
+#include <alpha/Compiler.h>
 #include <alpha/Slice.h>
 
 namespace alpha {
+// 固定大小的chunk池, 每个EventLoop一个, 非线程安全
+class TcpConnectionBufferPool final {
+ public:
+  static const size_t kDefaultMaxFreeChunks;
+
+  explicit TcpConnectionBufferPool(
+      size_t max_free_chunks = kDefaultMaxFreeChunks);
+  ~TcpConnectionBufferPool();
+  DISABLE_COPY_ASSIGNMENT(TcpConnectionBufferPool);
+
+  char* Allocate();
+  void Deallocate(char* chunk);
+  size_t free_chunks() const { return free_chunks_.size(); }
+
+ private:
+  const size_t max_free_chunks_;
+  std::vector<char*> free_chunks_;
+};
+
+// 由若干chunk组成, 第一次写入时才分配内存, 读空后chunk立即还给pool
 class TcpConnectionBuffer final {
  public:
+  static const size_t kChunkSize;
+  // 兼容旧代码, 等于kChunkSize
   static const size_t kDefaultBufferSize;
+  // 默认的单个连接缓冲区上限
   static const size_t kMaxBufferSize;
 
-  TcpConnectionBuffer(size_t default_size = kDefaultBufferSize);
+  explicit TcpConnectionBuffer(TcpConnectionBufferPool* pool = nullptr,
+                               size_t max_size = kMaxBufferSize);
   ~TcpConnectionBuffer();
+  DISABLE_COPY_ASSIGNMENT(TcpConnectionBuffer);
 
-  size_t max_size() const;
+  size_t max_size() const { return max_size_; }
+  void set_max_size(size_t max_size) { max_size_ = max_size; }
   size_t capacity() const;
 
-  //不触发扩容的写
+  //不触发扩容的写, 没有分配过chunk时GetContiguousSpace为0
   size_t GetContiguousSpace() const;
   char* WriteBegin();
   bool AddBytes(size_t n);
   bool EnsureSpace(size_t n);
+  // 预留至多n字节的可写空间(可以跨chunk), 返回iovec个数, 之后用AddBytes提交
+  int PrepareWrite(size_t n, iovec* iov, int iovcnt);
 
-  //写入(可能会扩容, 超限返回false)
+  //写入(可能会分配新的chunk, 超限返回false)
   bool Append(alpha::Slice s);
   bool Append(const void* data, size_t size);
   size_t SpaceBeforeFull() const;
 
-  size_t BytesToRead() const;
+  size_t BytesToRead() const { return bytes_; }
+  // 数据跨chunk时会先合并成连续的内存
   char* Read(size_t* length);
   const char* Read(size_t* length) const;
   alpha::Slice Read() const;
+  // 不合并, 按chunk返回数据, 返回iovec个数
+  int Read(iovec* iov, int iovcnt) const;
   size_t ReadAndClear(void* buf, size_t len);
   void ConsumeBytes(size_t len);
 
  private:
+  struct Chunk {
+    char* data;
+    size_t capacity;
+    size_t begin;  // 读位置
+    size_t end;    // 写位置
+    bool pooled;
+  };
+  Chunk NewChunk(size_t size) const;
+  void FreeChunk(const Chunk& chunk) const;
+  void FreeAllChunks() const;
+  size_t WriteChunkIndex() const;
+  void ReleaseEmptyTail();
+  void Linearize() const;
   void CheckIndex() const;
-  size_t read_index_;
-  size_t write_index_;
-  std::vector<char> internal_buffer_;
+
+  TcpConnectionBufferPool* pool_;
+  size_t max_size_;
+  size_t bytes_;
+  // Read()需要合并chunk, 逻辑上并不改变内容
+  mutable std::vector<Chunk> chunks_;
 };
 }
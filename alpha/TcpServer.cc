@@ -12,53 +12,143 @@
 
 #include <alpha/TcpServer.h>
 #include <cassert>
+#include <algorithm>
 #include <alpha/Logger.h>
 #include <alpha/Channel.h>
 #include <alpha/NetAddress.h>
 #include <alpha/EventLoop.h>
+#include <alpha/EventLoopThreadPool.h>
 #include <alpha/TcpAcceptor.h>
 
 namespace alpha {
+TcpServer::LoopContext::LoopContext(EventLoop* loop)
+    : loop(loop), num_connections(0) {}
+
+TcpServer::LoopContext::~LoopContext() = default;
+
 TcpServer::TcpServer(EventLoop* loop, const NetAddress& addr)
-    : loop_(loop), listening_address_(addr) {
+    : loop_(loop),
+      listening_address_(addr),
+      pool_(nullptr),
+      dispatch_(Dispatch::kRoundRobin),
+      edge_triggered_(false),
+      next_loop_(0) {
   assert(loop_);
 }
 
-TcpServer::~TcpServer() = default;
+TcpServer::~TcpServer() {
+  if (pool_) {
+    // 先让工作线程退出, 之后才能安全地销毁属于它们的连接
+    pool_->Stop();
+  }
+}
+
+void TcpServer::SetThreadPool(EventLoopThreadPool* pool, Dispatch dispatch) {
+  CHECK(loops_.empty()) << "SetThreadPool must be called before Run";
+  CHECK(pool->base_loop() == loop_) << "Mismatch base loop";
+  pool_ = pool;
+  dispatch_ = dispatch;
+}
 
 bool TcpServer::Run() {
   using namespace std::placeholders;
-  acceptor_.reset(new TcpAcceptor(loop_));
-  acceptor_->SetOnNewConnection(
-      std::bind(&TcpServer::OnNewConnection, this, _1));
-  if (!acceptor_->Bind(listening_address_)) {
-    return false;
+  CHECK(loops_.empty()) << "TcpServer already running";
+  std::vector<EventLoop*> loops(1, loop_);
+  if (pool_) {
+    loops = pool_->GetAllLoops();
+  }
+  for (auto loop : loops) {
+    loops_.emplace_back(new LoopContext(loop));
+  }
+
+  // 全部Bind成功之后才开始Listen, 失败时销毁已经创建的acceptor, 可以再次Run
+  if (pool_ && dispatch_ == Dispatch::kReusePort) {
+    for (auto& ctx : loops_) {
+      ctx->acceptor.reset(new TcpAcceptor(ctx->loop));
+      ctx->acceptor->set_edge_triggered(edge_triggered_);
+      ctx->acceptor->SetOnNewConnection(
+          std::bind(&TcpServer::OnNewConnection, this, ctx.get(), _1));
+      if (!ctx->acceptor->Bind(listening_address_, true)) {
+        loops_.clear();
+        return false;
+      }
+    }
+    for (auto& ctx : loops_) {
+      ctx->loop->QueueInLoop(
+          std::bind(&TcpAcceptor::Listen, ctx->acceptor.get()));
+    }
   } else {
+    acceptor_.reset(new TcpAcceptor(loop_));
+    acceptor_->set_edge_triggered(edge_triggered_);
+    acceptor_->SetOnNewConnection(
+        std::bind(&TcpServer::OnNewConnection, this, nullptr, _1));
+    if (!acceptor_->Bind(listening_address_)) {
+      acceptor_.reset();
+      loops_.clear();
+      return false;
+    }
     loop_->QueueInLoop(std::bind(&TcpAcceptor::Listen, acceptor_.get()));
-    return true;
+  }
+
+  if (pool_ && !pool_->started()) {
+    pool_->Start();
+  }
+  return true;
+}
+
+TcpServer::LoopContext* TcpServer::SelectLoop() {
+  if (dispatch_ == Dispatch::kLeastConnections) {
+    auto it = std::min_element(
+        loops_.begin(),
+        loops_.end(),
+        [](const std::unique_ptr<LoopContext>& lhs,
+           const std::unique_ptr<LoopContext>& rhs) {
+          return lhs->num_connections < rhs->num_connections;
+        });
+    return it->get();
+  }
+  LoopContext* ctx = loops_[next_loop_].get();
+  next_loop_ = (next_loop_ + 1) % loops_.size();
+  return ctx;
+}
+
+void TcpServer::OnNewConnection(LoopContext* ctx, int fd) {
+  // ctx为空说明是base loop上的acceptor, 否则就是ctx自己的acceptor
+  bool in_loop = ctx != nullptr;
+  if (!in_loop) {
+    ctx = SelectLoop();
+    in_loop = ctx->loop == loop_;
+  }
+  ++ctx->num_connections;
+  if (in_loop) {
+    NewConnectionInLoop(ctx, fd);
+  } else {
+    ctx->loop->QueueInLoop(
+        std::bind(&TcpServer::NewConnectionInLoop, this, ctx, fd));
   }
 }
 
-void TcpServer::OnNewConnection(int fd) {
+void TcpServer::NewConnectionInLoop(LoopContext* ctx, int fd) {
   using namespace std::placeholders;
   TcpConnectionPtr conn = std::make_shared<TcpConnection>(
-      loop_, fd, TcpConnection::State::kConnected);
+      ctx->loop, fd, TcpConnection::State::kConnected, edge_triggered_);
   conn->SetOnRead(read_callback_);
-  conn->SetOnClose(std::bind(&TcpServer::OnConnectionClose, this, _1));
-  assert(connections_.find(fd) == connections_.end());
+  conn->SetOnClose(std::bind(&TcpServer::OnConnectionClose, this, ctx, _1));
+  assert(ctx->connections.find(fd) == ctx->connections.end());
 
-  connections_.emplace(fd, conn);
+  ctx->connections.emplace(fd, conn);
   DLOG_INFO << "New Connection, client addr = " << conn->PeerAddr();
   if (new_connection_callback_) {
     new_connection_callback_(conn);
   }
 }
 
-void TcpServer::OnConnectionClose(int fd) {
-  auto it = connections_.find(fd);
-  assert(it != connections_.end());
+void TcpServer::OnConnectionClose(LoopContext* ctx, int fd) {
+  auto it = ctx->connections.find(fd);
+  assert(it != ctx->connections.end());
   TcpConnectionPtr conn = it->second;
-  connections_.erase(it);
+  ctx->connections.erase(it);
+  --ctx->num_connections;
 
   DLOG_INFO << "Remove connection, peer_addr = " << conn->PeerAddr();
   if (close_callback_) {
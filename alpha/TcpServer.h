@@ -13,6 +13,8 @@
 #pragma once
 
 #include <map>
+#include <atomic>
+#include <vector>
 #include <memory>
 #include <functional>
 #include <alpha/Compiler.h>
@@ -23,6 +25,7 @@ class NetAddress;
 class TcpConnectionBuffer;
 class TcpAcceptor;
 class EventLoop;
+class EventLoopThreadPool;
 
 class TcpServer {
  public:
@@ -30,12 +33,24 @@ class TcpServer {
       std::function<void(TcpConnectionPtr, TcpConnectionBuffer*)>;
   using CloseCallback = std::function<void(TcpConnectionPtr)>;
   using NewConnectionCallback = std::function<void(TcpConnectionPtr)>;
+  // 使用线程池时新连接的分配方式
+  enum class Dispatch {
+    kRoundRobin = 0,        // base loop accept, 轮流交给工作线程
+    kLeastConnections = 1,  // base loop accept, 交给连接数最少的工作线程
+    kReusePort = 2          // 每个工作线程一个SO_REUSEPORT acceptor
+  };
 
  public:
   TcpServer(EventLoop* loop, const NetAddress& addr);
   ~TcpServer();
   DISABLE_COPY_ASSIGNMENT(TcpServer);
 
+  // 在Run之前调用, 所有回调都在连接所属的loop线程中执行.
+  // TcpServer析构时会先停止线程池
+  void SetThreadPool(EventLoopThreadPool* pool,
+                     Dispatch dispatch = Dispatch::kRoundRobin);
+  // 在Run之前调用, acceptor和新连接都使用边缘触发
+  void set_edge_triggered(bool enable) { edge_triggered_ = enable; }
   bool Run();
   void SetOnRead(const ReadCallback& cb) { read_callback_ = cb; }
   void SetOnClose(const CloseCallback& cb) { close_callback_ = cb; }
@@ -46,16 +61,32 @@ class TcpServer {
   const NetAddress& listening_address() const { return listening_address_; }
 
  private:
-  void OnNewConnection(int fd);
-  void OnConnectionClose(int fd);
   using TcpConnectionMap = std::map<int, TcpConnectionPtr>;
+  // 每个loop一份, 除了num_connections都只在对应的loop线程中访问
+  struct LoopContext {
+    explicit LoopContext(EventLoop* loop);
+    ~LoopContext();
+    EventLoop* loop;
+    std::unique_ptr<TcpAcceptor> acceptor;
+    TcpConnectionMap connections;
+    std::atomic<int> num_connections;
+  };
+
+  LoopContext* SelectLoop();
+  void OnNewConnection(LoopContext* ctx, int fd);
+  void NewConnectionInLoop(LoopContext* ctx, int fd);
+  void OnConnectionClose(LoopContext* ctx, int fd);
 
   EventLoop* loop_;
   NetAddress listening_address_;
+  EventLoopThreadPool* pool_;
+  Dispatch dispatch_;
+  bool edge_triggered_;
+  size_t next_loop_;
   std::unique_ptr<TcpAcceptor> acceptor_;
   ReadCallback read_callback_;
   CloseCallback close_callback_;
   NewConnectionCallback new_connection_callback_;
-  TcpConnectionMap connections_;
+  std::vector<std::unique_ptr<LoopContext>> loops_;
 };
 }
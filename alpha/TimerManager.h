@@ -23,18 +23,28 @@ class TimerManager {
   using TimerId = uint64_t;
   using TimerFunctor = std::function<void(void)>;
   using TimerFunctorList = std::vector<TimerFunctor>;
+  // kTree keeps timers in a balanced tree, kTimingWheel uses a hierarchical
+  // timing wheel with O(1) add/remove and pooled timer nodes
+  enum class Backend { kTree = 0, kTimingWheel = 1 };
 
-  TimerManager();
+  explicit TimerManager(Backend backend = Backend::kTree);
   ~TimerManager();
   TimerId AddTimer(alpha::TimeStamp expire_time, TimerFunctor functor);
   TimerId AddPeriodicalTimer(alpha::TimeStamp expire_time,
                              uint32_t interval_ms,
                              TimerFunctor functor);
   void RemoveTimer(TimerId timer);
+  // Returns copies of all expired functors, caller runs them
   TimerFunctorList Step(alpha::TimeStamp now);
+  // Runs all expired functors in place, returns number of functors called
+  size_t Fire(alpha::TimeStamp now);
   bool Expired(TimerId timer) const;
+  Backend backend() const { return backend_; }
 
  private:
+  class TreeImpl;
+  class WheelImpl;
+  Backend backend_;
   class Impl;
   std::unique_ptr<Impl> impl_;
 };
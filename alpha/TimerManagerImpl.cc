@@ -21,16 +21,32 @@
 namespace alpha {
 class TimerManager::Impl {
  public:
-  Impl() = default;
-  ~Impl() = default;
+  virtual ~Impl() = default;
 
-  TimerId AddTimer(alpha::TimeStamp expire_time, TimerFunctor functor);
+  virtual TimerId AddTimer(alpha::TimeStamp expire_time,
+                           TimerFunctor functor) = 0;
+  virtual TimerId AddPeriodicalTimer(alpha::TimeStamp expire_time,
+                                     uint32_t interval_ms,
+                                     TimerFunctor functor) = 0;
+  virtual void RemoveTimer(TimerId timer) = 0;
+  virtual TimerFunctorList Step(alpha::TimeStamp now) = 0;
+  virtual size_t Fire(alpha::TimeStamp now) = 0;
+  virtual bool Expired(TimerId timer) const = 0;
+};
+
+class TimerManager::TreeImpl final : public TimerManager::Impl {
+ public:
+  TreeImpl() = default;
+  ~TreeImpl() = default;
+
+  TimerId AddTimer(alpha::TimeStamp expire_time, TimerFunctor functor) override;
   TimerId AddPeriodicalTimer(alpha::TimeStamp expire_time,
                              uint32_t interval_ms,
-                             TimerFunctor functor);
-  void RemoveTimer(TimerId timer);
-  TimerFunctorList Step(alpha::TimeStamp now);
-  bool Expired(TimerId timer) const;
+                             TimerFunctor functor) override;
+  void RemoveTimer(TimerId timer) override;
+  TimerFunctorList Step(alpha::TimeStamp now) override;
+  size_t Fire(alpha::TimeStamp now) override;
+  bool Expired(TimerId timer) const override;
 
  private:
   struct Timer {
@@ -41,7 +57,7 @@ class TimerManager::Impl {
     void UpdateExpireTime();
 
    private:
-    friend class Impl;
+    friend class TreeImpl;
     TimerId id_;
     alpha::TimeStamp expire_time_;
     uint32_t interval_ms_;
@@ -63,26 +79,29 @@ class TimerManager::Impl {
   ActiveTimerMap active_timers_;
 };
 
-TimerManager::Impl::Timer::Timer(TimerManager::TimerId id,
-                                 TimeStamp expire_time,
-                                 TimerManager::TimerFunctor functor)
-    : id_(id), expire_time_(expire_time), interval_ms_(0), functor_(functor) {}
+TimerManager::TreeImpl::Timer::Timer(TimerManager::TimerId id,
+                                     TimeStamp expire_time,
+                                     TimerManager::TimerFunctor functor)
+    : id_(id),
+      expire_time_(expire_time),
+      interval_ms_(0),
+      functor_(std::move(functor)) {}
 
-void TimerManager::Impl::Timer::SetPeridical(uint32_t interval_ms) {
+void TimerManager::TreeImpl::Timer::SetPeridical(uint32_t interval_ms) {
   interval_ms_ = interval_ms;
 }
 
-bool TimerManager::Impl::Timer::IsPeriodical() const {
+bool TimerManager::TreeImpl::Timer::IsPeriodical() const {
   return interval_ms_ != 0;
 }
 
-void TimerManager::Impl::Timer::UpdateExpireTime() {
+void TimerManager::TreeImpl::Timer::UpdateExpireTime() {
   assert(IsPeriodical());
   expire_time_ += interval_ms_;
 }
 
-bool TimerManager::Impl::TimerEntryCompare::operator()(const TimerEntry& lhs,
-                                                       const TimerEntry& rhs) {
+bool TimerManager::TreeImpl::TimerEntryCompare::operator()(
+    const TimerEntry& lhs, const TimerEntry& rhs) {
   if (lhs.first == rhs.first) {
     return reinterpret_cast<uintptr_t>(lhs.second) <
            reinterpret_cast<uintptr_t>(rhs.second);
@@ -91,19 +110,19 @@ bool TimerManager::Impl::TimerEntryCompare::operator()(const TimerEntry& lhs,
   }
 }
 
-TimerManager::TimerId TimerManager::Impl::AddTimer(alpha::TimeStamp expire_time,
-                                                   TimerFunctor functor) {
-  return Insert(expire_time, functor)->id_;
+TimerManager::TimerId TimerManager::TreeImpl::AddTimer(
+    alpha::TimeStamp expire_time, TimerFunctor functor) {
+  return Insert(expire_time, std::move(functor))->id_;
 }
 
-TimerManager::TimerId TimerManager::Impl::AddPeriodicalTimer(
+TimerManager::TimerId TimerManager::TreeImpl::AddPeriodicalTimer(
     alpha::TimeStamp expire_time, uint32_t interval_ms, TimerFunctor f) {
-  Timer* timer = Insert(expire_time, f);
+  Timer* timer = Insert(expire_time, std::move(f));
   timer->SetPeridical(interval_ms);
   return timer->id_;
 }
 
-void TimerManager::Impl::RemoveTimer(TimerId id) {
+void TimerManager::TreeImpl::RemoveTimer(TimerId id) {
   auto active = active_timers_.find(id);
   if (active == active_timers_.end()) {
     //已经触发了
@@ -117,7 +136,8 @@ void TimerManager::Impl::RemoveTimer(TimerId id) {
   active_timers_.erase(active);
 }
 
-TimerManager::TimerFunctorList TimerManager::Impl::Step(alpha::TimeStamp now) {
+TimerManager::TimerFunctorList TimerManager::TreeImpl::Step(
+    alpha::TimeStamp now) {
   TimerFunctorList functors;
   Timer* max_timer_ptr =
       reinterpret_cast<Timer*>(std::numeric_limits<uintptr_t>::max());
@@ -144,10 +164,22 @@ TimerManager::TimerFunctorList TimerManager::Impl::Step(alpha::TimeStamp now) {
   return functors;
 }
 
-TimerManager::Impl::Timer* TimerManager::Impl::Insert(
+size_t TimerManager::TreeImpl::Fire(alpha::TimeStamp now) {
+  auto functors = Step(now);
+  std::for_each(functors.begin(), functors.end(), [](const TimerFunctor& f) {
+    f();
+  });
+  return functors.size();
+}
+
+bool TimerManager::TreeImpl::Expired(TimerId id) const {
+  return active_timers_.find(id) == active_timers_.end();
+}
+
+TimerManager::TreeImpl::Timer* TimerManager::TreeImpl::Insert(
     alpha::TimeStamp expire_time, TimerFunctor f) {
   TimerId id = ++current_;
-  TimerPtr timer(new Timer(id, expire_time, f));
+  TimerPtr timer(new Timer(id, expire_time, std::move(f)));
   Timer* p = timer.get();
   TimerEntry entry = std::make_pair(expire_time, timer.get());
   timers_.emplace(entry);
@@ -155,22 +187,345 @@ TimerManager::Impl::Timer* TimerManager::Impl::Insert(
   return p;
 }
 
-TimerManager::TimerManager() : impl_(new Impl) {}
+// 分层时间轮, 精度为1ms, 第一层256个槽, 之后每层64个槽, 共覆盖2^32ms
+// 定时器节点由池分配, 通过TimerId直接定位, 添加/删除都是O(1)
+class TimerManager::WheelImpl final : public TimerManager::Impl {
+ public:
+  WheelImpl();
+  ~WheelImpl();
 
-TimerManager::~TimerManager() = default;
+  TimerId AddTimer(alpha::TimeStamp expire_time, TimerFunctor functor) override;
+  TimerId AddPeriodicalTimer(alpha::TimeStamp expire_time,
+                             uint32_t interval_ms,
+                             TimerFunctor functor) override;
+  void RemoveTimer(TimerId timer) override;
+  TimerFunctorList Step(alpha::TimeStamp now) override;
+  size_t Fire(alpha::TimeStamp now) override;
+  bool Expired(TimerId timer) const override;
 
-bool TimerManager::Impl::Expired(TimerId id) const {
-  return active_timers_.find(id) == active_timers_.end();
+ private:
+  static const int kNearBits = 8;
+  static const int kLevelBits = 6;
+  static const int kLevels = 4;
+  static const uint32_t kNearSize = 1 << kNearBits;
+  static const uint32_t kLevelSize = 1 << kLevelBits;
+  static const uint32_t kNearMask = kNearSize - 1;
+  static const uint32_t kLevelMask = kLevelSize - 1;
+  static const uint32_t kSlotNum = kNearSize + kLevels * kLevelSize;
+  static const uint32_t kNodesPerChunk = 256;
+
+  struct Link {
+    Link* prev;
+    Link* next;
+  };
+
+  enum class NodeState : uint8_t { kFree, kPending, kRunning, kCancelled };
+
+  struct Node : Link {
+    uint32_t index;
+    uint32_t generation;
+    uint32_t interval_ms;
+    NodeState state;
+    uint8_t slot_level;
+    alpha::TimeStamp expire_time;
+    TimerFunctor functor;
+  };
+
+  static void ListInit(Link* head);
+  static bool ListEmpty(const Link* head);
+  static void ListAppend(Link* head, Link* link);
+  static void ListRemove(Link* link);
+  static void ListSplice(Link* from, Link* to);
+
+  TimerId Insert(alpha::TimeStamp expire_time,
+                 uint32_t interval_ms,
+                 TimerFunctor functor);
+  Node* AllocateNode();
+  void DeallocateNode(Node* node);
+  Node* FindNode(TimerId id) const;
+  void Schedule(Node* node);
+  void Unschedule(Node* node);
+  void Cascade(int level, uint32_t index);
+  template <typename Visitor>
+  size_t Advance(alpha::TimeStamp now, Visitor&& visitor);
+
+  alpha::TimeStamp current_;
+  uint32_t pending_;
+  uint32_t near_pending_;
+  Link slots_[kSlotNum];
+  Node* free_nodes_;
+  std::vector<std::unique_ptr<Node[]>> chunks_;
+};
+
+TimerManager::WheelImpl::WheelImpl()
+    : current_(alpha::Now()),
+      pending_(0),
+      near_pending_(0),
+      free_nodes_(nullptr) {
+  for (auto& slot : slots_) {
+    ListInit(&slot);
+  }
+}
+
+TimerManager::WheelImpl::~WheelImpl() = default;
+
+void TimerManager::WheelImpl::ListInit(Link* head) {
+  head->prev = head;
+  head->next = head;
+}
+
+bool TimerManager::WheelImpl::ListEmpty(const Link* head) {
+  return head->next == head;
+}
+
+void TimerManager::WheelImpl::ListAppend(Link* head, Link* link) {
+  link->prev = head->prev;
+  link->next = head;
+  head->prev->next = link;
+  head->prev = link;
 }
 
+void TimerManager::WheelImpl::ListRemove(Link* link) {
+  link->prev->next = link->next;
+  link->next->prev = link->prev;
+  link->prev = link->next = link;
+}
+
+void TimerManager::WheelImpl::ListSplice(Link* from, Link* to) {
+  ListInit(to);
+  if (!ListEmpty(from)) {
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    ListInit(from);
+  }
+}
+
+TimerManager::TimerId TimerManager::WheelImpl::AddTimer(
+    alpha::TimeStamp expire_time, TimerFunctor functor) {
+  return Insert(expire_time, 0, std::move(functor));
+}
+
+TimerManager::TimerId TimerManager::WheelImpl::AddPeriodicalTimer(
+    alpha::TimeStamp expire_time, uint32_t interval_ms, TimerFunctor f) {
+  return Insert(expire_time, interval_ms, std::move(f));
+}
+
+void TimerManager::WheelImpl::RemoveTimer(TimerId id) {
+  Node* node = FindNode(id);
+  if (node == nullptr) {
+    //已经触发了
+    return;
+  }
+  if (node->state == NodeState::kRunning) {
+    //正在执行, 执行完成后再释放
+    node->state = NodeState::kCancelled;
+    return;
+  }
+  assert(node->state == NodeState::kPending);
+  Unschedule(node);
+  DeallocateNode(node);
+}
+
+bool TimerManager::WheelImpl::Expired(TimerId id) const {
+  return FindNode(id) == nullptr;
+}
+
+TimerManager::TimerFunctorList TimerManager::WheelImpl::Step(
+    alpha::TimeStamp now) {
+  TimerFunctorList functors;
+  Advance(now, [&functors](Node* node) {
+    if (node->interval_ms) {
+      functors.push_back(node->functor);
+    } else {
+      functors.push_back(std::move(node->functor));
+    }
+  });
+  return functors;
+}
+
+size_t TimerManager::WheelImpl::Fire(alpha::TimeStamp now) {
+  return Advance(now, [](Node* node) { node->functor(); });
+}
+
+TimerManager::TimerId TimerManager::WheelImpl::Insert(
+    alpha::TimeStamp expire_time, uint32_t interval_ms, TimerFunctor f) {
+  Node* node = AllocateNode();
+  node->interval_ms = interval_ms;
+  node->expire_time = expire_time;
+  node->functor = std::move(f);
+  Schedule(node);
+  return (static_cast<TimerId>(node->generation) << 32) | node->index;
+}
+
+TimerManager::WheelImpl::Node* TimerManager::WheelImpl::AllocateNode() {
+  if (free_nodes_ == nullptr) {
+    std::unique_ptr<Node[]> chunk(new Node[kNodesPerChunk]);
+    uint32_t base = chunks_.size() * kNodesPerChunk;
+    for (uint32_t i = kNodesPerChunk; i != 0; --i) {
+      Node* node = &chunk[i - 1];
+      node->index = base + i - 1;
+      node->generation = 0;
+      node->state = NodeState::kFree;
+      node->next = free_nodes_;
+      free_nodes_ = node;
+    }
+    chunks_.push_back(std::move(chunk));
+  }
+  Node* node = free_nodes_;
+  free_nodes_ = static_cast<Node*>(node->next);
+  //保证TimerId不为0, 同一个节点复用后也不会和旧的TimerId冲突
+  if (++node->generation == 0) {
+    node->generation = 1;
+  }
+  node->state = NodeState::kPending;
+  ListInit(node);
+  return node;
+}
+
+void TimerManager::WheelImpl::DeallocateNode(Node* node) {
+  node->functor = nullptr;
+  node->state = NodeState::kFree;
+  node->next = free_nodes_;
+  free_nodes_ = node;
+}
+
+TimerManager::WheelImpl::Node* TimerManager::WheelImpl::FindNode(
+    TimerId id) const {
+  uint32_t index = id & std::numeric_limits<uint32_t>::max();
+  uint32_t generation = id >> 32;
+  if (index >= chunks_.size() * kNodesPerChunk) {
+    return nullptr;
+  }
+  Node* node = &chunks_[index / kNodesPerChunk][index % kNodesPerChunk];
+  if (node->generation != generation) {
+    return nullptr;
+  }
+  switch (node->state) {
+    case NodeState::kPending:
+      return node;
+    case NodeState::kRunning:
+      //和TreeImpl一致, 一次性定时器执行时已经算作过期
+      return node->interval_ms ? node : nullptr;
+    default:
+      return nullptr;
+  }
+}
+
+void TimerManager::WheelImpl::Schedule(Node* node) {
+  alpha::TimeStamp expire_time = std::max(node->expire_time, current_);
+  uint64_t delta = expire_time - current_;
+  Link* slot;
+  if (delta < kNearSize) {
+    node->slot_level = 0;
+    slot = &slots_[expire_time & kNearMask];
+    ++near_pending_;
+  } else {
+    const uint64_t kMaxDelta = std::numeric_limits<uint32_t>::max();
+    if (delta > kMaxDelta) {
+      //超出时间轮范围, 先挂到最高层, 转到时再重新计算
+      expire_time = current_ + kMaxDelta;
+      delta = kMaxDelta;
+    }
+    int level = 1;
+    while (level < kLevels &&
+           delta >= (1ull << (kNearBits + level * kLevelBits))) {
+      ++level;
+    }
+    uint32_t index =
+        (expire_time >> (kNearBits + (level - 1) * kLevelBits)) & kLevelMask;
+    node->slot_level = level;
+    slot = &slots_[kNearSize + (level - 1) * kLevelSize + index];
+  }
+  ListAppend(slot, node);
+  ++pending_;
+}
+
+void TimerManager::WheelImpl::Unschedule(Node* node) {
+  ListRemove(node);
+  --pending_;
+  if (node->slot_level == 0) {
+    --near_pending_;
+  }
+}
+
+void TimerManager::WheelImpl::Cascade(int level, uint32_t index) {
+  Link list;
+  ListSplice(&slots_[kNearSize + (level - 1) * kLevelSize + index], &list);
+  while (!ListEmpty(&list)) {
+    Node* node = static_cast<Node*>(list.next);
+    ListRemove(node);
+    --pending_;
+    Schedule(node);
+  }
+}
+
+template <typename Visitor>
+size_t TimerManager::WheelImpl::Advance(alpha::TimeStamp now,
+                                        Visitor&& visitor) {
+  size_t fired = 0;
+  Link expired;
+  while (current_ <= now) {
+    if (pending_ == 0) {
+      current_ = now + 1;
+      break;
+    }
+    alpha::TimeStamp tick = current_;
+    uint32_t index = tick & kNearMask;
+    if (index == 0) {
+      for (int level = 1; level <= kLevels; ++level) {
+        uint32_t i =
+            (tick >> (kNearBits + (level - 1) * kLevelBits)) & kLevelMask;
+        Cascade(level, i);
+        if (i != 0) {
+          break;
+        }
+      }
+    } else if (near_pending_ == 0) {
+      //第一层没有定时器, 直接跳到下一次需要降层的位置
+      current_ = std::min(now + 1, (tick | kNearMask) + 1);
+      continue;
+    }
+
+    ListSplice(&slots_[index], &expired);
+    current_ = tick + 1;
+    while (!ListEmpty(&expired)) {
+      Node* node = static_cast<Node*>(expired.next);
+      Unschedule(node);
+      node->state = NodeState::kRunning;
+      visitor(node);
+      ++fired;
+      if (node->interval_ms && node->state == NodeState::kRunning) {
+        node->state = NodeState::kPending;
+        node->expire_time += node->interval_ms;
+        Schedule(node);
+      } else {
+        DeallocateNode(node);
+      }
+    }
+  }
+  return fired;
+}
+
+TimerManager::TimerManager(Backend backend) : backend_(backend) {
+  if (backend == Backend::kTimingWheel) {
+    impl_.reset(new WheelImpl);
+  } else {
+    impl_.reset(new TreeImpl);
+  }
+}
+
+TimerManager::~TimerManager() = default;
+
 TimerManager::TimerId TimerManager::AddTimer(alpha::TimeStamp ts,
                                              TimerFunctor functor) {
-  return impl_->AddTimer(ts, functor);
+  return impl_->AddTimer(ts, std::move(functor));
 }
 
 TimerManager::TimerId TimerManager::AddPeriodicalTimer(
     alpha::TimeStamp expire_time, uint32_t interval_ms, TimerFunctor f) {
-  return impl_->AddPeriodicalTimer(expire_time, interval_ms, f);
+  return impl_->AddPeriodicalTimer(expire_time, interval_ms, std::move(f));
 }
 
 void TimerManager::RemoveTimer(TimerId id) { return impl_->RemoveTimer(id); }
@@ -179,5 +534,7 @@ TimerManager::TimerFunctorList TimerManager::Step(alpha::TimeStamp now) {
   return impl_->Step(now);
 }
 
+size_t TimerManager::Fire(alpha::TimeStamp now) { return impl_->Fire(now); }
+
 bool TimerManager::Expired(TimerId id) const { return impl_->Expired(id); }
 }
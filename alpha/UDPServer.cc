@@ -11,46 +11,197 @@
  */
 
 #include <alpha/UDPServer.h>
+#include <cerrno>
 #include <alpha/Logger.h>
 #include <alpha/Channel.h>
 #include <alpha/EventLoop.h>
+#include <alpha/EventLoopThreadPool.h>
 
 namespace alpha {
-UDPServer::UDPServer(EventLoop* loop) : loop_(loop) {}
+const int UDPServer::kDefaultBatchSize;
+const size_t UDPServer::kMaxDatagramSize;
 
-UDPServer::~UDPServer() = default;
+UDPServer::LoopContext::LoopContext(EventLoop* loop, size_t index)
+    : loop(loop), index(index) {}
+
+UDPServer::LoopContext::~LoopContext() = default;
+
+void UDPServer::ForwardedBatch::Append(const UDPDatagram& datagram) {
+  // buffer可能扩容, 先记下长度, 转发之前再设置data
+  buffer.insert(buffer.end(), datagram.data, datagram.data + datagram.len);
+  datagrams.push_back({nullptr, datagram.len, datagram.address});
+}
+
+UDPServer::UDPServer(EventLoop* loop)
+    : loop_(loop),
+      pool_(nullptr),
+      dispatch_to_base_loop_(false),
+      batch_size_(kDefaultBatchSize),
+      max_datagram_size_(kMaxDatagramSize) {}
+
+UDPServer::~UDPServer() {
+  if (pool_) {
+    // 先让工作线程退出, 之后才能安全地销毁属于它们的socket
+    pool_->Stop();
+  }
+}
+
+void UDPServer::SetThreadPool(EventLoopThreadPool* pool) {
+  CHECK(loops_.empty()) << "SetThreadPool must be called before Run";
+  CHECK(pool->base_loop() == loop_) << "Mismatch base loop";
+  pool_ = pool;
+}
+
+void UDPServer::set_batch_size(int batch_size) {
+  CHECK(loops_.empty()) << "Set batch size after Run";
+  CHECK(batch_size > 0 && batch_size <= UDPSocket::kMaxBatchSize)
+      << "Invalid batch size: " << batch_size;
+  batch_size_ = batch_size;
+}
+
+void UDPServer::set_max_datagram_size(size_t size) {
+  CHECK(loops_.empty()) << "Set max datagram size after Run";
+  CHECK(size > 0 && size <= kMaxDatagramSize) << "Invalid size: " << size;
+  max_datagram_size_ = size;
+}
 
 bool UDPServer::Run(const NetAddress& address) {
-  int err = socket_.Open();
+  CHECK(loops_.empty()) << "UDPServer already running";
+  std::vector<EventLoop*> loops(1, loop_);
+  if (pool_) {
+    loops = pool_->GetAllLoops();
+  }
+  // 全部Bind成功之后才开始读, 失败时关闭已经创建的socket, 可以再次Run
+  for (size_t i = 0; i < loops.size(); ++i) {
+    loops_.emplace_back(new LoopContext(loops[i], i));
+    if (!Bind(loops_.back().get(), address, pool_ != nullptr)) {
+      loops_.clear();
+      return false;
+    }
+  }
+  for (auto& ctx : loops_) {
+    if (ctx->loop == loop_) {
+      EnableReadingInLoop(ctx.get());
+    } else {
+      ctx->loop->QueueInLoop(
+          std::bind(&UDPServer::EnableReadingInLoop, this, ctx.get()));
+    }
+  }
+
+  if (pool_ && !pool_->started()) {
+    pool_->Start();
+  }
+  return true;
+}
+
+bool UDPServer::Bind(LoopContext* ctx,
+                     const NetAddress& address,
+                     bool reuse_port) {
+  ctx->buffers.reset(new char[batch_size_ * max_datagram_size_]);
+  ctx->datagrams.resize(batch_size_);
+  int err = ctx->socket.Open();
   if (err) {
     PLOG_ERROR << "UDPSocket::Open";
     return false;
   }
-  err = socket_.Bind(address);
+  err = ctx->socket.Bind(address, reuse_port);
   if (err) {
     PLOG_ERROR << "UDPSocket::Bind";
     return false;
   }
-  channel_ = make_unique<Channel>(loop_, socket_.fd());
-  using namespace std::placeholders;
-  channel_->set_read_callback(std::bind(&UDPServer::OnReadable, this));
-  channel_->EnableReading();
-  channel_->DisableWriting();
   return true;
 }
 
-void UDPServer::OnReadable() {
-  static const size_t kMaxUDPSize = 1 << 16;
-  alpha::IOBuffer buf(kMaxUDPSize);
-  alpha::NetAddress peer;
-  int nread = socket_.RecvFrom(&buf, kMaxUDPSize, &peer);
-  if (nread >= 0) {
-    DLOG_INFO << "Read " << nread << " bytes from " << peer;
-    if (cb_) {
-      cb_(&socket_, &buf, nread, peer);
-    }
+void UDPServer::EnableReadingInLoop(LoopContext* ctx) {
+  ctx->channel = make_unique<Channel>(ctx->loop, ctx->socket.fd());
+  ctx->channel->set_read_callback(
+      std::bind(&UDPServer::OnReadable, this, ctx));
+  ctx->channel->EnableReading();
+  ctx->channel->DisableWriting();
+}
+
+void UDPServer::OnReadable(LoopContext* ctx) {
+  auto datagrams = ctx->datagrams.data();
+  for (int i = 0; i < batch_size_; ++i) {
+    datagrams[i].data = ctx->buffers.get() + i * max_datagram_size_;
+    datagrams[i].len = max_datagram_size_;
+  }
+  // 每次可读只收一批, 剩下的等下一轮, 不让UDP饿死其他事件
+  int n = ctx->socket.RecvBatch(datagrams, batch_size_);
+  if (n < 0) {
+    PLOG_WARNING_IF(errno != EAGAIN && errno != EWOULDBLOCK)
+        << "UDPSocket::RecvBatch failed";
+    return;
+  }
+  DLOG_INFO << "Read " << n << " datagrams";
+  if (ctx->loop != loop_ && (dispatch_to_base_loop_ || steering_cb_)) {
+    Forward(ctx, datagrams, n);
   } else {
-    PLOG_WARNING << "UDPSocket::RecvFrom failed";
+    Dispatch(&ctx->socket, datagrams, n);
+  }
+}
+
+void UDPServer::Forward(LoopContext* ctx, UDPDatagram* datagrams, int count) {
+  if (dispatch_to_base_loop_) {
+    auto batch = std::make_shared<ForwardedBatch>();
+    for (int i = 0; i < count; ++i) {
+      batch->Append(datagrams[i]);
+    }
+    ForwardTo(&ctx->socket, loop_, batch);
+    return;
+  }
+
+  // 属于自己的报文原地往前挪, 其他的按目标loop攒成一批再转发
+  std::vector<ForwardedBatchPtr> batches(loops_.size());
+  int local = 0;
+  for (int i = 0; i < count; ++i) {
+    const size_t index = steering_cb_(datagrams[i].address) % loops_.size();
+    if (index == ctx->index) {
+      datagrams[local++] = datagrams[i];
+      continue;
+    }
+    auto& batch = batches[index];
+    if (!batch) {
+      batch = std::make_shared<ForwardedBatch>();
+    }
+    batch->Append(datagrams[i]);
+  }
+  for (size_t i = 0; i < batches.size(); ++i) {
+    if (batches[i]) {
+      ForwardTo(&ctx->socket, loops_[i]->loop, batches[i]);
+    }
+  }
+  Dispatch(&ctx->socket, datagrams, local);
+}
+
+void UDPServer::ForwardTo(UDPSocket* socket,
+                          EventLoop* loop,
+                          const ForwardedBatchPtr& batch) {
+  char* data = batch->buffer.data();
+  for (auto& datagram : batch->datagrams) {
+    datagram.data = data;
+    data += datagram.len;
+  }
+  // 回调拿到的还是收到报文的socket, 回包的源地址不变
+  loop->QueueInLoop([this, socket, batch] {
+    Dispatch(socket,
+             batch->datagrams.data(),
+             static_cast<int>(batch->datagrams.size()));
+  });
+}
+
+void UDPServer::Dispatch(UDPSocket* socket, UDPDatagram* datagrams, int count) {
+  if (count == 0) {
+    return;
+  }
+  if (batch_cb_) {
+    batch_cb_(socket, datagrams, count);
+  } else if (cb_) {
+    for (int i = 0; i < count; ++i) {
+      auto& datagram = datagrams[i];
+      WrappedIOBuffer buf(datagram.data);
+      cb_(socket, &buf, datagram.len, datagram.address);
+    }
   }
 }
 }
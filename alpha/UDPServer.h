@@ -14,6 +14,7 @@
 
 #include <memory>
 #include <functional>
+#include <vector>
 #include <alpha/Compiler.h>
 #include <alpha/NetAddress.h>
 #include <alpha/UDPSocket.h>
@@ -21,24 +22,86 @@
 namespace alpha {
 class Channel;
 class EventLoop;
+class EventLoopThreadPool;
 
+// 每次可读时用recvmmsg收一批报文到预先分配的缓冲区里, 不再每个报文分配内存
+// 回调里拿到的缓冲区在回调返回之后会被下一批报文复用
+// 设置线程池之后每个工作线程一个SO_REUSEPORT socket, 内核按四元组分发报文,
+// 同一个对端的报文总是落在同一个线程, 保持顺序
 class UDPServer final {
  public:
   using MessageCallback = std::function<void(
       UDPSocket*, IOBuffer*, size_t buf_len, const NetAddress&)>;
+  // 一次可读收到的所有报文, 回调中可以修改datagrams的内容, 比如原地构造回包
+  using BatchMessageCallback =
+      std::function<void(UDPSocket*, UDPDatagram* datagrams, int count)>;
+  // 返回对端应该由第几个loop处理, 对loop个数取模
+  using SteeringCallback = std::function<size_t(const NetAddress& peer)>;
+  static const int kDefaultBatchSize = 32;
+  static const size_t kMaxDatagramSize = 1 << 16;
 
   explicit UDPServer(alpha::EventLoop* loop);
   ~UDPServer();
   DISABLE_COPY_ASSIGNMENT(UDPServer);
 
+  // 在Run之前调用, 回调在收到报文的loop线程中执行, 析构时会先停止线程池
+  void SetThreadPool(EventLoopThreadPool* pool);
+  // 按对端地址把报文转给指定的loop处理, 不在自己线程的报文会被拷贝一份
+  // 同一个对端总是从同一个socket收到, 转发之后仍然保持顺序
+  void SetSteeringCallback(const SteeringCallback& cb) { steering_cb_ = cb; }
+  // 所有报文都拷贝回base loop处理, 回调要访问共享状态时使用, Run之前调用
+  void set_dispatch_to_base_loop(bool enable) {
+    dispatch_to_base_loop_ = enable;
+  }
+  // 两个回调只需要设置一个, 都设置时只调用BatchMessageCallback
   void SetMessageCallback(const MessageCallback& cb) { cb_ = cb; }
+  void SetBatchMessageCallback(const BatchMessageCallback& cb) {
+    batch_cb_ = cb;
+  }
+  // 每次可读最多收多少个报文, 不超过UDPSocket::kMaxBatchSize, Run之前调用
+  void set_batch_size(int batch_size);
+  // 单个报文的缓冲区大小, 更长的报文会被丢弃, Run之前调用
+  void set_max_datagram_size(size_t size);
   bool Run(const NetAddress& address);
 
  private:
-  void OnReadable();
+  // 每个loop一份, 只在对应的loop线程中访问
+  struct LoopContext {
+    LoopContext(EventLoop* loop, size_t index);
+    ~LoopContext();
+    EventLoop* loop;
+    size_t index;
+    UDPSocket socket;
+    std::unique_ptr<Channel> channel;
+    // batch_size_个报文的缓冲区, 每次收包都复用
+    std::unique_ptr<char[]> buffers;
+    std::vector<UDPDatagram> datagrams;
+  };
+  // 转给其他loop的报文, 数据拷贝到自己的缓冲区里
+  struct ForwardedBatch {
+    void Append(const UDPDatagram& datagram);
+    std::vector<char> buffer;
+    std::vector<UDPDatagram> datagrams;
+  };
+  using ForwardedBatchPtr = std::shared_ptr<ForwardedBatch>;
+
+  bool Bind(LoopContext* ctx, const NetAddress& address, bool reuse_port);
+  void EnableReadingInLoop(LoopContext* ctx);
+  void OnReadable(LoopContext* ctx);
+  void Forward(LoopContext* ctx, UDPDatagram* datagrams, int count);
+  void ForwardTo(UDPSocket* socket,
+                 EventLoop* loop,
+                 const ForwardedBatchPtr& batch);
+  void Dispatch(UDPSocket* socket, UDPDatagram* datagrams, int count);
+
   EventLoop* loop_;
+  EventLoopThreadPool* pool_;
+  bool dispatch_to_base_loop_;
+  int batch_size_;
+  size_t max_datagram_size_;
   MessageCallback cb_;
-  std::unique_ptr<Channel> channel_;
-  UDPSocket socket_;
+  BatchMessageCallback batch_cb_;
+  SteeringCallback steering_cb_;
+  std::vector<std::unique_ptr<LoopContext>> loops_;
 };
 }
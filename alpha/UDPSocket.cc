@@ -15,10 +15,15 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/ip.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <alpha/Logger.h>
 #include <alpha/SocketOps.h>
 
 namespace alpha {
+const int UDPSocket::kMaxBatchSize;
+
 UDPSocket::UDPSocket() = default;
 
 UDPSocket::~UDPSocket() { Close(); }
@@ -46,9 +51,12 @@ int UDPSocket::Connect(const NetAddress& addr) {
   }
 }
 
-int UDPSocket::Bind(const NetAddress& addr) {
+int UDPSocket::Bind(const NetAddress& addr, bool reuse_port) {
   CHECK(socket_ != kInvalidSocket);
   CHECK(!is_connected());
+  if (reuse_port) {
+    SocketOps::SetReusePort(socket_);
+  }
   int rc = DoBind(addr);
   if (rc == -1) {
     return -1;
@@ -133,6 +141,68 @@ int UDPSocket::SendTo(IOBuffer* buf, size_t buf_len, const NetAddress& addr) {
   return SendOrWrite(buf, buf_len, &addr);
 }
 
+int UDPSocket::RecvBatch(UDPDatagram* datagrams, int count) {
+  CHECK(socket_ != kInvalidSocket);
+  count = std::min(count, kMaxBatchSize);
+  struct mmsghdr messages[kMaxBatchSize];
+  struct iovec iovecs[kMaxBatchSize];
+  struct sockaddr_in addresses[kMaxBatchSize];
+  for (int i = 0; i < count; ++i) {
+    iovecs[i].iov_base = datagrams[i].data;
+    iovecs[i].iov_len = datagrams[i].len;
+    memset(&messages[i], 0, sizeof(messages[i]));
+    messages[i].msg_hdr.msg_name = &addresses[i];
+    messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+    messages[i].msg_hdr.msg_iov = &iovecs[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+  int n = ::recvmmsg(socket_, messages, count, MSG_DONTWAIT, nullptr);
+  if (n <= 0) {
+    return n == 0 ? 0 : -1;
+  }
+  // 把截断的报文去掉, 后面的往前挪
+  int received = 0;
+  for (int i = 0; i < n; ++i) {
+    const auto& hdr = messages[i].msg_hdr;
+    if (unlikely(hdr.msg_flags & MSG_TRUNC)) {
+      LOG_WARNING << "Drop truncated datagram, buffer size: "
+                  << datagrams[i].len;
+      continue;
+    }
+    CHECK(hdr.msg_namelen == sizeof(sockaddr_in));
+    auto& datagram = datagrams[received++];
+    if (&datagram != &datagrams[i]) {
+      memmove(datagram.data, datagrams[i].data, messages[i].msg_len);
+    }
+    datagram.len = messages[i].msg_len;
+    CHECK(datagram.address.FromSockAddr(addresses[i]));
+  }
+  if (received == 0) {
+    errno = EAGAIN;
+    return -1;
+  }
+  return received;
+}
+
+int UDPSocket::SendBatch(const UDPDatagram* datagrams, int count) {
+  CHECK(socket_ != kInvalidSocket);
+  count = std::min(count, kMaxBatchSize);
+  struct mmsghdr messages[kMaxBatchSize];
+  struct iovec iovecs[kMaxBatchSize];
+  struct sockaddr_in addresses[kMaxBatchSize];
+  for (int i = 0; i < count; ++i) {
+    iovecs[i].iov_base = datagrams[i].data;
+    iovecs[i].iov_len = datagrams[i].len;
+    addresses[i] = datagrams[i].address.ToSockAddr();
+    memset(&messages[i], 0, sizeof(messages[i]));
+    messages[i].msg_hdr.msg_name = &addresses[i];
+    messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+    messages[i].msg_hdr.msg_iov = &iovecs[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+  return ::sendmmsg(socket_, messages, count, 0);
+}
+
 int UDPSocket::DoBind(const NetAddress& addr) {
   sockaddr_in sock_addr = addr.ToSockAddr();
   socklen_t addr_len = sizeof(sock_addr);
@@ -16,13 +16,22 @@
 #include <alpha/IOBuffer.h>
 
 namespace alpha {
+// 批量收发的一个报文, data指向调用者的缓冲区
+struct UDPDatagram {
+  char* data;
+  // 收的时候传入缓冲区大小, 返回报文长度; 发的时候是报文长度
+  size_t len;
+  NetAddress address;
+};
+
 class UDPSocket {
  public:
   UDPSocket();
   virtual ~UDPSocket();
   int Open();
   int Connect(const NetAddress& addr);
-  int Bind(const NetAddress& addr);
+  // reuse_port为true时多个UDPSocket可以绑定同一个地址, 由内核分发报文
+  int Bind(const NetAddress& addr, bool reuse_port = false);
   void Close();
   int GetPeerAddress(NetAddress* addr);
   int GetLocalAddress(NetAddress* addr);
@@ -33,6 +42,14 @@ class UDPSocket {
   int RecvFrom(IOBuffer* buf, size_t buf_len, NetAddress* addr);
   int SendTo(IOBuffer* buf, size_t buf_len, const NetAddress& addr);
 
+  // recvmmsg/sendmmsg, 一次系统调用最多处理kMaxBatchSize个报文
+  // 返回处理的报文个数, 一个也没有处理时返回-1, errno表示原因
+  // 超过缓冲区大小的报文被截断, 丢弃之后不计入返回值
+  static const int kMaxBatchSize = 64;
+  int RecvBatch(UDPDatagram* datagrams, int count);
+  // 可能只发出一部分, 调用者需要从返回值的位置继续发
+  int SendBatch(const UDPDatagram* datagrams, int count);
+
   int SetReceiveBufferSize(int32_t size);
   int SetSendBufferSize(int32_t size);
 
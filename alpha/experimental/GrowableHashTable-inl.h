@@ -0,0 +1,294 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  GrowableHashTable-inl.h
+ *        Created:  10/18/26 16:13:02
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <utility>
+#include <new>
+#include <alpha/Logger.h>
+
+#define GrowableHashTableTypeDeclaration \
+  template <typename Table, typename KeyOfValue>
+#define GrowableHashTableType GrowableHashTable<Table, KeyOfValue>
+
+namespace alpha {
+
+GrowableHashTableTypeDeclaration const uint64_t GrowableHashTableType::kMagic;
+GrowableHashTableTypeDeclaration const uint32_t
+    GrowableHashTableType::kRehashing;
+GrowableHashTableTypeDeclaration const int64_t GrowableHashTableType::kPageSize;
+GrowableHashTableTypeDeclaration const typename GrowableHashTableType::size_type
+    GrowableHashTableType::kRehashStep;
+
+GrowableHashTableTypeDeclaration GrowableHashTableType::iterator::iterator(
+    GrowableHashTable* ht, bool in_old, typename Table::iterator it)
+    : ht_(ht), in_old_(in_old), it_(it) {
+  SkipToOld();
+}
+
+GrowableHashTableTypeDeclaration typename GrowableHashTableType::iterator&
+    GrowableHashTableType::iterator::operator++() {
+  ++it_;
+  SkipToOld();
+  return *this;
+}
+
+GrowableHashTableTypeDeclaration typename GrowableHashTableType::iterator
+    GrowableHashTableType::iterator::operator++(int) {
+  auto tmp = *this;
+  ++*this;
+  return tmp;
+}
+
+GrowableHashTableTypeDeclaration void
+GrowableHashTableType::iterator::SkipToOld() {
+  if (!in_old_ && ht_->old_ && it_ == ht_->table_->end()) {
+    in_old_ = true;
+    it_ = ht_->old_->begin();
+  }
+}
+
+GrowableHashTableTypeDeclaration std::unique_ptr<GrowableHashTableType>
+GrowableHashTableType::Create(MemoryMappedFile* file) {
+  auto size = file->size();
+  if (size <= kPageSize) {
+    return nullptr;
+  }
+  std::unique_ptr<GrowableHashTable> ht(new GrowableHashTable(file));
+  auto header = ht->header();
+  header->element_size = sizeof(value_type);
+  header->state = 0;
+  header->segments[0].offset = kPageSize;
+  header->segments[0].size = (size - kPageSize) / kPageSize * kPageSize;
+  header->segments[1].offset = 0;
+  header->segments[1].size = 0;
+  header->rehash_index = 0;
+  auto start = reinterpret_cast<char*>(file->mapped_start());
+  ht->table_ = Table::Create(start + kPageSize, header->segments[0].size);
+  if (ht->table_ == nullptr) {
+    return nullptr;
+  }
+  // 最后写magic, 创建到一半时不会被当成有效数据
+  header->magic = kMagic;
+  return ht;
+}
+
+GrowableHashTableTypeDeclaration std::unique_ptr<GrowableHashTableType>
+GrowableHashTableType::Restore(MemoryMappedFile* file) {
+  if (file->size() <= kPageSize) {
+    return nullptr;
+  }
+  std::unique_ptr<GrowableHashTable> ht(new GrowableHashTable(file));
+  auto header = ht->header();
+  if (header->magic != kMagic || header->element_size != sizeof(value_type) ||
+      header->state > 3 || !ht->Attach()) {
+    return nullptr;
+  }
+  if (ht->rehashing()) {
+    if (header->rehash_index > ht->old_->bucket_count()) {
+      return nullptr;
+    }
+    LOG_INFO << "Continue rehashing, bucket: " << header->rehash_index << "/"
+             << ht->old_->bucket_count();
+    // 崩溃时正在搬迁的桶中的元素可能两个表里都有, 先搬完这个桶
+    ht->Rehash(1);
+  }
+  return ht;
+}
+
+GrowableHashTableTypeDeclaration GrowableHashTableType::GrowableHashTable(
+    MemoryMappedFile* file)
+    : file_(file) {}
+
+GrowableHashTableTypeDeclaration typename GrowableHashTableType::Header*
+GrowableHashTableType::header() const {
+  return reinterpret_cast<Header*>(file_->mapped_start());
+}
+
+GrowableHashTableTypeDeclaration bool GrowableHashTableType::Attach() {
+  auto header = this->header();
+  auto start = reinterpret_cast<char*>(file_->mapped_start());
+  auto file_size = static_cast<uint64_t>(file_->size());
+  auto restore = [&](const Segment& segment) -> std::unique_ptr<Table> {
+    if (segment.offset < kPageSize || segment.offset > file_size ||
+        segment.size > file_size - segment.offset) {
+      LOG_WARNING << "Invalid segment, offset: " << segment.offset
+                  << ", size: " << segment.size << ", file size: " << file_size;
+      return nullptr;
+    }
+    return Table::Restore(start + segment.offset, segment.size);
+  };
+  table_ = restore(header->segments[current()]);
+  old_.reset();
+  if (rehashing()) {
+    old_ = restore(header->segments[1 - current()]);
+    return table_ && old_;
+  }
+  return table_ != nullptr;
+}
+
+GrowableHashTableTypeDeclaration bool GrowableHashTableType::empty() const {
+  return size() == 0;
+}
+
+GrowableHashTableTypeDeclaration typename GrowableHashTableType::size_type
+GrowableHashTableType::size() const {
+  return table_->size() + (old_ ? old_->size() : 0);
+}
+
+GrowableHashTableTypeDeclaration typename GrowableHashTableType::size_type
+GrowableHashTableType::max_size() const {
+  return table_->max_size();
+}
+
+GrowableHashTableTypeDeclaration bool GrowableHashTableType::rehashing()
+    const {
+  return header()->state & kRehashing;
+}
+
+GrowableHashTableTypeDeclaration typename GrowableHashTableType::iterator
+GrowableHashTableType::begin() {
+  return iterator(this, false, table_->begin());
+}
+
+GrowableHashTableTypeDeclaration typename GrowableHashTableType::iterator
+GrowableHashTableType::end() {
+  return old_ ? iterator(this, true, old_->end())
+              : iterator(this, false, table_->end());
+}
+
+GrowableHashTableTypeDeclaration
+    std::pair<typename GrowableHashTableType::iterator, bool>
+    GrowableHashTableType::insert(const value_type& obj) {
+  auto it = find(KeyOfValue()(obj));
+  if (it != end()) {
+    return std::make_pair(it, false);
+  }
+  if (rehashing()) {
+    Rehash(kRehashStep);
+  }
+  if (rehashing() && size() >= table_->max_size()) {
+    // 新表已经放不下旧表剩下的元素, 不再等, 直接搬完
+    Rehash(old_->bucket_count());
+  }
+  if (!rehashing() && NeedGrow()) {
+    // 失败时继续用当前的表, 满了之后由Table::insert抛出bad_alloc
+    Grow();
+  }
+  auto res = table_->insert(obj);
+  return std::make_pair(iterator(this, false, res.first), true);
+}
+
+GrowableHashTableTypeDeclaration typename GrowableHashTableType::size_type
+GrowableHashTableType::erase(const key_type& k) {
+  if (rehashing()) {
+    Rehash(kRehashStep);
+  }
+  auto n = table_->erase(k);
+  if (old_) {
+    n += old_->erase(k);
+  }
+  return n;
+}
+
+GrowableHashTableTypeDeclaration void GrowableHashTableType::clear() {
+  table_->clear();
+  if (rehashing()) {
+    FinishRehash();
+  }
+}
+
+GrowableHashTableTypeDeclaration typename GrowableHashTableType::iterator
+GrowableHashTableType::find(const key_type& k) {
+  auto it = table_->find(k);
+  if (it != table_->end()) {
+    return iterator(this, false, it);
+  }
+  if (old_) {
+    return iterator(this, true, old_->find(k));
+  }
+  return end();
+}
+
+GrowableHashTableTypeDeclaration bool GrowableHashTableType::NeedGrow() const {
+  return static_cast<uint64_t>(table_->size() + 1) * 5 >
+         static_cast<uint64_t>(table_->max_size()) * 4;
+}
+
+GrowableHashTableTypeDeclaration bool GrowableHashTableType::Grow() {
+  auto header = this->header();
+  const auto& segment = header->segments[current()];
+  Segment next;
+  next.offset = segment.offset + segment.size;
+  next.size = segment.size * 2;
+  // 文件大小只按当前的表算, 之前扩容到一半崩溃时留下的部分不再保留
+  if (!file_->Resize(next.offset + next.size)) {
+    LOG_WARNING << "Resize file failed, new size: " << next.offset + next.size;
+    return false;
+  }
+  CHECK(Attach()) << "Attach after resize failed";
+  header = this->header();
+  auto start = reinterpret_cast<char*>(file_->mapped_start());
+  auto table = Table::Create(start + next.offset, next.size);
+  if (table == nullptr) {
+    LOG_WARNING << "Create table failed, size: " << next.size;
+    return false;
+  }
+  LOG_INFO << "Start rehashing, size: " << table_->size()
+           << ", max size: " << table_->max_size() << " -> "
+           << table->max_size();
+  auto other = 1 - current();
+  header->segments[other] = next;
+  header->rehash_index = 0;
+  // 只改一个字段来切换到新表
+  header->state = (other << 1) | kRehashing;
+  old_ = std::move(table_);
+  table_ = std::move(table);
+  return true;
+}
+
+GrowableHashTableTypeDeclaration void GrowableHashTableType::Rehash(
+    size_type buckets) {
+  auto header = this->header();
+  auto bucket_count = old_->bucket_count();
+  for (size_type i = 0; i < buckets && header->rehash_index < bucket_count;
+       ++i) {
+    MoveBucket(header->rehash_index);
+    ++header->rehash_index;
+  }
+  if (header->rehash_index == bucket_count) {
+    FinishRehash();
+  }
+}
+
+GrowableHashTableTypeDeclaration void GrowableHashTableType::MoveBucket(
+    size_type n) {
+  for (auto it = old_->bucket_front(n); it != old_->end();
+       it = old_->bucket_front(n)) {
+    auto obj = *it;
+    // 先插入再删除, 新表中已经有了说明是崩溃之前搬了一半
+    table_->insert(obj);
+    old_->erase(KeyOfValue()(obj));
+  }
+}
+
+GrowableHashTableTypeDeclaration void GrowableHashTableType::FinishRehash() {
+  auto header = this->header();
+  auto segment = header->segments[1 - current()];
+  header->state = current() << 1;
+  old_.reset();
+  // 旧表的内存不再使用, 还给文件系统
+  file_->PunchHole(segment.offset, segment.size);
+  LOG_INFO << "Finish rehashing, size: " << table_->size();
+}
+}
+
+#undef GrowableHashTableType
+#undef GrowableHashTableTypeDeclaration
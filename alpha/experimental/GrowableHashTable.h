@@ -0,0 +1,136 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  GrowableHashTable.h
+ *        Created:  10/18/26 16:12:35
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  建在MemoryMappedFile上, 可以在线扩容的哈希表
+ *
+ * =============================================================================
+ */
+#pragma once
+
+#include <memory>
+#include <alpha/MemoryMappedFile.h>
+#include "RegionBasedHashMap.h"
+#include "RegionBasedFlatHashMap.h"
+
+namespace alpha {
+// 文件开头一页是头部, 后面是按页对齐的segment, 每个segment放一个Table
+// 元素个数超过当前表的4/5时把文件扩大, 在文件末尾新建一个两倍大小的表,
+// 之后每次insert/erase从旧表搬迁kRehashStep个桶到新表, 搬完之后释放旧表占用的磁盘
+// 搬迁过程中新插入的元素只放到新表中, 查找时两个表都要查
+//
+// 崩溃一致性:
+// 切换到新表只改头部的一个32位的state, 崩溃时要么还是旧表, 要么已经开始搬迁
+// 搬迁一个元素时先插入新表再从旧表删除, 恢复时先把正在搬迁的桶搬完, 两个表中
+// 都有的元素以新表为准. Table自身的操作(例如清理墓碑)也要求崩溃之后能恢复
+//
+// 扩容时文件会被重新映射, 之前拿到的迭代器和指针都会失效
+// Table可以是RegionBasedHashTable或RegionBasedFlatHashTable
+template <typename Table, typename KeyOfValue>
+class GrowableHashTable {
+ public:
+  using key_type = typename Table::key_type;
+  using value_type = typename Table::value_type;
+  using size_type = typename Table::size_type;
+
+  class iterator : public std::iterator<std::forward_iterator_tag, value_type> {
+   public:
+    iterator() = default;
+    iterator& operator++();
+    iterator operator++(int);
+    value_type& operator*() const { return *it_; }
+    value_type* operator->() const { return &*it_; }
+    bool operator==(const iterator& rhs) const {
+      return in_old_ == rhs.in_old_ && it_ == rhs.it_;
+    }
+    bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+
+   private:
+    friend class GrowableHashTable;
+    iterator(GrowableHashTable* ht, bool in_old, typename Table::iterator it);
+    // 新表遍历完之后接着遍历旧表
+    void SkipToOld();
+    GrowableHashTable* ht_ = nullptr;
+    bool in_old_ = false;
+    typename Table::iterator it_;
+  };
+
+  // 用文件当前的大小创建
+  static std::unique_ptr<GrowableHashTable> Create(MemoryMappedFile* file);
+  // 如果崩溃时正在搬迁, 恢复之后继续搬迁
+  static std::unique_ptr<GrowableHashTable> Restore(MemoryMappedFile* file);
+
+  bool empty() const;
+  size_type size() const;
+  // 当前的表不扩容能放下的元素个数
+  size_type max_size() const;
+  bool rehashing() const;
+
+  iterator begin();
+  iterator end();
+
+  // 扩容失败并且当前的表已满时抛出std::bad_alloc
+  std::pair<iterator, bool> insert(const value_type& obj);
+  size_type erase(const key_type& k);
+  void clear();
+  // 不搬迁, 读多写少时搬迁由insert/erase推进
+  iterator find(const key_type& k);
+
+ private:
+  struct Segment {
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  struct Header {
+    uint64_t magic;
+    uint32_t element_size;
+    // 第0位表示正在搬迁, 第1位是当前的表在哪个segment
+    uint32_t state;
+    Segment segments[2];
+    // 旧表中编号小于rehash_index的桶都已经搬完了
+    uint32_t rehash_index;
+  };
+
+  static const uint64_t kMagic = 0x2b8e5d0f6c3a7149;
+  static const uint32_t kRehashing = 1;
+  static const int64_t kPageSize = 4096;
+  static const size_type kRehashStep = 4;
+
+  explicit GrowableHashTable(MemoryMappedFile* file);
+  Header* header() const;
+  int current() const { return header()->state >> 1; }
+  // 文件重新映射之后重新挂载两个表
+  bool Attach();
+  bool NeedGrow() const;
+  bool Grow();
+  void Rehash(size_type buckets);
+  void MoveBucket(size_type n);
+  void FinishRehash();
+
+  MemoryMappedFile* file_;
+  std::unique_ptr<Table> table_;
+  std::unique_ptr<Table> old_;
+};
+
+template <class Key,
+          class T,
+          class Hash = std::hash<Key>,
+          class Pred = std::equal_to<Key>>
+using GrowableRegionBasedHashMap =
+    GrowableHashTable<RegionBasedHashMap<Key, T, Hash, Pred>,
+                      Select1st<PODPair<Key, T>>>;
+
+template <class Key,
+          class T,
+          class Hash = std::hash<Key>,
+          class Pred = std::equal_to<Key>>
+using GrowableRegionBasedFlatHashMap =
+    GrowableHashTable<RegionBasedFlatHashMap<Key, T, Hash, Pred>,
+                      Select1st<PODPair<Key, T>>>;
+}
+
+#include "GrowableHashTable-inl.h"
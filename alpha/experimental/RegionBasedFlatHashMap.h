@@ -0,0 +1,30 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  RegionBasedFlatHashMap.h
+ *        Created:  10/18/26 15:04:21
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#pragma once
+
+#include "RegionBasedHashMap.h"
+#include "RegionBasedFlatHashTable.h"
+
+namespace alpha {
+// 接口和RegionBasedHashMap相同, 数据布局不同, 不能互相恢复
+template <class Key,
+          class T,
+          class Hash = std::hash<Key>,
+          class Pred = std::equal_to<Key>>
+using RegionBasedFlatHashMap =
+    RegionBasedFlatHashTable<Key,
+                             PODPair<Key, T>,
+                             Hash,
+                             Pred,
+                             Select1st<PODPair<Key, T>>>;
+}
@@ -0,0 +1,535 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  RegionBasedFlatHashTable-inl.h
+ *        Created:  10/18/26 15:03:10
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <utility>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace alpha {
+namespace detail {
+// 一组16个控制字节, 返回的掩码中第i位对应组内第i个槽位
+class FlatHashTableGroup {
+ public:
+#ifdef __SSE2__
+  explicit FlatHashTableGroup(const int8_t* ctrl)
+      : ctrl_(_mm_load_si128(reinterpret_cast<const __m128i*>(ctrl))) {}
+
+  uint32_t Match(int8_t c) const {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(c), ctrl_));
+  }
+
+  // 最高位为1的就是没有被占用的
+  uint32_t MatchNonFull() const { return _mm_movemask_epi8(ctrl_); }
+
+ private:
+  __m128i ctrl_;
+#else
+  explicit FlatHashTableGroup(const int8_t* ctrl) : ctrl_(ctrl) {}
+
+  uint32_t Match(int8_t c) const {
+    uint32_t mask = 0;
+    for (int i = 0; i < 16; ++i) {
+      mask |= static_cast<uint32_t>(ctrl_[i] == c) << i;
+    }
+    return mask;
+  }
+
+  uint32_t MatchNonFull() const {
+    uint32_t mask = 0;
+    for (int i = 0; i < 16; ++i) {
+      mask |= static_cast<uint32_t>(ctrl_[i] < 0) << i;
+    }
+    return mask;
+  }
+
+ private:
+  const int8_t* ctrl_;
+#endif
+};
+}
+
+#define FlatHashTableIteratorTypeDeclaration \
+  template <typename Key,                    \
+            typename T,                      \
+            typename Hash,                   \
+            typename Pred,                   \
+            typename KeyOfValue>
+#define FlatHashTableIteratorType \
+  FlatHashTableIterator<Key, T, Hash, Pred, KeyOfValue>
+#define FlatHashTableConstIteratorType \
+  FlatHashTableConstIterator<Key, T, Hash, Pred, KeyOfValue>
+
+FlatHashTableIteratorTypeDeclaration
+FlatHashTableIteratorType::FlatHashTableIterator()
+    : ht_(nullptr), index_(0) {}
+
+FlatHashTableIteratorTypeDeclaration
+FlatHashTableIteratorType::FlatHashTableIterator(_HashTable* ht,
+                                                 uint32_t index)
+    : ht_(ht), index_(index) {}
+
+FlatHashTableIteratorTypeDeclaration FlatHashTableIteratorType&
+    FlatHashTableIteratorType::operator++() {
+  index_ = ht_->NextFull(index_ + 1);
+  return *this;
+}
+
+FlatHashTableIteratorTypeDeclaration FlatHashTableIteratorType
+    FlatHashTableIteratorType::operator++(int) {
+  auto tmp = *this;
+  ++*this;
+  return tmp;
+}
+
+FlatHashTableIteratorTypeDeclaration
+    typename FlatHashTableIteratorType::_Base::reference
+    FlatHashTableIteratorType::operator*() const {
+  return ht_->slots_[index_];
+}
+
+FlatHashTableIteratorTypeDeclaration
+    typename FlatHashTableIteratorType::_Base::pointer
+    FlatHashTableIteratorType::operator->() const {
+  return &(operator*());
+}
+
+FlatHashTableIteratorTypeDeclaration bool FlatHashTableIteratorType::operator==(
+    const FlatHashTableIterator& rhs) const {
+  return ht_ == rhs.ht_ && index_ == rhs.index_;
+}
+
+FlatHashTableIteratorTypeDeclaration bool FlatHashTableIteratorType::operator!=(
+    const FlatHashTableIterator& rhs) const {
+  return !(*this == rhs);
+}
+
+FlatHashTableIteratorTypeDeclaration
+FlatHashTableConstIteratorType::FlatHashTableConstIterator()
+    : ht_(nullptr), index_(0) {}
+
+FlatHashTableIteratorTypeDeclaration
+FlatHashTableConstIteratorType::FlatHashTableConstIterator(
+    FlatHashTableIteratorType it)
+    : ht_(it.ht_), index_(it.index_) {}
+
+FlatHashTableIteratorTypeDeclaration
+FlatHashTableConstIteratorType::FlatHashTableConstIterator(
+    const _HashTable* ht, uint32_t index)
+    : ht_(ht), index_(index) {}
+
+FlatHashTableIteratorTypeDeclaration FlatHashTableConstIteratorType&
+    FlatHashTableConstIteratorType::operator++() {
+  index_ = ht_->NextFull(index_ + 1);
+  return *this;
+}
+
+FlatHashTableIteratorTypeDeclaration FlatHashTableConstIteratorType
+    FlatHashTableConstIteratorType::operator++(int) {
+  auto tmp = *this;
+  ++*this;
+  return tmp;
+}
+
+FlatHashTableIteratorTypeDeclaration
+    typename FlatHashTableConstIteratorType::_Base::reference
+    FlatHashTableConstIteratorType::operator*() const {
+  return ht_->slots_[index_];
+}
+
+FlatHashTableIteratorTypeDeclaration
+    typename FlatHashTableConstIteratorType::_Base::pointer
+    FlatHashTableConstIteratorType::operator->() const {
+  return &(operator*());
+}
+
+FlatHashTableIteratorTypeDeclaration bool FlatHashTableConstIteratorType::
+operator==(const FlatHashTableConstIterator& rhs) const {
+  return ht_ == rhs.ht_ && index_ == rhs.index_;
+}
+
+FlatHashTableIteratorTypeDeclaration bool FlatHashTableConstIteratorType::
+operator!=(const FlatHashTableConstIterator& rhs) const {
+  return !(*this == rhs);
+}
+
+#undef FlatHashTableConstIteratorType
+#undef FlatHashTableIteratorType
+#undef FlatHashTableIteratorTypeDeclaration
+
+#define FlatHashTableType                              \
+  RegionBasedFlatHashTable<                            \
+      Key,                                             \
+      T,                                               \
+      Hash,                                            \
+      Pred,                                            \
+      KeyOfValue,                                      \
+      typename std::enable_if<std::is_pod<T>::value && \
+                              !std::is_pointer<T>::value>::type>
+#define FlatHashTableTypeDeclaration \
+  template <typename Key,            \
+            typename T,              \
+            typename Hash,           \
+            typename Pred,           \
+            typename KeyOfValue>
+
+FlatHashTableTypeDeclaration const typename FlatHashTableType::ctrl_t
+    FlatHashTableType::kEmpty;
+FlatHashTableTypeDeclaration const typename FlatHashTableType::ctrl_t
+    FlatHashTableType::kDeleted;
+FlatHashTableTypeDeclaration const typename FlatHashTableType::size_type
+    FlatHashTableType::kGroupWidth;
+FlatHashTableTypeDeclaration const typename FlatHashTableType::size_type
+    FlatHashTableType::kNoMove;
+FlatHashTableTypeDeclaration const uint64_t FlatHashTableType::kMagic;
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::size_type
+FlatHashTableType::CalculateCapacity(char* data, size_t size) {
+  static_assert(alignof(Header) <= kAlignmentRequired &&
+                    alignof(value_type) <= kAlignmentRequired,
+                "kAlignmentRequired is not enough!");
+  // 控制字节按组对齐, 组的大小又是16的倍数, 所以槽位也是对齐的
+  auto ctrl = Align(data + sizeof(Header));
+  if (data + size < ctrl) {
+    return 0;
+  }
+  size_t groups = (data + size - ctrl) / (kGroupWidth * (1 + sizeof(T)));
+  groups = std::min<size_t>(groups, UINT32_MAX / kGroupWidth);
+  return groups * kGroupWidth;
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::size_type
+FlatHashTableType::MaxSize(size_type capacity) {
+  return capacity - capacity / 8;
+}
+
+FlatHashTableTypeDeclaration std::unique_ptr<
+    typename FlatHashTableType::_HashTable>
+FlatHashTableType::Create(char* data, size_t size) {
+  if (CheckAligned(data) == false) {
+    return nullptr;
+  }
+  auto capacity = CalculateCapacity(data, size);
+  if (capacity == 0) {
+    return nullptr;
+  }
+  std::unique_ptr<_HashTable> ht(new _HashTable);
+  ht->header_ = reinterpret_cast<Header*>(data);
+  ht->ctrl_ = reinterpret_cast<ctrl_t*>(Align(data + sizeof(Header)));
+  ht->slots_ = reinterpret_cast<value_type*>(ht->ctrl_ + capacity);
+  ht->header_->element_size = sizeof(value_type);
+  ht->header_->capacity = capacity;
+  ht->header_->move_from = kNoMove;
+  ht->header_->move_to = kNoMove;
+  ht->clear();
+  ht->header_->magic = kMagic;
+  return ht;
+}
+
+FlatHashTableTypeDeclaration std::unique_ptr<
+    typename FlatHashTableType::_HashTable>
+FlatHashTableType::Restore(char* data, size_t size) {
+  if (CheckAligned(data) == false || size < sizeof(Header)) {
+    return nullptr;
+  }
+  auto header = reinterpret_cast<Header*>(data);
+  auto capacity = CalculateCapacity(data, size);
+  if (header->magic != kMagic || header->element_size != sizeof(value_type) ||
+      header->capacity != capacity || capacity == 0 ||
+      header->size > MaxSize(capacity) ||
+      header->growth_left > MaxSize(capacity) - header->size ||
+      (header->move_from != kNoMove &&
+       (header->move_from >= capacity || header->move_to >= capacity))) {
+    return nullptr;
+  }
+  std::unique_ptr<_HashTable> ht(new _HashTable);
+  ht->header_ = header;
+  ht->ctrl_ = reinterpret_cast<ctrl_t*>(Align(data + sizeof(Header)));
+  ht->slots_ = reinterpret_cast<value_type*>(ht->ctrl_ + capacity);
+  if (header->move_from != kNoMove) {
+    // 崩溃时正在搬迁一个元素, 新的槽位已经写好了, 重新做一遍
+    auto to = header->move_to;
+    ht->MoveSlot(
+        header->move_from, to, H2(HashOf(KeyOfValue()(ht->slots_[to]))));
+  }
+  return ht;
+}
+
+FlatHashTableTypeDeclaration bool FlatHashTableType::empty() const {
+  return size() == 0;
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::size_type
+FlatHashTableType::size() const {
+  return header_->size;
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::size_type
+FlatHashTableType::max_size() const {
+  return MaxSize(header_->capacity);
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::size_type
+FlatHashTableType::capacity() const {
+  return header_->capacity;
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::size_type
+FlatHashTableType::bucket_count() const {
+  return header_->capacity;
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::iterator
+FlatHashTableType::bucket_front(size_type n) {
+  assert(n < bucket_count());
+  return IsFull(n) ? iterator(this, n) : end();
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::iterator
+FlatHashTableType::begin() {
+  return iterator(this, NextFull(0));
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::const_iterator
+FlatHashTableType::begin() const {
+  return const_iterator(this, NextFull(0));
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::const_iterator
+FlatHashTableType::cbegin() const {
+  return begin();
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::iterator
+FlatHashTableType::end() {
+  return iterator(this, header_->capacity);
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::const_iterator
+FlatHashTableType::end() const {
+  return const_iterator(this, header_->capacity);
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::const_iterator
+FlatHashTableType::cend() const {
+  return end();
+}
+
+FlatHashTableTypeDeclaration std::pair<typename FlatHashTableType::iterator,
+                                       bool>
+FlatHashTableType::insert(const value_type& obj) {
+  const auto& key = KeyOfValue()(obj);
+  auto hash = HashOf(key);
+  auto index = FindSlot(key, hash);
+  if (index != header_->capacity) {
+    return std::make_pair(iterator(this, index), false);
+  }
+
+  index = FindFirstNonFull(hash);
+  if (ctrl_[index] == kEmpty && header_->growth_left == 0) {
+    // 空闲的额度都被墓碑占了, 清掉墓碑之后再找
+    if (header_->size >= max_size()) {
+      throw std::bad_alloc();
+    }
+    DropDeletes();
+    index = FindFirstNonFull(hash);
+  }
+  if (ctrl_[index] == kEmpty) {
+    --header_->growth_left;
+  }
+  // 先写元素再写控制字节
+  slots_[index] = obj;
+  SetCtrl(index, H2(hash));
+  ++header_->size;
+  return std::make_pair(iterator(this, index), true);
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::iterator
+FlatHashTableType::erase(const_iterator position) {
+  assert(position.ht_ == this && IsFull(position.index_));
+  EraseSlot(position.index_);
+  return iterator(this, NextFull(position.index_ + 1));
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::size_type
+FlatHashTableType::erase(const key_type& k) {
+  auto index = FindSlot(k, HashOf(k));
+  if (index == header_->capacity) {
+    return 0;
+  }
+  EraseSlot(index);
+  return 1;
+}
+
+FlatHashTableTypeDeclaration void FlatHashTableType::clear() {
+  memset(ctrl_, kEmpty, header_->capacity);
+  header_->size = 0;
+  header_->growth_left = max_size();
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::iterator
+FlatHashTableType::find(const key_type& k) {
+  return iterator(this, FindSlot(k, HashOf(k)));
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::const_iterator
+FlatHashTableType::find(const key_type& k) const {
+  return const_iterator(this, FindSlot(k, HashOf(k)));
+}
+
+FlatHashTableTypeDeclaration FlatHashTableType::RegionBasedFlatHashTable()
+    : header_(nullptr), ctrl_(nullptr), slots_(nullptr) {}
+
+FlatHashTableTypeDeclaration uint64_t
+FlatHashTableType::HashOf(const key_type& k) {
+  // std::hash对整数是恒等映射, 乘一个奇数把低位的差异扩散到高位
+  return static_cast<uint64_t>(hasher()(k)) * 0x9e3779b97f4a7c15ull;
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::size_type
+FlatHashTableType::ProbeStart(uint64_t hash) const {
+  // 高7位给H2用, 取中间32位映射到[0, groups)
+  auto groups = header_->capacity / kGroupWidth;
+  return static_cast<uint64_t>(static_cast<uint32_t>(hash >> 25)) * groups >>
+         32;
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::size_type
+FlatHashTableType::NextGroup(size_type group) const {
+  return group + 1 == header_->capacity / kGroupWidth ? 0 : group + 1;
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::size_type
+FlatHashTableType::FindSlot(const key_type& k, uint64_t hash) const {
+  auto h2 = H2(hash);
+  auto group = ProbeStart(hash);
+  for (size_type probed = 0; probed < header_->capacity;
+       probed += kGroupWidth) {
+    auto base = group * kGroupWidth;
+    detail::FlatHashTableGroup g(ctrl_ + base);
+    for (auto mask = g.Match(h2); mask; mask &= mask - 1) {
+      auto index = base + __builtin_ctz(mask);
+      if (key_equal()(KeyOfValue()(slots_[index]), k)) {
+        return index;
+      }
+    }
+    if (g.Match(kEmpty)) {
+      break;
+    }
+    group = NextGroup(group);
+  }
+  return header_->capacity;
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::size_type
+FlatHashTableType::FindFirstNonFull(uint64_t hash) const {
+  auto group = ProbeStart(hash);
+  for (;;) {
+    auto base = group * kGroupWidth;
+    auto mask = detail::FlatHashTableGroup(ctrl_ + base).MatchNonFull();
+    if (mask) {
+      return base + __builtin_ctz(mask);
+    }
+    group = NextGroup(group);
+  }
+}
+
+FlatHashTableTypeDeclaration void FlatHashTableType::SetCtrl(size_type index,
+                                                             ctrl_t c) {
+  ctrl_[index] = c;
+}
+
+FlatHashTableTypeDeclaration void FlatHashTableType::EraseSlot(
+    size_type index) {
+  // 所在的组里还有空闲槽位时, 探测不会越过这个组, 可以直接置为空闲
+  auto base = index / kGroupWidth * kGroupWidth;
+  if (detail::FlatHashTableGroup(ctrl_ + base).Match(kEmpty)) {
+    SetCtrl(index, kEmpty);
+    ++header_->growth_left;
+  } else {
+    SetCtrl(index, kDeleted);
+  }
+  --header_->size;
+}
+
+FlatHashTableTypeDeclaration void FlatHashTableType::DropDeletes() {
+  // 把元素逐个搬到探测路径上更靠前的墓碑里, 直到没有元素能再往前搬
+  // 这时任何元素的探测路径都不会越过含有墓碑的组, 墓碑都可以直接置为空闲
+  for (bool moved = true; moved;) {
+    moved = false;
+    for (size_type i = 0; i < header_->capacity; ++i) {
+      if (!IsFull(i)) {
+        continue;
+      }
+      auto hash = HashOf(KeyOfValue()(slots_[i]));
+      auto target = FindFirstNonFull(hash);
+      if (ProbeDistance(hash, target / kGroupWidth) >=
+          ProbeDistance(hash, i / kGroupWidth)) {
+        continue;
+      }
+      // i之前的组都没有空闲槽位, 否则查找不到i, 所以target一定是墓碑
+      assert(ctrl_[target] == kDeleted);
+      MoveSlot(i, target, H2(hash));
+      moved = true;
+    }
+  }
+  for (size_type i = 0; i < header_->capacity; ++i) {
+    if (ctrl_[i] == kDeleted) {
+      SetCtrl(i, kEmpty);
+    }
+  }
+  header_->growth_left = max_size() - header_->size;
+}
+
+FlatHashTableTypeDeclaration void FlatHashTableType::MoveSlot(size_type from,
+                                                              size_type to,
+                                                              ctrl_t h2) {
+  slots_[to] = slots_[from];
+  header_->move_to = to;
+  header_->move_from = from;
+  SetCtrl(to, h2);
+  SetCtrl(from, kDeleted);
+  header_->move_from = kNoMove;
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::size_type
+FlatHashTableType::ProbeDistance(uint64_t hash, size_type group) const {
+  auto groups = header_->capacity / kGroupWidth;
+  return (group + groups - ProbeStart(hash)) % groups;
+}
+
+FlatHashTableTypeDeclaration typename FlatHashTableType::size_type
+FlatHashTableType::NextFull(size_type index) const {
+  // 先逐个检查到组的边界, 之后按组跳过空的槽位
+  while (index < header_->capacity && index % kGroupWidth) {
+    if (IsFull(index)) {
+      return index;
+    }
+    ++index;
+  }
+  for (; index < header_->capacity; index += kGroupWidth) {
+    auto mask = detail::FlatHashTableGroup(ctrl_ + index).MatchNonFull();
+    if (mask != 0xffff) {
+      return index + __builtin_ctz(~mask);
+    }
+  }
+  return header_->capacity;
+}
+}
+
+#undef FlatHashTableTypeDeclaration
+#undef FlatHashTableType
@@ -0,0 +1,199 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  RegionBasedFlatHashTable.h
+ *        Created:  10/18/26 15:02:44
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  开放寻址的哈希表, 元素直接存放在槽位中
+ *
+ * =============================================================================
+ */
+#pragma once
+
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include "RegionBasedHelper.h"
+
+namespace alpha {
+// 布局和查找方式参考Swiss table:
+// 每个槽位有一个控制字节, 空闲/已删除/占用(存哈希值的高7位)
+// 16个槽位为一组, 查找时一次比较一组控制字节(有SSE2时用SSE2), 匹配上才去比较key
+// 组数不要求是2的幂, 从哈希值决定的组开始逐组向后探测, 遇到有空闲槽位的组就停止
+template <typename Key,
+          typename T,
+          typename Hash,
+          typename Pred,
+          typename KeyOfValue,
+          class Enable = void>
+class RegionBasedFlatHashTable;
+
+template <typename Key,
+          typename T,
+          typename Hash,
+          typename Pred,
+          typename KeyOfValue>
+class FlatHashTableConstIterator;
+
+template <typename Key,
+          typename T,
+          typename Hash,
+          typename Pred,
+          typename KeyOfValue>
+class FlatHashTableIterator
+    : public std::iterator<std::forward_iterator_tag, T> {
+ public:
+  using _HashTable = RegionBasedFlatHashTable<Key, T, Hash, Pred, KeyOfValue>;
+  using _Base = std::iterator<std::forward_iterator_tag, T>;
+
+  FlatHashTableIterator();
+  FlatHashTableIterator(_HashTable* ht, uint32_t index);
+  FlatHashTableIterator& operator++();
+  FlatHashTableIterator operator++(int);
+  typename _Base::reference operator*() const;
+  typename _Base::pointer operator->() const;
+  bool operator==(const FlatHashTableIterator& rhs) const;
+  bool operator!=(const FlatHashTableIterator& rhs) const;
+
+ private:
+  friend class FlatHashTableConstIterator<Key, T, Hash, Pred, KeyOfValue>;
+  friend class RegionBasedFlatHashTable<Key, T, Hash, Pred, KeyOfValue>;
+  _HashTable* ht_;
+  uint32_t index_;
+};
+
+template <typename Key,
+          typename T,
+          typename Hash,
+          typename Pred,
+          typename KeyOfValue>
+class FlatHashTableConstIterator
+    : public std::iterator<std::forward_iterator_tag, const T> {
+ public:
+  using _HashTable = RegionBasedFlatHashTable<Key, T, Hash, Pred, KeyOfValue>;
+  using _Base = std::iterator<std::forward_iterator_tag, const T>;
+
+  FlatHashTableConstIterator();
+  FlatHashTableConstIterator(
+      FlatHashTableIterator<Key, T, Hash, Pred, KeyOfValue> it);
+  FlatHashTableConstIterator(const _HashTable* ht, uint32_t index);
+  FlatHashTableConstIterator& operator++();
+  FlatHashTableConstIterator operator++(int);
+  typename _Base::reference operator*() const;
+  typename _Base::pointer operator->() const;
+  bool operator==(const FlatHashTableConstIterator& rhs) const;
+  bool operator!=(const FlatHashTableConstIterator& rhs) const;
+
+ private:
+  friend class RegionBasedFlatHashTable<Key, T, Hash, Pred, KeyOfValue>;
+  const _HashTable* ht_;
+  uint32_t index_;
+};
+
+template <typename Key,
+          typename T,
+          typename Hash,
+          typename Pred,
+          typename KeyOfValue>
+class RegionBasedFlatHashTable<
+    Key,
+    T,
+    Hash,
+    Pred,
+    KeyOfValue,
+    typename std::enable_if<std::is_pod<T>::value &&
+                            !std::is_pointer<T>::value>::type> {
+ public:
+  using key_type = Key;
+  using value_type = T;
+  using hasher = Hash;
+  using key_equal = Pred;
+  using iterator = FlatHashTableIterator<Key, T, Hash, Pred, KeyOfValue>;
+  using const_iterator =
+      FlatHashTableConstIterator<Key, T, Hash, Pred, KeyOfValue>;
+  using size_type = uint32_t;
+  using _HashTable =
+      RegionBasedFlatHashTable<Key, T, Hash, Pred, KeyOfValue, void>;
+
+  static std::unique_ptr<_HashTable> Create(char* data, size_t size);
+  static std::unique_ptr<_HashTable> Restore(char* data, size_t size);
+
+  bool empty() const;
+  size_type size() const;
+  // 负载因子最大7/8, 保证max_size个元素一定放得下
+  size_type max_size() const;
+  // 槽位总数
+  size_type capacity() const;
+  // 每个槽位看作一个桶, 和RegionBasedHashTable一样可以逐个桶搬迁元素
+  size_type bucket_count() const;
+  iterator bucket_front(size_type n);
+
+  iterator begin();
+  const_iterator begin() const;
+  const_iterator cbegin() const;
+  iterator end();
+  const_iterator end() const;
+  const_iterator cend() const;
+
+  // 已有max_size个元素时抛出std::bad_alloc
+  std::pair<iterator, bool> insert(const value_type& obj);
+  iterator erase(const_iterator position);
+  size_type erase(const key_type& k);
+  void clear();
+
+  iterator find(const key_type& k);
+  const_iterator find(const key_type& k) const;
+
+ private:
+  friend class FlatHashTableIterator<Key, T, Hash, Pred, KeyOfValue>;
+  friend class FlatHashTableConstIterator<Key, T, Hash, Pred, KeyOfValue>;
+  using ctrl_t = int8_t;
+  struct Header {
+    uint64_t magic;
+    uint32_t element_size;
+    uint32_t capacity;
+    uint32_t size;
+    // 还能占用多少个空闲槽位, 删除留下的墓碑也要占用这个额度
+    uint32_t growth_left;
+    // DropDeletes正在把move_from的元素搬到move_to, 不在搬迁时为kNoMove
+    uint32_t move_from;
+    uint32_t move_to;
+  };
+
+  // 占用的槽位控制字节为[0, 127], 最高位为1的都不是占用的
+  static const ctrl_t kEmpty = -128;
+  static const ctrl_t kDeleted = -2;
+  static const size_type kGroupWidth = 16;
+  static const size_type kNoMove = std::numeric_limits<size_type>::max();
+  static const uint64_t kMagic = 0x3a5f6e2c8d1b4f76;
+
+  RegionBasedFlatHashTable();
+  static size_type CalculateCapacity(char* data, size_t size);
+  static size_type MaxSize(size_type capacity);
+  static uint64_t HashOf(const key_type& k);
+  static ctrl_t H2(uint64_t hash) { return hash >> 57; }
+  size_type ProbeStart(uint64_t hash) const;
+  size_type NextGroup(size_type group) const;
+  size_type FindSlot(const key_type& k, uint64_t hash) const;
+  // 探测路径上第一个空闲或者已删除的槽位
+  size_type FindFirstNonFull(uint64_t hash) const;
+  void SetCtrl(size_type index, ctrl_t c);
+  void EraseSlot(size_type index);
+  // 原地清掉墓碑, 每一步之后表都是完整的, 中途崩溃最多留下一些墓碑
+  void DropDeletes();
+  // 先写新的槽位再删除旧的, 头部记录正在搬的元素, 崩溃之后由Restore搬完
+  void MoveSlot(size_type from, size_type to, ctrl_t h2);
+  // 探测路径上第group组是从起始组开始的第几个组
+  size_type ProbeDistance(uint64_t hash, size_type group) const;
+  // 从index开始(含)第一个被占用的槽位, 没有时返回capacity
+  size_type NextFull(size_type index) const;
+  bool IsFull(size_type index) const { return ctrl_[index] >= 0; }
+
+  Header* header_;
+  ctrl_t* ctrl_;
+  value_type* slots_;
+};
+}
+
+#include "RegionBasedFlatHashTable-inl.h"
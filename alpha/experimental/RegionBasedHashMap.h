@@ -16,7 +16,9 @@
 
 namespace alpha {
 template <typename Pair>
-struct Select1st : std::unary_function<Pair, typename Pair::first_type> {
+struct Select1st {
+  using argument_type = Pair;
+  using result_type = typename Pair::first_type;
   const typename Pair::first_type& operator()(const Pair& p) const {
     return p.first;
   }
@@ -290,6 +290,14 @@ HashTableType::bucket_size(size_type n) const {
   return num;
 }
 
+HashTableTypeDeclaration typename HashTableType::iterator
+HashTableType::bucket_front(size_type n) {
+  assert(n < bucket_count());
+  auto id = (*buckets_)[n];
+  return id == AllocatorType::kInvalidNodeID ? end()
+                                             : iterator(this, alloc_->Get(id));
+}
+
 HashTableTypeDeclaration typename HashTableType::size_type
 HashTableType::bucket(const key_type& k) const {
   auto hash = hasher()(k);
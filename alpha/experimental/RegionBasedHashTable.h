@@ -127,6 +127,8 @@ class RegionBasedHashTable<
   size_type bucket_count() const;
   size_type bucket(const key_type& k) const;
   size_type bucket_size(size_type n) const;
+  // 桶n中的第一个元素, 桶为空时返回end(), 用来逐个桶搬迁元素
+  iterator bucket_front(size_type n);
 
   iterator begin();
   const_iterator begin() const;
@@ -17,6 +17,7 @@
 #include <alpha/Slice.h>
 #include <alpha/Logger.h>
 #include <alpha/EventLoop.h>
+#include <alpha/EventLoopThreadPool.h>
 #include <alpha/TcpConnectionBuffer.h>
 #include <alpha/TcpConnection.h>
 #include <alpha/TcpServer.h>
@@ -24,13 +25,14 @@
 class EchoServer {
  public:
   EchoServer(alpha::EventLoop* loop, const alpha::NetAddress& addr)
-      : loop_(loop), server_(loop, addr) {}
+      : server_(loop, addr) {}
 
-  bool Run() {
+  bool Run(alpha::EventLoopThreadPool* pool) {
     using namespace std::placeholders;
     server_.SetOnNewConnection(
         std::bind(&EchoServer::OnNewConnection, this, _1));
     server_.SetOnRead(std::bind(&EchoServer::OnRead, this, _1, _2));
+    server_.SetThreadPool(pool, alpha::TcpServer::Dispatch::kReusePort);
     return server_.Run();
   }
 
@@ -50,12 +52,13 @@ class EchoServer {
     UpdateTimer(conn);
   }
 
+  // 连接的回调都在它自己的loop线程中执行, 定时器也要放到同一个loop上
   void UpdateTimer(alpha::TcpConnectionPtr& conn) {
     auto timerid = conn->GetContextPtr<alpha::TimerManager::TimerId>();
     if (timerid) {
-      loop_->RemoveTimer(*timerid);
+      conn->loop()->RemoveTimer(*timerid);
     }
-    auto timer_id = loop_->RunAfter(
+    auto timer_id = conn->loop()->RunAfter(
         kDefaultTimeout,
         std::bind(
             &EchoServer::KickOff, this, alpha::TcpConnectionWeakPtr(conn)));
@@ -67,24 +70,25 @@ class EchoServer {
       LOG_INFO << "Kickoff " << conn->PeerAddr();
       auto ctx = conn->GetContext();
       auto timer_id = boost::any_cast<alpha::TimerManager::TimerId>(ctx);
-      loop_->RemoveTimer(timer_id);
+      conn->loop()->RemoveTimer(timer_id);
       conn->Write("Timeout\n");
       conn->Close();
     }
   }
 
   const uint32_t kDefaultTimeout = 3000;
-  alpha::EventLoop* loop_;
   alpha::TcpServer server_;
 };
 
 int main(int argc, char* argv[]) {
   alpha::Logger::Init(argv[0]);
   alpha::Logger::set_logtostderr(true);
+  int threads = argc > 1 ? std::stoi(argv[1]) : 0;
   alpha::EventLoop loop;
+  alpha::EventLoopThreadPool pool(&loop, threads);
   alpha::NetAddress addr("127.0.0.1", 7890);
   EchoServer echo_server(&loop, addr);
-  if (!echo_server.Run()) {
+  if (!echo_server.Run(&pool)) {
     return EXIT_FAILURE;
   }
   loop.Run();
@@ -49,7 +49,8 @@ int NetSvrdApp::Init(const char* file) {
       for (const auto& interface : server.get_child("")) {
         if (interface.first != "Interface") continue;
         virtual_server->AddInterface(
-            interface.second.get<std::string>("<xmlattr>.addr"));
+            interface.second.get<std::string>("<xmlattr>.addr"),
+            interface.second.get<int>("<xmlattr>.threads", 0));
       }
       servers_.emplace_back(std::move(virtual_server));
     }
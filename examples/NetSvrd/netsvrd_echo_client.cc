@@ -20,7 +20,8 @@ static const std::string msg = "HELLO, WORLD!";
 static void SendFrame(alpha::TcpConnectionPtr conn) {
   auto frame = NetSvrdFrame::CreateUnique(msg.size());
   memcpy(frame->payload, msg.data(), msg.size());
-  conn->Write(frame->data(), frame->size());
+  alpha::Slice data(static_cast<const char*>(frame->data()), frame->size());
+  conn->Write(data, std::move(frame));
 }
 
 static void OnRead(alpha::TcpConnectionPtr conn,
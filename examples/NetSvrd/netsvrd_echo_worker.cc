@@ -11,7 +11,6 @@
  */
 
 #include <unistd.h>
-#include <iostream>
 #include <alpha/Logger.h>
 #include <alpha/ProcessBus.h>
 #include "netsvrd_frame.h"
@@ -29,17 +28,26 @@ int main(int argc, char* argv[]) {
     LOG_ERROR << "Restore bus from " << argv[2] << " failed";
     return EXIT_FAILURE;
   }
+  // 打开通知之后没有消息就睡眠, 否则只能轮询
+  const bool notification = bus.EnableNotification();
+  LOG_WARNING_IF(!notification) << "Enable notification failed, use polling";
+  // 超时只是保底, 正常情况下有消息会被唤醒
+  static const int kMaxWaitTime = 1000;  // milliseconds
 
   while (1) {
     int len;
-    auto data = bus.Read(&len);
+    auto data = bus.PeekContiguous(&len);
     if (data) {
       DLOG_INFO << "Receive data, len: " << len;
       auto internal_frame = reinterpret_cast<NetSvrdInternalFrame*>(data);
       DLOG_INFO << "Server id in frame: " << internal_frame->net_server_id;
       DLOG_INFO << "Client id in frame: " << internal_frame->client_id;
       bus.Write(data, len);
+      bus.Commit();
+    } else if (notification) {
+      bus.WaitForReadable(kMaxWaitTime);
+    } else {
+      usleep(1000);
     }
-    usleep(1000);
   }
 }
@@ -22,6 +22,8 @@ class NetSvrdFrameCodec final {
   NetSvrdFrameCodec();
   NetSvrdFrame::UniquePtr OnMessage(alpha::TcpConnectionPtr conn,
                                     alpha::TcpConnectionBuffer* buffer);
+  // 是否有读了一半的帧
+  bool HasPartialFrame() const { return frame_ != nullptr; }
 
  private:
   uint32_t read_payload_size_;
@@ -18,6 +18,7 @@
 #include <alpha/TcpServer.h>
 #include <alpha/IOBuffer.h>
 #include <alpha/UDPServer.h>
+#include <alpha/EventLoopThreadPool.h>
 #include "netsvrd_frame.h"
 
 using namespace std::placeholders;
@@ -71,7 +72,8 @@ NetSvrdVirtualServer::~NetSvrdVirtualServer() {
   // loop_->RemoveTimer(poll_workers_timer_id_);
 }
 
-bool NetSvrdVirtualServer::AddInterface(const std::string& addr) {
+bool NetSvrdVirtualServer::AddInterface(const std::string& addr,
+                                        int udp_threads) {
   NetSvrdAddressParser parser(addr);
   if (!parser.valid()) {
     LOG_ERROR << "Invalid addr: " << addr;
@@ -94,6 +96,13 @@ bool NetSvrdVirtualServer::AddInterface(const std::string& addr) {
     auto& server = p.first->second;
     server->SetMessageCallback(
         std::bind(&NetSvrdVirtualServer::OnUDPMessage, this, _1, _2, _3, _4));
+    if (udp_threads > 0) {
+      udp_pools_.emplace_back(
+          alpha::make_unique<alpha::EventLoopThreadPool>(loop_, udp_threads));
+      server->SetThreadPool(udp_pools_.rbegin()->get());
+      // 工作线程只负责收包, 写worker的bus还是在主线程
+      server->set_dispatch_to_base_loop(true);
+    }
   }
   return true;
 }
@@ -117,37 +126,47 @@ bool NetSvrdVirtualServer::Run() {
 }
 
 void NetSvrdVirtualServer::FlushWorkersOutput() {
+  for (auto& worker : workers_) {
+    // 打开了通知的worker有输出时会唤醒loop, 不需要轮询
+    if (!worker->bus()->notification_enabled()) {
+      FlushWorkerOutput(worker.get());
+    }
+  }
+}
+
+void NetSvrdVirtualServer::FlushWorkerOutput(NetSvrdWorker* worker) {
+  auto bus = worker->bus();
   char* data = nullptr;
   int len = 0;
-  for (auto& worker : workers_) {
-    do {
-      data = static_cast<char*>(worker->bus()->Read(&len));
-      if (data) {
-        DLOG_INFO << "Data len from worker: " << len;
-        auto internal_frame = reinterpret_cast<NetSvrdInternalFrame*>(data);
-        if (internal_frame->net_server_id != net_server_id_) {
-          LOG_WARNING << "Drop obsolete frame, old server id: "
-                      << internal_frame->net_server_id;
-          continue;
-        }
-        auto client_id = internal_frame->client_id;
-        if (client_id >= next_connection_id_) {
-          LOG_WARNING << "Invalid client id found, id: " << client_id;
-          continue;
-        }
-        auto it = connections_.find(client_id);
-        if (it == connections_.end()) {
-          LOG_INFO << "Frame to closed connection, id: " << client_id;
-          continue;
-        }
-        bool ok = it->second->Write(alpha::Slice(data, len));
-        if (!ok) {
-          LOG_WARNING << "Write to client failed";
-          continue;
-        }
-      }
-    } while (data);
+  do {
+    // 直接从共享内存发送, 发送完再出队
+    while ((data = static_cast<char*>(bus->PeekContiguous(&len)))) {
+      DLOG_INFO << "Data len from worker: " << len;
+      SendToClient(data, len);
+      bus->Commit();
+    }
+  } while (bus->notification_enabled() && !bus->PrepareWait());
+}
+
+void NetSvrdVirtualServer::SendToClient(const char* data, int len) {
+  auto internal_frame = reinterpret_cast<const NetSvrdInternalFrame*>(data);
+  if (internal_frame->net_server_id != net_server_id_) {
+    LOG_WARNING << "Drop obsolete frame, old server id: "
+                << internal_frame->net_server_id;
+    return;
   }
+  auto client_id = internal_frame->client_id;
+  if (client_id >= next_connection_id_) {
+    LOG_WARNING << "Invalid client id found, id: " << client_id;
+    return;
+  }
+  auto it = connections_.find(client_id);
+  if (it == connections_.end()) {
+    LOG_INFO << "Frame to closed connection, id: " << client_id;
+    return;
+  }
+  bool ok = it->second->Write(alpha::Slice(data, len));
+  LOG_WARNING_IF(!ok) << "Write to client failed";
 }
 
 void NetSvrdVirtualServer::OnConnected(alpha::TcpConnectionPtr conn) {
@@ -166,6 +185,10 @@ void NetSvrdVirtualServer::OnMessage(alpha::TcpConnectionPtr conn,
   auto ctx = conn->GetContextPtr<NetSvrdConnectionContext>();
   CHECK(ctx);
   while (buffer->Read().size() >= NetSvrdFrame::kHeaderSize) {
+    if (!ctx->codec->HasPartialFrame() &&
+        ForwardFrameInPlace(ctx->connection_id_, buffer)) {
+      continue;
+    }
     auto frame = ctx->codec->OnMessage(conn, buffer);
     if (conn->closed()) break;
     if (frame) {
@@ -217,6 +240,31 @@ void NetSvrdVirtualServer::OnFrame(uint64_t connection_id,
   LOG_WARNING_IF(!ok) << "Write to worker input bus failed, drop it";
 }
 
+bool NetSvrdVirtualServer::ForwardFrameInPlace(
+    uint64_t connection_id, alpha::TcpConnectionBuffer* buffer) {
+  // 完整的帧直接拷进worker的bus, 非法或者不完整的帧交给codec处理
+  auto data = buffer->Read();
+  auto header = NetSvrdFrame::CastHeaderOnly(data.data(), data.size());
+  if (header == nullptr || header->size() > data.size()) {
+    return false;
+  }
+  const int size = header->size();
+  auto worker = NextWorker();
+  CHECK(worker);
+  auto p = worker->bus()->Reserve(size);
+  if (p) {
+    memcpy(p, data.data(), size);
+    auto internal_frame = reinterpret_cast<NetSvrdInternalFrame*>(p);
+    internal_frame->client_id = connection_id;
+    internal_frame->net_server_id = net_server_id_;
+    worker->bus()->CommitReserved(size);
+  } else {
+    LOG_WARNING << "Write to worker input bus failed, drop it";
+  }
+  buffer->ConsumeBytes(size);
+  return true;
+}
+
 void NetSvrdVirtualServer::StartMonitorWorkers() {
   using namespace std::placeholders;
   CHECK(poll_workers_timer_id_ == 0);
@@ -241,12 +289,22 @@ NetSvrdWorkerPtr NetSvrdVirtualServer::SpawnWorker(int worker_id) {
   bool ok = bus.RestoreOrCreate(
       bus_path, kProcessBusSize, alpha::ProcessBus::QueueOrder::kReadFirst);
   CHECK(ok);
+  ok = bus.EnableNotification();
+  LOG_WARNING_IF(!ok) << "Enable notification failed, bus path: " << bus_path;
   std::vector<std::string> argv = {
       worker_path_, std::to_string(net_server_id_), bus_path};
   alpha::Subprocess::Options options;
   options.CloseOtherFds();
-  return alpha::make_unique<NetSvrdWorker>(
+  auto worker = alpha::make_unique<NetSvrdWorker>(
       alpha::Subprocess(argv, nullptr, options), std::move(bus));
+  if (ok) {
+    auto w = worker.get();
+    worker->WatchOutput(
+        loop_, std::bind(&NetSvrdVirtualServer::FlushWorkerOutput, this, w));
+    // 处理上一个worker遗留的输出, 同时登记等待
+    FlushWorkerOutput(w);
+  }
+  return worker;
 }
 
 void NetSvrdVirtualServer::PollWorkers() {
@@ -27,6 +27,7 @@ class IOBuffer;
 class EventLoop;
 class TcpServer;
 class UDPServer;
+class EventLoopThreadPool;
 class UDPSocket;
 }
 
@@ -67,13 +68,15 @@ class NetSvrdVirtualServer final {
   ~NetSvrdVirtualServer();
   DISABLE_COPY_ASSIGNMENT(NetSvrdVirtualServer);
 
-  bool AddInterface(const std::string& addr);
+  // udp_threads大于0时UDP接口用多个SO_REUSEPORT socket分到多个线程收包
+  bool AddInterface(const std::string& addr, int udp_threads = 0);
   bool Run();
   void FlushWorkersOutput();
 
  private:
   using TcpServerPtr = std::unique_ptr<alpha::TcpServer>;
   using UDPServerPtr = std::unique_ptr<alpha::UDPServer>;
+  using EventLoopThreadPoolPtr = std::unique_ptr<alpha::EventLoopThreadPool>;
   static const uint32_t kCheckWorkerStatusInterval = 30000;  // milliseconds
   void OnConnected(alpha::TcpConnectionPtr conn);
   void OnMessage(alpha::TcpConnectionPtr conn,
@@ -84,6 +87,10 @@ class NetSvrdVirtualServer final {
                     size_t buf_len,
                     const alpha::NetAddress& address);
   void OnFrame(uint64_t connection_id, NetSvrdFrame::UniquePtr&& frame);
+  bool ForwardFrameInPlace(uint64_t connection_id,
+                           alpha::TcpConnectionBuffer* buffer);
+  void FlushWorkerOutput(NetSvrdWorker* worker);
+  void SendToClient(const char* data, int len);
   void StartMonitorWorkers();
   void StopMonitorWorkers();
   NetSvrdWorkerPtr SpawnWorker(int worker_id);
@@ -98,6 +105,8 @@ class NetSvrdVirtualServer final {
   std::string bus_dir_;
   std::string worker_path_;
   std::vector<TcpServerPtr> tcp_servers_;
+  // UDPServer析构时会停止线程池, 所以线程池要在UDPServer之后析构
+  std::vector<EventLoopThreadPoolPtr> udp_pools_;
   std::map<alpha::NetAddress, UDPServerPtr> udp_servers_;
   std::vector<NetSvrdWorkerPtr> workers_;
   std::map<uint64_t, alpha::TcpConnection*> connections_;
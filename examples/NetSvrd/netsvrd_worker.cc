@@ -11,7 +11,23 @@
  */
 
 #include "netsvrd_worker.h"
+#include <alpha/Logger.h>
 
 NetSvrdWorker::NetSvrdWorker(const alpha::Subprocess& subprocess,
                              alpha::ProcessBus&& bus)
     : subprocess_(subprocess), bus_(std::move(bus)) {}
+
+NetSvrdWorker::~NetSvrdWorker() {
+  if (output_channel_) {
+    output_channel_->Remove();
+  }
+}
+
+void NetSvrdWorker::WatchOutput(alpha::EventLoop* loop,
+                                const std::function<void()>& cb) {
+  CHECK(bus_.notification_enabled());
+  CHECK(!output_channel_);
+  output_channel_.reset(new alpha::Channel(loop, bus_.notify_fd()));
+  output_channel_->set_read_callback(cb);
+  output_channel_->EnableReading();
+}
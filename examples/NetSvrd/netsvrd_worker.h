@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <functional>
+#include <alpha/Channel.h>
 #include <alpha/Compiler.h>
 #include <alpha/ProcessBus.h>
 #include <alpha/Subprocess.h>
@@ -19,13 +21,18 @@
 class NetSvrdWorker final {
  public:
   NetSvrdWorker(const alpha::Subprocess& subprocess, alpha::ProcessBus&& bus);
+  ~NetSvrdWorker();
   DISABLE_COPY_ASSIGNMENT(NetSvrdWorker);
 
   alpha::Subprocess* Process() { return &subprocess_; }
   alpha::ProcessBus* bus() { return &bus_; }
 
+  // bus打开了通知时, worker有输出会在loop中调用cb
+  void WatchOutput(alpha::EventLoop* loop, const std::function<void()>& cb);
+
  private:
   alpha::Subprocess subprocess_;
   alpha::ProcessBus bus_;
+  std::unique_ptr<alpha::Channel> output_channel_;
 };
 using NetSvrdWorkerPtr = std::unique_ptr<NetSvrdWorker>;
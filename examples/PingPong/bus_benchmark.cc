@@ -0,0 +1,154 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  bus_benchmark.cc
+ *        Created:  10/18/26 16:42:10
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  两个进程通过ProcessBus收发消息, 测试吞吐和往返延迟
+ *
+ * =============================================================================
+ */
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <alpha/Logger.h>
+#include <alpha/ProcessBus.h>
+
+enum MessageType : uint64_t {
+  kThroughput = 1,
+  kThroughputDone = 2,
+  kPing = 3,
+  kQuit = 4,
+};
+
+struct Message {
+  uint64_t type;
+  int64_t timestamp;
+};
+
+static int64_t NowInNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static void Send(alpha::ProcessBus* bus, const std::string& msg) {
+  while (!bus->Write(msg.data(), msg.size())) {
+    sched_yield();
+  }
+}
+
+static const Message* Receive(alpha::ProcessBus* bus, int* len) {
+  void* data;
+  while ((data = bus->PeekContiguous(len)) == nullptr) {
+    sched_yield();
+  }
+  return static_cast<const Message*>(data);
+}
+
+// 子进程: 统计吞吐消息, 回显ping消息
+static int RunPong(const std::string& path, int messages) {
+  alpha::ProcessBus bus;
+  if (!bus.RestoreFrom(path, alpha::ProcessBus::QueueOrder::kWriteFirst)) {
+    LOG_ERROR << "Restore bus from " << path << " failed";
+    return EXIT_FAILURE;
+  }
+  int received = 0;
+  while (1) {
+    int len;
+    auto msg = Receive(&bus, &len);
+    auto type = msg->type;
+    if (type == kPing) {
+      std::string reply(reinterpret_cast<const char*>(msg), len);
+      bus.Commit();
+      Send(&bus, reply);
+      continue;
+    }
+    bus.Commit();
+    if (type == kThroughput && ++received == messages) {
+      Message done = {kThroughputDone, 0};
+      Send(&bus, std::string(reinterpret_cast<char*>(&done), sizeof(done)));
+    } else if (type == kQuit) {
+      return EXIT_SUCCESS;
+    }
+  }
+}
+
+static void RunPing(alpha::ProcessBus* bus,
+                    int messages,
+                    int round_trips,
+                    int message_size) {
+  std::string msg(message_size, '\0');
+  auto header = reinterpret_cast<Message*>(&msg[0]);
+  int len;
+
+  header->type = kThroughput;
+  auto start = NowInNanoseconds();
+  for (int i = 0; i < messages; ++i) {
+    Send(bus, msg);
+  }
+  auto reply = Receive(bus, &len);
+  CHECK(reply->type == kThroughputDone);
+  bus->Commit();
+  auto elapsed = NowInNanoseconds() - start;
+  LOG_INFO << "throughput: " << messages * 1e9 / elapsed << " msgs/s, "
+           << static_cast<double>(messages) * message_size * 1e3 / elapsed
+           << " MB/s";
+
+  std::vector<int64_t> rtts;
+  rtts.reserve(round_trips);
+  header->type = kPing;
+  for (int i = 0; i < round_trips; ++i) {
+    header->timestamp = NowInNanoseconds();
+    Send(bus, msg);
+    reply = Receive(bus, &len);
+    CHECK(reply->type == kPing);
+    rtts.push_back(NowInNanoseconds() - reply->timestamp);
+    bus->Commit();
+  }
+  std::sort(rtts.begin(), rtts.end());
+  LOG_INFO << "round trip: p50 " << rtts[rtts.size() / 2] << " ns, p99 "
+           << rtts[rtts.size() * 99 / 100] << " ns, max " << rtts.back()
+           << " ns";
+
+  header->type = kQuit;
+  Send(bus, msg);
+}
+
+int main(int argc, char* argv[]) {
+  alpha::Logger::Init(argv[0]);
+  alpha::Logger::set_logtostderr(true);
+  int messages = argc > 1 ? std::stoi(argv[1]) : 1000000;
+  int round_trips = argc > 2 ? std::stoi(argv[2]) : 100000;
+  int message_size = argc > 3 ? std::stoi(argv[3]) : 64;
+  CHECK(message_size >= static_cast<int>(sizeof(Message)));
+  CHECK(round_trips > 0);
+
+  const std::string path =
+      "/tmp/alpha_bus_benchmark." + std::to_string(getpid());
+  alpha::ProcessBus bus;
+  if (!bus.CreateFrom(
+          path, 16 << 20, alpha::ProcessBus::QueueOrder::kReadFirst)) {
+    LOG_ERROR << "Create bus at " << path << " failed";
+    return EXIT_FAILURE;
+  }
+
+  auto pid = fork();
+  PCHECK(pid >= 0) << "fork failed";
+  if (pid == 0) {
+    return RunPong(path, messages);
+  }
+  LOG_INFO << "messages: " << messages << ", round trips: " << round_trips
+           << ", message size: " << message_size;
+  RunPing(&bus, messages, round_trips, message_size);
+  waitpid(pid, nullptr, 0);
+  ::unlink(path.c_str());
+  return EXIT_SUCCESS;
+}
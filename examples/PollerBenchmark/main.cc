@@ -0,0 +1,198 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  main.cc
+ *        Created:  10/18/26 14:20:45
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  Many connections doing small request/response exchanges,
+ *                  reports syscalls made by the library per message
+ *
+ * =============================================================================
+ */
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <atomic>
+#include <future>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <alpha/Logger.h>
+#include <alpha/EventLoop.h>
+#include <alpha/NetAddress.h>
+#include <alpha/TcpServer.h>
+#include <alpha/TcpConnection.h>
+
+// 只统计服务器线程的调用, 客户端用send/recv
+static std::atomic<std::thread::id> server_thread;
+static std::atomic<uint64_t> epoll_wait_calls(0);
+static std::atomic<uint64_t> epoll_ctl_calls(0);
+static std::atomic<uint64_t> read_calls(0);
+static std::atomic<uint64_t> write_calls(0);
+
+static bool InServerThread() {
+  return server_thread.load() == std::this_thread::get_id();
+}
+
+extern "C" {
+int __real_epoll_wait(int, struct epoll_event*, int, int);
+int __real_epoll_ctl(int, int, int, struct epoll_event*);
+ssize_t __real_read(int, void*, size_t);
+ssize_t __real_readv(int, const struct iovec*, int);
+ssize_t __real_write(int, const void*, size_t);
+ssize_t __real_writev(int, const struct iovec*, int);
+ssize_t __real_sendmsg(int, const struct msghdr*, int);
+
+int __wrap_epoll_wait(int epfd, struct epoll_event* events, int n, int t) {
+  if (InServerThread()) ++epoll_wait_calls;
+  return __real_epoll_wait(epfd, events, n, t);
+}
+
+int __wrap_epoll_ctl(int epfd, int op, int fd, struct epoll_event* event) {
+  if (InServerThread()) ++epoll_ctl_calls;
+  return __real_epoll_ctl(epfd, op, fd, event);
+}
+
+ssize_t __wrap_read(int fd, void* buf, size_t count) {
+  if (InServerThread()) ++read_calls;
+  return __real_read(fd, buf, count);
+}
+
+ssize_t __wrap_readv(int fd, const struct iovec* iov, int iovcnt) {
+  if (InServerThread()) ++read_calls;
+  return __real_readv(fd, iov, iovcnt);
+}
+
+ssize_t __wrap_write(int fd, const void* buf, size_t count) {
+  if (InServerThread()) ++write_calls;
+  return __real_write(fd, buf, count);
+}
+
+ssize_t __wrap_writev(int fd, const struct iovec* iov, int iovcnt) {
+  if (InServerThread()) ++write_calls;
+  return __real_writev(fd, iov, iovcnt);
+}
+
+ssize_t __wrap_sendmsg(int fd, const struct msghdr* msg, int flags) {
+  if (InServerThread()) ++write_calls;
+  return __real_sendmsg(fd, msg, flags);
+}
+}
+
+static const size_t kMessageSize = 32;
+static const uint32_t kHeaderSize = 4;
+
+static void OnRead(alpha::TcpConnectionPtr conn,
+                   alpha::TcpConnectionBuffer* buffer) {
+  size_t length;
+  const char* data = buffer->Read(&length);
+  while (length >= kMessageSize) {
+    // 模拟先写包头再写包体的协议编码
+    uint32_t header = kMessageSize;
+    conn->Write(&header, kHeaderSize);
+    conn->Write(data, kMessageSize);
+    buffer->ConsumeBytes(kMessageSize);
+    data = buffer->Read(&length);
+  }
+}
+
+static int Connect(const alpha::NetAddress& addr) {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  PCHECK(fd >= 0) << "socket failed";
+  int nodelay = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+  struct sockaddr_in sock_addr = addr.ToSockAddr();
+  int ret = ::connect(
+      fd, reinterpret_cast<sockaddr*>(&sock_addr), sizeof(sock_addr));
+  PCHECK(ret == 0) << "connect failed";
+  return fd;
+}
+
+int main(int argc, char* argv[]) {
+  alpha::Logger::Init(argv[0]);
+  alpha::Logger::set_logtostderr(true);
+  alpha::Logger::set_minloglevel(alpha::kLogLevelWarning);
+  int connections = argc > 1 ? std::stoi(argv[1]) : 10000;
+  int rounds = argc > 2 ? std::stoi(argv[2]) : 10;
+  int port = argc > 3 ? std::stoi(argv[3]) : 7891;
+  bool edge_triggered = argc > 4 && std::string(argv[4]) == "et";
+
+  struct rlimit limit;
+  ::getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  ::setrlimit(RLIMIT_NOFILE, &limit);
+  rlim_t max_connections = (limit.rlim_cur - 64) / 2;
+  if (static_cast<rlim_t>(connections) > max_connections) {
+    LOG_WARNING << "RLIMIT_NOFILE too small, use " << max_connections
+                << " connections";
+    connections = max_connections;
+  }
+
+  alpha::EventLoop loop;
+  alpha::NetAddress addr("127.0.0.1", port);
+  alpha::TcpServer server(&loop, addr);
+  server.SetOnRead(OnRead);
+  server.set_edge_triggered(edge_triggered);
+  CHECK(server.Run());
+  // Listen是在loop里执行的, 等它完成之后再连接
+  std::promise<void> listening;
+  loop.QueueInLoop([&listening] { listening.set_value(); });
+  std::thread server_thread_handle([&loop] {
+    server_thread = std::this_thread::get_id();
+    loop.Run();
+  });
+
+  listening.get_future().wait();
+  std::vector<int> fds;
+  for (int i = 0; i < connections; ++i) {
+    fds.push_back(Connect(addr));
+  }
+
+  std::string message(kMessageSize, 'x');
+  std::vector<char> reply(kHeaderSize + kMessageSize);
+  // 等所有连接都被accept之后再开始统计
+  for (auto fd : fds) {
+    ::send(fd, message.data(), message.size(), 0);
+    ::recv(fd, reply.data(), reply.size(), MSG_WAITALL);
+  }
+  epoll_wait_calls = epoll_ctl_calls = read_calls = write_calls = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; ++round) {
+    for (auto fd : fds) {
+      ::send(fd, message.data(), message.size(), 0);
+    }
+    for (auto fd : fds) {
+      ssize_t n = ::recv(fd, reply.data(), reply.size(), MSG_WAITALL);
+      CHECK(n == static_cast<ssize_t>(reply.size())) << "recv failed: " << n;
+    }
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start).count();
+
+  double messages = static_cast<double>(connections) * rounds;
+  uint64_t total =
+      epoll_wait_calls + epoll_ctl_calls + read_calls + write_calls;
+  LOG_WARNING << "connections: " << connections << ", rounds: " << rounds
+              << (edge_triggered ? ", edge triggered" : "")
+              << ", " << messages * 1000000 / elapsed << " msgs/s";
+  LOG_WARNING << "syscalls per message: " << total / messages
+              << " (epoll_wait: " << epoll_wait_calls / messages
+              << ", epoll_ctl: " << epoll_ctl_calls / messages
+              << ", read: " << read_calls / messages
+              << ", write: " << write_calls / messages << ")";
+
+  for (auto fd : fds) {
+    ::close(fd);
+  }
+  loop.QueueInLoop([&loop] { loop.Quit(); });
+  server_thread_handle.join();
+  return 0;
+}
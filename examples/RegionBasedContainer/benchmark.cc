@@ -0,0 +1,126 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  benchmark.cc
+ *        Created:  10/18/26 15:40:12
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  链式的RegionBasedHashMap和开放寻址的RegionBasedFlatHashMap
+ *                  在不同负载下的插入和查找耗时
+ *
+ * =============================================================================
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_set>
+#include <vector>
+#include <alpha/Random.h>
+#include <alpha/experimental/RegionBasedHashMap.h>
+#include <alpha/experimental/RegionBasedFlatHashMap.h>
+
+template <typename F>
+static double NanosecondsPerOp(size_t ops, F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / ops;
+}
+
+// 元素个数相同, 按每个元素平均占用的空间算出达到指定负载需要的内存大小
+template <typename MapType>
+static void Benchmark(const char* name,
+                      std::vector<__uint128_t>* buf,
+                      size_t n,
+                      int load) {
+  auto data = reinterpret_cast<char*>(buf->data());
+  auto probe = MapType::Create(data, buf->size() * sizeof(__uint128_t));
+  if (!probe) {
+    fprintf(stderr, "Create %s failed\n", name);
+    return;
+  }
+  double bytes_per_element =
+      static_cast<double>(buf->size() * sizeof(__uint128_t)) /
+      probe->max_size();
+  size_t size = static_cast<size_t>(n * 100 / load * bytes_per_element);
+  auto m = MapType::Create(data, size);
+  if (!m || m->max_size() < n) {
+    fprintf(stderr, "Create %s failed, size: %zu\n", name, size);
+    return;
+  }
+  std::unordered_set<uint32_t> unique(2 * n);
+  std::vector<uint32_t> keys;
+  while (keys.size() < n) {
+    auto key = alpha::Random::Rand32();
+    if (unique.insert(key).second) {
+      keys.push_back(key);
+    }
+  }
+  std::vector<uint32_t> missing;
+  while (missing.size() < n) {
+    auto key = alpha::Random::Rand32();
+    if (unique.count(key) == 0) {
+      missing.push_back(key);
+    }
+  }
+
+  auto insert = NanosecondsPerOp(n, [&] {
+    for (auto key : keys) {
+      m->insert(alpha::make_pod_pair(key, uint64_t(key)));
+    }
+  });
+  alpha::Random::Shuffle(keys.begin(), keys.end());
+  uint64_t sum = 0;
+  auto hit = NanosecondsPerOp(n, [&] {
+    for (auto key : keys) {
+      sum += m->find(key)->second;
+    }
+  });
+  size_t misses = 0;
+  auto miss = NanosecondsPerOp(n, [&] {
+    for (auto key : missing) {
+      misses += m->find(key) == m->end();
+    }
+  });
+  size_t iterated = 0;
+  auto iterate = NanosecondsPerOp(n, [&] {
+    for (const auto& p : *m) {
+      sum -= p.second;
+      ++iterated;
+    }
+  });
+  if (sum != 0 || misses != n || iterated != n) {
+    fprintf(stderr, "%s: unexpected result\n", name);
+  }
+  printf("%-8s %3d%% %10zu %10.1f %10.1f %10.1f %10.1f\n",
+         name,
+         load,
+         size >> 10,
+         insert,
+         hit,
+         miss,
+         iterate);
+}
+
+int main(int argc, char* argv[]) {
+  size_t n = argc > 1 ? atoi(argv[1]) : 1000000;
+  // 最低负载时需要的内存最多, 按16字节对齐
+  std::vector<__uint128_t> buf(n * 2 * 64 / sizeof(__uint128_t));
+  printf("elements: %zu, time in ns/op\n", n);
+  printf("%-8s %4s %10s %10s %10s %10s %10s\n",
+         "table",
+         "load",
+         "size(KiB)",
+         "insert",
+         "find",
+         "miss",
+         "iterate");
+  for (int load = 50; load <= 90; load += 10) {
+    Benchmark<alpha::RegionBasedHashMap<uint32_t, uint64_t>>(
+        "chained", &buf, n, load);
+    Benchmark<alpha::RegionBasedFlatHashMap<uint32_t, uint64_t>>(
+        "flat", &buf, n, load);
+  }
+}
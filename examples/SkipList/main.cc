@@ -10,16 +10,77 @@
  * ==============================================================================
  */
 
+#include <chrono>
 #include <map>
 #include <vector>
 #include <alpha/SkipList.h>
 #include <alpha/Logger.h>
 #include <alpha/Random.h>
 
-int main(int argc, char* argv[]) {
+using MapType = alpha::SkipList<uint32_t, uint32_t>;
+
+// 旧的布局中每个节点都带20个前向指针
+struct LegacyNode {
+  uint32_t prev;
+  uint32_t level;
+  uint32_t levels[20];
+  MapType::value_type val;
+};
+
+template <typename F>
+static double NanosecondsPerOp(size_t ops, F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / ops;
+}
+
+static void Benchmark(size_t buffer_size) {
+  std::vector<char> buf(buffer_size);
+  auto m = MapType::Create(buf.data(), buf.size());
+  CHECK(m);
+  LOG_INFO << "Buffer size: " << buffer_size
+           << ", legacy capacity: " << buffer_size / sizeof(LegacyNode)
+           << ", capacity: " << m->max_size();
+
+  std::vector<uint32_t> keys;
+  std::map<uint32_t, uint32_t> ordered;
+  while (ordered.size() < m->max_size()) {
+    auto key = alpha::Random::Rand32();
+    if (ordered.emplace(key, key).second) {
+      keys.push_back(key);
+    }
+  }
+  auto insert = NanosecondsPerOp(keys.size(), [&] {
+    for (auto key : keys) {
+      m->insert(std::make_pair(key, key));
+    }
+  });
+  CHECK(m->size() == m->max_size());
+
+  for (size_t i = keys.size() - 1; i > 0; --i) {
+    std::swap(keys[i], keys[alpha::Random::Rand32() % (i + 1)]);
+  }
+  uint64_t sum = 0;
+  auto lookup = NanosecondsPerOp(keys.size(), [&] {
+    for (auto key : keys) {
+      sum += m->find(key)->second;
+    }
+  });
+  auto map_lookup = NanosecondsPerOp(keys.size(), [&] {
+    for (auto key : keys) {
+      sum -= ordered.find(key)->second;
+    }
+  });
+  CHECK(sum == 0);
+  LOG_INFO << "insert: " << insert << " ns, find: " << lookup
+           << " ns, std::map find: " << map_lookup << " ns";
+}
+
+int main(int, char* argv[]) {
   alpha::Logger::Init(argv[0]);
   alpha::Logger::set_logtostderr(true);
-  using MapType = alpha::SkipList<uint32_t, uint32_t>;
   std::vector<char> buf(1 << 20);
   auto m = MapType::Create(buf.data(), buf.size());
   CHECK(m);
@@ -36,4 +97,7 @@ int main(int argc, char* argv[]) {
   m->erase(it);
 
   LOG_INFO << "After erase, size: " << m->size();
+
+  Benchmark(1 << 20);
+  Benchmark(16 << 20);
 }
@@ -73,6 +73,9 @@ std::unique_ptr<T> MakeFromMemoryMappedFile(alpha::MemoryMappedFile* file) {
 const size_t ServerApp::kRankDataRegionSize = 1 << 16;
 const size_t ServerApp::kRankDataPaddingSize = 1 << 14;
 const size_t ServerApp::kRankMax = 1000;
+// 各个Routine里有大量protobuf对象, 栈比较深, 用独立的栈避免每次切换都拷贝
+const alpha::Coroutine::StackMode ServerApp::kRoutineStackMode =
+    alpha::Coroutine::StackMode::kDedicated;
 const char ServerApp::kBattleDataKey[] = "BattleData";
 const char ServerApp::kWarriorsDataKey[] = "WarriorsData";
 const char ServerApp::kRewardsDataKey[] = "RewardsData";
@@ -205,7 +208,9 @@ int ServerApp::InitNormalMode() {
         return EXIT_FAILURE;
       }
     } else {
-      bool ok = rank->RestoreFrom(data, kRankDataRegionSize);
+      auto legacy_backup = conf_->rank_data_file() + ".legacy_season_" +
+                           std::to_string(zone_id);
+      bool ok = rank->RestoreFrom(data, kRankDataRegionSize, legacy_backup);
       if (!ok) {
         LOG_ERROR << "Restore rank failed, zone: " << zone_id;
         return EXIT_FAILURE;
@@ -232,7 +237,9 @@ int ServerApp::InitNormalMode() {
         return EXIT_FAILURE;
       }
     } else {
-      bool ok = rank->RestoreFrom(data, kRankDataRegionSize);
+      auto legacy_backup = conf_->rank_data_file() + ".legacy_history_" +
+                           std::to_string(zone_id);
+      bool ok = rank->RestoreFrom(data, kRankDataRegionSize, legacy_backup);
       if (!ok) {
         LOG_ERROR << "Restore rank failed, zone: " << zone_id;
         return EXIT_FAILURE;
@@ -253,8 +260,16 @@ int ServerApp::InitNormalMode() {
     camp->AddWarrior(warrior.uin(), dead);
   }
 
-  http_server_.SetCallback(
-      std::bind(&ServerApp::HandleHTTPMessage, this, _1, _2));
+  http_router_.Add(
+      "GET", "/status", std::bind(&ServerApp::HandleHTTPStatus, this, _1, _2));
+  http_router_.Add("GET",
+                   "/warrior",
+                   std::bind(&ServerApp::HandleHTTPWarrior, this, _1, _2));
+  http_router_.Add(
+      "GET", "/backup", std::bind(&ServerApp::HandleHTTPBackup, this, _1, _2));
+  http_router_.Add(
+      "GET", "/dump", std::bind(&ServerApp::HandleHTTPDump, this, _1, _2));
+  http_server_.SetRouter(&http_router_);
 
 #define THRONES_BATTLE_REGISTER_HANDLER(ReqType, RespType, Handler) \
   message_dispatcher_.Register<ReqType, RespType>(                  \
@@ -298,8 +313,10 @@ int ServerApp::InitNormalMode() {
 
 int ServerApp::InitRecoveryMode(const char* server_id, const char* suffix) {
   loop_.QueueInLoop([this, server_id, suffix] {
-    async_tcp_client_.RunInCoroutine(std::bind(
-        &ServerApp::RecoveryRoutine, this, _1, _2, server_id, suffix));
+    async_tcp_client_.RunInCoroutine(
+        std::bind(
+            &ServerApp::RecoveryRoutine, this, _1, _2, server_id, suffix),
+        kRoutineStackMode);
   });
   return EXIT_SUCCESS;
 }
@@ -866,7 +883,8 @@ void ServerApp::AddTimerForBackup() {
   DLOG_INFO << "Check backup interval: " << check_interval;
   loop_.RunEvery(check_interval, [this] {
     async_tcp_client_.RunInCoroutine(
-        std::bind(&ServerApp::BackupRoutine, this, _1, _2, true));
+        std::bind(&ServerApp::BackupRoutine, this, _1, _2, true),
+        kRoutineStackMode);
   });
 }
 
@@ -933,7 +951,8 @@ void ServerApp::RunBattleTask(BattleTask task) {
                                              _2,
                                              task.zone,
                                              task.one,
-                                             task.the_other));
+                                             task.the_other),
+                                   kRoutineStackMode);
 }
 
 void ServerApp::StartAllZonesToCurrentRound() {
@@ -20,6 +20,7 @@
 #include <alpha/UDPServer.h>
 #include <alpha/File.h>
 #include <alpha/SimpleHTTPServer.h>
+#include <alpha/HTTPRouter.h>
 #include <alpha/experimental/RegionBasedHashMap.h>
 #include "ThronesBattleSvrdDef.h"
 #include "ThronesBattleSvrdMessageDispatcher.h"
@@ -71,6 +72,7 @@ class ServerApp final {
   static const char kWarriorsDataKey[];
   static const char kRewardsDataKey[];
   static const char kRankDataKey[];
+  static const alpha::Coroutine::StackMode kRoutineStackMode;
   int InitNormalMode();
   int InitRecoveryMode(const char* server_id, const char* suffix);
   bool CreatePidFile();
@@ -157,8 +159,14 @@ class ServerApp final {
                              QueryWarriorRankResponse* resp);
 
   // Handlers for HTTP message admin
-  void HandleHTTPMessage(alpha::TcpConnectionPtr conn,
-                         const alpha::HTTPMessage& message);
+  void HandleHTTPStatus(alpha::TcpConnectionPtr conn,
+                        const alpha::HTTPRequest& request);
+  void HandleHTTPWarrior(alpha::TcpConnectionPtr conn,
+                         const alpha::HTTPRequest& request);
+  void HandleHTTPBackup(alpha::TcpConnectionPtr conn,
+                        const alpha::HTTPRequest& request);
+  void HandleHTTPDump(alpha::TcpConnectionPtr conn,
+                      const alpha::HTTPRequest& request);
   alpha::EventLoop loop_;
   std::unique_ptr<ServerConf> conf_;
   alpha::MemoryMappedFile battle_data_file_;
@@ -178,6 +186,7 @@ class ServerApp final {
   alpha::AsyncTcpClient async_tcp_client_;
   MessageDispatcher message_dispatcher_;
   alpha::UDPServer udp_server_;
+  alpha::HTTPRouter http_router_;
   alpha::SimpleHTTPServer http_server_;
 };
 }
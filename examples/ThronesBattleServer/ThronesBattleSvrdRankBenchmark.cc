@@ -0,0 +1,166 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  ThronesBattleSvrdRankBenchmark.cc
+ *        Created:  10/18/26 14:26:37
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  回放一个赛季的击杀上报, 对比RankVector和原来的
+ *                  线性查找 + stable_sort实现
+ *
+ * =============================================================================
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include <alpha/Logger.h>
+#include <alpha/Random.h>
+#include "ThronesBattleSvrdRankVector.h"
+
+using ThronesBattle::RankVector;
+using ThronesBattle::RankVectorUnit;
+
+// 原来的实现, 每次上报都要线性查找再整体排序
+class NaiveRankVector {
+ public:
+  NaiveRankVector(size_t max) : max_(max) {}
+
+  void Report(uint32_t uin, uint32_t val) {
+    RankVectorUnit u;
+    u.uin = uin;
+    u.val = val;
+    auto it = std::find(v_.begin(), v_.end(), u);
+    if (it != v_.end()) {
+      it->val = val;
+    } else if (v_.size() < max_) {
+      v_.push_back(u);
+    } else if (u > v_.back()) {
+      v_.back() = u;
+    } else {
+      return;
+    }
+    std::stable_sort(v_.begin(), v_.end(), std::greater<RankVectorUnit>());
+  }
+
+  unsigned Rank(uint32_t uin) const {
+    RankVectorUnit u;
+    u.uin = uin;
+    auto it = std::find(v_.begin(), v_.end(), u);
+    return it == v_.end() ? 0 : std::distance(v_.begin(), it) + 1;
+  }
+
+  const std::vector<RankVectorUnit>& units() const { return v_; }
+
+ private:
+  size_t max_;
+  std::vector<RankVectorUnit> v_;
+};
+
+struct Kill {
+  uint32_t uin;
+  uint32_t killing_num;
+};
+
+// 每一轮所有人随机两两对战, 输的出局, 直到剩下一个人
+static std::vector<Kill> GenerateSeason(uint32_t warriors, int rounds) {
+  std::vector<uint32_t> killing_nums(warriors + 1);
+  std::vector<Kill> kills;
+  for (int round = 0; round < rounds; ++round) {
+    std::vector<uint32_t> alive(warriors);
+    for (uint32_t i = 0; i < warriors; ++i) {
+      alive[i] = i + 1;
+    }
+    while (alive.size() > 1) {
+      alpha::Random::Shuffle(alive.begin(), alive.end());
+      std::vector<uint32_t> winners;
+      for (size_t i = 0; i + 1 < alive.size(); i += 2) {
+        auto winner = alpha::Random::Rand32(2) ? alive[i] : alive[i + 1];
+        kills.push_back({winner, ++killing_nums[winner]});
+        winners.push_back(winner);
+      }
+      if (alive.size() % 2) {
+        winners.push_back(alive.back());
+      }
+      alive.swap(winners);
+    }
+  }
+  return kills;
+}
+
+template <typename F>
+static double NanosecondsPerOp(size_t ops, F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / ops;
+}
+
+int main(int argc, char* argv[]) {
+  alpha::Logger::Init(argv[0]);
+  alpha::Logger::set_logtostderr(true);
+  // 和ServerApp中的kRankMax, kRankDataRegionSize保持一致
+  const size_t kRankMax = 1000;
+  const size_t kRegionSize = 1 << 16;
+  uint32_t warriors = argc > 1 ? std::atoi(argv[1]) : 10000;
+  int rounds = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  auto kills = GenerateSeason(warriors, rounds);
+  LOG_INFO << "Warriors: " << warriors << ", rounds: " << rounds
+           << ", kills: " << kills.size();
+
+  // mmap出来的内存是对齐的, 这里也要按16字节对齐
+  std::vector<uint64_t> region(kRegionSize / sizeof(uint64_t) + 1);
+  auto data = reinterpret_cast<char*>(alpha::Align(
+      reinterpret_cast<char*>(region.data())));
+  RankVector rank(kRankMax);
+  CHECK(rank.CreateFrom(data, kRegionSize));
+  NaiveRankVector naive(kRankMax);
+
+  auto report = NanosecondsPerOp(kills.size(), [&] {
+    for (const auto& kill : kills) {
+      rank.Report(kill.uin, kill.killing_num);
+    }
+  });
+  auto naive_report = NanosecondsPerOp(kills.size(), [&] {
+    for (const auto& kill : kills) {
+      naive.Report(kill.uin, kill.killing_num);
+    }
+  });
+
+  // 结果要和原来的实现完全一致
+  auto units = rank.GetRange(0, kRankMax);
+  CHECK(units.size() == naive.units().size());
+  for (size_t i = 0; i < units.size(); ++i) {
+    CHECK(units[i].uin == naive.units()[i].uin &&
+          units[i].val == naive.units()[i].val)
+        << "Mismatch at " << i;
+  }
+
+  uint64_t sum = 0;
+  auto query = NanosecondsPerOp(warriors, [&] {
+    for (uint32_t uin = 1; uin <= warriors; ++uin) {
+      sum += rank.Rank(uin);
+    }
+  });
+  auto naive_query = NanosecondsPerOp(warriors, [&] {
+    for (uint32_t uin = 1; uin <= warriors; ++uin) {
+      sum -= naive.Rank(uin);
+    }
+  });
+  CHECK(sum == 0);
+
+  // 重新挂载同一块内存, 排行榜不变
+  RankVector restored(kRankMax);
+  CHECK(restored.RestoreFrom(data, kRegionSize));
+  CHECK(restored.Size() == units.size());
+  for (size_t i = 0; i < units.size(); ++i) {
+    CHECK(restored.Rank(units[i].uin) == i + 1);
+  }
+
+  LOG_INFO << "Report: " << report << " ns, naive Report: " << naive_report
+           << " ns, Rank: " << query << " ns, naive Rank: " << naive_query
+           << " ns";
+}
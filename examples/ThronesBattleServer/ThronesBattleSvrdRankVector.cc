@@ -10,7 +10,9 @@
  * =============================================================================
  */
 
+#include <algorithm>
 #include <iterator>
+#include <alpha/FileUtil.h>
 #include <alpha/Logger.h>
 #include "ThronesBattleSvrdRankVector.h"
 
@@ -24,95 +26,248 @@ bool operator>(const RankVectorUnit& lhs, const RankVectorUnit& rhs) {
   return lhs.val > rhs.val;
 }
 
+const uint64_t RankVector::kMagic = 0x3c5a1f0e7b2d4e61;
+const uint64_t RankVector::kConvertingMagic = 0x3c5a1f0e7b2d4e60;
+
 RankVector::RankVector(size_t max) : max_(max) {}
 
 bool RankVector::CreateFrom(char* data, size_t size) {
-  auto v = VectorType::Create(data, size);
-  if (!v) {
-    LOG_ERROR << "Create RankVector failed, size: " << size;
+  if (size >= sizeof(Header)) {
+    reinterpret_cast<Header*>(data)->magic = 0;
+  }
+  if (!Init(data, size, true)) {
+    LOG_ERROR << "Create RankVector failed, size: " << size
+              << ", max: " << max_;
+    return false;
+  }
+  // 最后写magic, 创建到一半时不会被当成有效数据
+  header_->magic = kMagic;
+  return true;
+}
+
+bool RankVector::RestoreFrom(char* data,
+                             size_t size,
+                             const std::string& legacy_backup) {
+  auto header = reinterpret_cast<Header*>(data);
+  if (size >= sizeof(Header) && header->magic == kConvertingMagic) {
+    // 上次转换到一半, 从备份恢复旧的数据重新转换
+    if (legacy_backup.empty() ||
+        !alpha::ReadFileExactly(legacy_backup, data, size)) {
+      LOG_ERROR << "Read legacy RankVector backup failed, backup: "
+                << legacy_backup;
+      return false;
+    }
+  }
+  bool ok = size >= sizeof(Header) && header->magic == kMagic
+                ? Init(data, size, false)
+                : RestoreLegacy(data, size, legacy_backup);
+  if (!ok) {
+    LOG_ERROR << "Restore RankVector failed, size: " << size
+              << ", max: " << max_;
+    return false;
+  }
+  CheckIndex();
+  return true;
+}
+
+bool RankVector::Init(char* data, size_t size, bool create) {
+  if (size < sizeof(Header)) {
+    return false;
+  }
+  auto header = reinterpret_cast<Header*>(data);
+  auto start = data + sizeof(Header);
+  auto left = size - sizeof(Header);
+  std::unique_ptr<ListType> list;
+  if (create) {
+    // 跳表能多放一个, Report时先插入新的再删掉旧的
+    // 剩下的空间都给哈希表
+    static const size_t kStep = 1 << 10;
+    uint32_t list_size = kStep;
+    for (; list_size < left; list_size += kStep) {
+      list = ListType::Create(start, list_size);
+      if (list && list->max_size() > max_) {
+        break;
+      }
+    }
+    header->next_seq = 0;
+    header->list_size = list_size;
+  } else if (header->list_size < left) {
+    list = ListType::Restore(start, header->list_size);
+  }
+  if (!list || list->max_size() <= max_) {
+    return false;
+  }
+
+  auto index_start = alpha::Align(start + header->list_size);
+  if (index_start >= data + size) {
     return false;
   }
-  if (v->max_size() < max_) {
-    LOG_ERROR << "RankVector size is too small, expect: " << max_
-              << ", actual: " << v->max_size();
+  auto index_size = data + size - index_start;
+  auto index = create ? IndexType::Create(index_start, index_size)
+                      : IndexType::Restore(index_start, index_size);
+  if (!index || index->max_size() < max_) {
+    LOG_ERROR << "RankVector index is too small, expect: " << max_
+              << ", actual: " << (index ? index->max_size() : 0);
     return false;
   }
-  v_ = std::move(v);
+  header_ = header;
+  list_ = std::move(list);
+  index_ = std::move(index);
   return true;
 }
 
-bool RankVector::RestoreFrom(char* data, size_t size) {
-  auto v = VectorType::Restore(data, size);
+bool RankVector::RestoreLegacy(char* data,
+                               size_t size,
+                               const std::string& legacy_backup) {
+  auto v = LegacyVectorType::Restore(data, size);
   if (!v) {
-    LOG_ERROR << "Restore RankVector failed, size: " << size;
     return false;
   }
-  if (v->max_size() < max_) {
-    LOG_ERROR << "RankVector size is too small, expect: " << max_
-              << ", actual: " << v->max_size();
+  // 先把数据拷出来, 再在原来的内存上按新的布局重建
+  std::vector<RankVectorUnit> units(v->begin(), v->end());
+  if (units.size() > max_) {
+    LOG_ERROR << "Too many units in legacy RankVector, size: " << units.size();
+    return false;
+  }
+  if (legacy_backup.empty()) {
+    LOG_ERROR << "No backup file to convert legacy RankVector";
     return false;
   }
-  v_ = std::move(v);
+  // 旧的数据完整写到磁盘之后才能覆盖
+  if (!alpha::WriteFileAtomically(legacy_backup, data, size)) {
+    PLOG_ERROR << "Write legacy RankVector backup failed, backup: "
+               << legacy_backup;
+    return false;
+  }
+  std::vector<char> backup(data, data + size);
+  reinterpret_cast<Header*>(data)->magic = kConvertingMagic;
+  if (!Init(data, size, true)) {
+    memcpy(data, backup.data(), size);
+    alpha::DeleteFile(legacy_backup);
+    return false;
+  }
+  // 旧的数据已经排好序, 按顺序插入就保持了相同val之间的先后
+  for (const auto& u : units) {
+    Insert(u.uin, u.val);
+  }
+  // 全部插入之后再写magic, 转换到一半时不会被当成完整的新布局
+  header_->magic = kMagic;
+  alpha::DeleteFile(legacy_backup);
+  LOG_INFO << "Convert legacy RankVector, size: " << units.size();
   return true;
 }
 
+void RankVector::CheckIndex() {
+  bool consistent = index_->size() == list_->size();
+  for (auto it = list_->begin(); consistent && it != list_->end(); ++it) {
+    auto index_it = index_->find(it->second);
+    consistent = index_it != index_->end() &&
+                 index_it->second.val == it->first.val &&
+                 index_it->second.seq == it->first.seq;
+  }
+  if (consistent) {
+    return;
+  }
+
+  LOG_WARNING << "RankVector index is inconsistent, rebuild it"
+              << ", list size: " << list_->size()
+              << ", index size: " << index_->size();
+  // 同一个uin出现多次时只保留最新的那一条
+  index_->clear();
+  std::vector<RankKey> stale;
+  for (const auto& p : *list_) {
+    auto res = index_->insert(alpha::make_pod_pair(p.second, p.first));
+    if (!res.second) {
+      auto& key = res.first->second;
+      if (key.seq < p.first.seq) {
+        stale.push_back(key);
+        key = p.first;
+      } else {
+        stale.push_back(p.first);
+      }
+    }
+  }
+  for (const auto& key : stale) {
+    list_->erase(key);
+  }
+  // 最后一次Report可能已经插入新的再删除旧的之前中断, 这时会超出max_
+  while (list_->size() > max_) {
+    auto last = list_->end();
+    --last;
+    index_->erase(last->second);
+    list_->erase(last);
+  }
+}
+
 size_t RankVector::Size() const {
-  CHECK(v_);
-  return v_->size();
+  CHECK(list_);
+  return list_->size();
 }
 
 void RankVector::Clear() {
-  CHECK(v_);
-  v_->clear();
+  CHECK(list_);
+  index_->clear();
+  list_->clear();
+  header_->next_seq = 0;
 }
 
 void RankVector::Report(uint32_t uin, uint32_t val) {
-  auto rank = Rank(uin);
-  if (rank == 0) {
+  CHECK(list_);
+  auto it = index_->find(uin);
+  if (it == index_->end()) {
     // 还不在榜
-    RankVectorUnit u;
-    u.uin = uin;
-    u.val = val;
-    if (v_->size() < max_) {
-      v_->push_back(u);
-    } else if (u > v_->back()) {
-      v_->back() = u;
-    } else {
-      return;
+    if (list_->size() >= max_) {
+      auto last = list_->end();
+      --last;
+      if (val <= last->first.val) {
+        return;
+      }
+      index_->erase(last->second);
+      list_->erase(last);
     }
+    Insert(uin, val);
+  } else if (it->second.val != val) {
+    auto old = it->second;
+    Insert(uin, val);
+    list_->erase(old);
+  }
+}
+
+void RankVector::Insert(uint32_t uin, uint32_t val) {
+  RankKey key;
+  key.val = val;
+  key.seq = header_->next_seq++;
+  auto res = list_->insert(std::make_pair(key, uin));
+  CHECK(res.second);
+  auto it = index_->find(uin);
+  if (it == index_->end()) {
+    CHECK(index_->insert(alpha::make_pod_pair(uin, key)).second);
   } else {
-    auto it = std::next(v_->begin(), rank - 1);
-    it->val = val;
+    it->second = key;
   }
-  KeepOrdered();
 }
 
 unsigned RankVector::Rank(uint32_t uin) const {
-  CHECK(v_);
-  RankVectorUnit u;
-  u.uin = uin;
-  auto it = std::find(v_->begin(), v_->end(), u);
-  return it == v_->end() ? 0 : std::distance(v_->begin(), it) + 1;
+  CHECK(list_);
+  auto it = index_->find(uin);
+  return it == index_->end() ? 0 : list_->rank(it->second) + 1;
 }
 
 std::vector<RankVectorUnit> RankVector::GetRange(unsigned start,
                                                  unsigned num) const {
-  CHECK(v_);
+  CHECK(list_);
   std::vector<RankVectorUnit> v;
-  if (v_->size() <= start) {
+  if (list_->size() <= start) {
     return v;
   }
-  auto left = v_->size() - start;
-  num = std::min<unsigned>(num, left);
-
-  auto first = std::next(v_->begin(), start);
-  auto last = std::next(v_->begin(), start + num);
-
-  std::copy(first, last, std::back_inserter(v));
+  num = std::min<unsigned>(num, list_->size() - start);
+  auto range = list_->range_by_rank(start, num);
+  for (auto it = range.first; it != range.second; ++it) {
+    RankVectorUnit u;
+    u.uin = it->second;
+    u.val = it->first.val;
+    v.push_back(u);
+  }
   return v;
 }
-
-void RankVector::KeepOrdered() {
-  std::stable_sort(v_->begin(), v_->end(), std::greater<RankVectorUnit>());
-}
 }
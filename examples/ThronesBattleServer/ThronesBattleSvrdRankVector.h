@@ -12,6 +12,10 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+#include <alpha/SkipList.h>
+#include <alpha/experimental/RegionBasedHashMap.h>
 #include <alpha/experimental/RegionBasedVector.h>
 
 namespace ThronesBattle {
@@ -23,24 +27,67 @@ struct RankVectorUnit {
 bool operator==(const RankVectorUnit& lhs, const RankVectorUnit& rhs);
 bool operator>(const RankVectorUnit& lhs, const RankVectorUnit& rhs);
 
+// 排行榜中的排序键, val大的在前, val相同时先达到的(seq小的)在前
+struct RankKey {
+  uint32_t val;
+  uint32_t seq;
+};
+
+struct RankKeyGreater {
+  bool operator()(const RankKey& lhs, const RankKey& rhs) const {
+    return lhs.val > rhs.val || (lhs.val == rhs.val && lhs.seq < rhs.seq);
+  }
+};
+
+// 数据都在传入的内存中:
+// 有序的部分是IndexedSkipList<RankKey, uin>, 另外用一个uin -> RankKey的哈希表
+// 找到玩家在跳表中的位置, 所以Report/Rank/GetRange都是O(log n)的
 class RankVector {
  public:
   RankVector(size_t max);
 
   bool CreateFrom(char* data, size_t size);
-  bool RestoreFrom(char* data, size_t size);
+  // 也能恢复旧的RegionBasedVector布局, 会在原来的内存上转换成新的布局
+  // 转换之前先把旧的数据写到legacy_backup, 中途崩溃时下次从这个文件重新转换
+  bool RestoreFrom(char* data,
+                   size_t size,
+                   const std::string& legacy_backup = std::string());
 
   size_t Size() const;
   void Clear();
   void Report(uint32_t uin, uint32_t val);
+  // 从1开始, 不在榜上返回0
   unsigned Rank(uint32_t uin) const;
   // start 从0开始
   std::vector<RankVectorUnit> GetRange(unsigned start, unsigned num) const;
 
  private:
-  void KeepOrdered();
+  struct Header {
+    uint64_t magic;
+    uint32_t next_seq;
+    uint32_t list_size;
+  };
+  // 排行榜不会超过几千人, 12层足够了
+  using ListType =
+      alpha::IndexedSkipList<RankKey, uint32_t, 12, RankKeyGreater>;
+  using IndexType = alpha::RegionBasedHashMap<uint32_t, RankKey>;
+  using LegacyVectorType = alpha::RegionBasedVector<RankVectorUnit>;
+
+  static const uint64_t kMagic;
+  // 正在从旧的布局转换
+  static const uint64_t kConvertingMagic;
+  // 不写magic, 由调用者在数据完整之后写入
+  bool Init(char* data, size_t size, bool create);
+  bool RestoreLegacy(char* data,
+                     size_t size,
+                     const std::string& legacy_backup);
+  // 跳表为准, 修复中途崩溃导致的索引不一致
+  void CheckIndex();
+  void Insert(uint32_t uin, uint32_t val);
+
   size_t max_;
-  using VectorType = alpha::RegionBasedVector<RankVectorUnit>;
-  std::unique_ptr<VectorType> v_;
+  Header* header_ = nullptr;
+  std::unique_ptr<ListType> list_;
+  std::unique_ptr<IndexType> index_;
 };
 }
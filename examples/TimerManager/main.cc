@@ -0,0 +1,74 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  main.cc
+ *        Created:  10/18/26 10:40:12
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  Compare TimerManager backends with a timeout-like workload:
+ *                  most timers are removed before they expire
+ *
+ * =============================================================================
+ */
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <alpha/Logger.h>
+#include <alpha/Random.h>
+#include <alpha/TimerManager.h>
+
+static double Run(alpha::TimerManager::Backend backend,
+                  int ticks,
+                  int timers_per_tick,
+                  int cancel_percent) {
+  alpha::TimerManager timers(backend);
+  alpha::TimeStamp now = alpha::Now();
+  std::vector<alpha::TimerManager::TimerId> pending;
+  uint64_t fired = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int tick = 0; tick < ticks; ++tick) {
+    for (int i = 0; i < timers_per_tick; ++i) {
+      auto delay = alpha::Random::Rand32(1, 5000);
+      auto id = timers.AddTimer(now + delay, [&fired] { ++fired; });
+      if (alpha::Random::Rand32(100) < static_cast<uint32_t>(cancel_percent)) {
+        pending.push_back(id);
+      }
+    }
+    //模拟连接在超时前完成, 删除一部分定时器
+    size_t remove = pending.size() / 2;
+    for (size_t i = 0; i < remove; ++i) {
+      timers.RemoveTimer(pending[i]);
+    }
+    pending.erase(pending.begin(), pending.begin() + remove);
+    timers.Fire(++now);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  auto ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+  LOG_INFO << "fired: " << fired;
+  return static_cast<double>(ns) / (static_cast<double>(ticks) *
+                                    timers_per_tick);
+}
+
+int main(int argc, char* argv[]) {
+  alpha::Logger::Init(argv[0]);
+  alpha::Logger::set_logtostderr(true);
+  int ticks = argc > 1 ? std::stoi(argv[1]) : 10000;
+  int timers_per_tick = argc > 2 ? std::stoi(argv[2]) : 50;
+  int cancel_percent = argc > 3 ? std::stoi(argv[3]) : 90;
+
+  auto tree = Run(alpha::TimerManager::Backend::kTree,
+                  ticks,
+                  timers_per_tick,
+                  cancel_percent);
+  auto wheel = Run(alpha::TimerManager::Backend::kTimingWheel,
+                   ticks,
+                   timers_per_tick,
+                   cancel_percent);
+  LOG_INFO << "ticks: " << ticks << ", timers per tick: " << timers_per_tick
+           << ", cancel percent: " << cancel_percent;
+  LOG_INFO << "tree: " << tree << " ns/timer";
+  LOG_INFO << "wheel: " << wheel << " ns/timer";
+  return 0;
+}
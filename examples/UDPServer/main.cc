@@ -14,17 +14,25 @@
 #include <alpha/EventLoop.h>
 #include <alpha/UDPSocket.h>
 #include <alpha/UDPServer.h>
-#include <alpha/IOBuffer.h>
 
 static int num = 0;
 static void EchoHandler(alpha::UDPSocket* sock,
-                        alpha::IOBuffer* buffer,
-                        size_t buf_len,
-                        const alpha::NetAddress& raddr) {
-  int n = sock->SendTo(buffer, buf_len, raddr);
-  CHECK(n == int(buf_len));
-  ++num;
-  LOG_INFO_IF(num % 10000 == 0) << "Receive " << num << " messages";
+                        alpha::UDPDatagram* datagrams,
+                        int count) {
+  // 收到的报文原地回给来源地址
+  int sent = 0;
+  while (sent < count) {
+    int n = sock->SendBatch(datagrams + sent, count - sent);
+    if (n < 0) {
+      PLOG_WARNING << "Drop " << count - sent << " replies";
+      break;
+    }
+    sent += n;
+  }
+  for (int i = 0; i < count; ++i) {
+    ++num;
+    LOG_INFO_IF(num % 10000 == 0) << "Receive " << num << " messages";
+  }
 }
 
 int main(int argc, char* argv[]) {
@@ -33,7 +41,7 @@ int main(int argc, char* argv[]) {
   LOG_INFO << "Listening at 0.0.0.0:40000";
   alpha::EventLoop loop;
   alpha::UDPServer server(&loop);
-  server.SetMessageCallback(EchoHandler);
+  server.SetBatchMessageCallback(EchoHandler);
   server.Run(alpha::NetAddress("0.0.0.0", 40000));
   loop.Run();
 }
@@ -0,0 +1,82 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  switch_benchmark.cc
+ *        Created:  10/18/26 18:32:47
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  比较不同切换方式和栈模式下协程切换的速度
+ *
+ * =============================================================================
+ */
+
+#include <chrono>
+#include <string>
+#include <alpha/Coroutine.h>
+#include <alpha/Logger.h>
+
+class PingCoroutine final : public alpha::Coroutine {
+ public:
+  PingCoroutine(Backend backend, StackMode stack_mode, int depth, int limit)
+      : Coroutine(backend, stack_mode), depth_(depth), limit_(limit) {}
+  void Routine() override { Recurse(depth_); }
+  int64_t count() const { return count_; }
+
+ private:
+  // 模拟调用栈比较深的协程, 每层占用1KiB左右的栈
+  void Recurse(int depth) {
+    volatile char frame[1024];
+    frame[0] = 0;
+    if (depth > 0) {
+      Recurse(depth - 1);
+    } else {
+      while (count_ < limit_) {
+        ++count_;
+        Yield();
+      }
+    }
+    count_ += frame[0];
+  }
+
+  int depth_;
+  int limit_;
+  int64_t count_ = 0;
+};
+
+static void Run(alpha::Coroutine::Backend backend,
+                alpha::Coroutine::StackMode stack_mode,
+                int depth,
+                const char* name,
+                int switches) {
+  PingCoroutine co(backend, stack_mode, depth, switches);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < switches; ++i) {
+    co.Resume();
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  CHECK(co.count() == switches);
+  // 一次Resume加一次Yield算两次切换
+  LOG_INFO << name << ", depth " << depth << ": " << switches * 2 * 1e9 / elapsed
+           << " switches/s, " << elapsed / (switches * 2.0) << " ns/switch";
+}
+
+int main(int argc, char* argv[]) {
+  alpha::Logger::Init(argv[0]);
+  alpha::Logger::set_logtostderr(true);
+  int switches = argc > 1 ? std::stoi(argv[1]) : 1000000;
+  using Backend = alpha::Coroutine::Backend;
+  using StackMode = alpha::Coroutine::StackMode;
+  for (int depth : {0, 32}) {
+    Run(Backend::kUContext, StackMode::kShared, depth, "ucontext/shared",
+        switches);
+    Run(Backend::kAssembly, StackMode::kShared, depth, "assembly/shared",
+        switches);
+    Run(Backend::kUContext, StackMode::kDedicated, depth,
+        "ucontext/dedicated", switches);
+    Run(Backend::kAssembly, StackMode::kDedicated, depth,
+        "assembly/dedicated", switches);
+  }
+  return EXIT_SUCCESS;
+}
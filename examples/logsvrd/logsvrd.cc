@@ -60,6 +60,10 @@ void WorkerRoutine(std::unique_ptr<alpha::ProcessBus> bus,
   const int kIdleSleepTime = 200 * 1000;
   const int kNormalSleepTime = 50 * 1000;
 
+  // 打开通知之后没有日志就睡眠等待唤醒, 超时只用于定期fflush和检查退出
+  const bool notification = bus->EnableNotification();
+  const int kWaitTime = 200; /* milliseconds */
+
   int idle = 0;
   while (detail::running_) {
     if (bus->empty()) {
@@ -72,7 +76,11 @@ void WorkerRoutine(std::unique_ptr<alpha::ProcessBus> bus,
         idle = kMaxIdleLoop;
       }
 
-      ::usleep(idle >= kMaxIdleLoop ? kIdleSleepTime : kNormalSleepTime);
+      if (notification) {
+        bus->WaitForReadable(kWaitTime);
+      } else {
+        ::usleep(idle >= kMaxIdleLoop ? kIdleSleepTime : kNormalSleepTime);
+      }
     } else {
       idle = 0;
       int len;
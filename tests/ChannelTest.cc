@@ -0,0 +1,101 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  ChannelTest.cc
+ *        Created:  10/18/26 22:52:10
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <alpha/Channel.h>
+#include <alpha/EventLoop.h>
+
+class ChannelTest : public ::testing::Test {
+ protected:
+  void SetUp() override { ASSERT_EQ(::pipe2(fds_, O_NONBLOCK), 0); }
+
+  void TearDown() override {
+    ::close(fds_[0]);
+    ::close(fds_[1]);
+  }
+
+  alpha::EventLoop loop_;
+  int fds_[2];
+};
+
+// 边缘触发时每次epoll_ctl都会重新通知已经就绪的事件,
+// 用来检查关注的事件没变时确实没有调用epoll_ctl
+TEST_F(ChannelTest, SkipUnchangedEvents) {
+  alpha::Channel channel(&loop_, fds_[0]);
+  channel.set_edge_triggered(true);
+  EXPECT_FALSE(channel.registered());
+  int reads = 0;
+  channel.set_read_callback([&channel, &reads] {
+    ++reads;
+    // 不读数据, 关注的事件也没变
+    channel.EnableReading();
+  });
+  channel.EnableReading();
+  EXPECT_TRUE(channel.registered());
+  EXPECT_EQ(channel.registered_events(), EPOLLIN | EPOLLET);
+
+  ASSERT_EQ(::write(fds_[1], "x", 1), 1);
+  loop_.RunAfter(100, [this] { loop_.Quit(); });
+  loop_.Run();
+  EXPECT_EQ(reads, 1);
+  channel.Remove();
+}
+
+TEST_F(ChannelTest, RemoveAndRegisterAgain) {
+  alpha::Channel channel(&loop_, fds_[0]);
+  channel.EnableReading();
+  EXPECT_TRUE(channel.registered());
+  EXPECT_EQ(channel.registered_events(), EPOLLIN);
+  channel.DisableAll();
+  EXPECT_TRUE(channel.registered());
+  EXPECT_EQ(channel.registered_events(), 0);
+
+  channel.Remove();
+  EXPECT_FALSE(channel.registered());
+  // 重复Remove什么都不做
+  channel.Remove();
+  EXPECT_FALSE(channel.registered());
+
+  // 删除之后重新ADD, 事件能正常收到
+  channel.EnableReading();
+  EXPECT_TRUE(channel.registered());
+  EXPECT_EQ(channel.registered_events(), EPOLLIN);
+  bool read = false;
+  channel.set_read_callback([this, &read] {
+    char c;
+    EXPECT_EQ(::read(fds_[0], &c, 1), 1);
+    read = true;
+    loop_.Quit();
+  });
+  ASSERT_EQ(::write(fds_[1], "x", 1), 1);
+  loop_.RunAfter(1000, [this] { loop_.Quit(); });
+  loop_.Run();
+  EXPECT_TRUE(read);
+  channel.Remove();
+}
+
+// epoll不支持普通文件, ADD失败之后不能当作已经注册过
+TEST_F(ChannelTest, FailedAddNotCached) {
+  FILE* file = ::tmpfile();
+  ASSERT_TRUE(file);
+  alpha::Channel channel(&loop_, ::fileno(file));
+  channel.EnableReading();
+  EXPECT_FALSE(channel.registered());
+  channel.EnableWriting();
+  EXPECT_FALSE(channel.registered());
+  channel.Remove();
+  ::fclose(file);
+}
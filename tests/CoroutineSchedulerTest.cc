@@ -0,0 +1,159 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  CoroutineSchedulerTest.cc
+ *        Created:  10/18/26 19:40:12
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <unistd.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/CoroutineScheduler.h>
+#include <alpha/EventLoop.h>
+
+class CoroutineSchedulerTest : public ::testing::Test {
+ protected:
+  CoroutineSchedulerTest() : scheduler_(&loop_) {}
+
+  alpha::EventLoop loop_;
+  alpha::CoroutineScheduler scheduler_;
+};
+
+TEST_F(CoroutineSchedulerTest, YieldOrder) {
+  std::vector<std::string> trace;
+  for (auto name : {"a", "b"}) {
+    scheduler_.Spawn([this, &trace, name] {
+      for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(alpha::CoroutineScheduler::Current(), &scheduler_);
+        trace.push_back(name + std::to_string(i));
+        scheduler_.YieldNow();
+      }
+    });
+  }
+  scheduler_.Spawn([this] {
+    while (scheduler_.alive_coroutines() > 1) {
+      scheduler_.YieldNow();
+    }
+    loop_.Quit();
+  });
+  loop_.Run();
+  EXPECT_EQ(alpha::CoroutineScheduler::Current(), nullptr);
+  EXPECT_EQ(trace,
+            (std::vector<std::string>{"a0", "b0", "a1", "b1", "a2", "b2"}));
+}
+
+TEST_F(CoroutineSchedulerTest, SleepFor) {
+  std::vector<int> woken;
+  for (int i : {30, 10, 20}) {
+    scheduler_.Spawn([this, &woken, i] {
+      scheduler_.SleepFor(i);
+      woken.push_back(i);
+      if (woken.size() == 3) loop_.Quit();
+    });
+  }
+  loop_.Run();
+  EXPECT_EQ(woken, (std::vector<int>{10, 20, 30}));
+}
+
+TEST_F(CoroutineSchedulerTest, ChannelAndWaitGroup) {
+  const int kProducers = 100;
+  const int kMessages = 100;
+  alpha::CoChannel<int> channel(4);
+  alpha::WaitGroup producers;
+  int64_t sum = 0;
+  int received = 0;
+  producers.Add(kProducers);
+  for (int i = 0; i < kProducers; ++i) {
+    scheduler_.Spawn([&] {
+      for (int j = 1; j <= kMessages; ++j) {
+        EXPECT_TRUE(channel.Send(j));
+        // 队列满了生产者会被挂起, 不会超过容量
+        EXPECT_LE(channel.size(), channel.capacity());
+      }
+      producers.Done();
+    });
+  }
+  scheduler_.Spawn([&] {
+    int value;
+    while (channel.Recv(&value)) {
+      sum += value;
+      ++received;
+    }
+    loop_.Quit();
+  });
+  scheduler_.Spawn([&] {
+    producers.Wait();
+    EXPECT_EQ(producers.count(), 0);
+    channel.Close();
+    EXPECT_FALSE(channel.Send(0));
+  });
+  loop_.Run();
+  EXPECT_EQ(received, kProducers * kMessages);
+  EXPECT_EQ(sum, kProducers * kMessages * (kMessages + 1) / 2);
+}
+
+TEST_F(CoroutineSchedulerTest, WaitReadable) {
+  int fds[2];
+  ASSERT_EQ(::pipe(fds), 0);
+  std::vector<bool> results;
+  scheduler_.Spawn([&] {
+    results.push_back(scheduler_.WaitReadable(fds[0], 10));
+    results.push_back(scheduler_.WaitReadable(fds[0], 1000));
+    char c;
+    EXPECT_EQ(::read(fds[0], &c, 1), 1);
+    loop_.Quit();
+  });
+  scheduler_.Spawn([&] {
+    scheduler_.SleepFor(50);
+    EXPECT_TRUE(scheduler_.WaitWritable(fds[1]));
+    EXPECT_EQ(::write(fds[1], "x", 1), 1);
+  });
+  auto start = std::chrono::steady_clock::now();
+  loop_.Run();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+  EXPECT_EQ(results, (std::vector<bool>{false, true}));
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+TEST_F(CoroutineSchedulerTest, ReuseCoroutines) {
+  const int kRounds = 3;
+  const int kCoroutines = 1000;
+  int finished = 0;
+  std::function<void(int)> spawn_round = [&](int round) {
+    alpha::WaitGroup* wg = new alpha::WaitGroup;
+    wg->Add(kCoroutines);
+    for (int i = 0; i < kCoroutines; ++i) {
+      scheduler_.Spawn([&, wg] {
+        scheduler_.YieldNow();
+        ++finished;
+        wg->Done();
+      });
+    }
+    scheduler_.Spawn([&, wg, round] {
+      wg->Wait();
+      delete wg;
+      if (round + 1 < kRounds) {
+        spawn_round(round + 1);
+      } else {
+        loop_.Quit();
+      }
+    });
+  };
+  spawn_round(0);
+  loop_.Run();
+  EXPECT_EQ(finished, kRounds * kCoroutines);
+  // 每一轮都复用上一轮结束的协程对象
+  EXPECT_EQ(scheduler_.alive_coroutines(), 0u);
+  EXPECT_LE(scheduler_.free_coroutines(),
+            alpha::CoroutineScheduler::kDefaultMaxFreeCoroutines);
+  EXPECT_GE(scheduler_.free_coroutines(), static_cast<size_t>(kCoroutines));
+}
@@ -0,0 +1,160 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  CoroutineTest.cc
+ *        Created:  10/18/26 18:10:26
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <algorithm>
+#include <csignal>
+#include <cfenv>
+#include <functional>
+#include <tuple>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/Coroutine.h>
+
+using Backend = alpha::Coroutine::Backend;
+using StackMode = alpha::Coroutine::StackMode;
+
+class FunctionCoroutine final : public alpha::Coroutine {
+ public:
+  FunctionCoroutine(std::tuple<Backend, StackMode> param,
+                    const std::function<void()>& func)
+      : Coroutine(std::get<0>(param), std::get<1>(param)), func_(func) {}
+  void Routine() override { func_(); }
+
+ private:
+  std::function<void()> func_;
+};
+
+class CoroutineTest
+    : public ::testing::TestWithParam<std::tuple<Backend, StackMode>> {};
+
+TEST_P(CoroutineTest, YieldAndResume) {
+  std::vector<int> trace;
+  FunctionCoroutine* self = nullptr;
+  FunctionCoroutine co(GetParam(), [&trace, &self] {
+    for (int i = 0; i < 3; ++i) {
+      trace.push_back(i);
+      self->Yield();
+    }
+  });
+  self = &co;
+  EXPECT_EQ(co.status(), alpha::Coroutine::Status::kReady);
+  for (int i = 0; i < 3; ++i) {
+    co.Resume();
+    EXPECT_TRUE(co.IsSuspended());
+    EXPECT_EQ(trace.size(), static_cast<size_t>(i + 1));
+  }
+  co.Resume();
+  EXPECT_TRUE(co.IsDead());
+  EXPECT_EQ(trace, (std::vector<int>{0, 1, 2}));
+}
+
+static int Recurse(alpha::Coroutine* co, int depth) {
+  // 栈上的数据在切换之后要保持不变
+  char buf[128];
+  snprintf(buf, sizeof(buf), "depth-%d", depth);
+  double d = depth * 0.5;
+  if (depth == 0) {
+    co->Yield();
+    return 0;
+  }
+  int sum = Recurse(co, depth - 1);
+  EXPECT_EQ(std::string(buf), "depth-" + std::to_string(depth));
+  EXPECT_EQ(d, depth * 0.5);
+  return sum + depth;
+}
+
+TEST_P(CoroutineTest, InterleavedStacks) {
+  // 两个协程共享同一个栈, 交替运行
+  FunctionCoroutine* first = nullptr;
+  FunctionCoroutine* second = nullptr;
+  int first_sum = 0, second_sum = 0;
+  FunctionCoroutine a(GetParam(),
+                      [&first, &first_sum] { first_sum = Recurse(first, 50); });
+  FunctionCoroutine b(GetParam(), [&second, &second_sum] {
+    second_sum = Recurse(second, 100);
+  });
+  first = &a;
+  second = &b;
+  a.Resume();
+  b.Resume();
+  a.Resume();
+  b.Resume();
+  EXPECT_TRUE(a.IsDead());
+  EXPECT_TRUE(b.IsDead());
+  EXPECT_EQ(first_sum, 50 * 51 / 2);
+  EXPECT_EQ(second_sum, 100 * 101 / 2);
+}
+
+TEST_P(CoroutineTest, FloatingPointEnvironment) {
+  // 协程里修改的舍入模式不能影响到调用者
+  FunctionCoroutine* self = nullptr;
+  int inside = 0;
+  FunctionCoroutine co(GetParam(), [&self, &inside] {
+    fesetround(FE_UPWARD);
+    self->Yield();
+    inside = fegetround();
+  });
+  self = &co;
+  co.Resume();
+  EXPECT_EQ(fegetround(), FE_TONEAREST);
+  co.Resume();
+  EXPECT_EQ(inside, FE_UPWARD);
+  fesetround(FE_TONEAREST);
+}
+
+static int Overflow(int depth) {
+  volatile char buf[4096];
+  buf[0] = static_cast<char>(depth);
+  if (depth < 0) return 0;
+  return Overflow(depth + 1) + buf[0];
+}
+
+TEST_P(CoroutineTest, StackReuse) {
+  if (std::get<1>(GetParam()) != StackMode::kDedicated) return;
+  auto pool = alpha::Coroutine::StackPool();
+  auto free_stacks = pool->free_stacks();
+  const char* first_stack = nullptr;
+  const char* second_stack = nullptr;
+  {
+    FunctionCoroutine co(GetParam(), [&first_stack] {
+      char dummy;
+      first_stack = &dummy;
+    });
+    co.Resume();
+    EXPECT_TRUE(co.IsDead());
+  }
+  // 协程结束后栈回到池中, 下一个协程复用同一个栈
+  EXPECT_EQ(pool->free_stacks(), std::max<size_t>(free_stacks, 1));
+  FunctionCoroutine co(GetParam(), [&second_stack] {
+    char dummy;
+    second_stack = &dummy;
+  });
+  co.Resume();
+  EXPECT_EQ(first_stack, second_stack);
+}
+
+TEST_P(CoroutineTest, GuardPage) {
+  if (std::get<1>(GetParam()) != StackMode::kDedicated) return;
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  FunctionCoroutine co(GetParam(), [] { Overflow(1); });
+  // 栈溢出碰到guard page直接段错误, 不会写坏其他内存
+  EXPECT_EXIT(co.Resume(), ::testing::KilledBySignal(SIGSEGV), "");
+}
+
+INSTANTIATE_TEST_CASE_P(
+    Backends,
+    CoroutineTest,
+    ::testing::Combine(::testing::Values(Backend::kUContext,
+                                         Backend::kAssembly),
+                       ::testing::Values(StackMode::kShared,
+                                         StackMode::kDedicated)));
@@ -0,0 +1,109 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  EventLoopTest.cc
+ *        Created:  10/18/26 13:05:21
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/EventLoop.h>
+
+TEST(EventLoopTest, QueueInLoopFromOtherThreads) {
+  alpha::EventLoop loop;
+  // 没有唤醒的话至少要等一个超时才能处理完
+  loop.set_busy_timeout(10000);
+  loop.set_idle_timeout(10000);
+  const int kThreads = 4;
+  const int kFunctorsPerThread = 1000;
+  int count = 0;
+  auto max_latency = std::chrono::steady_clock::duration::zero();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&loop, &count, &max_latency] {
+      for (int j = 0; j < kFunctorsPerThread; ++j) {
+        auto queued = std::chrono::steady_clock::now();
+        loop.QueueInLoop([&loop, &count, &max_latency, queued] {
+          EXPECT_TRUE(loop.IsInLoopThread());
+          max_latency = std::max(max_latency,
+                                 std::chrono::steady_clock::now() - queued);
+          if (++count == kThreads * kFunctorsPerThread) {
+            loop.Quit();
+          }
+        });
+        // 让队列经常变空, 多制造一些和loop取走队列的竞争
+        if (j % 16 == 0) {
+          std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+      }
+    });
+  }
+  auto start = std::chrono::steady_clock::now();
+  loop.Run();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(count, kThreads * kFunctorsPerThread);
+  EXPECT_LT(elapsed, std::chrono::seconds(5));
+  // 唤醒丢失时要等到超时才会执行
+  EXPECT_LT(
+      std::chrono::duration_cast<std::chrono::milliseconds>(max_latency)
+          .count(),
+      500);
+}
+
+TEST(EventLoopTest, QueueInLoopOrder) {
+  alpha::EventLoop loop;
+  std::vector<int> order;
+  for (int i = 0; i < 10; ++i) {
+    loop.QueueInLoop([&order, i] { order.push_back(i); });
+  }
+  loop.QueueInLoop([&loop] { loop.Quit(); });
+  loop.Run();
+  ASSERT_EQ(order.size(), 10u);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(EventLoopTest, QuitFromOtherThread) {
+  alpha::EventLoop loop;
+  loop.set_busy_timeout(10000);
+  loop.set_idle_timeout(10000);
+  std::thread t([&loop] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(loop.IsInLoopThread());
+    loop.Quit();
+  });
+  auto start = std::chrono::steady_clock::now();
+  loop.Run();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  t.join();
+  EXPECT_LT(elapsed, std::chrono::seconds(5));
+}
+
+TEST(EventLoopTest, RunInLoop) {
+  alpha::EventLoop loop;
+  std::vector<int> order;
+  // Run之前还没有loop线程, 只能排队
+  EXPECT_FALSE(loop.IsInLoopThread());
+  loop.RunInLoop([&loop, &order] {
+    order.push_back(1);
+    // 在loop线程中直接执行
+    loop.RunInLoop([&order] { order.push_back(2); });
+    order.push_back(3);
+    loop.Quit();
+  });
+  EXPECT_TRUE(order.empty());
+  loop.Run();
+  EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+}
@@ -0,0 +1,77 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  EventLoopThreadPoolTest.cc
+ *        Created:  10/18/26 22:18:43
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/EventLoop.h>
+#include <alpha/EventLoopThreadPool.h>
+
+TEST(EventLoopThreadPoolTest, NoThreads) {
+  alpha::EventLoop loop;
+  alpha::EventLoopThreadPool pool(&loop, 0);
+  EXPECT_EQ(pool.size(), 0u);
+  EXPECT_EQ(pool.GetNextLoop(), &loop);
+  EXPECT_EQ(pool.GetLoop(3), &loop);
+  EXPECT_EQ(pool.GetAllLoops(), std::vector<alpha::EventLoop*>(1, &loop));
+  pool.Start();
+  pool.Stop();
+}
+
+TEST(EventLoopThreadPoolTest, RunInWorkerThreads) {
+  const int kThreads = 3;
+  alpha::EventLoop loop;
+  alpha::EventLoopThreadPool pool(&loop, kThreads);
+  ASSERT_EQ(pool.size(), static_cast<size_t>(kThreads));
+  auto loops = pool.GetAllLoops();
+  ASSERT_EQ(loops.size(), static_cast<size_t>(kThreads));
+  for (int i = 0; i < 2 * kThreads; ++i) {
+    EXPECT_EQ(pool.GetNextLoop(), loops[i % kThreads]);
+    EXPECT_EQ(pool.GetLoop(i), loops[i % kThreads]);
+  }
+
+  std::mutex mutex;
+  std::map<alpha::EventLoop*, std::thread::id> init_threads;
+  std::map<alpha::EventLoop*, std::thread::id> run_threads;
+  pool.SetThreadInitCallback([&](alpha::EventLoop* worker) {
+    std::lock_guard<std::mutex> lock(mutex);
+    init_threads[worker] = std::this_thread::get_id();
+  });
+  pool.Start();
+  EXPECT_TRUE(pool.started());
+  for (auto worker : loops) {
+    worker->QueueInLoop([&, worker] {
+      EXPECT_TRUE(worker->IsInLoopThread());
+      std::lock_guard<std::mutex> lock(mutex);
+      run_threads[worker] = std::this_thread::get_id();
+      if (run_threads.size() == loops.size()) {
+        loop.Quit();
+      }
+    });
+  }
+  loop.Run();
+  pool.Stop();
+  // Stop可以重复调用
+  pool.Stop();
+
+  // 每个loop在自己的线程中运行, 和初始化回调是同一个线程
+  EXPECT_EQ(init_threads, run_threads);
+  std::set<std::thread::id> threads;
+  for (auto& p : run_threads) {
+    EXPECT_NE(p.second, std::this_thread::get_id());
+    threads.insert(p.second);
+  }
+  EXPECT_EQ(threads.size(), static_cast<size_t>(kThreads));
+}
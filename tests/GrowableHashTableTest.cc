@@ -0,0 +1,315 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  GrowableHashTableTest.cc
+ *        Created:  10/18/26 16:41:19
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/MemoryMappedFile.h>
+#include <alpha/Random.h>
+#include <alpha/experimental/GrowableHashTable.h>
+
+namespace {
+// 调用次数到了crash_at时直接退出, 模拟操作过程中进程被杀掉
+int64_t hash_calls = 0;
+int64_t crash_at = -1;
+
+struct CrashingHash {
+  size_t operator()(uint32_t k) const {
+    if (++hash_calls == crash_at) {
+      _exit(0);
+    }
+    return std::hash<uint32_t>()(k);
+  }
+};
+}
+
+class GrowableHashTableTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = "/tmp/alpha_growable_hash_table_test." + std::to_string(getpid());
+    ::unlink(path_.c_str());
+  }
+
+  void TearDown() override { ::unlink(path_.c_str()); }
+
+  void Open() {
+    file_.reset(new alpha::MemoryMappedFile);
+    ASSERT_TRUE(file_->Init(path_, kInitialSize, alpha::kCreateIfNotExists));
+  }
+
+  template <typename MapType>
+  void CheckSame(MapType* m) {
+    ASSERT_EQ(m->size(), expected_.size());
+    std::map<uint32_t, uint64_t> actual;
+    for (const auto& p : *m) {
+      ASSERT_TRUE(actual.emplace(p.first, p.second).second);
+    }
+    EXPECT_EQ(actual, expected_);
+    for (const auto& p : expected_) {
+      auto it = m->find(p.first);
+      ASSERT_NE(it, m->end());
+      EXPECT_EQ(it->second, p.second);
+    }
+  }
+
+  template <typename MapType>
+  void Grow();
+
+  template <typename Table>
+  void RestoreWhileRehashing();
+
+  // 和GrowableHashTable的头部布局一致, 用来构造崩溃时的状态
+  struct Segment {
+    uint64_t offset;
+    uint64_t size;
+  };
+  struct Header {
+    uint64_t magic;
+    uint32_t element_size;
+    uint32_t state;
+    Segment segments[2];
+    uint32_t rehash_index;
+  };
+
+  static const int64_t kInitialSize = 16 << 10;
+  std::string path_;
+  std::unique_ptr<alpha::MemoryMappedFile> file_;
+  std::map<uint32_t, uint64_t> expected_;
+};
+
+const int64_t GrowableHashTableTest::kInitialSize;
+
+template <typename MapType>
+void GrowableHashTableTest::Grow() {
+  Open();
+  auto m = MapType::Create(file_.get());
+  ASSERT_TRUE(m);
+  auto initial_max_size = m->max_size();
+  // 一路插入, 中间会扩容好几次, 同时删除一部分
+  for (uint32_t i = 0; i < 20 * initial_max_size; ++i) {
+    auto p = m->insert(alpha::make_pod_pair(i, uint64_t(i) * 2));
+    ASSERT_TRUE(p.second);
+    ASSERT_EQ(p.first->second, uint64_t(i) * 2);
+    expected_[i] = uint64_t(i) * 2;
+    if (i % 3 == 0) {
+      ASSERT_EQ(m->erase(i / 2), expected_.erase(i / 2));
+    }
+    if (m->rehashing() && i % 97 == 0) {
+      // 搬迁过程中两个表的元素都能查到和遍历到
+      CheckSame(m.get());
+    }
+  }
+  EXPECT_GT(m->max_size(), 8 * initial_max_size);
+  auto last = expected_.rbegin()->first;
+  EXPECT_FALSE(m->insert(alpha::make_pod_pair(last, 0ul)).second);
+  CheckSame(m.get());
+
+  // 重新打开文件恢复
+  m.reset();
+  Open();
+  m = MapType::Restore(file_.get());
+  ASSERT_TRUE(m);
+  CheckSame(m.get());
+
+  m->clear();
+  expected_.clear();
+  EXPECT_TRUE(m->empty());
+  EXPECT_FALSE(m->rehashing());
+  EXPECT_EQ(m->begin(), m->end());
+}
+
+template <typename Table>
+void GrowableHashTableTest::RestoreWhileRehashing() {
+  using MapType =
+      alpha::GrowableHashTable<Table,
+                               alpha::Select1st<typename Table::value_type>>;
+  Open();
+  auto m = MapType::Create(file_.get());
+  ASSERT_TRUE(m);
+  uint32_t key = 0;
+  while (!m->rehashing()) {
+    m->insert(alpha::make_pod_pair(key, uint64_t(key)));
+    expected_[key] = key;
+    ++key;
+  }
+  m.reset();
+
+  // 模拟搬迁一个元素时崩溃: 元素已经插入新表, 还没从旧表删除
+  auto start = reinterpret_cast<char*>(file_->mapped_start());
+  auto header = reinterpret_cast<Header*>(start);
+  auto current = header->state >> 1;
+  const auto& old_segment = header->segments[1 - current];
+  const auto& new_segment = header->segments[current];
+  auto old_table = Table::Restore(start + old_segment.offset, old_segment.size);
+  auto new_table = Table::Restore(start + new_segment.offset, new_segment.size);
+  ASSERT_TRUE(old_table);
+  ASSERT_TRUE(new_table);
+  // 前面的空桶搬不搬都一样, 让rehash_index指向第一个有元素的桶
+  while (header->rehash_index < old_table->bucket_count() &&
+         old_table->bucket_front(header->rehash_index) == old_table->end()) {
+    ++header->rehash_index;
+  }
+  ASSERT_LT(header->rehash_index, old_table->bucket_count());
+  auto moving = old_table->bucket_front(header->rehash_index)->first;
+  // 搬迁之后又被修改过, 新表中的值和旧表不同
+  const uint64_t kNewValue = 1ul << 40;
+  ASSERT_TRUE(
+      new_table->insert(alpha::make_pod_pair(moving, kNewValue)).second);
+  expected_[moving] = kNewValue;
+  old_table.reset();
+  new_table.reset();
+
+  Open();
+  m = MapType::Restore(file_.get());
+  ASSERT_TRUE(m);
+  // 两个表中都有的元素只算一次, 以新表为准
+  EXPECT_EQ(m->size(), expected_.size());
+  size_t occurrences = 0;
+  for (const auto& p : *m) {
+    if (p.first == moving) ++occurrences;
+  }
+  EXPECT_EQ(occurrences, 1u);
+  EXPECT_EQ(m->find(moving)->second, kNewValue);
+  CheckSame(m.get());
+
+  // 继续插入直到搬完
+  while (m->rehashing()) {
+    m->insert(alpha::make_pod_pair(key, uint64_t(key)));
+    expected_[key] = key;
+    ++key;
+  }
+  CheckSame(m.get());
+}
+
+TEST_F(GrowableHashTableTest, Grow) {
+  Grow<alpha::GrowableRegionBasedHashMap<uint32_t, uint64_t>>();
+}
+
+TEST_F(GrowableHashTableTest, GrowFlat) {
+  Grow<alpha::GrowableRegionBasedFlatHashMap<uint32_t, uint64_t>>();
+}
+
+TEST_F(GrowableHashTableTest, RestoreWhileRehashing) {
+  RestoreWhileRehashing<alpha::RegionBasedHashMap<uint32_t, uint64_t>>();
+}
+
+TEST_F(GrowableHashTableTest, RestoreWhileRehashingFlat) {
+  RestoreWhileRehashing<alpha::RegionBasedFlatHashMap<uint32_t, uint64_t>>();
+}
+
+// 不扩容时反复删除插入, 新表里清理墓碑的过程中崩溃, 恢复之后元素都还在
+TEST_F(GrowableHashTableTest, CrashInDropDeletes) {
+  using MapType = alpha::GrowableHashTable<
+      alpha::RegionBasedFlatHashMap<uint32_t, uint64_t, CrashingHash>,
+      alpha::Select1st<alpha::PODPair<uint32_t, uint64_t>>>;
+  Open();
+  auto m = MapType::Create(file_.get());
+  ASSERT_TRUE(m);
+  std::vector<uint32_t> keys;
+  uint32_t next_key = 0;
+  while (keys.size() < m->max_size() * 3 / 4) {
+    keys.push_back(next_key);
+    expected_[next_key] = next_key;
+    m->insert(alpha::make_pod_pair(next_key, uint64_t(next_key)));
+    ++next_key;
+  }
+  ASSERT_FALSE(m->rehashing());
+
+  // 找到一次需要清理墓碑的插入, 记下插入之前文件的内容
+  auto start = reinterpret_cast<char*>(file_->mapped_start());
+  auto size = file_->size();
+  std::vector<char> snapshot;
+  int64_t drop_calls = 0;
+  uint32_t key = 0;
+  for (int i = 0; i < 100000 && drop_calls == 0; ++i) {
+    auto index = alpha::Random::Rand32(keys.size());
+    ASSERT_EQ(m->erase(keys[index]), 1u);
+    expected_.erase(keys[index]);
+    key = keys[index] = next_key++;
+    snapshot.assign(start, start + size);
+    auto calls = hash_calls;
+    ASSERT_TRUE(m->insert(alpha::make_pod_pair(key, uint64_t(key))).second);
+    // 正常插入只有查找和插入两次
+    if (hash_calls - calls > 2) {
+      drop_calls = hash_calls - calls;
+    } else {
+      expected_[key] = key;
+    }
+  }
+  ASSERT_GT(drop_calls, 0);
+  ASSERT_FALSE(m->rehashing());
+  ASSERT_EQ(file_->size(), size);
+  m.reset();
+
+  for (int64_t n = 1; n <= drop_calls; ++n) {
+    memcpy(start, snapshot.data(), size);
+    pid_t pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+      auto child = MapType::Restore(file_.get());
+      crash_at = hash_calls + n;
+      if (child) {
+        child->insert(alpha::make_pod_pair(key, uint64_t(key)));
+      }
+      _exit(1);
+    }
+    int status = 0;
+    ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0) << n;
+
+    m = MapType::Restore(file_.get());
+    ASSERT_TRUE(m) << n;
+    CheckSame(m.get());
+    ASSERT_TRUE(m->insert(alpha::make_pod_pair(key, uint64_t(key))).second);
+    EXPECT_EQ(m->find(key)->second, key);
+    m.reset();
+  }
+}
+
+// 扩容到一半崩溃时文件可能已经扩大过了, 再次扩容时按当前的表计算文件大小
+TEST_F(GrowableHashTableTest, GrowSizedFromLiveSegment) {
+  using MapType = alpha::GrowableRegionBasedFlatHashMap<uint32_t, uint64_t>;
+  Open();
+  auto m = MapType::Create(file_.get());
+  ASSERT_TRUE(m);
+  m.reset();
+  ASSERT_TRUE(file_->Resize(kInitialSize * 64));
+  m = MapType::Restore(file_.get());
+  ASSERT_TRUE(m);
+  for (uint32_t key = 0; !m->rehashing(); ++key) {
+    m->insert(alpha::make_pod_pair(key, uint64_t(key)));
+  }
+  // 头部一页, 原来的表, 两倍大小的新表
+  const int64_t kPageSize = 4096;
+  EXPECT_EQ(file_->size(), kPageSize + 3 * (kInitialSize - kPageSize));
+}
+
+TEST_F(GrowableHashTableTest, ResizeMemoryMappedFile) {
+  Open();
+  auto start = reinterpret_cast<char*>(file_->mapped_start());
+  memcpy(start, "hello", 5);
+  ASSERT_TRUE(file_->Resize(kInitialSize * 64));
+  EXPECT_EQ(file_->size(), kInitialSize * 64);
+  start = reinterpret_cast<char*>(file_->mapped_start());
+  EXPECT_EQ(std::string(start, 5), "hello");
+  start[kInitialSize * 64 - 1] = 'x';
+
+  ASSERT_TRUE(file_->PunchHole(0, 4096));
+  EXPECT_EQ(start[0], 0);
+  EXPECT_EQ(start[kInitialSize * 64 - 1], 'x');
+
+  ASSERT_TRUE(file_->Resize(kInitialSize));
+  EXPECT_EQ(file_->size(), kInitialSize);
+}
@@ -0,0 +1,103 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  HTTPMessageCodecTest.cc
+ *        Created:  10/18/26 23:31:44
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/HTTPMessageCodec.h>
+#include <alpha/HTTPRequest.h>
+
+TEST(HTTPMessageCodecTest, ProcessInPlace) {
+  std::string buffer =
+      "GET /warrior?uin=10086&zone=3&flag HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "x-custom-header:   value with spaces  \r\n"
+      "\r\n"
+      "POST /upload HTTP/1.0\r\n"
+      "Content-Length: 5\r\n"
+      "\r\n"
+      "hello";
+  alpha::Slice data(buffer);
+  alpha::HTTPMessageCodec codec;
+  alpha::HTTPRequest request;
+
+  ASSERT_EQ(codec.ProcessInPlace(data, &request),
+            alpha::HTTPMessageCodec::kDone);
+  EXPECT_TRUE(codec.keep_alive());
+  EXPECT_EQ(request.method(), "GET");
+  EXPECT_EQ(request.path(), "/warrior");
+  EXPECT_EQ(request.query_string(), "uin=10086&zone=3&flag");
+  EXPECT_EQ(request.Param("uin"), "10086");
+  EXPECT_EQ(request.Param("zone"), "3");
+  EXPECT_TRUE(request.Param("flag").empty());
+  EXPECT_TRUE(request.Param("missing").empty());
+  EXPECT_EQ(request.header_count(), 2);
+  EXPECT_EQ(request.Header("HOST"), "localhost");
+  EXPECT_EQ(request.Header("X-Custom-Header"), "value with spaces");
+  EXPECT_FALSE(request.HasHeader("Content-Length"));
+  EXPECT_TRUE(request.body().empty());
+  // Slice直接指向原来的数据
+  EXPECT_EQ(request.path().data(), buffer.data() + 4);
+
+  codec.Reset();
+  ASSERT_EQ(codec.ProcessInPlace(data, &request),
+            alpha::HTTPMessageCodec::kDone);
+  EXPECT_FALSE(codec.keep_alive());
+  EXPECT_EQ(request.method(), "POST");
+  EXPECT_EQ(request.body(), "hello");
+  EXPECT_TRUE(data.empty());
+  EXPECT_EQ(codec.bytes_processed(), buffer.size());
+}
+
+TEST(HTTPMessageCodecTest, ProcessInPlaceIncompleteAndInvalid) {
+  const std::string request_text =
+      "PUT /a HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc";
+  alpha::HTTPRequest request;
+  // 不完整时不消耗数据, 数据补全之后从头解析
+  for (size_t len = 0; len < request_text.size(); ++len) {
+    alpha::HTTPMessageCodec codec;
+    alpha::Slice data(request_text.data(), len);
+    EXPECT_GT(codec.ProcessInPlace(data, &request), 0) << len;
+    EXPECT_EQ(data.size(), len);
+  }
+
+  std::vector<std::pair<std::string, alpha::HTTPMessageCodec::Status>> cases =
+      {{"GET /a HTTP/2.0\r\n\r\n",
+        alpha::HTTPMessageCodec::kInvalidHTTPVersion},
+       {"PATCH /a HTTP/1.1\r\n\r\n", alpha::HTTPMessageCodec::kInvalidMethod},
+       {"GET a HTTP/1.1\r\n\r\n", alpha::HTTPMessageCodec::kInvalidStartLine},
+       {"GET /a HTTP/1.1\r\nbad header\r\n\r\n",
+        alpha::HTTPMessageCodec::kInvalidHeadLine},
+       {"GET /a HTTP/1.1\r\nContent-Length: -1\r\n\r\n",
+        alpha::HTTPMessageCodec::kInvalidContentLength},
+       {"GET /a HTTP/1.1\r\n" + std::string(9000, 'x'),
+        alpha::HTTPMessageCodec::kHeaderTooLarge}};
+  for (const auto& c : cases) {
+    alpha::HTTPMessageCodec codec;
+    alpha::Slice data(c.first);
+    EXPECT_EQ(codec.ProcessInPlace(data, &request), c.second) << c.first;
+  }
+}
+
+TEST(HTTPMessageCodecTest, ProcessInPlaceMaxSize) {
+  const std::string header =
+      "POST /a HTTP/1.1\r\nContent-Length: 100\r\n\r\n";
+  alpha::HTTPRequest request;
+  alpha::Slice data(header);
+  // 整个请求放不进读缓冲区时不用等body收完
+  alpha::HTTPMessageCodec codec;
+  EXPECT_EQ(codec.ProcessInPlace(data, &request, header.size() + 99),
+            alpha::HTTPMessageCodec::kTooMuchContent);
+  alpha::HTTPMessageCodec fits;
+  EXPECT_EQ(fits.ProcessInPlace(data, &request, header.size() + 100),
+            alpha::HTTPMessageCodec::kParseData);
+}
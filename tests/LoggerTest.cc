@@ -0,0 +1,271 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  LoggerTest.cc
+ *        Created:  10/18/26 20:31:47
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <unistd.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/Logger.h>
+
+class AsyncLoggerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/alpha_logger_test.XXXXXX";
+    ASSERT_TRUE(::mkdtemp(dir) != nullptr);
+    logdir_ = dir;
+    alpha::Logger::set_logtostderr(false);
+    alpha::Logger::set_minloglevel(alpha::kLogLevelInfo);
+    alpha::Logger::set_logdir(logdir_);
+    alpha::Logger::Init("logger_test");
+  }
+
+  void TearDown() override {
+    alpha::Logger::DisableAsync();
+    // 其他测试的日志还是输出到stderr
+    alpha::Logger::set_logtostderr(true);
+    alpha::Logger::set_minloglevel(alpha::kLogLevelInfo);
+    for (auto level : {"INFO", "WARN", "ERROR", "FATAL"}) {
+      auto link = LogPath(level);
+      char target[256];
+      auto n = ::readlink(link.c_str(), target, sizeof(target) - 1);
+      if (n > 0) {
+        target[n] = '\0';
+        ::unlink((logdir_ + "/" + target).c_str());
+      }
+      ::unlink(link.c_str());
+    }
+    ::rmdir(logdir_.c_str());
+  }
+
+  std::string LogPath(const std::string& level) const {
+    return logdir_ + "/logger_test." + level + ".log";
+  }
+
+  std::vector<std::string> ReadLines(const std::string& level) const {
+    std::ifstream in(LogPath(level));
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(in, line)) {
+      lines.push_back(line);
+    }
+    return lines;
+  }
+
+  std::string logdir_;
+};
+
+// 同步写文件的测试也用同一个fixture
+class LoggerTest : public AsyncLoggerTest {};
+
+TEST_F(AsyncLoggerTest, MultipleThreads) {
+  alpha::AsyncLogOptions options;
+  options.flush_interval_ms = 10;
+  alpha::Logger::EnableAsync(options);
+  const int kThreads = 4;
+  const int kMessages = 2000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([t] {
+      for (int i = 0; i < kMessages; ++i) {
+        LOG_INFO << "thread " << t << " message " << i;
+      }
+      LOG_WARNING << "thread " << t << " done";
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  alpha::Logger::Flush();
+  EXPECT_EQ(alpha::Logger::dropped_logs(), 0u);
+
+  // 同一个线程的日志保持顺序
+  std::map<int, int> next;
+  int done = 0;
+  for (const auto& line : ReadLines("INFO")) {
+    auto pos = line.find("] thread ");
+    ASSERT_NE(pos, std::string::npos) << line;
+    std::istringstream iss(line.substr(pos + 9));
+    int t;
+    std::string word;
+    iss >> t >> word;
+    if (word == "done") {
+      EXPECT_EQ(next[t], kMessages);
+      ++done;
+      continue;
+    }
+    int i;
+    iss >> i;
+    EXPECT_EQ(i, next[t]++);
+  }
+  EXPECT_EQ(done, kThreads);
+  EXPECT_EQ(ReadLines("WARN").size(), static_cast<size_t>(kThreads));
+}
+
+TEST_F(AsyncLoggerTest, DropWhenFull) {
+  alpha::AsyncLogOptions options;
+  options.thread_buffer_size = 0;  // 取最小值
+  options.flush_interval_ms = 1000;
+  options.overflow_policy = alpha::LogOverflowPolicy::kDropAndCount;
+  alpha::Logger::EnableAsync(options);
+  const int kMessages = 20000;
+  const std::string padding(100, 'x');
+  for (int i = 0; i < kMessages; ++i) {
+    LOG_INFO << padding << i;
+  }
+  alpha::Logger::Flush();
+  // 后台线程来不及写时会丢日志, 丢多少取决于调度
+  // 但写入的加上丢弃的正好是全部日志, 丢弃的条数也记在日志里
+  auto dropped = alpha::Logger::dropped_logs();
+  uint64_t written = 0, reported = 0;
+  for (const auto& line : ReadLines("INFO")) {
+    auto pos = line.find("log messages dropped");
+    if (pos == std::string::npos) {
+      ++written;
+    } else {
+      reported += std::stoul(line.substr(6, pos - 6));
+    }
+  }
+  EXPECT_EQ(written + dropped, static_cast<uint64_t>(kMessages));
+  EXPECT_EQ(reported, dropped);
+}
+
+// EnableAsync之后修改minloglevel, 和同步模式一样按写日志时的级别写文件
+TEST_F(AsyncLoggerTest, SetMinLogLevelAfterEnable) {
+  alpha::Logger::EnableAsync();
+  LOG_WARNING << "before";
+  alpha::Logger::set_minloglevel(alpha::kLogLevelWarning);
+  LOG_INFO << "filtered";
+  LOG_WARNING << "after";
+  alpha::Logger::Flush();
+  auto info = ReadLines("INFO");
+  ASSERT_EQ(info.size(), 1u);
+  EXPECT_NE(info[0].find("] before"), std::string::npos) << info[0];
+  EXPECT_EQ(ReadLines("WARN").size(), 2u);
+}
+
+// 进程退出时还有线程在写日志, 退出之前写的日志要写到文件, 进程要正常退出
+TEST_F(AsyncLoggerTest, ExitWhileLogging) {
+  pid_t pid = ::fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    alpha::AsyncLogOptions options;
+    options.flush_interval_ms = 10;
+    alpha::Logger::EnableAsync(options);
+    for (int i = 0; i < 4; ++i) {
+      std::thread([] {
+        for (uint64_t n = 0;; ++n) {
+          LOG_INFO << "background " << n;
+        }
+      }).detach();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    LOG_WARNING << "exiting";
+    std::exit(0);
+  }
+  int status = 0;
+  ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status)) << "status: " << status;
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+  auto lines = ReadLines("WARN");
+  ASSERT_EQ(lines.size(), 1u);
+  EXPECT_NE(lines[0].find("] exiting"), std::string::npos) << lines[0];
+}
+
+static std::string Format(const std::function<void(alpha::LoggerStream&)>& f) {
+  char buf[256];
+  alpha::LoggerStream stream;
+  stream.rdbuf()->pubsetbuf(buf, sizeof(buf));
+  f(stream);
+  return std::string(buf, stream.streambuf()->used());
+}
+
+TEST(LoggerStreamTest, Integers) {
+  EXPECT_EQ(Format([](alpha::LoggerStream& s) { s << 0 << ' ' << -1; }),
+            "0 -1");
+  EXPECT_EQ(Format([](alpha::LoggerStream& s) {
+              s << LLONG_MIN << ' ' << ULLONG_MAX << ' ' << INT_MIN;
+            }),
+            "-9223372036854775808 18446744073709551615 -2147483648");
+  EXPECT_EQ(Format([](alpha::LoggerStream& s) {
+              s << 'c' << true << static_cast<uint8_t>('x') << 1.5;
+            }),
+            "c1x1.5");
+  EXPECT_EQ(Format([](alpha::LoggerStream& s) {
+              s << "a" << std::string("b") << std::setw(3) << "c";
+            }),
+            "ab  c");
+  // 设置了格式时和std::ostream一样
+  EXPECT_EQ(Format([](alpha::LoggerStream& s) {
+              s << std::hex << 255 << std::dec << ' ' << std::setw(4) << 7
+                << ' ' << std::showpos << 8;
+            }),
+            "ff    7 +8");
+  // 复用之前恢复默认格式
+  EXPECT_EQ(Format([](alpha::LoggerStream& s) {
+              s << std::hex << std::setprecision(2);
+              s.Reset();
+              s << 255 << ' ' << 3.14159;
+            }),
+            "255 3.14159");
+}
+
+struct Nested {
+  int value;
+};
+
+static std::ostream& operator<<(std::ostream& os, const Nested& nested) {
+  // 格式化的过程中又写日志, 不能写坏外面那条日志的缓冲区
+  LOG_INFO << "nested " << nested.value;
+  return os << "outer " << nested.value;
+}
+
+TEST_F(LoggerTest, NestedLog) {
+  LOG_WARNING << Nested{42} << " done";
+  auto lines = ReadLines("INFO");
+  ASSERT_EQ(lines.size(), 2u);
+  EXPECT_NE(lines[0].find("] nested 42"), std::string::npos) << lines[0];
+  EXPECT_NE(lines[1].find("] outer 42 done"), std::string::npos) << lines[1];
+}
+
+static double NanosecondsPerLog(int iterations) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    LOG_INFO << "benchmark message " << i << " of " << iterations;
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+TEST_F(LoggerTest, Benchmark) {
+  const int kIterations = 200000;
+  alpha::Logger::EnableAsync();
+  auto enabled = NanosecondsPerLog(kIterations);
+  alpha::Logger::Flush();
+  alpha::Logger::set_minloglevel(alpha::kLogLevelWarning);
+  auto disabled = NanosecondsPerLog(kIterations);
+  printf("LOG_INFO: %.1f ns enabled (async), %.1f ns disabled\n",
+         enabled,
+         disabled);
+  EXPECT_LT(disabled, enabled);
+  EXPECT_EQ(ReadLines("INFO").size(), static_cast<size_t>(kIterations));
+}
@@ -0,0 +1,114 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  ProcessBusTest.cc
+ *        Created:  10/18/26 17:35:02
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+#include <alpha/Channel.h>
+#include <alpha/EventLoop.h>
+#include <alpha/ProcessBus.h>
+
+class ProcessBusTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = "/tmp/alpha_process_bus_test." + std::to_string(getpid());
+    using QueueOrder = alpha::ProcessBus::QueueOrder;
+    ASSERT_TRUE(a_.CreateFrom(path_, 1 << 16, QueueOrder::kReadFirst));
+    ASSERT_TRUE(b_.RestoreFrom(path_, QueueOrder::kWriteFirst));
+    ASSERT_TRUE(a_.EnableNotification());
+    ASSERT_TRUE(b_.EnableNotification());
+  }
+
+  void TearDown() override {
+    ::unlink(path_.c_str());
+    ::unlink((path_ + ".notify0").c_str());
+    ::unlink((path_ + ".notify1").c_str());
+  }
+
+  std::string path_;
+  alpha::ProcessBus a_;
+  alpha::ProcessBus b_;
+};
+
+TEST_F(ProcessBusTest, WaitTimeout) {
+  EXPECT_FALSE(b_.WaitForReadable(10));
+  // 已经有消息时不会睡眠
+  EXPECT_TRUE(a_.Write("x", 1));
+  EXPECT_TRUE(b_.WaitForReadable(-1));
+}
+
+TEST_F(ProcessBusTest, WakeupOnWrite) {
+  std::thread writer([this] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_TRUE(a_.Write("hello", 5));
+  });
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(b_.WaitForReadable(5000));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+  writer.join();
+  int len;
+  auto data = static_cast<char*>(b_.Read(&len));
+  ASSERT_TRUE(data != nullptr);
+  EXPECT_EQ(std::string(data, len), "hello");
+}
+
+TEST_F(ProcessBusTest, SignalOncePerWait) {
+  // 没有登记等待时写入不通知
+  EXPECT_TRUE(a_.Write("1", 1));
+  char buf[16];
+  EXPECT_EQ(::read(b_.notify_fd(), buf, sizeof(buf)), -1);
+  int len;
+  EXPECT_TRUE(b_.Read(&len) != nullptr);
+
+  EXPECT_TRUE(b_.PrepareWait());
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(a_.Write("2", 1));
+  }
+  EXPECT_EQ(::read(b_.notify_fd(), buf, sizeof(buf)), 1);
+  // 队列不为空时不能睡眠
+  EXPECT_FALSE(b_.PrepareWait());
+}
+
+TEST_F(ProcessBusTest, EventLoop) {
+  alpha::EventLoop loop;
+  alpha::Channel channel(&loop, b_.notify_fd());
+  int received = 0;
+  const int kMessages = 100;
+  channel.set_read_callback([this, &loop, &received] {
+    do {
+      int len;
+      while (b_.Read(&len)) {
+        ++received;
+      }
+    } while (!b_.PrepareWait());
+    if (received == kMessages) {
+      loop.Quit();
+    }
+  });
+  channel.EnableReading();
+  EXPECT_TRUE(b_.PrepareWait());
+
+  std::thread writer([this] {
+    for (int i = 0; i < kMessages; ++i) {
+      EXPECT_TRUE(a_.Write(&i, sizeof(i)));
+      if (i % 10 == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  });
+  loop.Run();
+  writer.join();
+  channel.Remove();
+  EXPECT_EQ(received, kMessages);
+}
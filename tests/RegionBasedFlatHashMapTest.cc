@@ -0,0 +1,247 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  RegionBasedFlatHashMapTest.cc
+ *        Created:  10/18/26 15:21:08
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstring>
+#include <map>
+#include <new>
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/Random.h>
+#include <alpha/experimental/RegionBasedFlatHashMap.h>
+
+using MapType = alpha::RegionBasedFlatHashMap<uint32_t, uint64_t>;
+
+class RegionBasedFlatHashMapTest : public ::testing::Test {
+ protected:
+  // 按16字节对齐
+  char* data() { return reinterpret_cast<char*>(buf_.data()); }
+  size_t size() const { return buf_.size() * sizeof(buf_[0]); }
+
+  // 和std::map比较所有元素, 同时检查迭代器只访问每个元素一次
+  void CheckSame(const MapType& m,
+                 const std::map<uint32_t, uint64_t>& expected) {
+    ASSERT_EQ(m.size(), expected.size());
+    std::map<uint32_t, uint64_t> actual;
+    for (const auto& p : m) {
+      ASSERT_TRUE(actual.emplace(p.first, p.second).second);
+    }
+    EXPECT_EQ(actual, expected);
+    for (const auto& p : expected) {
+      auto it = m.find(p.first);
+      ASSERT_NE(it, m.end());
+      EXPECT_EQ(it->second, p.second);
+    }
+  }
+
+  std::vector<__uint128_t> buf_ = std::vector<__uint128_t>(1 << 10);
+};
+
+TEST_F(RegionBasedFlatHashMapTest, Basic) {
+  auto m = MapType::Create(data(), size());
+  ASSERT_TRUE(m);
+  EXPECT_TRUE(m->empty());
+  EXPECT_EQ(m->capacity() % 16, 0u);
+  EXPECT_EQ(m->max_size(), m->capacity() - m->capacity() / 8);
+  EXPECT_EQ(m->begin(), m->end());
+
+  auto p = m->insert(alpha::make_pod_pair(1u, 100ul));
+  EXPECT_TRUE(p.second);
+  EXPECT_EQ(p.first->second, 100u);
+  p = m->insert(alpha::make_pod_pair(1u, 200ul));
+  EXPECT_FALSE(p.second);
+  EXPECT_EQ(p.first->second, 100u);
+  p.first->second = 200;
+  EXPECT_EQ(m->find(1)->second, 200u);
+  EXPECT_EQ(m->find(2), m->end());
+
+  EXPECT_EQ(m->erase(2), 0u);
+  EXPECT_EQ(m->erase(1), 1u);
+  EXPECT_TRUE(m->empty());
+  EXPECT_EQ(m->find(1), m->end());
+}
+
+TEST_F(RegionBasedFlatHashMapTest, Full) {
+  auto m = MapType::Create(data(), size());
+  ASSERT_TRUE(m);
+  std::map<uint32_t, uint64_t> expected;
+  for (uint32_t i = 0; i < m->max_size(); ++i) {
+    ASSERT_TRUE(m->insert(alpha::make_pod_pair(i, uint64_t(i) * 3)).second);
+    expected[i] = uint64_t(i) * 3;
+  }
+  EXPECT_THROW(m->insert(alpha::make_pod_pair(m->max_size(), 0ul)),
+               std::bad_alloc);
+  // 已有的key仍然可以找到
+  EXPECT_FALSE(m->insert(alpha::make_pod_pair(0u, 0ul)).second);
+  CheckSame(*m, expected);
+
+  m->clear();
+  EXPECT_TRUE(m->empty());
+  EXPECT_EQ(m->begin(), m->end());
+}
+
+// 满负载下反复删除插入会留下很多墓碑, 插入时要能清理掉继续使用
+TEST_F(RegionBasedFlatHashMapTest, Churn) {
+  auto m = MapType::Create(data(), size());
+  ASSERT_TRUE(m);
+  std::map<uint32_t, uint64_t> expected;
+  std::vector<uint32_t> keys;
+  while (keys.size() < m->max_size()) {
+    auto key = alpha::Random::Rand32();
+    if (expected.emplace(key, key).second) {
+      keys.push_back(key);
+      ASSERT_TRUE(m->insert(alpha::make_pod_pair(key, uint64_t(key))).second);
+    }
+  }
+  for (int i = 0; i < 20000; ++i) {
+    auto index = alpha::Random::Rand32(keys.size());
+    ASSERT_EQ(m->erase(keys[index]), 1u);
+    expected.erase(keys[index]);
+    uint32_t key;
+    do {
+      key = alpha::Random::Rand32();
+    } while (expected.count(key));
+    keys[index] = key;
+    expected[key] = key;
+    ASSERT_TRUE(m->insert(alpha::make_pod_pair(key, uint64_t(key))).second);
+  }
+  CheckSame(*m, expected);
+
+  // 边迭代边删除
+  for (auto it = m->begin(); it != m->end();) {
+    if (it->first % 2) {
+      expected.erase(it->first);
+      it = m->erase(it);
+    } else {
+      ++it;
+    }
+  }
+  CheckSame(*m, expected);
+}
+
+TEST_F(RegionBasedFlatHashMapTest, Restore) {
+  std::map<uint32_t, uint64_t> expected;
+  {
+    auto m = MapType::Create(data(), size());
+    ASSERT_TRUE(m);
+    for (uint32_t i = 0; i < 500; ++i) {
+      m->insert(alpha::make_pod_pair(i * 7, uint64_t(i)));
+      expected[i * 7] = i;
+    }
+    m->erase(7);
+    expected.erase(7);
+  }
+  auto m = MapType::Restore(data(), size());
+  ASSERT_TRUE(m);
+  CheckSame(*m, expected);
+
+  // 大小不同或者元素类型不同都不能恢复
+  EXPECT_FALSE(MapType::Restore(data(), size() / 2));
+  using OtherMapType = alpha::RegionBasedFlatHashMap<uint32_t, uint32_t>;
+  EXPECT_FALSE(OtherMapType::Restore(data(), size()));
+  // 不对齐的内存
+  EXPECT_FALSE(MapType::Create(data() + 1, size() - 1));
+  EXPECT_FALSE(MapType::Create(data(), 32));
+}
+
+// 调用次数到了crash_at时直接退出, 模拟插入过程中进程被杀掉
+static int64_t hash_calls = 0;
+static int64_t crash_at = -1;
+
+struct CrashingHash {
+  size_t operator()(uint32_t k) const {
+    if (++hash_calls == crash_at) {
+      _exit(0);
+    }
+    return std::hash<uint32_t>()(k);
+  }
+};
+
+TEST_F(RegionBasedFlatHashMapTest, CrashInDropDeletes) {
+  using CrashingMapType =
+      alpha::RegionBasedFlatHashMap<uint32_t, uint64_t, CrashingHash>;
+  // 子进程的修改要对父进程可见, 和mmap文件一样用共享映射
+  const size_t kSize = size();
+  auto data = static_cast<char*>(::mmap(nullptr,
+                                        kSize,
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_ANONYMOUS,
+                                        -1,
+                                        0));
+  ASSERT_NE(data, MAP_FAILED);
+  auto m = CrashingMapType::Create(data, kSize);
+  ASSERT_TRUE(m);
+  std::map<uint32_t, uint64_t> expected;
+  std::vector<uint32_t> keys;
+  uint32_t next_key = 0;
+  while (keys.size() < m->max_size()) {
+    keys.push_back(next_key);
+    expected[next_key] = next_key;
+    ASSERT_TRUE(
+        m->insert(alpha::make_pod_pair(next_key, uint64_t(next_key))).second);
+    ++next_key;
+  }
+
+  // 反复删除插入, 直到某次插入需要清理墓碑, 记下插入之前的内存
+  std::vector<char> snapshot;
+  int64_t drop_calls = 0;
+  uint32_t key = 0;
+  for (int i = 0; i < 100000 && drop_calls == 0; ++i) {
+    auto index = alpha::Random::Rand32(keys.size());
+    ASSERT_EQ(m->erase(keys[index]), 1u);
+    expected.erase(keys[index]);
+    key = keys[index] = next_key++;
+    snapshot.assign(data, data + kSize);
+    auto calls = hash_calls;
+    ASSERT_TRUE(m->insert(alpha::make_pod_pair(key, uint64_t(key))).second);
+    if (hash_calls - calls > 1) {
+      drop_calls = hash_calls - calls;
+    } else {
+      expected[key] = key;
+    }
+  }
+  ASSERT_GT(drop_calls, 0);
+
+  // 在清理墓碑的每一步崩溃, 恢复之后已有的元素都还在
+  for (int64_t n = 1; n <= drop_calls; ++n) {
+    memcpy(data, snapshot.data(), kSize);
+    pid_t pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+      auto child = CrashingMapType::Restore(data, kSize);
+      crash_at = hash_calls + n;
+      if (child) {
+        child->insert(alpha::make_pod_pair(key, uint64_t(key)));
+      }
+      _exit(1);
+    }
+    int status = 0;
+    ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0) << n;
+
+    auto restored = CrashingMapType::Restore(data, kSize);
+    ASSERT_TRUE(restored) << n;
+    ASSERT_EQ(restored->size(), expected.size()) << n;
+    std::map<uint32_t, uint64_t> actual;
+    for (const auto& p : *restored) {
+      ASSERT_TRUE(actual.emplace(p.first, p.second).second) << n;
+    }
+    ASSERT_EQ(actual, expected) << n;
+    // 恢复之后还能继续插入
+    ASSERT_TRUE(
+        restored->insert(alpha::make_pod_pair(key, uint64_t(key))).second);
+    ASSERT_EQ(restored->find(key)->second, key);
+  }
+  ::munmap(data, kSize);
+}
@@ -177,3 +177,98 @@ TEST_F(RingBufferTest, TestFulfil) {
 
   EXPECT_EQ(num, 0);
 }
+
+TEST_F(RingBufferTest, PeekContiguous) {
+  std::string msg = "Long live the queen!";
+  ASSERT_TRUE(buffer_->Push(msg.data(), msg.size()));
+  int len;
+  auto data = static_cast<char*>(buffer_->PeekContiguous(&len));
+  ASSERT_NE(data, nullptr);
+  // 没有回绕时直接指向共享内存
+  EXPECT_GE(data, underlying_buffer_);
+  EXPECT_LT(data, underlying_buffer_ + kBufferSize);
+  EXPECT_EQ(std::string(data, len), msg);
+  EXPECT_EQ(buffer_->PeekContiguous(&len), data);
+  buffer_->Commit();
+  EXPECT_TRUE(buffer_->empty());
+  EXPECT_EQ(buffer_->PeekContiguous(&len), nullptr);
+  EXPECT_EQ(len, 0);
+}
+
+TEST_F(RingBufferTest, ReserveAndCommit) {
+  // 先把back推到靠近末尾的位置
+  std::vector<char> buf(alpha::RingBuffer::kMaxBufferBodyLength, 0x3f);
+  int len;
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(buffer_->Push(buf.data(), buf.size()));
+    buffer_->Pop(&len);
+  }
+  ASSERT_TRUE(buffer_->Push(buf.data(), 60000));
+  buffer_->Pop(&len);
+
+  // 会回绕的消息先写到线程局部缓冲区, 读的时候也要拷贝
+  const int kSize = 10000;
+  auto p = static_cast<char*>(buffer_->Reserve(kSize));
+  ASSERT_NE(p, nullptr);
+  EXPECT_TRUE(p < underlying_buffer_ || p >= underlying_buffer_ + kBufferSize);
+  for (int i = 0; i < kSize; ++i) {
+    p[i] = i % 128;
+  }
+  EXPECT_FALSE(buffer_->CommitReserved(kSize + 1));
+  EXPECT_TRUE(buffer_->empty());
+  ASSERT_EQ(buffer_->Reserve(kSize), p);
+  EXPECT_TRUE(buffer_->CommitReserved(kSize));
+  auto data = static_cast<char*>(buffer_->PeekContiguous(&len));
+  ASSERT_EQ(len, kSize);
+  EXPECT_TRUE(data < underlying_buffer_ ||
+              data >= underlying_buffer_ + kBufferSize);
+  for (int i = 0; i < kSize; ++i) {
+    ASSERT_EQ(data[i], i % 128);
+  }
+  buffer_->Commit();
+  EXPECT_TRUE(buffer_->empty());
+
+  // 不回绕时直接在共享内存中构造, 提交的长度可以比预留的小
+  std::string msg = "Long live the queen!";
+  p = static_cast<char*>(buffer_->Reserve(100));
+  ASSERT_NE(p, nullptr);
+  EXPECT_GE(p, underlying_buffer_);
+  EXPECT_LT(p, underlying_buffer_ + kBufferSize);
+  memcpy(p, msg.data(), msg.size());
+  EXPECT_TRUE(buffer_->CommitReserved(msg.size()));
+  EXPECT_FALSE(buffer_->CommitReserved(msg.size()));
+  data = static_cast<char*>(buffer_->Pop(&len));
+  EXPECT_EQ(std::string(data, len), msg);
+  EXPECT_TRUE(buffer_->empty());
+}
+
+TEST_F(RingBufferTest, RestoreLegacyLayout) {
+  // 旧布局: 两个int64_t的位置, 后面紧跟着数据
+  alignas(8) char buf[1024] = {};
+  std::string msg = "Long live the queen!";
+  int len = msg.size();
+  int64_t offsets[2] = {0, static_cast<int64_t>(sizeof(len) + msg.size())};
+  memcpy(buf, offsets, sizeof(offsets));
+  memcpy(buf + sizeof(offsets), &len, sizeof(len));
+  memcpy(buf + sizeof(offsets) + sizeof(len), msg.data(), msg.size());
+
+  alpha::RingBuffer buffer;
+  ASSERT_TRUE(buffer.RestoreFrom(buf, sizeof(buf)));
+  EXPECT_TRUE(buffer.legacy_layout());
+  void* data = buffer.Pop(&len);
+  ASSERT_NE(data, nullptr);
+  EXPECT_EQ(std::string(static_cast<char*>(data), len), msg);
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_TRUE(buffer.Push(msg.data(), msg.size()));
+  EXPECT_EQ(std::string(static_cast<char*>(buffer.Pop(&len)), len), msg);
+
+  // 位置越界说明文件已经损坏
+  offsets[1] = sizeof(buf);
+  memcpy(buf, offsets, sizeof(offsets));
+  alpha::RingBuffer broken;
+  EXPECT_FALSE(broken.RestoreFrom(buf, sizeof(buf)));
+  EXPECT_FALSE(broken);
+
+  // 新创建的都是新布局
+  EXPECT_FALSE(buffer_->legacy_layout());
+}
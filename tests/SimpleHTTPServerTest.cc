@@ -0,0 +1,312 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  SimpleHTTPServerTest.cc
+ *        Created:  10/18/26 22:05:17
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/EventLoop.h>
+#include <alpha/HTTPMessage.h>
+#include <alpha/HTTPRequest.h>
+#include <alpha/HTTPResponseBuilder.h>
+#include <alpha/HTTPRouter.h>
+#include <alpha/NetAddress.h>
+#include <alpha/SimpleHTTPServer.h>
+
+class SimpleHTTPServerTest : public ::testing::Test {
+ protected:
+  SimpleHTTPServerTest() : server_(&loop_), port_(0) {}
+
+  void SetUp() override {
+    // 先绑定0端口拿到一个空闲端口
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(fd, 0);
+    struct sockaddr_in addr = alpha::NetAddress("127.0.0.1", 0).ToSockAddr();
+    ASSERT_EQ(::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len), 0);
+    port_ = ntohs(addr.sin_port);
+    ::close(fd);
+
+    // 回包的内容就是请求的路径
+    server_.SetCallback(
+        [](alpha::TcpConnectionPtr conn, const alpha::HTTPMessage& message) {
+          alpha::HTTPResponseBuilder builder(conn);
+          builder.status(200, "OK").body(message.Path()).SendWithEOM();
+        });
+  }
+
+  // 在另一个线程中用阻塞的socket发出请求, 读到连接关闭为止
+  std::string Request(const std::string& request, bool send = true) {
+    return Request(send ? std::vector<std::string>(1, request)
+                        : std::vector<std::string>(),
+                   0);
+  }
+
+  // 分成几次发出, 每次间隔interval毫秒
+  std::string Request(const std::vector<std::string>& pieces, int interval) {
+    std::string response;
+    std::thread client([&] {
+      struct sockaddr_in addr =
+          alpha::NetAddress("127.0.0.1", port_).ToSockAddr();
+      struct timeval timeout = {2, 0};
+      int fd = -1;
+      // Listen是在loop中执行的, loop跑起来之前可能连不上
+      for (int i = 0; i < 100; ++i) {
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ==
+            0) {
+          break;
+        }
+        ::close(fd);
+        fd = -1;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+      EXPECT_GE(fd, 0);
+      if (fd >= 0) {
+        for (size_t i = 0; i < pieces.size(); ++i) {
+          if (i != 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+          }
+          // 服务端提前关闭时不能因为SIGPIPE退出
+          EXPECT_EQ(
+              ::send(fd, pieces[i].data(), pieces[i].size(), MSG_NOSIGNAL),
+              static_cast<ssize_t>(pieces[i].size()));
+        }
+        char buf[4096];
+        ssize_t n;
+        while ((n = ::read(fd, buf, sizeof(buf))) > 0) {
+          response.append(buf, n);
+        }
+        EXPECT_EQ(n, 0) << "connection not closed by server";
+        ::close(fd);
+      }
+      loop_.Quit();
+    });
+    loop_.Run();
+    client.join();
+    return response;
+  }
+
+  static std::string Response(const std::string& body, bool keep_alive) {
+    return std::string("HTTP/1.1 200 OK\r\nConnection: ") +
+           (keep_alive ? "keep-alive" : "close") + "\r\nContent-Length: " +
+           std::to_string(body.size()) + "\r\n\r\n" + body;
+  }
+
+  alpha::EventLoop loop_;
+  alpha::SimpleHTTPServer server_;
+  int port_;
+};
+
+TEST_F(SimpleHTTPServerTest, KeepAliveAndPipelining) {
+  ASSERT_TRUE(server_.Run(alpha::NetAddress("127.0.0.1", port_)));
+  // 一次发出多个请求, 同一个连接上按顺序回包, 直到客户端要求关闭
+  auto response = Request(
+      "GET /a HTTP/1.1\r\nHost: localhost\r\n\r\n"
+      "POST /b HTTP/1.1\r\nContent-Length: 4\r\n\r\nbody"
+      "GET /c?x=1 HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n"
+      "GET /d HTTP/1.1\r\nConnection: close\r\n\r\n"
+      "GET /ignored HTTP/1.1\r\n\r\n");
+  EXPECT_EQ(response,
+            Response("/a", true) + Response("/b", true) +
+                Response("/c", true) + Response("/d", false));
+}
+
+TEST_F(SimpleHTTPServerTest, HTTP10CloseByDefault) {
+  ASSERT_TRUE(server_.Run(alpha::NetAddress("127.0.0.1", port_)));
+  EXPECT_EQ(Request("GET /x HTTP/1.0\r\n\r\nGET /y HTTP/1.0\r\n\r\n"),
+            Response("/x", false));
+}
+
+TEST_F(SimpleHTTPServerTest, IdleTimeout) {
+  server_.set_idle_timeout(50);
+  ASSERT_TRUE(server_.Run(alpha::NetAddress("127.0.0.1", port_)));
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(Request("", false), "");
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_GE(elapsed, std::chrono::milliseconds(50));
+  EXPECT_LT(elapsed, std::chrono::seconds(1));
+}
+
+TEST_F(SimpleHTTPServerTest, SlowBodyIsNotIdle) {
+  server_.set_idle_timeout(50);
+  // 不拷贝的解析方式要等整个请求收完才会处理
+  server_.SetRequestCallback(
+      [](alpha::TcpConnectionPtr conn, const alpha::HTTPRequest& request) {
+        alpha::HTTPResponseBuilder(conn)
+            .status(200, "OK")
+            .body(request.path())
+            .SendWithEOM();
+      });
+  ASSERT_TRUE(server_.Run(alpha::NetAddress("127.0.0.1", port_)));
+  // 请求一直没收完, 但每次间隔都比idle timeout短, 不能被当成空闲连接关闭
+  std::vector<std::string> pieces = {
+      "POST /slow HTTP/1.1\r\nConnection: close\r\n"
+      "Content-Length: 5\r\n\r\n"};
+  for (int i = 0; i < 5; ++i) {
+    pieces.push_back("x");
+  }
+  EXPECT_EQ(Request(pieces, 30), Response("/slow", false));
+}
+
+TEST_F(SimpleHTTPServerTest, Router) {
+  alpha::HTTPRouter router;
+  auto reply = [](const std::string& body) {
+    return [body](alpha::TcpConnectionPtr conn, const alpha::HTTPRequest&) {
+      alpha::HTTPResponseBuilder(conn)
+          .status(200, "OK")
+          .body(body)
+          .SendWithEOM();
+    };
+  };
+  router.Add("GET", "/status", reply("status"));
+  router.Add("", "/static/index.html", reply("index"));
+  router.AddPrefix("GET", "/static", reply("static"));
+  router.Add("GET", "/warrior", [](alpha::TcpConnectionPtr conn,
+                                   const alpha::HTTPRequest& request) {
+    alpha::HTTPResponseBuilder(conn)
+        .status(200, "OK")
+        .body(request.Param("uin"))
+        .SendWithEOM();
+  });
+  server_.SetRouter(&router);
+  ASSERT_TRUE(server_.Run(alpha::NetAddress("127.0.0.1", port_)));
+
+  auto response = Request(
+      "GET /status HTTP/1.1\r\n\r\n"
+      "POST /static/index.html HTTP/1.1\r\nContent-Length: 1\r\n\r\nx"
+      "GET /static/js/app.js HTTP/1.1\r\n\r\n"
+      "GET /warrior?uin=42 HTTP/1.1\r\n\r\n"
+      "POST /status HTTP/1.1\r\nContent-Length: 0\r\n\r\n"
+      "GET /missing HTTP/1.1\r\nConnection: close\r\n\r\n");
+  const std::string method_not_allowed =
+      "HTTP/1.1 405 Method Not Allowed\r\nConnection: keep-alive\r\n"
+      "Content-Length: 0\r\n\r\n";
+  const std::string not_found =
+      "HTTP/1.1 404 Not Found\r\nConnection: close\r\n"
+      "Content-Length: 0\r\n\r\n";
+  EXPECT_EQ(response,
+            Response("status", true) + Response("index", true) +
+                Response("static", true) + Response("42", true) +
+                method_not_allowed + not_found);
+}
+
+// 每块内容不同, 总大小超过连接的发送缓冲区上限
+static const int kStreamChunks = 64;
+
+static std::string MakeChunk(int i) {
+  return std::string(64 << 10, static_cast<char>('a' + i % 26));
+}
+
+// 请求/stream时流式回包, 其他请求回复路径
+static void StreamCallback(alpha::TcpConnectionPtr conn,
+                           const alpha::HTTPMessage& message) {
+  if (message.Path() != "/stream") {
+    alpha::HTTPResponseBuilder(conn)
+        .status(200, "OK")
+        .body(message.Path())
+        .SendWithEOM();
+    return;
+  }
+  auto next = std::make_shared<int>(0);
+  alpha::HTTPResponseBuilder(conn)
+      .status(200, "OK")
+      .SendChunked([next](std::string* chunk) {
+        if (*next == kStreamChunks) return false;
+        *chunk = MakeChunk((*next)++);
+        return true;
+      });
+}
+
+TEST_F(SimpleHTTPServerTest, ChunkedStreaming) {
+  server_.SetCallback(&StreamCallback);
+  ASSERT_TRUE(server_.Run(alpha::NetAddress("127.0.0.1", port_)));
+  // 流式回包发完之前, 后面的流水线请求不能插进来
+  auto response = Request(
+      "GET /stream HTTP/1.1\r\n\r\n"
+      "GET /after HTTP/1.1\r\nConnection: close\r\n\r\n");
+  std::string expected =
+      "HTTP/1.1 200 OK\r\nConnection: keep-alive\r\n"
+      "Transfer-Encoding: chunked\r\n\r\n";
+  for (int i = 0; i < kStreamChunks; ++i) {
+    expected += "10000\r\n" + MakeChunk(i) + "\r\n";
+  }
+  expected += "0\r\n\r\n" + Response("/after", false);
+  ASSERT_EQ(response.size(), expected.size());
+  EXPECT_TRUE(response == expected);
+}
+
+TEST_F(SimpleHTTPServerTest, StreamingHTTP10) {
+  server_.SetCallback(&StreamCallback);
+  ASSERT_TRUE(server_.Run(alpha::NetAddress("127.0.0.1", port_)));
+  // HTTP/1.0不分块, 发完就关闭连接
+  auto response = Request(
+      "GET /stream HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"
+      "GET /ignored HTTP/1.0\r\n\r\n");
+  std::string expected = "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n";
+  for (int i = 0; i < kStreamChunks; ++i) {
+    expected += MakeChunk(i);
+  }
+  ASSERT_EQ(response.size(), expected.size());
+  EXPECT_TRUE(response == expected);
+}
+
+TEST_F(SimpleHTTPServerTest, SendFile) {
+  char path[] = "/tmp/alpha_sendfile_test.XXXXXX";
+  int fd = ::mkstemp(path);
+  ASSERT_GE(fd, 0);
+  ::unlink(path);
+  std::string content;
+  for (int i = 0; i < 48; ++i) {
+    content += MakeChunk(i);
+  }
+  ASSERT_EQ(::write(fd, content.data(), content.size()),
+            static_cast<ssize_t>(content.size()));
+
+  server_.SetCallback([fd, &content](alpha::TcpConnectionPtr conn,
+                                     const alpha::HTTPMessage& message) {
+    alpha::HTTPResponseBuilder builder(conn);
+    builder.status(200, "OK");
+    if (message.Path() == "/file") {
+      EXPECT_TRUE(builder.SendFile(fd, 0, content.size()));
+    } else if (message.Path() == "/range") {
+      EXPECT_TRUE(builder.SendFile(fd, 10, 5));
+    } else {
+      // 超出文件范围时什么都没发, 还可以回别的包
+      EXPECT_FALSE(builder.SendFile(fd, 1, content.size()));
+      builder.status(404, "Not Found").SendWithEOM();
+    }
+  });
+  ASSERT_TRUE(server_.Run(alpha::NetAddress("127.0.0.1", port_)));
+
+  auto response = Request(
+      "GET /file HTTP/1.1\r\n\r\n"
+      "GET /invalid HTTP/1.1\r\n\r\n"
+      "GET /range HTTP/1.1\r\nConnection: close\r\n\r\n");
+  const std::string not_found =
+      "HTTP/1.1 404 Not Found\r\nConnection: keep-alive\r\n"
+      "Content-Length: 0\r\n\r\n";
+  auto expected = Response(content, true) + not_found +
+                  Response(content.substr(10, 5), false);
+  ASSERT_EQ(response.size(), expected.size());
+  EXPECT_TRUE(response == expected);
+  ::close(fd);
+}
@@ -10,7 +10,14 @@
  * ==============================================================================
  */
 
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <limits>
 #include <map>
+#include <new>
+#include <string>
 #include <vector>
 #include <gtest/gtest.h>
 #include <alpha/SkipList.h>
@@ -23,12 +30,18 @@ class SkipListTest : public ::testing::Test {
   virtual void SetUp() {
     buffer_.resize(kBufferSize);
     list_ = DefaultSkipListType::Create(buffer_.data(), buffer_.size());
+    backup_ = "/tmp/alpha_skip_list_test." + std::to_string(getpid());
+    ::unlink(backup_.c_str());
   }
 
-  virtual void TearDown() { buffer_.clear(); }
+  virtual void TearDown() {
+    buffer_.clear();
+    ::unlink(backup_.c_str());
+  }
 
   static const size_t kBufferSize = (1 << 23);
   std::vector<char> buffer_;
+  std::string backup_;
   DefaultSkipListType::UniquePtr list_;
 };
 
@@ -316,3 +329,249 @@ TEST_F(SkipListTest, Restore) {
   ASSERT_TRUE(newlist->empty());
   ASSERT_EQ(list_->size(), expected_elements);
 }
+
+// 旧的布局中每个节点都带kMaxLevel个前向指针
+struct LegacyNode {
+  uint32_t prev;
+  uint32_t level;
+  uint32_t levels[20];
+  alpha::SkipList<int, int>::value_type val;
+};
+
+TEST_F(SkipListTest, Capacity) {
+  ASSERT_NE(list_, nullptr);
+  const auto legacy_max_size = kBufferSize / sizeof(LegacyNode);
+  EXPECT_GE(list_->max_size(), 4 * legacy_max_size);
+
+  // 反复删除和插入, 空闲节点被重新利用, 始终能放下max_size个元素
+  std::vector<char> buffer(1 << 18);
+  auto list = DefaultSkipListType::Create(buffer.data(), buffer.size());
+  ASSERT_NE(list, nullptr);
+  std::map<int, int> m;
+  for (int round = 0; round < 3; ++round) {
+    while (list->size() < list->max_size()) {
+      int key = alpha::Random::Rand32();
+      auto res = list->insert(std::make_pair(key, ~key));
+      EXPECT_EQ(res.second, m.emplace(key, ~key).second);
+    }
+    EXPECT_THROW(list->insert(std::make_pair(m.begin()->first - 1, 0)),
+                 std::bad_alloc);
+    for (auto it = m.begin(); it != m.end();) {
+      if (alpha::Random::Rand32() % 2) {
+        ASSERT_EQ(list->erase(it->first), 1u);
+        it = m.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    ASSERT_EQ(list->size(), m.size());
+  }
+  ASSERT_TRUE(std::equal(
+      m.begin(),
+      m.end(),
+      list->begin(),
+      [](const std::pair<const int, int>& lhs,
+         const DefaultSkipListType::value_type& rhs) {
+        return lhs.first == rhs.first && lhs.second == rhs.second;
+      }));
+}
+
+// 按旧的布局构造数据: 头部, MemoryList<LegacyNode>, 所有元素节点都只有一层
+static void BuildLegacyLayout(char* start, size_t size, int elements) {
+  auto header = reinterpret_cast<uint32_t*>(start);
+  auto nodes = alpha::MemoryList<LegacyNode>::Create(start + 24, size - 24);
+  ASSERT_NE(nodes, nullptr);
+  auto head = nodes->Allocate();
+  auto tail = nodes->Allocate();
+  auto prev = head;
+  for (int i = 0; i < elements; ++i) {
+    auto id = nodes->Allocate();
+    auto node = nodes->Get(id);
+    node->prev = prev;
+    node->level = 1;
+    node->val.first = i * 2;
+    node->val.second = i;
+    nodes->Get(prev)->levels[0] = id;
+    prev = id;
+  }
+  nodes->Get(prev)->levels[0] = tail;
+  nodes->Get(tail)->prev = prev;
+  header[0] = head;
+  header[1] = tail;
+  header[2] = 20;
+  header[3] = elements;
+  *reinterpret_cast<int64_t*>(header + 4) = 0x631e48e40b310071;
+}
+
+TEST_F(SkipListTest, RestoreLegacyLayout) {
+  const int kElements = 1000;
+  BuildLegacyLayout(buffer_.data(), buffer_.size(), kElements);
+  std::vector<char> legacy(buffer_);
+  // 没有备份文件时不转换, 数据不变
+  EXPECT_EQ(DefaultSkipListType::Restore(buffer_.data(), buffer_.size()),
+            nullptr);
+  ASSERT_EQ(buffer_, legacy);
+
+  auto list =
+      DefaultSkipListType::Restore(buffer_.data(), buffer_.size(), backup_);
+  ASSERT_NE(list, nullptr);
+  EXPECT_EQ(list->size(), static_cast<uint32_t>(kElements));
+  int i = 0;
+  for (const auto& v : *list) {
+    EXPECT_EQ(v.first, i * 2);
+    EXPECT_EQ(v.second, i);
+    ++i;
+  }
+  EXPECT_EQ(i, kElements);
+  EXPECT_EQ(list->find(1), list->end());
+  EXPECT_EQ(list->find(100)->second, 50);
+  // 转换完成之后删掉备份
+  EXPECT_NE(::access(backup_.c_str(), F_OK), 0);
+
+  // 转换之后按新的布局恢复
+  list.reset();
+  list = DefaultSkipListType::Restore(buffer_.data(), buffer_.size());
+  ASSERT_NE(list, nullptr);
+  EXPECT_EQ(list->size(), static_cast<uint32_t>(kElements));
+  EXPECT_EQ(list->max_size(), list_->max_size());
+}
+
+static int compare_calls = 0;
+static int crash_at = -1;
+struct CrashingLess {
+  bool operator()(int lhs, int rhs) const {
+    if (++compare_calls == crash_at) {
+      _exit(0);
+    }
+    return lhs < rhs;
+  }
+};
+
+TEST_F(SkipListTest, CrashWhileConvertingLegacyLayout) {
+  using ListType = alpha::SkipList<int, int, 20, CrashingLess>;
+  const int kElements = 100;
+  const size_t kSize = 1 << 16;
+  std::vector<char> legacy(kSize);
+  BuildLegacyLayout(legacy.data(), legacy.size(), kElements);
+  int convert_calls;
+  {
+    std::vector<char> buffer(legacy);
+    compare_calls = 0;
+    ASSERT_NE(ListType::Restore(buffer.data(), buffer.size(), backup_),
+              nullptr);
+    convert_calls = compare_calls;
+  }
+
+  auto region = static_cast<char*>(::mmap(nullptr,
+                                          kSize,
+                                          PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_ANONYMOUS,
+                                          -1,
+                                          0));
+  ASSERT_NE(region, MAP_FAILED);
+  // 转换中途的各个位置崩溃, 下次Restore都能从备份重新转换
+  // 节点的层数是随机的, 比较次数每次不完全一样, 不取最后的位置
+  for (int n :
+       {1, convert_calls / 3, convert_calls / 2, convert_calls * 3 / 4}) {
+    memcpy(region, legacy.data(), kSize);
+    auto pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+      compare_calls = 0;
+      crash_at = n;
+      ListType::Restore(region, kSize, backup_);
+      _exit(1);
+    }
+    int status;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0) << n;
+    // 没有备份文件时不能恢复转换了一半的数据
+    EXPECT_EQ(ListType::Restore(region, kSize), nullptr);
+
+    auto list = ListType::Restore(region, kSize, backup_);
+    ASSERT_NE(list, nullptr) << n;
+    ASSERT_EQ(list->size(), static_cast<uint32_t>(kElements));
+    int i = 0;
+    for (const auto& v : *list) {
+      ASSERT_EQ(v.first, i * 2);
+      ASSERT_EQ(v.second, i);
+      ++i;
+    }
+    EXPECT_NE(::access(backup_.c_str(), F_OK), 0);
+  }
+  ::munmap(region, kSize);
+}
+
+TEST(IndexedSkipListTest, Rank) {
+  using ListType = alpha::IndexedSkipList<int, int>;
+  std::vector<char> buffer(1 << 18);
+  auto list = ListType::Create(buffer.data(), buffer.size());
+  ASSERT_NE(list, nullptr);
+  // 节点里多了span, 但还是比旧的布局能放下更多的元素
+  EXPECT_GE(list->max_size(), 3 * buffer.size() / sizeof(LegacyNode));
+
+  std::map<int, int> m;
+  auto check = [&m](const ListType& l) {
+    ASSERT_EQ(l.size(), m.size());
+    uint32_t r = 0;
+    for (const auto& p : m) {
+      ASSERT_EQ(l.rank(p.first), r);
+      ASSERT_EQ(l.rank(p.first + 1), r + 1) << "key " << p.first;
+      auto it = l.at_rank(r);
+      ASSERT_NE(it, l.end());
+      ASSERT_EQ(it->first, p.first);
+      ++r;
+    }
+    EXPECT_EQ(l.at_rank(r), l.end());
+  };
+  for (int round = 0; round < 3; ++round) {
+    while (m.size() < list->max_size() / 2) {
+      // 键都是偶数, 奇数用来测试不存在的键
+      int key = alpha::Random::Rand32() % 100000 * 2;
+      EXPECT_EQ(list->insert(std::make_pair(key, key)).second,
+                m.emplace(key, key).second);
+    }
+    for (auto it = m.begin(); it != m.end();) {
+      if (alpha::Random::Rand32() % 3 == 0) {
+        ASSERT_EQ(list->erase(it->first), 1u);
+        it = m.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    check(*list);
+  }
+
+  auto range = list->range_by_rank(10, 5);
+  auto it = m.begin();
+  std::advance(it, 10);
+  for (int i = 0; i < 5; ++i, ++it, ++range.first) {
+    ASSERT_NE(range.first, range.second);
+    EXPECT_EQ(range.first->first, it->first);
+  }
+  EXPECT_EQ(range.first, range.second);
+  range = list->range_by_rank(m.size() - 2, 5);
+  EXPECT_EQ(std::distance(range.first, range.second), 2);
+  EXPECT_EQ(range.second, list->end());
+  range = list->range_by_rank(m.size() + 1, 5);
+  EXPECT_EQ(range.first, list->end());
+  EXPECT_EQ(range.second, list->end());
+  // start + n溢出时也不能回绕到前面的元素
+  const auto kMaxRank = std::numeric_limits<ListType::size_type>::max();
+  range = list->range_by_rank(m.size() + 5, kMaxRank - 5);
+  EXPECT_EQ(range.first, list->end());
+  EXPECT_EQ(range.second, list->end());
+  range = list->range_by_rank(m.size() - 2, kMaxRank);
+  EXPECT_EQ(std::distance(range.first, range.second), 2);
+  EXPECT_EQ(range.second, list->end());
+
+  // 从拷贝的内存中恢复, span也一起恢复
+  std::vector<char> copy(buffer);
+  auto restored = ListType::Restore(copy.data(), copy.size());
+  ASSERT_NE(restored, nullptr);
+  check(*restored);
+  // 两种布局不能互相恢复
+  using PlainListType = alpha::SkipList<int, int>;
+  EXPECT_EQ(PlainListType::Restore(copy.data(), copy.size()), nullptr);
+}
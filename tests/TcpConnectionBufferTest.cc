@@ -12,12 +12,15 @@
 
 #include <cstring>
 #include <limits>
+#include <string>
 #include <algorithm>
 #include <gtest/gtest.h>
 #include <alpha/TcpConnectionBuffer.h>
 
 TEST(TcpConnectionBufferTest, Append) {
   alpha::TcpConnectionBuffer buffer;
+  EXPECT_EQ(buffer.GetContiguousSpace(), 0u);
+  ASSERT_TRUE(buffer.EnsureSpace(1));
   auto length = buffer.GetContiguousSpace();
   if (length != 0) {
     char c = 0x3f;
@@ -36,6 +39,7 @@ TEST(TcpConnectionBufferTest, Append) {
 
 TEST(TcpConnectionBufferTest, WriteInternalBuffer) {
   alpha::TcpConnectionBuffer buffer;
+  ASSERT_TRUE(buffer.EnsureSpace(1));
   auto length = buffer.GetContiguousSpace();
   auto p = buffer.WriteBegin();
   memset(p, 0x3f, length);
@@ -50,15 +54,21 @@ TEST(TcpConnectionBufferTest, WriteInternalBuffer) {
 TEST(TcpConnectionBufferTest, GetContiguousSpace) {
   alpha::TcpConnectionBuffer buffer;
   auto length = buffer.GetContiguousSpace();
+  EXPECT_EQ(length, 0u);
+  EXPECT_EQ(buffer.capacity(), 0u);
+  ASSERT_TRUE(buffer.EnsureSpace(1));
+  length = buffer.GetContiguousSpace();
   EXPECT_EQ(length, alpha::TcpConnectionBuffer::kDefaultBufferSize);
   const std::string s = "The final answer is 42!";
   ASSERT_LE(s.size(), alpha::TcpConnectionBuffer::kDefaultBufferSize);
   buffer.Append(s);
   length = buffer.GetContiguousSpace();
   EXPECT_EQ(length, alpha::TcpConnectionBuffer::kDefaultBufferSize - s.size());
+  // 读空之后chunk已经释放
   buffer.ConsumeBytes(s.size());
   length = buffer.GetContiguousSpace();
-  EXPECT_EQ(length, alpha::TcpConnectionBuffer::kDefaultBufferSize);
+  EXPECT_EQ(length, 0u);
+  EXPECT_EQ(buffer.capacity(), 0u);
 
   // force reallocate memory
   ASSERT_LT(alpha::TcpConnectionBuffer::kDefaultBufferSize,
@@ -211,3 +221,78 @@ TEST(TcpConnectionBufferTest, Capacity) {
   ok = buffer.Append("\n");
   EXPECT_NE(capacity, buffer.capacity());
 }
+
+TEST(TcpConnectionBufferTest, ReadAcrossChunks) {
+  alpha::TcpConnectionBufferPool pool;
+  alpha::TcpConnectionBuffer buffer(&pool);
+  const size_t kChunkSize = alpha::TcpConnectionBuffer::kChunkSize;
+  std::string s;
+  for (size_t i = 0; i < kChunkSize * 2 + 100; ++i) {
+    s.push_back('a' + i % 26);
+  }
+  ASSERT_TRUE(buffer.Append(s));
+  EXPECT_EQ(buffer.capacity(), kChunkSize * 3);
+
+  iovec iov[4];
+  ASSERT_EQ(buffer.Read(iov, 4), 3);
+  EXPECT_EQ(iov[0].iov_len, kChunkSize);
+  EXPECT_EQ(iov[2].iov_len, 100u);
+  EXPECT_EQ(memcmp(iov[1].iov_base, s.data() + kChunkSize, kChunkSize), 0);
+
+  buffer.ConsumeBytes(kChunkSize + 1);
+  EXPECT_EQ(pool.free_chunks(), 1u);
+  ASSERT_EQ(buffer.Read(iov, 4), 2);
+
+  // 跨chunk的数据合并成连续内存
+  EXPECT_EQ(buffer.Read(), alpha::Slice(s).subslice(kChunkSize + 1));
+  ASSERT_EQ(buffer.Read(iov, 4), 1);
+
+  buffer.ConsumeBytes(buffer.BytesToRead());
+  EXPECT_EQ(buffer.capacity(), 0u);
+  EXPECT_EQ(pool.free_chunks(), 3u);
+}
+
+TEST(TcpConnectionBufferTest, PrepareWrite) {
+  alpha::TcpConnectionBufferPool pool;
+  alpha::TcpConnectionBuffer buffer(&pool);
+  const size_t kChunkSize = alpha::TcpConnectionBuffer::kChunkSize;
+  ASSERT_TRUE(buffer.Append("hello"));
+
+  iovec iov[8];
+  auto iovcnt = buffer.PrepareWrite(kChunkSize * 2, iov, 8);
+  ASSERT_EQ(iovcnt, 3);
+  EXPECT_EQ(iov[0].iov_len, kChunkSize - 5);
+  EXPECT_EQ(iov[1].iov_len, kChunkSize);
+  EXPECT_EQ(iov[2].iov_len, 5u);
+
+  memset(iov[0].iov_base, 'x', iov[0].iov_len);
+  memset(iov[1].iov_base, 'y', 10);
+  ASSERT_TRUE(buffer.AddBytes(iov[0].iov_len + 10));
+  // 没用上的chunk还给了pool
+  EXPECT_EQ(buffer.capacity(), kChunkSize * 2);
+  EXPECT_EQ(pool.free_chunks(), 1u);
+  EXPECT_EQ(buffer.BytesToRead(), kChunkSize + 10);
+
+  std::string expected = "hello" + std::string(kChunkSize - 5, 'x') +
+                         std::string(10, 'y');
+  EXPECT_EQ(buffer.Read(), alpha::Slice(expected));
+}
+
+TEST(TcpConnectionBufferTest, MaxSize) {
+  alpha::TcpConnectionBuffer buffer(nullptr, 100);
+  EXPECT_EQ(buffer.max_size(), 100u);
+  std::vector<char> bytes(101, 0x3f);
+  EXPECT_FALSE(buffer.Append(bytes.data(), bytes.size()));
+  EXPECT_TRUE(buffer.Append(bytes.data(), 60));
+  EXPECT_EQ(buffer.SpaceBeforeFull(), 40u);
+  EXPECT_EQ(buffer.GetContiguousSpace(), 40u);
+  EXPECT_FALSE(buffer.EnsureSpace(41));
+
+  iovec iov[2];
+  ASSERT_EQ(buffer.PrepareWrite(1000, iov, 2), 1);
+  EXPECT_EQ(iov[0].iov_len, 40u);
+
+  buffer.set_max_size(200);
+  EXPECT_TRUE(buffer.Append(bytes.data(), 101));
+  EXPECT_EQ(buffer.BytesToRead(), 161u);
+}
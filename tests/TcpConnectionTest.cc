@@ -0,0 +1,203 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  TcpConnectionTest.cc
+ *        Created:  10/18/26 15:20:47
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/EventLoop.h>
+#include <alpha/SocketOps.h>
+#include <alpha/TcpConnection.h>
+
+// 返回已连接的一对fd, first是服务端(非阻塞), second是客户端
+static std::pair<int, int> LoopbackPair() {
+  int listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  EXPECT_EQ(::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), len), 0);
+  EXPECT_EQ(::listen(listen_fd, 1), 0);
+  ::getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &len);
+  int client_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  EXPECT_EQ(::connect(client_fd, reinterpret_cast<sockaddr*>(&addr), len), 0);
+  int server_fd = ::accept(listen_fd, nullptr, nullptr);
+  ::close(listen_fd);
+  alpha::SocketOps::SetNonBlocking(server_fd);
+  return std::make_pair(server_fd, client_fd);
+}
+
+TEST(TcpConnectionTest, WriteQueueKeepsOrder) {
+  alpha::EventLoop loop;
+  auto fds = LoopbackPair();
+  // 缩小内核缓冲区, 保证有数据进入发送队列
+  int size = 65536;
+  ::setsockopt(fds.first, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  ::setsockopt(fds.second, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  auto conn = std::make_shared<alpha::TcpConnection>(
+      &loop, fds.first, alpha::TcpConnection::State::kConnected);
+  conn->SetOnWriteDone([&loop](alpha::TcpConnectionPtr) { loop.Quit(); });
+
+  // 拷贝的数据和转交所有权的数据交替写入, 总量超过内核缓冲区
+  std::string expected;
+  const int kRounds = 16;
+  for (int i = 0; i < kRounds; ++i) {
+    std::string small(100, 'a' + i);
+    std::string large(40000, 'A' + i);
+    auto owned = std::make_shared<std::string>(20000, '0' + i % 10);
+    expected += small + large + *owned;
+    EXPECT_TRUE(conn->Write(small));
+    EXPECT_TRUE(conn->Write(std::move(large)));
+    EXPECT_TRUE(conn->Write(alpha::Slice(*owned), owned));
+  }
+  EXPECT_GT(conn->BytesToWrite(), 0u);
+  EXPECT_EQ(conn->BytesCanWrite() + conn->BytesToWrite(),
+            alpha::TcpConnectionBuffer::kMaxBufferSize);
+
+  std::string received;
+  std::thread reader([&received, &expected, &fds] {
+    char buf[8192];
+    while (received.size() < expected.size()) {
+      auto n = ::read(fds.second, buf, sizeof(buf));
+      if (n <= 0) break;
+      received.append(buf, n);
+    }
+  });
+  loop.Run();
+  reader.join();
+  EXPECT_EQ(conn->BytesToWrite(), 0u);
+  EXPECT_TRUE(received == expected);
+  ::close(fds.second);
+}
+
+TEST(TcpConnectionTest, WriteDoneAfterDirectWrite) {
+  alpha::EventLoop loop;
+  auto fds = LoopbackPair();
+  auto conn = std::make_shared<alpha::TcpConnection>(
+      &loop, fds.first, alpha::TcpConnection::State::kConnected);
+  int write_done = 0;
+  conn->SetOnWriteDone([&loop, &write_done](alpha::TcpConnectionPtr) {
+    ++write_done;
+    loop.Quit();
+  });
+  EXPECT_TRUE(conn->Write("hello, "));
+  EXPECT_TRUE(conn->Write(std::string("world")));
+  // 内核缓冲区没满时直接写出去了
+  EXPECT_EQ(conn->BytesToWrite(), 0u);
+  loop.Run();
+  EXPECT_EQ(write_done, 1);
+  char buf[64];
+  auto n = ::read(fds.second, buf, sizeof(buf));
+  EXPECT_EQ(std::string(buf, n), "hello, world");
+  ::close(fds.second);
+}
+
+// 数据一次性到达时只有一次边缘触发, 超过读预算的部分要在后面的循环中读完
+TEST(TcpConnectionTest, EdgeTriggeredReadBudget) {
+  alpha::EventLoop loop;
+  auto fds = LoopbackPair();
+  int size = 4 << 20;
+  ::setsockopt(fds.first, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  ::setsockopt(fds.second, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  const size_t kTotal = 2 << 20;
+  std::atomic<bool> written(false);
+  std::thread writer([&fds, &written] {
+    std::string data(kTotal, 'x');
+    size_t offset = 0;
+    while (offset < data.size()) {
+      auto n = ::write(fds.second, data.data() + offset, data.size() - offset);
+      if (n <= 0) break;
+      offset += n;
+    }
+    written = true;
+  });
+  // 尽量等数据都进了内核缓冲区再开始读
+  for (int i = 0; i < 100 && !written; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  auto conn = std::make_shared<alpha::TcpConnection>(
+      &loop, fds.first, alpha::TcpConnection::State::kConnected, true);
+  size_t received = 0;
+  // 每轮循环中回调的次数, cron_functor每轮调用一次
+  std::vector<int> reads(1, 0);
+  conn->SetOnRead([&](alpha::TcpConnectionPtr,
+                      alpha::TcpConnectionBuffer* buf) {
+    received += buf->BytesToRead();
+    buf->ConsumeBytes(buf->BytesToRead());
+    ++reads.back();
+    if (received == kTotal) loop.Quit();
+  });
+  loop.set_cron_functor([&reads](uint64_t) {
+    reads.push_back(0);
+    return alpha::EventLoop::kIdle;
+  });
+  loop.RunAfter(5000, [&loop] { loop.Quit(); });
+  loop.Run();
+  writer.join();
+  EXPECT_EQ(received, kTotal);
+  // 一次可读事件最多读预算的次数, 剩下的在之后的循环中读
+  EXPECT_GT(std::count_if(reads.begin(), reads.end(), [](int n) { return n; }),
+            1);
+  ::close(fds.second);
+}
+
+TEST(TcpConnectionTest, ReadStaysInOneChunk) {
+  alpha::EventLoop loop;
+  auto fds = LoopbackPair();
+  int size = 4 << 20;
+  ::setsockopt(fds.first, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  ::setsockopt(fds.second, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  const size_t kTotal = 1 << 20;
+  std::atomic<bool> written(false);
+  std::thread writer([&fds, &written] {
+    std::string data(kTotal, 'x');
+    size_t offset = 0;
+    while (offset < data.size()) {
+      auto n = ::write(fds.second, data.data() + offset, data.size() - offset);
+      if (n <= 0) break;
+      offset += n;
+    }
+    written = true;
+  });
+  // 内核里积压的数据比一个chunk多
+  for (int i = 0; i < 100 && !written; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  auto conn = std::make_shared<alpha::TcpConnection>(
+      &loop, fds.first, alpha::TcpConnection::State::kConnected);
+  size_t received = 0;
+  int max_chunks = 0;
+  conn->SetOnRead([&](alpha::TcpConnectionPtr,
+                      alpha::TcpConnectionBuffer* buf) {
+    // 每次都读空, 新读到的数据不会跨chunk, 连续的Read()不需要合并
+    iovec iov[8];
+    max_chunks = std::max(max_chunks, buf->Read(iov, 8));
+    received += buf->BytesToRead();
+    buf->ConsumeBytes(buf->BytesToRead());
+    if (received == kTotal) loop.Quit();
+  });
+  loop.RunAfter(5000, [&loop] { loop.Quit(); });
+  loop.Run();
+  writer.join();
+  EXPECT_EQ(received, kTotal);
+  EXPECT_EQ(max_chunks, 1);
+  ::close(fds.second);
+}
@@ -0,0 +1,307 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  TcpServerTest.cc
+ *        Created:  10/18/26 22:31:06
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/EventLoop.h>
+#include <alpha/EventLoopThreadPool.h>
+#include <alpha/NetAddress.h>
+#include <alpha/TcpConnectionBuffer.h>
+#include <alpha/TcpServer.h>
+
+class TcpServerTest : public ::testing::Test {
+ protected:
+  static const int kThreads = 3;
+
+  TcpServerTest() : pool_(&loop_, kThreads), port_(0), closed_(0) {}
+
+  void SetUp() override {
+    // 先绑定0端口拿到一个空闲端口
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(fd, 0);
+    struct sockaddr_in addr = alpha::NetAddress("127.0.0.1", 0).ToSockAddr();
+    ASSERT_EQ(::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len), 0);
+    port_ = ntohs(addr.sin_port);
+    ::close(fd);
+  }
+
+  void TearDown() override {
+    // 先停止工作线程, 回调里会用到下面的成员
+    server_.reset();
+    for (int fd : clients_) {
+      if (fd >= 0) ::close(fd);
+    }
+  }
+
+  // 回显收到的数据, 记录每个连接被分到了哪个loop
+  void CreateServer(alpha::TcpServer::Dispatch dispatch) {
+    server_.reset(
+        new alpha::TcpServer(&loop_, alpha::NetAddress("127.0.0.1", port_)));
+    server_->SetThreadPool(&pool_, dispatch);
+    server_->SetOnNewConnection([this](alpha::TcpConnectionPtr conn) {
+      EXPECT_TRUE(conn->loop()->IsInLoopThread());
+      std::lock_guard<std::mutex> lock(mutex_);
+      accepted_.push_back(conn->loop());
+      cond_.notify_all();
+    });
+    server_->SetOnRead(
+        [](alpha::TcpConnectionPtr conn, alpha::TcpConnectionBuffer* buf) {
+          auto data = buf->Read();
+          conn->Write(data);
+          buf->ConsumeBytes(data.size());
+        });
+    server_->SetOnClose([this](alpha::TcpConnectionPtr conn) {
+      EXPECT_TRUE(conn->loop()->IsInLoopThread());
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++closed_;
+      cond_.notify_all();
+    });
+  }
+
+  // 在客户端线程中调用, 返回连接在clients_中的下标
+  int Connect() {
+    struct sockaddr_in addr =
+        alpha::NetAddress("127.0.0.1", port_).ToSockAddr();
+    struct timeval timeout = {2, 0};
+    // Listen是在loop中执行的, loop跑起来之前可能连不上
+    for (int i = 0; i < 100; ++i) {
+      int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+      ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ==
+          0) {
+        clients_.push_back(fd);
+        return static_cast<int>(clients_.size()) - 1;
+      }
+      ::close(fd);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ADD_FAILURE() << "connect to port " << port_ << " failed";
+    return -1;
+  }
+
+  bool Echo(int index) {
+    int fd = clients_[index];
+    if (::write(fd, "ping", 4) != 4) {
+      return false;
+    }
+    char buf[4];
+    size_t received = 0;
+    while (received < sizeof(buf)) {
+      auto n = ::read(fd, buf + received, sizeof(buf) - received);
+      if (n <= 0) return false;
+      received += n;
+    }
+    return std::string(buf, sizeof(buf)) == "ping";
+  }
+
+  // 等待服务端一共accept了n个连接
+  bool WaitAccepted(size_t n) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cond_.wait_for(lock, std::chrono::seconds(5), [this, n] {
+      return accepted_.size() >= n;
+    });
+  }
+
+  bool WaitClosed(int n) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cond_.wait_for(
+        lock, std::chrono::seconds(5), [this, n] { return closed_ >= n; });
+  }
+
+  // base loop在当前线程运行, client在另一个线程中运行, 结束后退出loop
+  void RunClient(const std::function<void()>& client) {
+    std::thread t([this, &client] {
+      client();
+      loop_.Quit();
+    });
+    loop_.Run();
+    t.join();
+  }
+
+  std::vector<alpha::EventLoop*> accepted() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return accepted_;
+  }
+
+  alpha::EventLoop loop_;
+  alpha::EventLoopThreadPool pool_;
+  std::unique_ptr<alpha::TcpServer> server_;
+  int port_;
+  std::vector<int> clients_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::vector<alpha::EventLoop*> accepted_;
+  int closed_;
+};
+
+const int TcpServerTest::kThreads;
+
+TEST_F(TcpServerTest, RoundRobin) {
+  CreateServer(alpha::TcpServer::Dispatch::kRoundRobin);
+  ASSERT_TRUE(server_->Run());
+  const int kConnections = 2 * kThreads;
+  RunClient([this] {
+    for (int i = 0; i < kConnections; ++i) {
+      int index = Connect();
+      ASSERT_GE(index, 0);
+      ASSERT_TRUE(WaitAccepted(i + 1));
+      EXPECT_TRUE(Echo(index));
+    }
+  });
+  auto loops = accepted();
+  ASSERT_EQ(loops.size(), static_cast<size_t>(kConnections));
+  for (int i = 0; i < kConnections; ++i) {
+    EXPECT_EQ(loops[i], pool_.GetLoop(i));
+  }
+}
+
+TEST_F(TcpServerTest, LeastConnections) {
+  CreateServer(alpha::TcpServer::Dispatch::kLeastConnections);
+  ASSERT_TRUE(server_->Run());
+  RunClient([this] {
+    for (int i = 0; i < kThreads; ++i) {
+      ASSERT_GE(Connect(), 0);
+      ASSERT_TRUE(WaitAccepted(i + 1));
+    }
+    // 关掉第二个loop上的连接, 之后的新连接优先分给它
+    ::close(clients_[1]);
+    clients_[1] = -1;
+    ASSERT_TRUE(WaitClosed(1));
+    for (int i = kThreads; i < kThreads + 2; ++i) {
+      int index = Connect();
+      ASSERT_GE(index, 0);
+      ASSERT_TRUE(WaitAccepted(i + 1));
+      EXPECT_TRUE(Echo(index));
+    }
+  });
+  std::vector<alpha::EventLoop*> expected = {
+      pool_.GetLoop(0), pool_.GetLoop(1), pool_.GetLoop(2), pool_.GetLoop(1),
+      pool_.GetLoop(0)};
+  EXPECT_EQ(accepted(), expected);
+}
+
+TEST_F(TcpServerTest, ReusePort) {
+  CreateServer(alpha::TcpServer::Dispatch::kReusePort);
+  ASSERT_TRUE(server_->Run());
+  const int kConnections = 32;
+  RunClient([this] {
+    for (int i = 0; i < kConnections; ++i) {
+      ASSERT_GE(Connect(), 0);
+    }
+    ASSERT_TRUE(WaitAccepted(kConnections));
+    for (int i = 0; i < kConnections; ++i) {
+      EXPECT_TRUE(Echo(i));
+    }
+  });
+  // 连接由内核分发到各个工作线程, 不会经过base loop
+  std::set<alpha::EventLoop*> loops;
+  for (auto loop : accepted()) {
+    EXPECT_NE(loop, &loop_);
+    loops.insert(loop);
+  }
+  EXPECT_GT(loops.size(), 1u);
+}
+
+TEST_F(TcpServerTest, RunAgainAfterBindFailure) {
+  // 占住端口, 不设置SO_REUSEPORT, 所有acceptor都绑定不上
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr = alpha::NetAddress("127.0.0.1", port_).ToSockAddr();
+  ASSERT_EQ(::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+  CreateServer(alpha::TcpServer::Dispatch::kReusePort);
+  EXPECT_FALSE(server_->Run());
+  EXPECT_FALSE(pool_.started());
+
+  ::close(fd);
+  ASSERT_TRUE(server_->Run());
+  RunClient([this] {
+    for (int i = 0; i < kThreads; ++i) {
+      ASSERT_GE(Connect(), 0);
+    }
+    ASSERT_TRUE(WaitAccepted(kThreads));
+  });
+  EXPECT_EQ(accepted().size(), static_cast<size_t>(kThreads));
+}
+
+// 边缘触发的acceptor在一次可读事件中要accept到EAGAIN为止,
+// 否则同时到达的连接只会被accept一个, 剩下的不会再有通知
+TEST_F(TcpServerTest, EdgeTriggeredAcceptDrainsBacklog) {
+  server_.reset(
+      new alpha::TcpServer(&loop_, alpha::NetAddress("127.0.0.1", port_)));
+  server_->set_edge_triggered(true);
+  const int kConnections = 64;
+  int accepted = 0;
+  server_->SetOnNewConnection([this, &accepted](alpha::TcpConnectionPtr conn) {
+    EXPECT_TRUE(conn->edge_triggered());
+    if (++accepted == kConnections) loop_.Quit();
+  });
+  ASSERT_TRUE(server_->Run());
+  // 排在Listen之后执行, 所有连接都在下一次epoll_wait之前进入backlog
+  loop_.QueueInLoop([this] {
+    for (int i = 0; i < kConnections; ++i) {
+      ASSERT_GE(Connect(), 0);
+    }
+  });
+  loop_.RunAfter(2000, [this] { loop_.Quit(); });
+  loop_.Run();
+  EXPECT_EQ(accepted, kConnections);
+}
+
+// fd用完时等待中的连接要被accept之后关闭, 否则边缘触发时不会再有通知,
+// 后面释放了fd也accept不到它们
+TEST_F(TcpServerTest, EdgeTriggeredAcceptOutOfFiles) {
+  server_.reset(
+      new alpha::TcpServer(&loop_, alpha::NetAddress("127.0.0.1", port_)));
+  server_->set_edge_triggered(true);
+  const int kConnections = 8;
+  const int kFreeFiles = 3;
+  std::vector<alpha::TcpConnectionPtr> conns;
+  server_->SetOnNewConnection(
+      [&conns](alpha::TcpConnectionPtr conn) { conns.push_back(conn); });
+  ASSERT_TRUE(server_->Run());
+  struct rlimit old_limit;
+  ASSERT_EQ(::getrlimit(RLIMIT_NOFILE, &old_limit), 0);
+  loop_.QueueInLoop([this, &old_limit] {
+    for (int i = 0; i < kConnections; ++i) {
+      ASSERT_GE(Connect(), 0);
+    }
+    // 只剩kFreeFiles个fd可用
+    int next_fd = ::dup(0);
+    ::close(next_fd);
+    struct rlimit limit = old_limit;
+    limit.rlim_cur = next_fd + kFreeFiles;
+    ASSERT_EQ(::setrlimit(RLIMIT_NOFILE, &limit), 0);
+  });
+  loop_.RunAfter(200, [this] { loop_.Quit(); });
+  loop_.Run();
+  ASSERT_EQ(::setrlimit(RLIMIT_NOFILE, &old_limit), 0);
+
+  EXPECT_EQ(conns.size(), static_cast<size_t>(kFreeFiles));
+  int dropped = 0;
+  for (int fd : clients_) {
+    char c;
+    dropped += ::recv(fd, &c, 1, MSG_DONTWAIT) == 0;
+  }
+  EXPECT_EQ(dropped, kConnections - kFreeFiles);
+}
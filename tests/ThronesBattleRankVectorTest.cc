@@ -0,0 +1,207 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  ThronesBattleRankVectorTest.cc
+ *        Created:  10/18/26 23:48:20
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <unistd.h>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/FileUtil.h>
+#include <alpha/experimental/RegionBasedVector.h>
+#include "examples/ThronesBattleServer/ThronesBattleSvrdRankVector.h"
+
+using ThronesBattle::RankKey;
+using ThronesBattle::RankVector;
+using ThronesBattle::RankVectorUnit;
+
+class RankVectorTest : public ::testing::Test {
+ protected:
+  static const size_t kRankMax = 100;
+  static const size_t kRegionSize = 1 << 16;
+  // 和RankVector内部的布局一致, 用来直接构造数据
+  struct Header {
+    uint64_t magic;
+    uint32_t next_seq;
+    uint32_t list_size;
+  };
+  using ListType = alpha::IndexedSkipList<RankKey,
+                                          uint32_t,
+                                          12,
+                                          ThronesBattle::RankKeyGreater>;
+
+  RankVectorTest() : region_(kRegionSize / sizeof(uint64_t) + 1) {
+    data_ = alpha::Align(reinterpret_cast<char*>(region_.data()));
+    backup_ = "/tmp/alpha_rank_vector_test." + std::to_string(getpid());
+    ::unlink(backup_.c_str());
+  }
+
+  ~RankVectorTest() { ::unlink(backup_.c_str()); }
+
+  // 旧的布局是按val从大到小排好序的RegionBasedVector
+  void CreateLegacy(const std::vector<RankVectorUnit>& units) {
+    using LegacyVectorType = alpha::RegionBasedVector<RankVectorUnit>;
+    auto v = LegacyVectorType::Create(data_, kRegionSize);
+    ASSERT_NE(v, nullptr);
+    for (const auto& u : units) {
+      v->push_back(u);
+    }
+  }
+
+  bool BackupExists() const { return ::access(backup_.c_str(), F_OK) == 0; }
+
+  // 模拟Report时插入了新的节点, 还没来得及更新索引就退出了
+  void InsertWithoutIndex(uint32_t uin, uint32_t val) {
+    auto header = reinterpret_cast<Header*>(data_);
+    auto list = ListType::Restore(data_ + sizeof(Header), header->list_size);
+    ASSERT_NE(list, nullptr);
+    RankKey key;
+    key.val = val;
+    key.seq = header->next_seq++;
+    ASSERT_TRUE(list->insert(std::make_pair(key, uin)).second);
+  }
+
+  void ExpectUnits(const RankVector& rank,
+                   const std::vector<RankVectorUnit>& expected) {
+    auto units = rank.GetRange(0, kRankMax);
+    ASSERT_EQ(units.size(), expected.size());
+    for (size_t i = 0; i < units.size(); ++i) {
+      EXPECT_EQ(units[i].uin, expected[i].uin) << i;
+      EXPECT_EQ(units[i].val, expected[i].val) << i;
+      EXPECT_EQ(rank.Rank(expected[i].uin), i + 1);
+    }
+  }
+
+  std::vector<uint64_t> region_;
+  char* data_;
+  std::string backup_;
+};
+
+const size_t RankVectorTest::kRankMax;
+const size_t RankVectorTest::kRegionSize;
+
+TEST_F(RankVectorTest, GetRangeOutOfBounds) {
+  RankVector rank(kRankMax);
+  ASSERT_TRUE(rank.CreateFrom(data_, kRegionSize));
+  for (uint32_t uin = 1; uin <= 10; ++uin) {
+    rank.Report(uin, uin);
+  }
+  const auto kMaxNum = std::numeric_limits<unsigned>::max();
+  EXPECT_TRUE(rank.GetRange(10, 1).empty());
+  EXPECT_TRUE(rank.GetRange(11, kMaxNum).empty());
+  EXPECT_TRUE(rank.GetRange(kMaxNum, kMaxNum).empty());
+  auto units = rank.GetRange(8, kMaxNum);
+  ASSERT_EQ(units.size(), 2u);
+  EXPECT_EQ(units[0].uin, 2u);
+  EXPECT_EQ(units[1].uin, 1u);
+}
+
+TEST_F(RankVectorTest, RestoreLegacy) {
+  std::vector<RankVectorUnit> expected = {
+      {7, 30}, {3, 20}, {5, 20}, {1, 20}, {9, 10}};
+  CreateLegacy(expected);
+  std::vector<char> legacy(data_, data_ + kRegionSize);
+  // 没有备份文件时不转换, 数据不变
+  EXPECT_FALSE(RankVector(kRankMax).RestoreFrom(data_, kRegionSize));
+  EXPECT_EQ(memcmp(legacy.data(), data_, kRegionSize), 0);
+
+  RankVector rank(kRankMax);
+  ASSERT_TRUE(rank.RestoreFrom(data_, kRegionSize, backup_));
+  EXPECT_EQ(rank.Size(), expected.size());
+  // val相同的保持原来的先后
+  ExpectUnits(rank, expected);
+  // 转换完成之后删掉备份
+  EXPECT_FALSE(BackupExists());
+
+  // 转换之后按新的布局恢复
+  RankVector restored(kRankMax);
+  ASSERT_TRUE(restored.RestoreFrom(data_, kRegionSize));
+  ExpectUnits(restored, expected);
+  restored.Report(9, 25);
+  ExpectUnits(restored, {{7, 30}, {9, 25}, {3, 20}, {5, 20}, {1, 20}});
+}
+
+TEST_F(RankVectorTest, RestoreLegacyTooLarge) {
+  std::vector<RankVectorUnit> units;
+  for (uint32_t i = 0; i <= kRankMax; ++i) {
+    units.push_back({i + 1, static_cast<uint32_t>(kRankMax - i)});
+  }
+  CreateLegacy(units);
+  std::vector<char> backup(data_, data_ + kRegionSize);
+  RankVector rank(kRankMax);
+  EXPECT_FALSE(rank.RestoreFrom(data_, kRegionSize, backup_));
+  // 转换失败时原来的数据不变
+  EXPECT_EQ(memcmp(backup.data(), data_, kRegionSize), 0);
+  EXPECT_FALSE(BackupExists());
+}
+
+TEST_F(RankVectorTest, RestoreLegacyAfterCrash) {
+  std::vector<RankVectorUnit> expected = {{7, 30}, {3, 20}, {9, 10}};
+  CreateLegacy(expected);
+  // 模拟转换到一半崩溃: 备份已经写好, 原来的内存已经被部分覆盖
+  ASSERT_TRUE(alpha::WriteFileAtomically(backup_, data_, kRegionSize));
+  {
+    RankVector rank(kRankMax);
+    ASSERT_TRUE(rank.CreateFrom(data_, kRegionSize));
+    rank.Report(7, 30);
+  }
+  reinterpret_cast<Header*>(data_)->magic = 0x3c5a1f0e7b2d4e60;
+  // 没有备份文件时不能恢复
+  EXPECT_FALSE(RankVector(kRankMax).RestoreFrom(data_, kRegionSize));
+
+  RankVector rank(kRankMax);
+  ASSERT_TRUE(rank.RestoreFrom(data_, kRegionSize, backup_));
+  ExpectUnits(rank, expected);
+  EXPECT_FALSE(BackupExists());
+  RankVector restored(kRankMax);
+  ASSERT_TRUE(restored.RestoreFrom(data_, kRegionSize));
+  ExpectUnits(restored, expected);
+}
+
+TEST_F(RankVectorTest, RebuildIndex) {
+  {
+    RankVector rank(kRankMax);
+    ASSERT_TRUE(rank.CreateFrom(data_, kRegionSize));
+    rank.Report(1, 10);
+    rank.Report(2, 20);
+    rank.Report(3, 30);
+  }
+  // 新的节点已经插入, 旧的节点和索引都还没更新
+  InsertWithoutIndex(1, 40);
+
+  RankVector rank(kRankMax);
+  ASSERT_TRUE(rank.RestoreFrom(data_, kRegionSize));
+  // 只保留最新的那一条
+  EXPECT_EQ(rank.Size(), 3u);
+  ExpectUnits(rank, {{1, 40}, {3, 30}, {2, 20}});
+  rank.Report(2, 50);
+  ExpectUnits(rank, {{2, 50}, {1, 40}, {3, 30}});
+}
+
+TEST_F(RankVectorTest, RebuildIndexWhenFull) {
+  {
+    RankVector rank(kRankMax);
+    ASSERT_TRUE(rank.CreateFrom(data_, kRegionSize));
+    for (uint32_t uin = 1; uin <= kRankMax; ++uin) {
+      rank.Report(uin, uin + 100);
+    }
+  }
+  // 榜已经满了, 新上榜的插入之后还没来得及删掉最后一名
+  InsertWithoutIndex(kRankMax + 1, 1000);
+
+  RankVector rank(kRankMax);
+  ASSERT_TRUE(rank.RestoreFrom(data_, kRegionSize));
+  EXPECT_EQ(rank.Size(), kRankMax);
+  EXPECT_EQ(rank.Rank(kRankMax + 1), 1u);
+  EXPECT_EQ(rank.Rank(1), 0u);
+  EXPECT_EQ(rank.Rank(2), kRankMax);
+}
@@ -0,0 +1,118 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  TimerManagerTest.cc
+ *        Created:  10/18/26 10:12:35
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/TimerManager.h>
+
+class TimerManagerTest
+    : public ::testing::TestWithParam<alpha::TimerManager::Backend> {
+ protected:
+  TimerManagerTest() : timers_(GetParam()), now_(alpha::Now()) {}
+
+  alpha::TimerManager timers_;
+  alpha::TimeStamp now_;
+};
+
+TEST_P(TimerManagerTest, FireInOrder) {
+  std::vector<int> fired;
+  timers_.AddTimer(now_ + 30, [&fired] { fired.push_back(3); });
+  timers_.AddTimer(now_ + 10, [&fired] { fired.push_back(1); });
+  timers_.AddTimer(now_ + 20, [&fired] { fired.push_back(2); });
+  EXPECT_EQ(timers_.Fire(now_ + 9), 0u);
+  EXPECT_EQ(timers_.Fire(now_ + 10), 1u);
+  EXPECT_EQ(timers_.Fire(now_ + 100), 2u);
+  EXPECT_EQ(fired, (std::vector<int>{1, 2, 3}));
+}
+
+TEST_P(TimerManagerTest, Step) {
+  int count = 0;
+  auto id = timers_.AddTimer(now_ + 5, [&count] { ++count; });
+  EXPECT_FALSE(timers_.Expired(id));
+  auto functors = timers_.Step(now_ + 5);
+  ASSERT_EQ(functors.size(), 1u);
+  EXPECT_TRUE(timers_.Expired(id));
+  functors[0]();
+  EXPECT_EQ(count, 1);
+}
+
+TEST_P(TimerManagerTest, RemoveTimer) {
+  int count = 0;
+  auto id = timers_.AddTimer(now_ + 5, [&count] { ++count; });
+  EXPECT_NE(id, 0u);
+  timers_.RemoveTimer(id);
+  EXPECT_TRUE(timers_.Expired(id));
+  timers_.RemoveTimer(id);
+  EXPECT_EQ(timers_.Fire(now_ + 10), 0u);
+  EXPECT_EQ(count, 0);
+}
+
+TEST_P(TimerManagerTest, PeriodicalTimer) {
+  int count = 0;
+  auto id = timers_.AddPeriodicalTimer(now_ + 10, 10, [&count] { ++count; });
+  for (int i = 1; i <= 5; ++i) {
+    timers_.Fire(now_ + i * 10);
+  }
+  EXPECT_EQ(count, 5);
+  EXPECT_FALSE(timers_.Expired(id));
+  timers_.RemoveTimer(id);
+  EXPECT_TRUE(timers_.Expired(id));
+  timers_.Fire(now_ + 100);
+  EXPECT_EQ(count, 5);
+}
+
+TEST_P(TimerManagerTest, RemoveInsideCallback) {
+  int count = 0;
+  alpha::TimerManager::TimerId id = 0;
+  id = timers_.AddPeriodicalTimer(now_ + 1, 1, [this, &id, &count] {
+    if (++count == 3) {
+      timers_.RemoveTimer(id);
+    }
+  });
+  for (int i = 1; i <= 10; ++i) {
+    timers_.Fire(now_ + i);
+  }
+  EXPECT_EQ(count, 3);
+  EXPECT_TRUE(timers_.Expired(id));
+}
+
+TEST_P(TimerManagerTest, AddInsideCallback) {
+  int count = 0;
+  timers_.AddTimer(now_ + 1, [this, &count] {
+    ++count;
+    timers_.AddTimer(now_ + 1, [&count] { ++count; });
+  });
+  timers_.Fire(now_ + 1);
+  EXPECT_EQ(count, 1);
+  timers_.Fire(now_ + 2);
+  EXPECT_EQ(count, 2);
+}
+
+TEST_P(TimerManagerTest, LongTimeout) {
+  const alpha::TimeStamp kDelays[] = {255, 256, 16383, 16384, 1 << 20,
+                                      (1 << 26) + 7};
+  int count = 0;
+  for (auto delay : kDelays) {
+    timers_.AddTimer(now_ + delay, [&count] { ++count; });
+  }
+  for (auto delay : kDelays) {
+    EXPECT_EQ(timers_.Fire(now_ + delay - 1), 0u);
+    EXPECT_EQ(timers_.Fire(now_ + delay), 1u);
+  }
+  EXPECT_EQ(count, 6);
+}
+
+INSTANTIATE_TEST_CASE_P(
+    Backends,
+    TimerManagerTest,
+    ::testing::Values(alpha::TimerManager::Backend::kTree,
+                      alpha::TimerManager::Backend::kTimingWheel));
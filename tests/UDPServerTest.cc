@@ -0,0 +1,255 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  UDPServerTest.cc
+ *        Created:  10/18/26 21:12:40
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:
+ *
+ * =============================================================================
+ */
+
+#include <poll.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <alpha/EventLoop.h>
+#include <alpha/EventLoopThreadPool.h>
+#include <alpha/UDPServer.h>
+#include <alpha/UDPSocket.h>
+
+class UDPServerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // 先绑定0端口拿到一个空闲端口
+    alpha::UDPSocket probe;
+    ASSERT_EQ(probe.Open(), 0);
+    ASSERT_EQ(probe.Bind(alpha::NetAddress("127.0.0.1", 0)), 0);
+    alpha::NetAddress local;
+    ASSERT_EQ(probe.GetLocalAddress(&local), 0);
+    address_ = local;
+    probe.Close();
+    ASSERT_EQ(client_.Open(), 0);
+  }
+
+  // 客户端一次发出所有报文
+  void SendAll(std::vector<std::string>* payloads) {
+    SendAll(&client_, payloads);
+  }
+
+  void SendAll(alpha::UDPSocket* client, std::vector<std::string>* payloads) {
+    std::vector<alpha::UDPDatagram> datagrams;
+    for (auto& payload : *payloads) {
+      datagrams.push_back({&payload[0], payload.size(), address_});
+    }
+    int sent = 0;
+    while (sent < static_cast<int>(datagrams.size())) {
+      int n = client->SendBatch(datagrams.data() + sent,
+                                static_cast<int>(datagrams.size()) - sent);
+      ASSERT_GT(n, 0);
+      sent += n;
+    }
+  }
+
+  std::vector<std::string> ReceiveReplies(size_t expected) {
+    std::vector<std::string> replies;
+    std::vector<char> buffer(expected * 128);
+    std::vector<alpha::UDPDatagram> datagrams(expected);
+    while (replies.size() < expected) {
+      struct pollfd pfd = {client_.fd(), POLLIN, 0};
+      if (::poll(&pfd, 1, 1000) != 1) break;
+      for (size_t i = 0; i < expected; ++i) {
+        datagrams[i].data = buffer.data() + i * 128;
+        datagrams[i].len = 128;
+      }
+      int n = client_.RecvBatch(datagrams.data(),
+                                static_cast<int>(expected - replies.size()));
+      for (int i = 0; i < n; ++i) {
+        replies.emplace_back(datagrams[i].data, datagrams[i].len);
+      }
+    }
+    return replies;
+  }
+
+  alpha::NetAddress address_;
+  alpha::UDPSocket client_;
+  alpha::EventLoop loop_;
+};
+
+TEST_F(UDPServerTest, BatchEcho) {
+  const int kMessages = 100;
+  alpha::UDPServer server(&loop_);
+  server.set_batch_size(16);
+  int received = 0;
+  int max_batch = 0;
+  server.SetBatchMessageCallback([&](alpha::UDPSocket* socket,
+                                     alpha::UDPDatagram* datagrams,
+                                     int count) {
+    // 原地回包, 报文的地址就是回包的目的地址
+    int sent = 0;
+    while (sent < count) {
+      int n = socket->SendBatch(datagrams + sent, count - sent);
+      ASSERT_GT(n, 0);
+      sent += n;
+    }
+    max_batch = std::max(max_batch, count);
+    received += count;
+    if (received == kMessages) loop_.Quit();
+  });
+  ASSERT_TRUE(server.Run(address_));
+
+  std::vector<std::string> payloads;
+  for (int i = 0; i < kMessages; ++i) {
+    payloads.push_back("message " + std::to_string(i));
+  }
+  SendAll(&payloads);
+  loop_.Run();
+  EXPECT_EQ(received, kMessages);
+  // 消息在loop运行之前就已经到了, 每次都能收满一批
+  EXPECT_EQ(max_batch, 16);
+  EXPECT_EQ(ReceiveReplies(kMessages), payloads);
+}
+
+TEST_F(UDPServerTest, MessageCallbackAndTruncation) {
+  alpha::UDPServer server(&loop_);
+  server.set_max_datagram_size(16);
+  std::vector<std::string> received;
+  server.SetMessageCallback([&](alpha::UDPSocket* socket,
+                                alpha::IOBuffer* buf,
+                                size_t buf_len,
+                                const alpha::NetAddress& peer) {
+    received.emplace_back(buf->data(), buf_len);
+    EXPECT_EQ(socket->SendTo(buf, buf_len, peer), static_cast<int>(buf_len));
+    if (received.size() == 2) loop_.Quit();
+  });
+  ASSERT_TRUE(server.Run(address_));
+
+  // 中间那个超过缓冲区大小, 被丢弃
+  std::vector<std::string> payloads = {"short", std::string(100, 'x'), "end"};
+  SendAll(&payloads);
+  loop_.Run();
+  EXPECT_EQ(received, (std::vector<std::string>{"short", "end"}));
+  EXPECT_EQ(ReceiveReplies(2), (std::vector<std::string>{"short", "end"}));
+}
+
+// 多个客户端各发一批报文, 记录每个对端的报文在哪个线程按什么顺序处理
+class UDPServerShardingTest : public UDPServerTest {
+ protected:
+  static const int kClients = 8;
+  // 报文在工作线程开始收之前就都到了, 总数不能超过socket的接收缓冲区
+  static const int kMessages = 20;
+
+  void SetUp() override {
+    UDPServerTest::SetUp();
+    for (int i = 0; i < kClients; ++i) {
+      clients_.emplace_back(new alpha::UDPSocket);
+      ASSERT_EQ(clients_.back()->Open(), 0);
+      // 绑定之后才能拿到本地端口, 用来区分对端
+      ASSERT_EQ(clients_.back()->Bind(alpha::NetAddress("127.0.0.1", 0)), 0);
+    }
+  }
+
+  void Serve(alpha::UDPServer* server) {
+    server->SetBatchMessageCallback([this](alpha::UDPSocket*,
+                                           alpha::UDPDatagram* datagrams,
+                                           int count) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (int i = 0; i < count; ++i) {
+        auto& peer = peers_[datagrams[i].address.port()];
+        peer.threads.insert(std::this_thread::get_id());
+        peer.payloads.emplace_back(datagrams[i].data, datagrams[i].len);
+      }
+      received_ += count;
+      if (received_ == kClients * kMessages) loop_.Quit();
+    });
+    ASSERT_TRUE(server->Run(address_));
+    for (int i = 0; i < kClients; ++i) {
+      std::vector<std::string> payloads;
+      for (int j = 0; j < kMessages; ++j) {
+        payloads.push_back(std::to_string(i) + " " + std::to_string(j));
+      }
+      SendAll(clients_[i].get(), &payloads);
+      expected_.push_back(payloads);
+    }
+    loop_.Run();
+  }
+
+  // 同一个对端的报文只在一个线程中处理, 并且保持发送的顺序
+  std::set<std::thread::id> CheckPeers() {
+    std::set<std::thread::id> threads;
+    std::lock_guard<std::mutex> lock(mutex_);
+    EXPECT_EQ(received_, kClients * kMessages);
+    EXPECT_EQ(peers_.size(), static_cast<size_t>(kClients));
+    for (int i = 0; i < kClients; ++i) {
+      alpha::NetAddress local;
+      EXPECT_EQ(clients_[i]->GetLocalAddress(&local), 0);
+      auto& peer = peers_[local.port()];
+      EXPECT_EQ(peer.threads.size(), 1u);
+      EXPECT_EQ(peer.payloads, expected_[i]);
+      threads.insert(peer.threads.begin(), peer.threads.end());
+    }
+    return threads;
+  }
+
+  struct Peer {
+    std::set<std::thread::id> threads;
+    std::vector<std::string> payloads;
+  };
+  std::vector<std::unique_ptr<alpha::UDPSocket>> clients_;
+  std::vector<std::vector<std::string>> expected_;
+  std::mutex mutex_;
+  std::map<int, Peer> peers_;
+  int received_ = 0;
+};
+
+TEST_F(UDPServerShardingTest, ReusePort) {
+  alpha::EventLoopThreadPool pool(&loop_, 2);
+  pool.SetCpuAffinity({0});
+  alpha::UDPServer server(&loop_);
+  server.SetThreadPool(&pool);
+  Serve(&server);
+  auto threads = CheckPeers();
+  EXPECT_EQ(threads.count(std::this_thread::get_id()), 0u);
+}
+
+TEST_F(UDPServerShardingTest, Steering) {
+  alpha::EventLoopThreadPool pool(&loop_, 3);
+  alpha::UDPServer server(&loop_);
+  server.SetThreadPool(&pool);
+  // 所有对端都交给第一个工作线程
+  server.SetSteeringCallback([](const alpha::NetAddress&) { return 3; });
+  Serve(&server);
+  auto threads = CheckPeers();
+  EXPECT_EQ(threads.size(), 1u);
+  EXPECT_EQ(threads.count(std::this_thread::get_id()), 0u);
+}
+
+TEST_F(UDPServerShardingTest, DispatchToBaseLoop) {
+  alpha::EventLoopThreadPool pool(&loop_, 2);
+  alpha::UDPServer server(&loop_);
+  server.SetThreadPool(&pool);
+  server.set_dispatch_to_base_loop(true);
+  Serve(&server);
+  auto threads = CheckPeers();
+  EXPECT_EQ(threads, std::set<std::thread::id>{std::this_thread::get_id()});
+}
+
+TEST_F(UDPServerShardingTest, RunAgainAfterBindFailure) {
+  alpha::EventLoopThreadPool pool(&loop_, 2);
+  alpha::UDPServer server(&loop_);
+  server.SetThreadPool(&pool);
+  // 端口被占用时Run失败, 已经创建的socket都关闭, 之后可以再次Run
+  alpha::UDPSocket blocker;
+  ASSERT_EQ(blocker.Open(), 0);
+  ASSERT_EQ(blocker.Bind(address_), 0);
+  EXPECT_FALSE(server.Run(address_));
+  blocker.Close();
+  Serve(&server);
+  CheckPeers();
+}
@@ -0,0 +1,59 @@
+/*
+ * =============================================================================
+ *
+ *       Filename:  HTTPMessageCodecAllocationTest.cc
+ *        Created:  10/18/26 23:31:44
+ *         Author:  Peng Wang
+ *          Email:  pw2191195@gmail.com
+ *    Description:  替换了全局operator new, 单独编译成一个测试程序,
+ *                  不影响gtest-all里的其他测试
+ *
+ * =============================================================================
+ */
+
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <gtest/gtest.h>
+#include <alpha/HTTPMessageCodec.h>
+#include <alpha/HTTPRequest.h>
+
+// 统计当前线程的内存分配次数
+static thread_local bool count_allocations = false;
+static thread_local int allocations = 0;
+
+void* operator new(size_t size) {
+  if (count_allocations) ++allocations;
+  void* p = std::malloc(size ? size : 1);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+TEST(HTTPMessageCodecTest, ProcessInPlaceWithoutAllocation) {
+  std::string buffer =
+      "GET /status?uin=1 HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "User-Agent: curl/7.64.1\r\n"
+      "Accept: */*\r\n"
+      "\r\n";
+  alpha::HTTPMessageCodec codec;
+  alpha::HTTPRequest request;
+  allocations = 0;
+  count_allocations = true;
+  for (int i = 0; i < 100; ++i) {
+    alpha::Slice data(buffer);
+    auto status = codec.ProcessInPlace(data, &request);
+    bool ok = status == alpha::HTTPMessageCodec::kDone &&
+              request.Header("user-agent") == "curl/7.64.1" &&
+              request.Param("uin") == "1";
+    codec.Reset();
+    if (!ok) break;
+  }
+  count_allocations = false;
+  EXPECT_EQ(allocations, 0);
+  EXPECT_EQ(codec.bytes_processed(), 100 * buffer.size());
+}